@@ -0,0 +1,40 @@
+#
+# This module detects if Google Benchmark is installed and determines where the
+# include files and libraries are.
+#
+# This code sets the following variables:
+#
+# BENCHMARK_LIBRARIES       = full path to the benchmark libraries
+# BENCHMARK_INCLUDE_DIR     = include dir to be used when using the benchmark library
+# BENCHMARK_FOUND           = set to true if benchmark was found successfully
+#
+# BENCHMARK_LOCATION
+#   setting this enables search for benchmark libraries / headers in this location
+
+
+# -----------------------------------------------------
+# BENCHMARK Libraries
+# -----------------------------------------------------
+find_library(BENCHMARK_LIBRARIES
+    NAMES benchmark
+    HINTS ${BENCHMARK_LOCATION}/lib ${BENCHMARK_LOCATION}/lib64
+          ${BENCHMARK_LOCATION}/lib32
+    DOC "The main benchmark library"
+)
+
+# -----------------------------------------------------
+# BENCHMARK Include Directories
+# -----------------------------------------------------
+find_path(BENCHMARK_INCLUDE_DIR
+    NAMES benchmark/benchmark.h
+    HINTS ${BENCHMARK_LOCATION} ${BENCHMARK_LOCATION}/include
+    DOC "The benchmark include directory"
+)
+
+# -----------------------------------------------------
+# handle the QUIETLY and REQUIRED arguments and set BENCHMARK_FOUND to TRUE if
+# all listed variables are TRUE
+# -----------------------------------------------------
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(BENCHMARK DEFAULT_MSG BENCHMARK_LIBRARIES BENCHMARK_INCLUDE_DIR)
+mark_as_advanced(BENCHMARK_INCLUDE_DIR BENCHMARK_LIBRARIES)
@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <gfal_api.h>
+#include <common/gfal_plugin.h>
+#include <common/gfal_handle.h>
+#include "gfal_async.h"
+#include "gfal_file_handler_container.h"
+
+#define GFAL2_ASYNC_DEFAULT_THREADS 8
+
+
+struct gfal2_async_queue_s {
+    gfal2_context_t context;
+    GThreadPool* pool;
+    GMutex* lock;
+    GCond* idle;
+    GQueue completed;
+    int pending;
+    int efd;
+    // At least one loaded plugin implements async_submitG
+    gboolean native;
+};
+
+
+static void gfal2_async_signal(gfal2_async_queue_t queue)
+{
+    uint64_t one = 1;
+    if (write(queue->efd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        gfal2_log(G_LOG_LEVEL_WARNING, "Failed to signal the async completion queue: %s", strerror(errno));
+    }
+}
+
+
+static void gfal2_async_drain(gfal2_async_queue_t queue)
+{
+    uint64_t counter;
+    while (read(queue->efd, &counter, sizeof(counter)) > 0)
+        ;
+}
+
+
+void gfal2_async_complete(gfal2_async_request_t req, ssize_t result, GError* error)
+{
+    gfal2_async_queue_t queue = req->queue;
+
+    req->result = result;
+    req->error = error;
+
+    g_mutex_lock(queue->lock);
+    g_queue_push_tail(&queue->completed, req);
+    --queue->pending;
+    gfal2_async_signal(queue);
+    g_cond_broadcast(queue->idle);
+    g_mutex_unlock(queue->lock);
+}
+
+
+static plugin_mode gfal2_async_plugin_mode(gfal2_async_op_t op)
+{
+    switch (op) {
+        case GFAL2_ASYNC_STAT:
+            return GFAL_PLUGIN_STAT;
+        case GFAL2_ASYNC_LSTAT:
+            return GFAL_PLUGIN_LSTAT;
+        case GFAL2_ASYNC_ACCESS:
+            return GFAL_PLUGIN_ACCESS;
+        case GFAL2_ASYNC_UNLINK:
+            return GFAL_PLUGIN_UNLINK;
+        case GFAL2_ASYNC_MKDIR:
+            return GFAL_PLUGIN_MKDIR;
+        case GFAL2_ASYNC_RMDIR:
+            return GFAL_PLUGIN_RMDIR;
+        case GFAL2_ASYNC_CHECKSUM:
+            return GFAL_PLUGIN_CHECKSUM;
+        default:
+            return GFAL_PLUGIN_ALL;
+    }
+}
+
+
+// Offer the request to the plugin handling it
+// Returns 1 if the plugin took ownership of the request, 0 if it must be run by a worker
+static int gfal2_async_submit_native(gfal2_async_queue_t queue, gfal2_async_request_t req)
+{
+    GError* tmp_err = NULL;
+    gfal_plugin_interface* p = NULL;
+    gfal_file_handle fh = NULL;
+
+    switch (req->op) {
+        case GFAL2_ASYNC_CALL:
+            return 0;
+        case GFAL2_ASYNC_PREAD:
+        case GFAL2_ASYNC_PWRITE:
+            fh = gfal_file_handle_bind(queue->context->fdescs, req->fd, &tmp_err);
+            if (fh) {
+                p = gfal_plugin_map_file_handle(queue->context, fh, &tmp_err);
+            }
+            break;
+        default:
+            if (req->url) {
+                p = gfal_find_plugin(queue->context, req->url, gfal2_async_plugin_mode(req->op), &tmp_err);
+            }
+    }
+
+    // Errors are reported by the synchronous path
+    if (tmp_err || p == NULL || p->async_submitG == NULL) {
+        g_clear_error(&tmp_err);
+        return 0;
+    }
+
+    int ret = p->async_submitG(gfal_get_plugin_handle(p), queue->context, req, fh, &tmp_err);
+    if (ret < 0) {
+        gfal2_async_complete(req, -1, tmp_err);
+        return 1;
+    }
+    return ret > 0;
+}
+
+
+static void gfal2_async_execute(gpointer data, gpointer user_data)
+{
+    gfal2_async_request_t req = (gfal2_async_request_t)data;
+    gfal2_context_t context = ((gfal2_async_queue_t)user_data)->context;
+    GError* tmp_err = NULL;
+    ssize_t res = -1;
+
+    switch (req->op) {
+        case GFAL2_ASYNC_STAT:
+            res = gfal2_stat(context, req->url, &req->stat, &tmp_err);
+            break;
+        case GFAL2_ASYNC_LSTAT:
+            res = gfal2_lstat(context, req->url, &req->stat, &tmp_err);
+            break;
+        case GFAL2_ASYNC_ACCESS:
+            res = gfal2_access(context, req->url, req->mode, &tmp_err);
+            break;
+        case GFAL2_ASYNC_UNLINK:
+            res = gfal2_unlink(context, req->url, &tmp_err);
+            break;
+        case GFAL2_ASYNC_MKDIR:
+            res = gfal2_mkdir(context, req->url, req->mode, &tmp_err);
+            break;
+        case GFAL2_ASYNC_RMDIR:
+            res = gfal2_rmdir(context, req->url, &tmp_err);
+            break;
+        case GFAL2_ASYNC_PREAD:
+            res = gfal2_pread(context, req->fd, req->buffer, req->size, req->offset, &tmp_err);
+            break;
+        case GFAL2_ASYNC_PWRITE:
+            res = gfal2_pwrite(context, req->fd, req->buffer, req->size, req->offset, &tmp_err);
+            break;
+        case GFAL2_ASYNC_CHECKSUM:
+            res = gfal2_checksum(context, req->url, req->checksum_type, req->offset, req->length,
+                req->buffer, req->size, &tmp_err);
+            break;
+        case GFAL2_ASYNC_CALL:
+            if (req->func) {
+                res = req->func(context, req, &tmp_err);
+            }
+            else {
+                gfal2_set_error(&tmp_err, gfal2_get_core_quark(), EINVAL, __func__,
+                    "Generic asynchronous call without a function");
+            }
+            break;
+        default:
+            gfal2_set_error(&tmp_err, gfal2_get_core_quark(), ENOTSUP, __func__,
+                "Unknown asynchronous operation %d", req->op);
+    }
+
+    gfal2_async_complete(req, res, tmp_err);
+}
+
+
+gfal2_async_queue_t gfal2_async_queue_new(gfal2_context_t context, int nthreads, GError** err)
+{
+    g_return_val_err_if_fail(context != NULL, NULL, err, "[gfal2_async_queue_new] Invalid context");
+
+    GError* tmp_err = NULL;
+
+    if (nthreads <= 0) {
+        nthreads = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP, "ASYNC_THREADS",
+            GFAL2_ASYNC_DEFAULT_THREADS);
+    }
+    if (nthreads <= 0) {
+        nthreads = 1;
+    }
+
+    gfal2_async_queue_t queue = g_new0(struct gfal2_async_queue_s, 1);
+    queue->context = context;
+    queue->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (queue->efd < 0) {
+        gfal2_set_error(err, gfal2_get_core_quark(), errno, __func__,
+            "Could not create the completion event descriptor: %s", strerror(errno));
+        g_free(queue);
+        return NULL;
+    }
+
+    queue->pool = g_thread_pool_new(gfal2_async_execute, queue, nthreads, FALSE, &tmp_err);
+    if (queue->pool == NULL) {
+        close(queue->efd);
+        g_free(queue);
+        gfal2_propagate_prefixed_error(err, tmp_err, __func__);
+        return NULL;
+    }
+
+    queue->lock = g_mutex_new();
+    queue->idle = g_cond_new();
+    g_queue_init(&queue->completed);
+
+    int i, n = gfal_plugins_instance(context, NULL);
+    for (i = 0; i < n; ++i) {
+        if (context->plugin_opt.plugin_list[i].async_submitG) {
+            queue->native = TRUE;
+            break;
+        }
+    }
+
+    return queue;
+}
+
+
+void gfal2_async_queue_free(gfal2_async_queue_t queue)
+{
+    if (queue == NULL) {
+        return;
+    }
+
+    g_thread_pool_free(queue->pool, FALSE, TRUE);
+
+    // Native requests are not tracked by the pool
+    g_mutex_lock(queue->lock);
+    while (queue->pending > 0) {
+        g_cond_wait(queue->idle, queue->lock);
+    }
+    g_mutex_unlock(queue->lock);
+
+    g_queue_clear(&queue->completed);
+    g_cond_free(queue->idle);
+    g_mutex_free(queue->lock);
+    close(queue->efd);
+    g_free(queue);
+}
+
+
+int gfal2_async_get_fd(gfal2_async_queue_t queue)
+{
+    return queue->efd;
+}
+
+
+int gfal2_async_get_pending(gfal2_async_queue_t queue)
+{
+    g_mutex_lock(queue->lock);
+    int pending = queue->pending;
+    g_mutex_unlock(queue->lock);
+    return pending;
+}
+
+
+int gfal2_async_submit(gfal2_async_queue_t queue, gfal2_async_request_t req, GError** err)
+{
+    g_return_val_err_if_fail(queue != NULL && req != NULL, -1, err, "[gfal2_async_submit] Invalid arguments");
+
+    GError* tmp_err = NULL;
+
+    req->queue = queue;
+    req->result = -1;
+    req->error = NULL;
+
+    g_mutex_lock(queue->lock);
+    ++queue->pending;
+    g_mutex_unlock(queue->lock);
+
+    if (queue->native && gfal2_async_submit_native(queue, req)) {
+        return 0;
+    }
+
+    g_thread_pool_push(queue->pool, req, &tmp_err);
+    if (tmp_err) {
+        g_mutex_lock(queue->lock);
+        --queue->pending;
+        g_cond_broadcast(queue->idle);
+        g_mutex_unlock(queue->lock);
+        gfal2_propagate_prefixed_error(err, tmp_err, __func__);
+        return -1;
+    }
+    return 0;
+}
+
+
+int gfal2_async_poll(gfal2_async_queue_t queue, gfal2_async_request_t* completed, int max, int timeout)
+{
+    int count = 0;
+    // Signals and spurious wake-ups do not shorten the wait
+    gint64 deadline = timeout > 0 ? g_get_monotonic_time() + (gint64)timeout * 1000 : 0;
+
+    while (1) {
+        g_mutex_lock(queue->lock);
+        gfal2_async_drain(queue);
+        while (count < max && !g_queue_is_empty(&queue->completed)) {
+            completed[count++] = g_queue_pop_head(&queue->completed);
+        }
+        // Keep the descriptor readable while there are leftovers
+        if (!g_queue_is_empty(&queue->completed)) {
+            gfal2_async_signal(queue);
+        }
+        g_mutex_unlock(queue->lock);
+
+        if (count > 0 || timeout == 0) {
+            break;
+        }
+
+        int remaining = timeout;
+        if (timeout > 0) {
+            gint64 left = deadline - g_get_monotonic_time();
+            if (left <= 0) {
+                break;
+            }
+            remaining = (int)((left + 999) / 1000);
+        }
+
+        struct pollfd pfd = {queue->efd, POLLIN, 0};
+        int ret = poll(&pfd, 1, remaining);
+        if (ret < 0 && errno != EINTR) {
+            break;
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef GFAL_ASYNC_H_
+#define GFAL_ASYNC_H_
+
+#if !defined(__GFAL2_H_INSIDE__) && !defined(__GFAL2_BUILD__)
+#   warning "Direct inclusion of gfal2 headers is deprecated. Please, include only gfal_api.h or gfal_plugins_api.h"
+#endif
+
+#include "gfal_common.h"
+
+#include <glib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @file gfal_async.h
+ * @brief asynchronous submission API
+ *
+ * Requests are submitted to a completion queue and executed either natively by the
+ * plugin handling the url (when it implements async_submitG), or by a pool of worker
+ * threads owned by the queue.
+ * Completed requests are retrieved with \ref gfal2_async_poll. The file descriptor
+ * returned by \ref gfal2_async_get_fd becomes readable when completions are pending,
+ * so the queue can be integrated into an existing poll/epoll event loop.
+ */
+
+typedef struct gfal2_async_queue_s* gfal2_async_queue_t;
+typedef struct gfal2_async_request_s* gfal2_async_request_t;
+
+/**
+ * Operation to execute
+ */
+typedef enum {
+    GFAL2_ASYNC_STAT = 0,   /**< url -> stat, result */
+    GFAL2_ASYNC_LSTAT,      /**< url -> stat, result */
+    GFAL2_ASYNC_ACCESS,     /**< url, mode -> result */
+    GFAL2_ASYNC_UNLINK,     /**< url -> result */
+    GFAL2_ASYNC_MKDIR,      /**< url, mode -> result */
+    GFAL2_ASYNC_RMDIR,      /**< url -> result */
+    GFAL2_ASYNC_PREAD,      /**< fd, buffer, size, offset -> result */
+    GFAL2_ASYNC_PWRITE,     /**< fd, buffer, size, offset -> result */
+    GFAL2_ASYNC_CHECKSUM,   /**< url, checksum_type, offset, length, buffer, size -> result */
+    GFAL2_ASYNC_CALL        /**< func is called with the request */
+} gfal2_async_op_t;
+
+/**
+ * Generic operation executed by a worker for GFAL2_ASYNC_CALL
+ * @return the value stored in result
+ */
+typedef ssize_t (*gfal2_async_func_t)(gfal2_context_t context, gfal2_async_request_t req, GError** err);
+
+/**
+ * Asynchronous request
+ *
+ * The memory of the request, and of the buffers and strings it points to,
+ * is owned by the caller and must remain valid until the request is returned by
+ * \ref gfal2_async_poll
+ */
+struct gfal2_async_request_s {
+    // Input
+    gfal2_async_op_t op;
+    const char* url;
+    const char* url2;           /**< secondary url (i.e. copy destination) */
+    int fd;
+    int mode;
+    void* buffer;
+    size_t size;
+    off_t offset;
+    off_t length;
+    const char* checksum_type;
+    gpointer params;            /**< operation specific parameters (i.e. gfalt_params_t) */
+    gfal2_async_func_t func;
+    gpointer user_data;         /**< never touched by gfal2 */
+
+    // Output
+    ssize_t result;             /**< return value of the equivalent synchronous call */
+    struct stat stat;
+    GError* error;              /**< set on failure, must be freed by the caller */
+
+    //! @cond
+    gfal2_async_queue_t queue;
+    //! @endcond
+};
+
+/**
+ * Create a new completion queue
+ * @param context gfal2 context used to execute the requests. It must outlive the queue.
+ * @param nthreads Number of workers for the operations not supported natively by the plugins.
+ *                 If <= 0, the value of CORE:ASYNC_THREADS is used.
+ * @param err GError error report
+ * @return NULL on failure
+ */
+gfal2_async_queue_t gfal2_async_queue_new(gfal2_context_t context, int nthreads, GError** err);
+
+/**
+ * Free the queue. Blocks until all the submitted requests are completed.
+ * Completed requests not yet polled are dropped.
+ */
+void gfal2_async_queue_free(gfal2_async_queue_t queue);
+
+/**
+ * Get a file descriptor that becomes readable when completed requests are available
+ * The descriptor must not be read or closed by the caller.
+ */
+int gfal2_async_get_fd(gfal2_async_queue_t queue);
+
+/**
+ * Submit a request
+ * @return 0 if the request has been queued, -1 on failure (err is set and the request will never be completed)
+ */
+int gfal2_async_submit(gfal2_async_queue_t queue, gfal2_async_request_t req, GError** err);
+
+/**
+ * Retrieve completed requests
+ * @param queue     The completion queue
+ * @param completed Array where the completed requests are stored
+ * @param max       Size of completed
+ * @param timeout   Milliseconds to wait if there are no completed requests. 0 does not block, -1 blocks forever.
+ * @return Number of requests stored in completed
+ */
+int gfal2_async_poll(gfal2_async_queue_t queue, gfal2_async_request_t* completed, int max, int timeout);
+
+/**
+ * Number of requests submitted and not completed yet
+ */
+int gfal2_async_get_pending(gfal2_async_queue_t queue);
+
+/**
+ * Mark a request as completed
+ * Used by the plugins that execute requests natively, and by the internal workers.
+ * The ownership of error is transferred to the request.
+ */
+void gfal2_async_complete(gfal2_async_request_t req, ssize_t result, GError* error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GFAL_ASYNC_H_ */
@@ -20,6 +20,7 @@
 
 #include <glib.h>
 #include <common/gfal_config_internal.h>
+#include <common/gfal_metrics_internal.h>
 #include <logger/gfal_logger.h>
 #include <stdio.h>
 #include <string.h>
@@ -142,10 +143,13 @@ gfal2_context_t gfal2_context_new(GError **err)
         return NULL;
     }
     gfal_initCredentialLocation(context);
+    // Plugins may register their caches while loading
+    context->metrics = gfal_metrics_new();
     context->plugin_opt.plugin_number = 0;
     int ret = gfal_plugins_instance(context, &tmp_err);
     if (ret <= 0 && tmp_err) {
         gfal2_propagate_prefixed_error(err, tmp_err, __func__);
+        gfal_metrics_free(context->metrics);
         g_key_file_free(context->config);
         g_free(context);
         return NULL;
@@ -177,6 +181,10 @@ void gfal2_context_free(gfal2_context_t context)
     g_ptr_array_foreach(context->client_info, gfal_free_keyvalue, NULL);
     g_ptr_array_free(context->client_info, FALSE);
     gfal2_cred_clean(context, NULL);
+    gfal_metrics_free(context->metrics);
+    if (context->autotune_free) {
+        context->autotune_free(context->autotune);
+    }
     g_free(context);
 }
 
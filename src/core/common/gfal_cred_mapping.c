@@ -91,6 +91,8 @@ int gfal2_cred_set(gfal2_context_t handle, const char *url_prefix, const gfal2_c
     node->url_prefix = g_strdup(url_prefix);
     node->cred = gfal2_cred_dup(cred);
 
+    g_atomic_int_inc(&handle->cred_generation);
+
     // Remove existing value
     GList *item = g_list_find_custom(handle->cred_mapping, node, node_compare);
     if (item) {
@@ -156,6 +158,7 @@ int gfal2_cred_del(gfal2_context_t handle, const char *type, const char *url, GE
             (strcmp(node->url_prefix, url) == 0)) {
             node_free(node);
             handle->cred_mapping = g_list_delete_link(handle->cred_mapping, item);
+            g_atomic_int_inc(&handle->cred_generation);
             return 0;
         }
     }
@@ -167,6 +170,7 @@ int gfal2_cred_clean(gfal2_context_t handle, GError **error)
 {
     g_list_free_full(handle->cred_mapping, node_free);
     handle->cred_mapping = NULL;
+    g_atomic_int_inc(&handle->cred_generation);
     return 0;
 }
 
@@ -200,3 +204,9 @@ void gfal2_cred_foreach(gfal2_context_t handle, gfal_cred_func_t callback, void
     callback_data data = {callback, user_data};
     g_list_foreach(handle->cred_mapping, foreach_callback_wrapper, &data);
 }
+
+
+guint gfal2_cred_get_generation(gfal2_context_t handle)
+{
+    return g_atomic_int_get(&handle->cred_generation);
+}
@@ -131,6 +131,13 @@ int gfal2_cred_copy(gfal2_context_t dest, const gfal2_context_t src, GError **er
  */
 void gfal2_cred_foreach(gfal2_context_t handle, gfal_cred_func_t callback, void *user_data);
 
+/**
+ * Return a counter increased every time the credential list changes
+ * Allows to keep derived data (i.e. lookup indexes) until the credentials are modified
+ * @param handle        The gfal2 context
+ */
+guint gfal2_cred_get_generation(gfal2_context_t handle);
+
 #ifdef __cplusplus
 }
 #endif
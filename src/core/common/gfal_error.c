@@ -27,20 +27,59 @@
 #include "future/glib.h"
 #endif
 
+// Error code the caller of this thread expects, and does not need a message for
+static __thread int gfal_expected_errno = 0;
+
+
+int gfal2_expect_errno_begin(int code)
+{
+    int previous = gfal_expected_errno;
+    gfal_expected_errno = code;
+    return previous;
+}
+
+
+void gfal2_expect_errno_end(int previous)
+{
+    gfal_expected_errno = previous;
+}
+
+
+gboolean gfal2_errno_is_expected(int code)
+{
+    return code != 0 && code == gfal_expected_errno;
+}
+
 
 void gfal2_set_error(GError **err, GQuark domain, gint code,
         const gchar *function, const gchar *format, ...)
 {
-    char buffer[512];
+    if (err == NULL) {
+        return;
+    }
+    // Nothing to format, the message is not going to be read
+    if (*err == NULL && gfal2_errno_is_expected(code)) {
+        *err = g_error_new_literal(domain, code, g_strerror(code));
+        return;
+    }
+
     va_list args;
     va_start(args, format);
-    vsnprintf(buffer, sizeof(buffer), format, args);
-    va_end(args);
-
-    if (gfal2_log_get_level() >= G_LOG_LEVEL_DEBUG)
+    if (gfal2_log_get_level() >= G_LOG_LEVEL_DEBUG) {
+        char buffer[512];
+        vsnprintf(buffer, sizeof(buffer), format, args);
         g_set_error(err, domain, code, "[%s] %s", function, buffer);
-    else
-        g_set_error_literal(err, domain, code, buffer);
+    }
+    else if (*err == NULL) {
+        *err = g_error_new_valist(domain, code, format, args);
+    }
+    else {
+        // Let glib complain about the overwrite, with the message that was lost
+        char buffer[512];
+        vsnprintf(buffer, sizeof(buffer), format, args);
+        g_set_error(err, domain, code, "[%s] %s", function, buffer);
+    }
+    va_end(args);
 }
 
 
@@ -52,6 +91,11 @@ void gfal2_propagate_prefixed_error_extended(GError **dest, GError *src,
         return;
     }
 
+    if (gfal2_errno_is_expected(src->code)) {
+        *dest = src;
+        return;
+    }
+
     if (gfal2_log_get_level() >= G_LOG_LEVEL_DEBUG) {
         if (src->message[0] == '[')
             g_propagate_prefixed_error(dest, src, "[%s]", function);
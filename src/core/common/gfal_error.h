@@ -61,6 +61,23 @@ void gfal2_propagate_prefixed_error(GError       **dest,
                                     GError        *src,
                                     const gchar   *function);
 
+/** @def Declare that the calling thread expects errors with the given errno,
+ *       and only looks at their code (i.e. ENOENT for existence checks).
+ *       Until gfal2_expect_errno_end, gfal2_set_error does not format nor prefix
+ *       the messages of those errors: they are set to strerror(code).
+ *       Returns the previously expected code, to be passed to gfal2_expect_errno_end.
+ */
+int gfal2_expect_errno_begin(int code);
+
+/** @def Restore the expected errno returned by gfal2_expect_errno_begin
+ */
+void gfal2_expect_errno_end(int previous);
+
+/** @def Return TRUE if code is expected by the calling thread, so there is no need to
+ *       build a detailed message
+ */
+gboolean gfal2_errno_is_expected(int code);
+
 
 #ifdef __cplusplus
 }
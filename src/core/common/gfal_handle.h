@@ -58,6 +58,15 @@ struct gfal_handle_ {
 
 	// Credential mapping
     GList *cred_mapping;
+    // Increased on every change of the credential mapping
+    volatile gint cred_generation;
+
+    // Per plugin and operation accounting, see gfal_metrics_internal.h
+    struct gfal_metrics_s* metrics;
+
+    // Transfer settings learned per link, owned by the transfer library
+    volatile gpointer autotune;
+    GDestroyNotify autotune_free;
 
     // client information
     char* agent_name;
@@ -0,0 +1,489 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include <gfal_api.h>
+#include "gfal_handle.h"
+#include "gfal_metrics_internal.h"
+
+/*
+ * Latency histograms are log-linear (as HdrHistogram does): values below
+ * GFAL_METRICS_SUB_BUCKETS microseconds have their own bucket, above that each
+ * power of two is split into GFAL_METRICS_SUB_BUCKETS buckets, so the relative
+ * error stays under 1/GFAL_METRICS_SUB_BUCKETS up to 2^GFAL_METRICS_MAX_EXPONENT us (~12 days).
+ */
+#define GFAL_METRICS_SUB_BUCKET_BITS 3
+#define GFAL_METRICS_SUB_BUCKETS (1 << GFAL_METRICS_SUB_BUCKET_BITS)
+#define GFAL_METRICS_MAX_EXPONENT 40
+#define GFAL_METRICS_BUCKETS ((GFAL_METRICS_MAX_EXPONENT - GFAL_METRICS_SUB_BUCKET_BITS + 2) * GFAL_METRICS_SUB_BUCKETS)
+
+#define gfal_metrics_add(ptr, value) __sync_fetch_and_add((ptr), (value))
+#define gfal_metrics_get(ptr) __sync_fetch_and_add((ptr), 0)
+#define gfal_metrics_clear(ptr) __sync_fetch_and_and((ptr), 0)
+
+
+static const char* gfal_metrics_op_names[GFAL_METRICS_OP_COUNT] = {
+    "stat", "lstat", "access", "mkdir", "rmdir", "unlink", "rename", "opendir",
+    "open", "close", "read", "write", "getxattr", "setxattr", "checksum", "copy",
+    "bring_online", "bring_online_poll", "release", "abort", "archive_poll",
+    "stat_list", "checksum_list", "unlink_list", "bring_online_list", "bring_online_poll_list",
+    "release_list", "archive_poll_list", "copy_list", "token_retrieve"
+};
+
+
+typedef struct {
+    volatile gint64 count;
+    volatile gint64 errors;
+    volatile gint64 bytes;
+    volatile gint64 sum_us;
+    volatile gint64 max_us;
+    volatile gint64 buckets[GFAL_METRICS_BUCKETS];
+} gfal_metrics_op_stats_t;
+
+
+struct gfal_metrics_cache_s {
+    gchar* name;
+    volatile gint64 hits;
+    volatile gint64 misses;
+};
+
+
+struct gfal_metrics_s {
+    // Allocated on first use, as most plugins only see a few operations
+    volatile gpointer ops[MAX_PLUGIN_LIST][GFAL_METRICS_OP_COUNT];
+    GMutex* caches_mutex;
+    GSList* caches;
+};
+
+
+// Summary of one histogram, as read by a snapshot
+typedef struct {
+    gint64 count, errors, bytes, sum_us, max_us;
+    gint64 buckets[GFAL_METRICS_BUCKETS];
+} gfal_metrics_op_view_t;
+
+
+guint gfal_metrics_bucket_index(gint64 value)
+{
+    if (value < GFAL_METRICS_SUB_BUCKETS) {
+        return value < 0 ? 0 : (guint)value;
+    }
+    int exponent = 63 - __builtin_clzll((unsigned long long)value);
+    if (exponent > GFAL_METRICS_MAX_EXPONENT) {
+        return GFAL_METRICS_BUCKETS - 1;
+    }
+    guint sub = (value >> (exponent - GFAL_METRICS_SUB_BUCKET_BITS)) & (GFAL_METRICS_SUB_BUCKETS - 1);
+    return (exponent - GFAL_METRICS_SUB_BUCKET_BITS + 1) * GFAL_METRICS_SUB_BUCKETS + sub;
+}
+
+
+gint64 gfal_metrics_bucket_lower_bound(guint index)
+{
+    if (index < GFAL_METRICS_SUB_BUCKETS) {
+        return index;
+    }
+    int exponent = index / GFAL_METRICS_SUB_BUCKETS + GFAL_METRICS_SUB_BUCKET_BITS - 1;
+    gint64 sub = index % GFAL_METRICS_SUB_BUCKETS;
+    return (GFAL_METRICS_SUB_BUCKETS + sub) << (exponent - GFAL_METRICS_SUB_BUCKET_BITS);
+}
+
+
+gfal_metrics_t* gfal_metrics_new(void)
+{
+    gfal_metrics_t* metrics = g_new0(gfal_metrics_t, 1);
+    metrics->caches_mutex = g_mutex_new();
+    return metrics;
+}
+
+
+static void gfal_metrics_cache_free(gpointer data)
+{
+    struct gfal_metrics_cache_s* cache = (struct gfal_metrics_cache_s*)data;
+    g_free(cache->name);
+    g_free(cache);
+}
+
+
+void gfal_metrics_free(gfal_metrics_t* metrics)
+{
+    int i, j;
+    if (metrics == NULL) {
+        return;
+    }
+    for (i = 0; i < MAX_PLUGIN_LIST; ++i) {
+        for (j = 0; j < GFAL_METRICS_OP_COUNT; ++j) {
+            g_free(metrics->ops[i][j]);
+        }
+    }
+    g_slist_free_full(metrics->caches, gfal_metrics_cache_free);
+    g_mutex_free(metrics->caches_mutex);
+    g_free(metrics);
+}
+
+
+static gfal_metrics_op_stats_t* gfal_metrics_get_op(gfal_metrics_t* metrics, int plugin, gfal_metrics_op_t op)
+{
+    gfal_metrics_op_stats_t* stats = g_atomic_pointer_get(&metrics->ops[plugin][op]);
+    if (stats == NULL) {
+        gfal_metrics_op_stats_t* new_stats = g_new0(gfal_metrics_op_stats_t, 1);
+        if (g_atomic_pointer_compare_and_exchange(&metrics->ops[plugin][op], NULL, new_stats)) {
+            stats = new_stats;
+        }
+        else {
+            // Someone else was faster
+            g_free(new_stats);
+            stats = g_atomic_pointer_get(&metrics->ops[plugin][op]);
+        }
+    }
+    return stats;
+}
+
+
+void gfal_metrics_record(gfal2_context_t context, const gfal_plugin_interface* plugin,
+    gfal_metrics_op_t op, gint64 start, gboolean failed, gint64 bytes)
+{
+    if (context == NULL || context->metrics == NULL || plugin == NULL) {
+        return;
+    }
+    const gfal_plugin_interface* list = context->plugin_opt.plugin_list;
+    if (plugin < list || plugin >= list + context->plugin_opt.plugin_number) {
+        return;
+    }
+
+    gint64 elapsed = g_get_monotonic_time() - start;
+    if (elapsed < 0) {
+        elapsed = 0;
+    }
+
+    gfal_metrics_op_stats_t* stats = gfal_metrics_get_op(context->metrics, plugin - list, op);
+    gfal_metrics_add(&stats->count, 1);
+    if (failed) {
+        gfal_metrics_add(&stats->errors, 1);
+    }
+    if (bytes > 0) {
+        gfal_metrics_add(&stats->bytes, bytes);
+    }
+    gfal_metrics_add(&stats->sum_us, elapsed);
+    gfal_metrics_add(&stats->buckets[gfal_metrics_bucket_index(elapsed)], 1);
+
+    gint64 max = gfal_metrics_get(&stats->max_us);
+    while (elapsed > max && !__sync_bool_compare_and_swap(&stats->max_us, max, elapsed)) {
+        max = gfal_metrics_get(&stats->max_us);
+    }
+}
+
+
+gfal_metrics_cache_t gfal2_metrics_register_cache(gfal2_context_t context, const char* name)
+{
+    GSList* i;
+    struct gfal_metrics_cache_s* cache = NULL;
+
+    if (context == NULL || context->metrics == NULL || name == NULL) {
+        return NULL;
+    }
+
+    g_mutex_lock(context->metrics->caches_mutex);
+    for (i = context->metrics->caches; i != NULL; i = i->next) {
+        struct gfal_metrics_cache_s* candidate = (struct gfal_metrics_cache_s*)i->data;
+        if (strcmp(candidate->name, name) == 0) {
+            cache = candidate;
+            break;
+        }
+    }
+    if (cache == NULL) {
+        cache = g_new0(struct gfal_metrics_cache_s, 1);
+        cache->name = g_strdup(name);
+        context->metrics->caches = g_slist_append(context->metrics->caches, cache);
+    }
+    g_mutex_unlock(context->metrics->caches_mutex);
+    return cache;
+}
+
+
+void gfal2_metrics_cache_lookup(gfal_metrics_cache_t cache, gboolean hit)
+{
+    if (cache == NULL) {
+        return;
+    }
+    if (hit) {
+        gfal_metrics_add(&cache->hits, 1);
+    }
+    else {
+        gfal_metrics_add(&cache->misses, 1);
+    }
+}
+
+
+void gfal2_metrics_reset(gfal2_context_t context)
+{
+    GSList* i;
+    int plugin, op, b;
+
+    if (context == NULL || context->metrics == NULL) {
+        return;
+    }
+    for (plugin = 0; plugin < MAX_PLUGIN_LIST; ++plugin) {
+        for (op = 0; op < GFAL_METRICS_OP_COUNT; ++op) {
+            gfal_metrics_op_stats_t* stats = g_atomic_pointer_get(&context->metrics->ops[plugin][op]);
+            if (stats == NULL) {
+                continue;
+            }
+            gfal_metrics_clear(&stats->count);
+            gfal_metrics_clear(&stats->errors);
+            gfal_metrics_clear(&stats->bytes);
+            gfal_metrics_clear(&stats->sum_us);
+            gfal_metrics_clear(&stats->max_us);
+            for (b = 0; b < GFAL_METRICS_BUCKETS; ++b) {
+                gfal_metrics_clear(&stats->buckets[b]);
+            }
+        }
+    }
+
+    g_mutex_lock(context->metrics->caches_mutex);
+    for (i = context->metrics->caches; i != NULL; i = i->next) {
+        struct gfal_metrics_cache_s* cache = (struct gfal_metrics_cache_s*)i->data;
+        gfal_metrics_clear(&cache->hits);
+        gfal_metrics_clear(&cache->misses);
+    }
+    g_mutex_unlock(context->metrics->caches_mutex);
+}
+
+
+// Copy the counters, so the output is built from consistent values
+// The count is taken from the buckets, as it is the base of the percentiles
+static void gfal_metrics_op_read(gfal_metrics_op_stats_t* stats, gfal_metrics_op_view_t* view)
+{
+    int b;
+    view->count = 0;
+    for (b = 0; b < GFAL_METRICS_BUCKETS; ++b) {
+        view->buckets[b] = gfal_metrics_get(&stats->buckets[b]);
+        view->count += view->buckets[b];
+    }
+    view->errors = gfal_metrics_get(&stats->errors);
+    view->bytes = gfal_metrics_get(&stats->bytes);
+    view->sum_us = gfal_metrics_get(&stats->sum_us);
+    view->max_us = gfal_metrics_get(&stats->max_us);
+}
+
+
+// Highest value equivalent to the quantile q, in microseconds
+static gint64 gfal_metrics_percentile(const gfal_metrics_op_view_t* view, double q)
+{
+    gint64 rank = (gint64)(q * view->count + 0.5);
+    gint64 seen = 0;
+    guint b;
+
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (b = 0; b < GFAL_METRICS_BUCKETS; ++b) {
+        seen += view->buckets[b];
+        if (seen >= rank) {
+            gint64 value = (b + 1 < GFAL_METRICS_BUCKETS) ? gfal_metrics_bucket_lower_bound(b + 1) - 1 : view->max_us;
+            return MIN(value, view->max_us);
+        }
+    }
+    return view->max_us;
+}
+
+
+// Names are set by plugins, escape what would break the output
+static void gfal_metrics_append_escaped(GString* out, const char* str)
+{
+    for (; *str; ++str) {
+        switch (*str) {
+            case '"':
+                g_string_append(out, "\\\"");
+                break;
+            case '\\':
+                g_string_append(out, "\\\\");
+                break;
+            case '\n':
+                g_string_append(out, "\\n");
+                break;
+            default:
+                g_string_append_c(out, *str);
+        }
+    }
+}
+
+
+static void gfal_metrics_json_op(GString* out, const char* plugin, const char* op,
+    const gfal_metrics_op_view_t* view, gboolean first)
+{
+    g_string_append(out, first ? "\n    {\"plugin\": \"" : ",\n    {\"plugin\": \"");
+    gfal_metrics_append_escaped(out, plugin);
+    g_string_append_printf(out, "\", \"operation\": \"%s\", \"count\": %" G_GINT64_FORMAT
+        ", \"errors\": %" G_GINT64_FORMAT ", \"bytes\": %" G_GINT64_FORMAT
+        ", \"latency_us\": {\"sum\": %" G_GINT64_FORMAT ", \"max\": %" G_GINT64_FORMAT
+        ", \"p50\": %" G_GINT64_FORMAT ", \"p90\": %" G_GINT64_FORMAT ", \"p99\": %" G_GINT64_FORMAT "}}",
+        op, view->count, view->errors, view->bytes, view->sum_us, view->max_us,
+        gfal_metrics_percentile(view, 0.5), gfal_metrics_percentile(view, 0.9),
+        gfal_metrics_percentile(view, 0.99));
+}
+
+
+static void gfal_metrics_prometheus_labels(GString* out, const char* plugin, const char* op)
+{
+    g_string_append(out, "{plugin=\"");
+    gfal_metrics_append_escaped(out, plugin);
+    g_string_append_printf(out, "\",operation=\"%s\"", op);
+}
+
+
+// Microseconds as seconds with a fixed number of decimals, whatever the locale
+static void gfal_metrics_append_seconds(GString* out, gint64 us)
+{
+    g_string_append_printf(out, "%" G_GINT64_FORMAT ".%06" G_GINT64_FORMAT, us / 1000000, us % 1000000);
+}
+
+
+// Cumulative buckets up to every power of two microseconds, so the series are the same on every scrape.
+// Latencies are whole microseconds, so "le" is the last microsecond before the power of two
+static void gfal_metrics_prometheus_op(GString* out, const char* plugin, const char* op,
+    const gfal_metrics_op_view_t* view)
+{
+    static const char* counters[] = {
+        "gfal2_operations_total", "gfal2_operation_errors_total", "gfal2_operation_bytes_total"
+    };
+    gint64 values[] = {view->count, view->errors, view->bytes};
+    gint64 cumulative = 0;
+    guint b, c;
+
+    for (c = 0; c < G_N_ELEMENTS(counters); ++c) {
+        g_string_append(out, counters[c]);
+        gfal_metrics_prometheus_labels(out, plugin, op);
+        g_string_append_printf(out, "} %" G_GINT64_FORMAT "\n", values[c]);
+    }
+
+    for (b = 1; b < GFAL_METRICS_BUCKETS; ++b) {
+        gint64 bound = gfal_metrics_bucket_lower_bound(b);
+        cumulative += view->buckets[b - 1];
+        if ((bound & (bound - 1)) == 0) {
+            g_string_append(out, "gfal2_operation_duration_seconds_bucket");
+            gfal_metrics_prometheus_labels(out, plugin, op);
+            g_string_append(out, ",le=\"");
+            gfal_metrics_append_seconds(out, bound - 1);
+            g_string_append_printf(out, "\"} %" G_GINT64_FORMAT "\n", cumulative);
+        }
+    }
+    g_string_append(out, "gfal2_operation_duration_seconds_bucket");
+    gfal_metrics_prometheus_labels(out, plugin, op);
+    g_string_append_printf(out, ",le=\"+Inf\"} %" G_GINT64_FORMAT "\n", view->count);
+
+    g_string_append(out, "gfal2_operation_duration_seconds_sum");
+    gfal_metrics_prometheus_labels(out, plugin, op);
+    g_string_append(out, "} ");
+    gfal_metrics_append_seconds(out, view->sum_us);
+    g_string_append_c(out, '\n');
+    g_string_append(out, "gfal2_operation_duration_seconds_count");
+    gfal_metrics_prometheus_labels(out, plugin, op);
+    g_string_append_printf(out, "} %" G_GINT64_FORMAT "\n", view->count);
+}
+
+
+gchar* gfal2_metrics_snapshot(gfal2_context_t context, gfal_metrics_format_t format, GError** err)
+{
+    g_return_val_err_if_fail(context != NULL, NULL, err, "[gfal2_metrics_snapshot] Invalid context");
+    if (format != GFAL_METRICS_JSON && format != GFAL_METRICS_PROMETHEUS) {
+        gfal2_set_error(err, gfal2_get_core_quark(), EINVAL, __func__, "Unknown metrics format %d", format);
+        return NULL;
+    }
+
+    GString* out = g_string_new(NULL);
+    gfal_metrics_op_view_t* view = g_new0(gfal_metrics_op_view_t, 1);
+    gboolean first = TRUE;
+    int plugin, op;
+    GSList* i;
+
+    if (format == GFAL_METRICS_JSON) {
+        g_string_append(out, "{\n  \"operations\": [");
+    }
+    else {
+        g_string_append(out,
+            "# HELP gfal2_operations_total Operations dispatched to the plugins\n"
+            "# TYPE gfal2_operations_total counter\n"
+            "# HELP gfal2_operation_errors_total Operations that failed\n"
+            "# TYPE gfal2_operation_errors_total counter\n"
+            "# HELP gfal2_operation_bytes_total Bytes read or written\n"
+            "# TYPE gfal2_operation_bytes_total counter\n"
+            "# HELP gfal2_operation_duration_seconds Duration of the operations\n"
+            "# TYPE gfal2_operation_duration_seconds histogram\n");
+    }
+
+    int nplugins = MIN(context->plugin_opt.plugin_number, MAX_PLUGIN_LIST);
+    for (plugin = 0; plugin < nplugins; ++plugin) {
+        const char* name = context->plugin_opt.plugin_list[plugin].getName();
+        for (op = 0; op < GFAL_METRICS_OP_COUNT; ++op) {
+            gfal_metrics_op_stats_t* stats = g_atomic_pointer_get(&context->metrics->ops[plugin][op]);
+            if (stats == NULL) {
+                continue;
+            }
+            gfal_metrics_op_read(stats, view);
+            if (format == GFAL_METRICS_JSON) {
+                gfal_metrics_json_op(out, name, gfal_metrics_op_names[op], view, first);
+            }
+            else {
+                gfal_metrics_prometheus_op(out, name, gfal_metrics_op_names[op], view);
+            }
+            first = FALSE;
+        }
+    }
+    g_free(view);
+
+    if (format == GFAL_METRICS_JSON) {
+        g_string_append(out, first ? "],\n  \"caches\": [" : "\n  ],\n  \"caches\": [");
+    }
+    else {
+        g_string_append(out,
+            "# HELP gfal2_cache_hits_total Lookups served from a cache\n"
+            "# TYPE gfal2_cache_hits_total counter\n"
+            "# HELP gfal2_cache_misses_total Lookups not found in a cache\n"
+            "# TYPE gfal2_cache_misses_total counter\n");
+    }
+
+    first = TRUE;
+    g_mutex_lock(context->metrics->caches_mutex);
+    for (i = context->metrics->caches; i != NULL; i = i->next) {
+        struct gfal_metrics_cache_s* cache = (struct gfal_metrics_cache_s*)i->data;
+        gint64 hits = gfal_metrics_get(&cache->hits);
+        gint64 misses = gfal_metrics_get(&cache->misses);
+        if (format == GFAL_METRICS_JSON) {
+            g_string_append(out, first ? "\n    {\"name\": \"" : ",\n    {\"name\": \"");
+            gfal_metrics_append_escaped(out, cache->name);
+            g_string_append_printf(out, "\", \"hits\": %" G_GINT64_FORMAT ", \"misses\": %" G_GINT64_FORMAT "}",
+                hits, misses);
+        }
+        else {
+            g_string_append(out, "gfal2_cache_hits_total{cache=\"");
+            gfal_metrics_append_escaped(out, cache->name);
+            g_string_append_printf(out, "\"} %" G_GINT64_FORMAT "\n", hits);
+            g_string_append(out, "gfal2_cache_misses_total{cache=\"");
+            gfal_metrics_append_escaped(out, cache->name);
+            g_string_append_printf(out, "\"} %" G_GINT64_FORMAT "\n", misses);
+        }
+        first = FALSE;
+    }
+    g_mutex_unlock(context->metrics->caches_mutex);
+
+    if (format == GFAL_METRICS_JSON) {
+        g_string_append(out, first ? "]\n}\n" : "\n  ]\n}\n");
+    }
+
+    return g_string_free(out, FALSE);
+}
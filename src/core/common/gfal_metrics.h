@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef GFAL_METRICS_H_
+#define GFAL_METRICS_H_
+
+#if !defined(__GFAL2_H_INSIDE__) && !defined(__GFAL2_BUILD__)
+#   warning "Direct inclusion of gfal2 headers is deprecated. Please, include only gfal_api.h or gfal_plugins_api.h"
+#endif
+
+#include "gfal_common.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Output formats of gfal2_metrics_snapshot
+ */
+typedef enum {
+    GFAL_METRICS_JSON = 0,
+    GFAL_METRICS_PROMETHEUS
+} gfal_metrics_format_t;
+
+/**
+ * Cache accounting, as registered by the plugins
+ */
+typedef struct gfal_metrics_cache_s* gfal_metrics_cache_t;
+
+/**
+ * @brief Export the metrics accumulated by the context
+ *
+ * Every operation dispatched to a plugin is accounted, by plugin and operation:
+ * number of calls, failures, bytes transferred (for reads and writes) and a
+ * latency histogram. Caches registered by the plugins report hits and misses.
+ * Thread safe, and can be called while operations are running.
+ *
+ * @param context gfal2 context
+ * @param format  GFAL_METRICS_JSON or GFAL_METRICS_PROMETHEUS (text exposition format)
+ * @param err     GError error report
+ * @return a newly allocated string, to be freed with g_free, or NULL on error
+ */
+gchar* gfal2_metrics_snapshot(gfal2_context_t context, gfal_metrics_format_t format, GError** err);
+
+/**
+ * @brief Set all the counters and histograms of the context back to zero
+ * Registered caches are kept.
+ */
+void gfal2_metrics_reset(gfal2_context_t context);
+
+/**
+ * @brief Register a cache, so its hits and misses are exported with the metrics
+ * Registering the same name twice returns the same cache.
+ * The returned pointer is owned by the context, and valid as long as it is.
+ */
+gfal_metrics_cache_t gfal2_metrics_register_cache(gfal2_context_t context, const char* name);
+
+/**
+ * @brief Account a cache lookup
+ * Lock-free. A NULL cache is ignored.
+ */
+void gfal2_metrics_cache_lookup(gfal_metrics_cache_t cache, gboolean hit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GFAL_METRICS_H_ */
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef GFAL_METRICS_INTERNAL_H_
+#define GFAL_METRICS_INTERNAL_H_
+
+#include <glib.h>
+#include "gfal_common.h"
+#include "gfal_plugin_interface.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Operations accounted in the plugin dispatch
+// Bulk operations are accounted once per partition (see gfal_plugin_bulk.h)
+// Keep in sync with the names in gfal_metrics.c
+typedef enum {
+    GFAL_METRICS_OP_STAT = 0,
+    GFAL_METRICS_OP_LSTAT,
+    GFAL_METRICS_OP_ACCESS,
+    GFAL_METRICS_OP_MKDIR,
+    GFAL_METRICS_OP_RMDIR,
+    GFAL_METRICS_OP_UNLINK,
+    GFAL_METRICS_OP_RENAME,
+    GFAL_METRICS_OP_OPENDIR,
+    GFAL_METRICS_OP_OPEN,
+    GFAL_METRICS_OP_CLOSE,
+    GFAL_METRICS_OP_READ,
+    GFAL_METRICS_OP_WRITE,
+    GFAL_METRICS_OP_GETXATTR,
+    GFAL_METRICS_OP_SETXATTR,
+    GFAL_METRICS_OP_CHECKSUM,
+    GFAL_METRICS_OP_COPY,
+    GFAL_METRICS_OP_BRING_ONLINE,
+    GFAL_METRICS_OP_BRING_ONLINE_POLL,
+    GFAL_METRICS_OP_RELEASE,
+    GFAL_METRICS_OP_ABORT,
+    GFAL_METRICS_OP_ARCHIVE_POLL,
+    GFAL_METRICS_OP_STAT_LIST,
+    GFAL_METRICS_OP_CHECKSUM_LIST,
+    GFAL_METRICS_OP_UNLINK_LIST,
+    GFAL_METRICS_OP_BRING_ONLINE_LIST,
+    GFAL_METRICS_OP_BRING_ONLINE_POLL_LIST,
+    GFAL_METRICS_OP_RELEASE_LIST,
+    GFAL_METRICS_OP_ARCHIVE_POLL_LIST,
+    GFAL_METRICS_OP_COPY_LIST,
+    GFAL_METRICS_OP_TOKEN,
+    GFAL_METRICS_OP_COUNT
+} gfal_metrics_op_t;
+
+typedef struct gfal_metrics_s gfal_metrics_t;
+
+gfal_metrics_t* gfal_metrics_new(void);
+
+void gfal_metrics_free(gfal_metrics_t* metrics);
+
+// Start time of an operation, to be passed to gfal_metrics_record
+#define gfal_metrics_start() g_get_monotonic_time()
+
+/*
+ * Account one call of op on plugin, started at start
+ * bytes is only meaningful for reads and writes, pass 0 otherwise
+ * Plugins that are not part of the context plugin list are ignored.
+ */
+void gfal_metrics_record(gfal2_context_t context, const gfal_plugin_interface* plugin,
+    gfal_metrics_op_t op, gint64 start, gboolean failed, gint64 bytes);
+
+// Histogram bucketing, exposed for the tests
+guint gfal_metrics_bucket_index(gint64 value);
+
+gint64 gfal_metrics_bucket_lower_bound(guint index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GFAL_METRICS_INTERNAL_H_ */
@@ -31,12 +31,17 @@
 #include "gfal_constants.h"
 #include "gfal_error.h"
 #include "gfal_file_handler_container.h"
+#include "gfal_plugin_bulk.h"
+#include "gfal_metrics_internal.h"
 #include <future/glib.h>
 
 #ifndef GFAL_PLUGIN_DIR_DEFAULT
 #error "GFAL_PLUGIN_DIR_DEFAULT should be define at compile time"
 #endif
 
+#define GFAL_BULK_DEFAULT_STAT_THREADS 8
+#define GFAL_BULK_DEFAULT_CHECKSUM_THREADS 8
+
 
 /*
  * function to use in order to create a new plugin interface
@@ -457,8 +462,11 @@ int gfal_plugins_accessG(gfal2_context_t handle, const char* path, int mode,
     gfal_plugin_interface* p = gfal_find_plugin(handle, path,
             GFAL_PLUGIN_ACCESS, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         res = p->accessG(gfal_get_plugin_handle(p), path, mode, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_ACCESS, start, res < 0, 0);
+    }
 
     G_RETURN_ERR(res, tmp_err, err);
 }
@@ -473,8 +481,11 @@ int gfal_plugin_statG(gfal2_context_t handle, const char* path, struct stat* st,
     gfal_plugin_interface* p = gfal_find_plugin(handle, path, GFAL_PLUGIN_STAT,
             &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         res = p->statG(gfal_get_plugin_handle(p), path, st, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_STAT, start, res < 0, 0);
+    }
 
     G_RETURN_ERR(res, tmp_err, err);
 }
@@ -490,8 +501,11 @@ int gfal_plugin_lstatG(gfal2_context_t handle, const char* path, struct stat* st
     gfal_plugin_interface* p = gfal_find_plugin(handle, path, GFAL_PLUGIN_LSTAT,
             &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         res = p->lstatG(gfal_get_plugin_handle(p), path, st, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_LSTAT, start, res < 0, 0);
+    }
 
     G_RETURN_ERR(res, tmp_err, err);
 }
@@ -544,8 +558,11 @@ int gfal_plugin_renameG(gfal2_context_t handle, const char* oldpath, const char*
     src_p = gfal_find_plugin(handle, oldpath, GFAL_PLUGIN_RENAME, &tmp_err);
     if (src_p) {
         dst_p = gfal_find_plugin(handle, newpath, GFAL_PLUGIN_RENAME, &tmp_err);
-        if (src_p == dst_p)
+        if (src_p == dst_p) {
+            gint64 start = gfal_metrics_start();
             res = dst_p->renameG(gfal_get_plugin_handle(dst_p), oldpath, newpath, &tmp_err);
+            gfal_metrics_record(handle, dst_p, GFAL_METRICS_OP_RENAME, start, res < 0, 0);
+        }
     }
 
     G_RETURN_ERR(res, tmp_err, err);
@@ -578,8 +595,11 @@ int gfal_plugin_mkdirp(gfal2_context_t handle, const char* path, mode_t mode, gb
 
     gfal_plugin_interface* p = gfal_find_plugin(handle, path, GFAL_PLUGIN_MKDIR, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         res = p->mkdirpG(gfal_get_plugin_handle(p), path, mode, pflag, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_MKDIR, start, res < 0, 0);
+    }
 
     if (pflag && res < 0 && tmp_err->code == EEXIST) {
         g_error_free(tmp_err);
@@ -598,8 +618,11 @@ int gfal_plugin_rmdirG(gfal2_context_t handle, const char* path, GError** err)
     int res = -1;
     gfal_plugin_interface* p = gfal_find_plugin(handle, path, GFAL_PLUGIN_RMDIR, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         res = p->rmdirG(gfal_get_plugin_handle(p), path, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_RMDIR, start, res < 0, 0);
+    }
 
     G_RETURN_ERR(res, tmp_err, err);
 }
@@ -613,8 +636,11 @@ gfal_file_handle gfal_plugin_opendirG(gfal2_context_t handle, const char* name,
 
     gfal_plugin_interface* p = gfal_find_plugin(handle, name, GFAL_PLUGIN_OPENDIR, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         resu = p->opendirG(gfal_get_plugin_handle(p), name, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_OPENDIR, start, resu == NULL, 0);
+    }
 
     G_RETURN_ERR(resu, tmp_err, err);
 }
@@ -640,8 +666,11 @@ gfal_file_handle gfal_plugin_openG(gfal2_context_t handle, const char * path, in
 
     gfal_plugin_interface* p = gfal_find_plugin(handle, path, GFAL_PLUGIN_OPEN, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         resu = p->openG(gfal_get_plugin_handle(p), path, flag, mode, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_OPEN, start, resu == NULL, 0);
+    }
 
     G_RETURN_ERR(resu, tmp_err, err);
 }
@@ -656,8 +685,11 @@ int gfal_plugin_closeG(gfal2_context_t handle, gfal_file_handle fh, GError** err
     gfal2_log(G_LOG_LEVEL_DEBUG, " <- %s", __func__);
 
     gfal_plugin_interface* if_cata = gfal_plugin_map_file_handle(handle, fh, &tmp_err);
-    if (!tmp_err)
+    if (!tmp_err) {
+        gint64 start = gfal_metrics_start();
         res = if_cata->closeG(if_cata->plugin_data, fh, &tmp_err);
+        gfal_metrics_record(handle, if_cata, GFAL_METRICS_OP_CLOSE, start, res < 0, 0);
+    }
 
     G_RETURN_ERR(res, tmp_err, err);
 }
@@ -701,8 +733,11 @@ ssize_t gfal_plugin_getxattrG(gfal2_context_t handle, const char* path, const ch
 
     gfal_plugin_interface* p = gfal_find_plugin(handle, path, GFAL_PLUGIN_GETXATTR, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         resu = p->getxattrG(gfal_get_plugin_handle(p), path, name, buff, s_buff, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_GETXATTR, start, resu < 0, 0);
+    }
 
     // If asking for checksum, and got an error, try ourselves
     if (resu < 0 && tmp_err) {
@@ -744,8 +779,11 @@ int gfal_plugin_setxattrG(gfal2_context_t handle, const char* path, const char*
 
     gfal_plugin_interface* p = gfal_find_plugin(handle, path, GFAL_PLUGIN_SETXATTR, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         resu = p->setxattrG(gfal_get_plugin_handle(p), path, name, value, size, flags, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_SETXATTR, start, resu < 0, 0);
+    }
     G_RETURN_ERR(resu, tmp_err, err);
 }
 
@@ -756,8 +794,11 @@ int gfal_plugin_readG(gfal2_context_t handle, gfal_file_handle fh, void* buff, s
     GError* tmp_err = NULL;
     int res = -1;
     gfal_plugin_interface* if_cata = gfal_plugin_map_file_handle(handle, fh, &tmp_err);
-    if (!tmp_err)
+    if (!tmp_err) {
+        gint64 start = gfal_metrics_start();
         res = if_cata->readG(if_cata->plugin_data, fh, buff, s_buff, &tmp_err);
+        gfal_metrics_record(handle, if_cata, GFAL_METRICS_OP_READ, start, res < 0, res);
+    }
     G_RETURN_ERR(res, tmp_err, err);
 }
 
@@ -791,11 +832,13 @@ ssize_t gfal_plugin_preadG(gfal2_context_t handle, gfal_file_handle fh, void* bu
     ssize_t res = -1;
     gfal_plugin_interface* if_cata = gfal_plugin_map_file_handle(handle, fh, &tmp_err);
     if (!tmp_err) {
+        gint64 start = gfal_metrics_start();
         if (if_cata->preadG)
             res = if_cata->preadG(if_cata->plugin_data, fh, buff, s_buff, offset, &tmp_err);
         else {
             res = gfal_plugin_simulate_preadG(handle, if_cata, fh, buff, s_buff, offset, &tmp_err);
         }
+        gfal_metrics_record(handle, if_cata, GFAL_METRICS_OP_READ, start, res < 0, res);
     }
     G_RETURN_ERR(res, tmp_err, err);
 }
@@ -830,15 +873,35 @@ ssize_t gfal_plugin_pwriteG(gfal2_context_t handle, gfal_file_handle fh, void* b
     ssize_t res = -1;
     gfal_plugin_interface* if_cata = gfal_plugin_map_file_handle(handle, fh, &tmp_err);
     if (!tmp_err) {
+        gint64 start = gfal_metrics_start();
         if (if_cata->pwriteG)
             res = if_cata->pwriteG(if_cata->plugin_data, fh, buff, s_buff, offset, &tmp_err);
         else {
             res = gfal_plugin_simulate_pwriteG(handle, if_cata, fh, buff, s_buff, offset, &tmp_err);
         }
+        gfal_metrics_record(handle, if_cata, GFAL_METRICS_OP_WRITE, start, res < 0, res);
     }
     G_RETURN_ERR(res, tmp_err, err);
 }
 
+// Execute a fsync function on the appropriate plugin, ENOSYS if it has none
+int gfal_plugin_fsyncG(gfal2_context_t handle, gfal_file_handle fh, GError** err)
+{
+    g_return_val_err_if_fail(handle && fh, -1, err, "[gfal_plugin_fsyncG] Invalid args ");
+    GError* tmp_err = NULL;
+    int res = -1;
+    gfal_plugin_interface* if_cata = gfal_plugin_map_file_handle(handle, fh, &tmp_err);
+    if (!tmp_err) {
+        if (if_cata->fsyncG)
+            res = if_cata->fsyncG(if_cata->plugin_data, fh, &tmp_err);
+        else
+            gfal2_set_error(&tmp_err, gfal2_get_plugins_quark(), ENOSYS, __func__,
+                    "The plugin %s does not support fsync", if_cata->getName());
+    }
+    G_RETURN_ERR(res, tmp_err, err);
+}
+
+
 // Execute a lseek function on the appropriate plugin
 int gfal_plugin_lseekG(gfal2_context_t handle, gfal_file_handle fh, off_t offset, int whence, GError** err)
 {
@@ -859,8 +922,11 @@ int gfal_plugin_writeG(gfal2_context_t handle, gfal_file_handle fh, void* buff,
     GError* tmp_err = NULL;
     int res = -1;
     gfal_plugin_interface* if_cata = gfal_plugin_map_file_handle(handle, fh, &tmp_err);
-    if (!tmp_err)
+    if (!tmp_err) {
+        gint64 start = gfal_metrics_start();
         res = if_cata->writeG(if_cata->plugin_data, fh, buff, s_buff, &tmp_err);
+        gfal_metrics_record(handle, if_cata, GFAL_METRICS_OP_WRITE, start, res < 0, res);
+    }
     G_RETURN_ERR(res, tmp_err, err);
 }
 
@@ -871,8 +937,11 @@ int gfal_plugin_unlinkG(gfal2_context_t handle, const char* path, GError** err)
     int resu = -1;
     gfal_plugin_interface* p = gfal_find_plugin(handle, path, GFAL_PLUGIN_UNLINK, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         resu = p->unlinkG(gfal_get_plugin_handle(p), path, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_UNLINK, start, resu < 0, 0);
+    }
     G_RETURN_ERR(resu, tmp_err, err);
 
 }
@@ -885,9 +954,12 @@ int gfal_plugin_bring_onlineG(gfal2_context_t handle, const char* uri, time_t pi
     int resu = -1;
     gfal_plugin_interface* p = gfal_find_plugin(handle, uri, GFAL_PLUGIN_BRING_ONLINE, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         resu = p->bring_online(gfal_get_plugin_handle(p), uri, pintime, timeout, token, tsize,
                 async, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_BRING_ONLINE, start, resu < 0, 0);
+    }
     G_RETURN_ERR(resu, tmp_err, err);
 }
 
@@ -899,9 +971,12 @@ int gfal_plugin_bring_online_v2G(gfal2_context_t handle, const char* uri, const
     int resu = -1;
     gfal_plugin_interface* p = gfal_find_plugin(handle, uri, GFAL_PLUGIN_BRING_ONLINE, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         resu = p->bring_online_v2(gfal_get_plugin_handle(p), uri, metadata, pintime, timeout, token, tsize,
                 async, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_BRING_ONLINE, start, resu < 0, 0);
+    }
     G_RETURN_ERR(resu, tmp_err, err);
 }
 
@@ -970,8 +1045,11 @@ int gfal_plugin_bring_online_pollG(gfal2_context_t handle, const char* uri, cons
     int resu = -1;
     gfal_plugin_interface* p = gfal_find_plugin(handle, uri, GFAL_PLUGIN_BRING_ONLINE, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         resu = p->bring_online_poll(gfal_get_plugin_handle(p), uri, token, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_BRING_ONLINE_POLL, start, resu < 0, 0);
+    }
     G_RETURN_ERR(resu, tmp_err, err);
 }
 
@@ -983,34 +1061,195 @@ int gfal_plugin_release_fileG(gfal2_context_t handle, const char* uri, const cha
     int resu = -1;
     gfal_plugin_interface* p = gfal_find_plugin(handle, uri, GFAL_PLUGIN_BRING_ONLINE, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         resu = p->release_file(gfal_get_plugin_handle(p), uri, token, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_RELEASE, start, resu < 0, 0);
+    }
     G_RETURN_ERR(resu, tmp_err, err);
 }
 
 
-int gfal_plugin_bring_online_listG(gfal2_context_t handle, int nbfiles, const char* const* uris,
-        time_t pintime, time_t timeout, char* token, size_t tsize, int async, GError ** errors)
+// Set the same error for all the files of a partition
+static int gfal_bulk_partition_fail(gfal_bulk_partition_t* partition, const GError* error)
+{
+    int i;
+    for (i = 0; i < partition->nbfiles; ++i) {
+        partition->errors[i] = g_error_copy(error);
+    }
+    return -1;
+}
+
+
+// Fail the partition if it has no plugin, or the plugin does not implement the operation
+static int gfal_bulk_partition_check(gfal_bulk_partition_t* partition, gboolean implemented,
+        const char* func, const char* msg)
 {
     GError* tmp_err = NULL;
-    int resu = -1;
-    gfal_plugin_interface* p = gfal_find_plugin(handle, *uris, GFAL_PLUGIN_BRING_ONLINE, &tmp_err);
+    if (partition->plugin == NULL && partition->lookup_error) {
+        return gfal_bulk_partition_fail(partition, partition->lookup_error);
+    }
+    if (partition->plugin == NULL || !implemented) {
+        gfal2_set_error(&tmp_err, gfal2_get_plugins_quark(), EPROTONOSUPPORT, func, "%s", msg);
+        gfal_bulk_partition_fail(partition, tmp_err);
+        g_error_free(tmp_err);
+        return -1;
+    }
+    return 0;
+}
+
 
-    if (p && p->bring_online_list) {
-        resu = p->bring_online_list(gfal_get_plugin_handle(p), nbfiles, uris, pintime, timeout,
-                token, tsize, async, errors);
+static guint gfal_bulk_partition_position(GPtrArray* partitions, gfal_bulk_partition_t* partition)
+{
+    guint i;
+    for (i = 0; i < partitions->len; ++i) {
+        if (g_ptr_array_index(partitions, i) == partition) {
+            break;
+        }
     }
-    else {
-        if (p && !p->bring_online_list) {
-            gfal2_set_error(&tmp_err, gfal2_get_plugins_quark(), EPROTONOSUPPORT,
-                    __func__, "The plugin does not implement bulk bring online");
+    return i;
+}
+
+
+typedef struct {
+    GPtrArray* partitions;
+    time_t pintime, timeout;
+    int async;
+    size_t tsize;
+    const char* token;          // input token, for polling, release and abort
+    char** tokens;              // output tokens, one per partition
+} gfal_bulk_staging_t;
+
+
+static int gfal_bulk_bring_online(gfal2_context_t context, gfal_bulk_partition_t* partition, gpointer user_data)
+{
+    gfal_bulk_staging_t* staging = (gfal_bulk_staging_t*)user_data;
+    gfal_plugin_interface* p = (gfal_plugin_interface*)partition->plugin;
+    if (gfal_bulk_partition_check(partition, p && p->bring_online_list, __func__,
+            "The plugin does not implement bulk bring online") < 0) {
+        return -1;
+    }
+    char* token = staging->tokens[gfal_bulk_partition_position(staging->partitions, partition)];
+    gint64 start = gfal_metrics_start();
+    int resu = p->bring_online_list(gfal_get_plugin_handle(p), partition->nbfiles, partition->uris,
+        staging->pintime, staging->timeout, token, staging->tsize, staging->async, partition->errors);
+    gfal_metrics_record(context, p, GFAL_METRICS_OP_BRING_ONLINE_LIST, start, resu < 0, 0);
+    return resu;
+}
+
+
+static int gfal_bulk_bring_online_v2(gfal2_context_t context, gfal_bulk_partition_t* partition, gpointer user_data)
+{
+    gfal_bulk_staging_t* staging = (gfal_bulk_staging_t*)user_data;
+    gfal_plugin_interface* p = (gfal_plugin_interface*)partition->plugin;
+    if (gfal_bulk_partition_check(partition, p && p->bring_online_list_v2, __func__,
+            "The plugin does not implement bulk bring online") < 0) {
+        return -1;
+    }
+    char* token = staging->tokens[gfal_bulk_partition_position(staging->partitions, partition)];
+    gint64 start = gfal_metrics_start();
+    int resu = p->bring_online_list_v2(gfal_get_plugin_handle(p), partition->nbfiles, partition->uris,
+        partition->uris2, staging->pintime, staging->timeout, token, staging->tsize, staging->async,
+        partition->errors);
+    gfal_metrics_record(context, p, GFAL_METRICS_OP_BRING_ONLINE_LIST, start, resu < 0, 0);
+    return resu;
+}
+
+
+static void gfal_bulk_token_overflow(GPtrArray* partitions, GError** errors, int nbfiles)
+{
+    GError* tmp_err = NULL;
+    gfal2_set_error(&tmp_err, gfal2_get_plugins_quark(), ENOBUFS, __func__,
+            "The token buffer is too small for the tokens of %u endpoints", partitions->len);
+    int j;
+    for (j = 0; j < nbfiles; ++j) {
+        if (errors[j] == NULL) {
+            errors[j] = g_error_copy(tmp_err);
         }
-        int i;
-        for (i = 0; i < nbfiles; ++i) {
-            errors[i] = g_error_copy(tmp_err);
+    }
+    g_error_free(tmp_err);
+}
+
+
+// Abort a request that was submitted, but whose token can not be returned
+static void gfal_bulk_cancel_submitted(gfal_bulk_partition_t* partition, const char* token)
+{
+    gfal_plugin_interface* p = (gfal_plugin_interface*)partition->plugin;
+    int j;
+
+    if (token == NULL || token[0] == '\0') {
+        return;
+    }
+    if (p == NULL || p->abort_files == NULL) {
+        gfal2_log(G_LOG_LEVEL_WARNING, "Can not abort the request %s on %s, it is left behind",
+                token, partition->key);
+        return;
+    }
+
+    p->abort_files(gfal_get_plugin_handle(p), partition->nbfiles, partition->uris, token, partition->errors);
+    for (j = 0; j < partition->nbfiles; ++j) {
+        if (partition->errors[j]) {
+            gfal2_log(G_LOG_LEVEL_WARNING, "Failed to abort %s (%s): %s",
+                    partition->uris[j], token, partition->errors[j]->message);
+            g_clear_error(&partition->errors[j]);
         }
-        g_error_free(tmp_err);
     }
+}
+
+
+// Stage the partitions and combine their tokens into one
+static int gfal_bulk_bring_online_run(gfal2_context_t handle, GPtrArray* partitions, gfal_bulk_partition_func func,
+        gfal_bulk_staging_t* staging, char* token, GError** errors, int nbfiles)
+{
+    guint i;
+    staging->partitions = partitions;
+    staging->tokens = g_new0(char*, partitions->len);
+
+    // A single partition writes directly into the caller token
+    if (partitions->len == 1) {
+        staging->tokens[0] = token;
+        int resu = gfal_bulk_partitions_run(handle, partitions, func, staging, errors);
+        g_free(staging->tokens);
+        return resu;
+    }
+
+    // Do not submit anything if the combined token can not fit anyway
+    if (token && staging->tsize < gfal_bulk_token_min_size(partitions)) {
+        gfal_bulk_token_overflow(partitions, errors, nbfiles);
+        g_free(staging->tokens);
+        return -1;
+    }
+
+    for (i = 0; i < partitions->len; ++i) {
+        staging->tokens[i] = g_malloc0(staging->tsize + 1);
+    }
+
+    int resu = gfal_bulk_partitions_run(handle, partitions, func, staging, errors);
+    if (token && gfal_bulk_token_join(partitions, staging->tokens, token, staging->tsize) < 0) {
+        // The caller never gets the tokens, so the requests would be left behind
+        for (i = 0; i < partitions->len; ++i) {
+            gfal_bulk_cancel_submitted(g_ptr_array_index(partitions, i), staging->tokens[i]);
+        }
+        gfal_bulk_token_overflow(partitions, errors, nbfiles);
+        resu = -1;
+    }
+
+    for (i = 0; i < partitions->len; ++i) {
+        g_free(staging->tokens[i]);
+    }
+    g_free(staging->tokens);
+    return resu;
+}
+
+
+int gfal_plugin_bring_online_listG(gfal2_context_t handle, int nbfiles, const char* const* uris,
+        time_t pintime, time_t timeout, char* token, size_t tsize, int async, GError ** errors)
+{
+    gfal_bulk_staging_t staging = {NULL, pintime, timeout, async, tsize, NULL, NULL};
+    GPtrArray* partitions = gfal_bulk_partition_by_plugin(handle, nbfiles, uris, GFAL_PLUGIN_BRING_ONLINE);
+    int resu = gfal_bulk_bring_online_run(handle, partitions, gfal_bulk_bring_online, &staging, token,
+            errors, nbfiles);
+    gfal_bulk_partitions_free(partitions);
     return resu;
 }
 
@@ -1018,25 +1257,47 @@ int gfal_plugin_bring_online_listG(gfal2_context_t handle, int nbfiles, const ch
 int gfal_plugin_bring_online_list_v2G(gfal2_context_t handle, int nbfiles, const char* const* uris,
          const char* const* metadata, time_t pintime, time_t timeout, char* token, size_t tsize, int async, GError ** errors)
 {
-    GError* tmp_err = NULL;
-    int resu = -1;
-    gfal_plugin_interface* p = gfal_find_plugin(handle, *uris, GFAL_PLUGIN_BRING_ONLINE, &tmp_err);
+    gfal_bulk_staging_t staging = {NULL, pintime, timeout, async, tsize, NULL, NULL};
+    GPtrArray* partitions = gfal_bulk_partitions_new();
+    GHashTable* index_by_key = gfal_bulk_partitions_index_new();
+    int i;
 
-    if (p && p->bring_online_list_v2) {
-        resu = p->bring_online_list_v2(gfal_get_plugin_handle(p), nbfiles, uris, metadata, pintime, timeout,
-                token, tsize, async, errors);
-    }
-    else {
-        if (p && !p->bring_online_list) {
-            gfal2_set_error(&tmp_err, gfal2_get_plugins_quark(), EPROTONOSUPPORT,
-                    __func__, "The plugin does not implement bulk bring online");
+    // Same partitioning as gfal_bulk_partition_by_plugin, carrying the metadata along
+    GPtrArray* by_plugin = gfal_bulk_partition_by_plugin(handle, nbfiles, uris, GFAL_PLUGIN_BRING_ONLINE);
+    guint k;
+    for (k = 0; k < by_plugin->len; ++k) {
+        gfal_bulk_partition_t* partition = g_ptr_array_index(by_plugin, k);
+        for (i = 0; i < partition->nbfiles; ++i) {
+            int index = partition->indexes[i];
+            GError* lookup_error = partition->lookup_error ? g_error_copy(partition->lookup_error) : NULL;
+            gfal_bulk_partitions_add(partitions, index_by_key, partition->key, partition->plugin, lookup_error,
+                    index, uris[index], metadata[index]);
         }
-        int i;
-        for (i = 0; i < nbfiles; ++i) {
-            errors[i] = g_error_copy(tmp_err);
-        }
-        g_error_free(tmp_err);
     }
+    g_hash_table_destroy(index_by_key);
+    gfal_bulk_partitions_free(by_plugin);
+
+    int resu = gfal_bulk_bring_online_run(handle, partitions, gfal_bulk_bring_online_v2, &staging, token,
+            errors, nbfiles);
+    gfal_bulk_partitions_free(partitions);
+    return resu;
+}
+
+
+static int gfal_bulk_bring_online_poll(gfal2_context_t context, gfal_bulk_partition_t* partition, gpointer user_data)
+{
+    gfal_bulk_staging_t* staging = (gfal_bulk_staging_t*)user_data;
+    gfal_plugin_interface* p = (gfal_plugin_interface*)partition->plugin;
+    if (gfal_bulk_partition_check(partition, p && p->bring_online_poll_list, __func__,
+            "The plugin does not implement bulk bring online polling") < 0) {
+        return -1;
+    }
+    gchar* token = gfal_bulk_token_get(staging->token, partition);
+    gint64 start = gfal_metrics_start();
+    int resu = p->bring_online_poll_list(gfal_get_plugin_handle(p), partition->nbfiles, partition->uris,
+        token, partition->errors);
+    gfal_metrics_record(context, p, GFAL_METRICS_OP_BRING_ONLINE_POLL_LIST, start, resu < 0, 0);
+    g_free(token);
     return resu;
 }
 
@@ -1044,24 +1305,28 @@ int gfal_plugin_bring_online_list_v2G(gfal2_context_t handle, int nbfiles, const
 int gfal_plugin_bring_online_poll_listG(gfal2_context_t handle, int nbfiles, const char* const* uris,
         const char* token, GError ** errors)
 {
-    GError* tmp_err = NULL;
-    int resu = -1;
-    gfal_plugin_interface* p = gfal_find_plugin(handle, *uris, GFAL_PLUGIN_BRING_ONLINE, &tmp_err);
+    gfal_bulk_staging_t staging = {NULL, 0, 0, 0, 0, token, NULL};
+    GPtrArray* partitions = gfal_bulk_partition_by_plugin(handle, nbfiles, uris, GFAL_PLUGIN_BRING_ONLINE);
+    int resu = gfal_bulk_partitions_run(handle, partitions, gfal_bulk_bring_online_poll, &staging, errors);
+    gfal_bulk_partitions_free(partitions);
+    return resu;
+}
 
-    if (p && p->bring_online_poll_list) {
-        resu = p->bring_online_poll_list(gfal_get_plugin_handle(p), nbfiles, uris, token, errors);
-    }
-    else {
-        if (p && !p->bring_online_poll_list) {
-            gfal2_set_error(&tmp_err, gfal2_get_plugins_quark(), EPROTONOSUPPORT,
-                    __func__, "The plugin does not implement bulk bring online polling");
-        }
-        int i;
-        for (i = 0; i < nbfiles; ++i) {
-            errors[i] = g_error_copy(tmp_err);
-        }
-        g_error_free(tmp_err);
+
+static int gfal_bulk_release_file(gfal2_context_t context, gfal_bulk_partition_t* partition, gpointer user_data)
+{
+    gfal_bulk_staging_t* staging = (gfal_bulk_staging_t*)user_data;
+    gfal_plugin_interface* p = (gfal_plugin_interface*)partition->plugin;
+    if (gfal_bulk_partition_check(partition, p && p->release_file_list, __func__,
+            "The plugin does not implement bulk releases") < 0) {
+        return -1;
     }
+    gchar* token = gfal_bulk_token_get(staging->token, partition);
+    gint64 start = gfal_metrics_start();
+    int resu = p->release_file_list(gfal_get_plugin_handle(p), partition->nbfiles, partition->uris,
+        token, partition->errors);
+    gfal_metrics_record(context, p, GFAL_METRICS_OP_RELEASE_LIST, start, resu < 0, 0);
+    g_free(token);
     return resu;
 }
 
@@ -1069,78 +1334,185 @@ int gfal_plugin_bring_online_poll_listG(gfal2_context_t handle, int nbfiles, con
 int gfal_plugin_release_file_listG(gfal2_context_t handle, int nbfiles, const char* const* uris,
         const char* token, GError ** errors)
 {
-    GError* tmp_err = NULL;
-    int resu = -1;
-    gfal_plugin_interface* p = gfal_find_plugin(handle, *uris, GFAL_PLUGIN_BRING_ONLINE, &tmp_err);
+    gfal_bulk_staging_t staging = {NULL, 0, 0, 0, 0, token, NULL};
+    GPtrArray* partitions = gfal_bulk_partition_by_plugin(handle, nbfiles, uris, GFAL_PLUGIN_BRING_ONLINE);
+    int resu = gfal_bulk_partitions_run(handle, partitions, gfal_bulk_release_file, &staging, errors);
+    gfal_bulk_partitions_free(partitions);
+    return resu;
+}
+
 
-    if (p && p->release_file_list) {
-        resu = p->release_file_list(gfal_get_plugin_handle(p), nbfiles, uris, token, errors);
+static int gfal_bulk_unlink(gfal2_context_t context, gfal_bulk_partition_t* partition, gpointer user_data)
+{
+    gfal_plugin_interface* p = (gfal_plugin_interface*)partition->plugin;
+    if (gfal_bulk_partition_check(partition, p != NULL, __func__, "No plugin found for the urls") < 0) {
+        return -1;
     }
+
+    plugin_handle handle = gfal_get_plugin_handle(p);
+    gint64 start = gfal_metrics_start();
+    int i, resu = 0;
+    if (p->unlink_listG) {
+        resu = p->unlink_listG(handle, partition->nbfiles, partition->uris, partition->errors);
+    }
+    // Fallback
     else {
-        if (p && !p->release_file_list) {
-            gfal2_set_error(&tmp_err, gfal2_get_plugins_quark(), EPROTONOSUPPORT,
-                    __func__, "The plugin does not implement bulk releases");
-        }
-        int i;
-        for (i = 0; i < nbfiles; ++i) {
-            errors[i] = g_error_copy(tmp_err);
+        for (i = 0; i < partition->nbfiles; ++i) {
+            resu += p->unlinkG(handle, partition->uris[i], &(partition->errors[i]));
         }
-        g_error_free(tmp_err);
     }
+    gfal_metrics_record(context, p, GFAL_METRICS_OP_UNLINK_LIST, start, resu < 0, 0);
     return resu;
 }
 
 
 int gfal_plugin_unlink_listG(gfal2_context_t handle, int nbfiles, const char* const* uris, GError ** errors)
 {
-    GError* tmp_err = NULL;
-    int resu = -1;
-    gfal_plugin_interface* p = gfal_find_plugin(handle, *uris, GFAL_PLUGIN_UNLINK, &tmp_err);
+    GPtrArray* partitions = gfal_bulk_partition_by_plugin(handle, nbfiles, uris, GFAL_PLUGIN_UNLINK);
+    int resu = gfal_bulk_partitions_run(handle, partitions, gfal_bulk_unlink, NULL, errors);
+    gfal_bulk_partitions_free(partitions);
+    return resu;
+}
 
-    if (p) {
-        plugin_handle handle = gfal_get_plugin_handle(p);
-        if (p->unlink_listG) {
-            resu = p->unlink_listG(handle, nbfiles, uris, errors);
-        }
-        // Fallback
-        else {
-            int i;
-            resu = 0;
-            for (i = 0; i < nbfiles; ++i) {
-                resu += p->unlinkG(handle, uris[i], &(errors[i]));
-            }
-        }
+
+static int gfal_bulk_stat_one(gfal_bulk_partition_t* partition, int i, gpointer user_data)
+{
+    gfal_plugin_interface* p = (gfal_plugin_interface*)partition->plugin;
+    struct stat* stats = (struct stat*)user_data;
+    return p->statG(gfal_get_plugin_handle(p), partition->uris[i], &stats[i], &partition->errors[i]);
+}
+
+
+static int gfal_bulk_stat(gfal2_context_t context, gfal_bulk_partition_t* partition, gpointer user_data)
+{
+    struct stat* stats = (struct stat*)user_data;
+    gfal_plugin_interface* p = (gfal_plugin_interface*)partition->plugin;
+    if (gfal_bulk_partition_check(partition, p != NULL, __func__, "No plugin found for the urls") < 0) {
+        return -1;
+    }
+
+    int i, resu;
+    struct stat* partition_stats = g_new0(struct stat, partition->nbfiles);
+    gint64 start = gfal_metrics_start();
+
+    if (p->stat_listG) {
+        resu = p->stat_listG(gfal_get_plugin_handle(p), partition->nbfiles, partition->uris,
+            partition_stats, partition->errors);
     }
+    // Fallback, one stat per file, several at the same time
     else {
-        int i;
-        for (i = 0; i < nbfiles; ++i) {
-            errors[i] = g_error_copy(tmp_err);
-        }
-        g_error_free(tmp_err);
+        int nthreads = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP, "STAT_LIST_THREADS",
+            GFAL_BULK_DEFAULT_STAT_THREADS);
+        resu = gfal_bulk_partition_foreach(partition, nthreads, gfal_bulk_stat_one, partition_stats);
     }
+    gfal_metrics_record(context, p, GFAL_METRICS_OP_STAT_LIST, start, resu < 0, 0);
 
+    for (i = 0; i < partition->nbfiles; ++i) {
+        stats[partition->indexes[i]] = partition_stats[i];
+    }
+    g_free(partition_stats);
     return resu;
 }
 
 
-int gfal_plugin_abort_filesG(gfal2_context_t handle, int nbfiles,
-        const char* const * uris, const char* token, GError ** errors)
+int gfal_plugin_stat_listG(gfal2_context_t handle, int nbfiles, const char* const* uris,
+        struct stat* stats, GError ** errors)
 {
-    GError* tmp_err = NULL;
-    int resu = -1;
-    gfal_plugin_interface* p = gfal_find_plugin(handle, *uris, GFAL_PLUGIN_BRING_ONLINE, &tmp_err);
+    GPtrArray* partitions = gfal_bulk_partition_by_plugin(handle, nbfiles, uris, GFAL_PLUGIN_STAT);
+    int resu = gfal_bulk_partitions_run(handle, partitions, gfal_bulk_stat, stats, errors);
+    gfal_bulk_partitions_free(partitions);
+    return resu;
+}
 
-    if (p) {
-        plugin_handle handle = gfal_get_plugin_handle(p);
-        resu = p->abort_files(handle, nbfiles, uris, token, errors);
+
+typedef struct {
+    const char* check_type;
+    char** checksum_buffers;    // of the whole request
+    char** partition_buffers;   // of the partition being processed
+    size_t buffer_length;
+} gfal_bulk_checksum_t;
+
+
+static int gfal_bulk_checksum_one(gfal_bulk_partition_t* partition, int i, gpointer user_data)
+{
+    gfal_plugin_interface* p = (gfal_plugin_interface*)partition->plugin;
+    gfal_bulk_checksum_t* checksum = (gfal_bulk_checksum_t*)user_data;
+    return p->checksum_calcG(gfal_get_plugin_handle(p), partition->uris[i], checksum->check_type,
+        checksum->partition_buffers[i], checksum->buffer_length, 0, 0, &partition->errors[i]);
+}
+
+
+static int gfal_bulk_checksum(gfal2_context_t context, gfal_bulk_partition_t* partition, gpointer user_data)
+{
+    gfal_bulk_checksum_t* shared = (gfal_bulk_checksum_t*)user_data;
+    gfal_plugin_interface* p = (gfal_plugin_interface*)partition->plugin;
+    if (gfal_bulk_partition_check(partition, p && (p->checksum_listG || p->checksum_calcG), __func__,
+            "The plugin does not implement checksums") < 0) {
+        return -1;
     }
+
+    // The buffers are the caller's, only rearranged
+    int i, resu;
+    gfal_bulk_checksum_t checksum = *shared;
+    checksum.partition_buffers = g_new0(char*, partition->nbfiles);
+    for (i = 0; i < partition->nbfiles; ++i) {
+        checksum.partition_buffers[i] = shared->checksum_buffers[partition->indexes[i]];
+    }
+
+    gint64 start = gfal_metrics_start();
+    if (p->checksum_listG) {
+        resu = p->checksum_listG(gfal_get_plugin_handle(p), partition->nbfiles, partition->uris,
+            checksum.check_type, checksum.partition_buffers, checksum.buffer_length, partition->errors);
+    }
+    // Fallback, one checksum per file, several at the same time
     else {
-        int i;
-        for (i = 0; i < nbfiles; ++i) {
-            errors[i] = g_error_copy(tmp_err);
-        }
-        g_error_free(tmp_err);
+        int nthreads = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP, "CHECKSUM_LIST_THREADS",
+            GFAL_BULK_DEFAULT_CHECKSUM_THREADS);
+        resu = gfal_bulk_partition_foreach(partition, nthreads, gfal_bulk_checksum_one, &checksum);
+    }
+    gfal_metrics_record(context, p, GFAL_METRICS_OP_CHECKSUM_LIST, start, resu < 0, 0);
+
+    g_free(checksum.partition_buffers);
+    return resu;
+}
+
+
+int gfal_plugin_checksum_listG(gfal2_context_t handle, int nbfiles, const char* const* uris,
+        const char* check_type, char** checksum_buffers, size_t buffer_length, GError ** errors)
+{
+    gfal_bulk_checksum_t checksum = {check_type, checksum_buffers, NULL, buffer_length};
+    GPtrArray* partitions = gfal_bulk_partition_by_plugin(handle, nbfiles, uris, GFAL_PLUGIN_CHECKSUM);
+    int resu = gfal_bulk_partitions_run(handle, partitions, gfal_bulk_checksum, &checksum, errors);
+    gfal_bulk_partitions_free(partitions);
+    return resu;
+}
+
+
+static int gfal_bulk_abort_files(gfal2_context_t context, gfal_bulk_partition_t* partition, gpointer user_data)
+{
+    gfal_bulk_staging_t* staging = (gfal_bulk_staging_t*)user_data;
+    gfal_plugin_interface* p = (gfal_plugin_interface*)partition->plugin;
+    if (gfal_bulk_partition_check(partition, p && p->abort_files, __func__,
+            "The plugin does not implement abort") < 0) {
+        return -1;
     }
+    gchar* token = gfal_bulk_token_get(staging->token, partition);
+    gint64 start = gfal_metrics_start();
+    int resu = p->abort_files(gfal_get_plugin_handle(p), partition->nbfiles, partition->uris,
+        token, partition->errors);
+    gfal_metrics_record(context, p, GFAL_METRICS_OP_ABORT, start, resu < 0, 0);
+    g_free(token);
+    return resu;
+}
+
+
+int gfal_plugin_abort_filesG(gfal2_context_t handle, int nbfiles,
+        const char* const * uris, const char* token, GError ** errors)
+{
+    gfal_bulk_staging_t staging = {NULL, 0, 0, 0, 0, token, NULL};
+    GPtrArray* partitions = gfal_bulk_partition_by_plugin(handle, nbfiles, uris, GFAL_PLUGIN_BRING_ONLINE);
+    int resu = gfal_bulk_partitions_run(handle, partitions, gfal_bulk_abort_files, &staging, errors);
+    gfal_bulk_partitions_free(partitions);
     return resu;
 }
 
@@ -1151,32 +1523,34 @@ int gfal_plugin_archive_pollG(gfal2_context_t handle, const char* uri, GError **
     int resu = -1;
     gfal_plugin_interface* p = gfal_find_plugin(handle, uri, GFAL_PLUGIN_ARCHIVE, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         resu = p->archive_poll(gfal_get_plugin_handle(p), uri, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_ARCHIVE_POLL, start, resu < 0, 0);
+    }
     G_RETURN_ERR(resu, tmp_err, err);
 }
 
+static int gfal_bulk_archive_poll(gfal2_context_t context, gfal_bulk_partition_t* partition, gpointer user_data)
+{
+    gfal_plugin_interface* p = (gfal_plugin_interface*)partition->plugin;
+    if (gfal_bulk_partition_check(partition, p && p->archive_poll_list, __func__,
+            "The plugin does not support bulk archive polling") < 0) {
+        return -1;
+    }
+    gint64 start = gfal_metrics_start();
+    int resu = p->archive_poll_list(gfal_get_plugin_handle(p), partition->nbfiles, partition->uris, partition->errors);
+    gfal_metrics_record(context, p, GFAL_METRICS_OP_ARCHIVE_POLL_LIST, start, resu < 0, 0);
+    return resu;
+}
+
+
 int gfal_plugin_archive_poll_listG(gfal2_context_t handle, int nbfiles, const char* const* uris,
                                    GError ** errors)
 {
-    GError* tmp_err = NULL;
-    int resu = -1;
-    gfal_plugin_interface* p = gfal_find_plugin(handle, *uris, GFAL_PLUGIN_ARCHIVE, &tmp_err);
-
-    if (p && p->archive_poll_list) {
-        resu = p->archive_poll_list(gfal_get_plugin_handle(p), nbfiles, uris, errors);
-    }
-    else {
-        if (p && !p->archive_poll_list) {
-            gfal2_set_error(&tmp_err, gfal2_get_plugins_quark(), EPROTONOSUPPORT,
-                            __func__, "The plugin does not support bulk archive polling");
-        }
-        int i;
-        for (i = 0; i < nbfiles; ++i) {
-            errors[i] = g_error_copy(tmp_err);
-        }
-        g_error_free(tmp_err);
-    }
+    GPtrArray* partitions = gfal_bulk_partition_by_plugin(handle, nbfiles, uris, GFAL_PLUGIN_ARCHIVE);
+    int resu = gfal_bulk_partitions_run(handle, partitions, gfal_bulk_archive_poll, NULL, errors);
+    gfal_bulk_partitions_free(partitions);
     return resu;
 }
 
@@ -1188,8 +1562,11 @@ ssize_t gfal_plugin_token_retrieveG(gfal2_context_t handle, const char* url, con
     ssize_t resu = -1;
     gfal_plugin_interface* p = gfal_find_plugin(handle, url, GFAL_PLUGIN_TOKEN, &tmp_err);
 
-    if (p)
+    if (p) {
+        gint64 start = gfal_metrics_start();
         resu = p->token_retrieve(gfal_get_plugin_handle(p), url, issuer,
                                  write_access, validity, activities, buff, s_buff, err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_TOKEN, start, resu < 0, 0);
+    }
     G_RETURN_ERR(resu, tmp_err, err);
 }
@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gfal_api.h>
+#include <uri/gfal2_uri.h>
+#include "gfal_plugin.h"
+#include "gfal_plugin_bulk.h"
+
+#define GFAL_BULK_DEFAULT_PARTITION_THREADS 8
+// Tokens of several partitions are written as GFAL_BULK_TOKEN_PREFIX followed by
+// "<length>:<key><length>:<token>" for each of them, so neither may need escaping
+#define GFAL_BULK_TOKEN_PREFIX "gfal2-bulk:"
+
+
+typedef struct {
+    gfal2_context_t context;
+    gfal_bulk_partition_func func;
+    gpointer user_data;
+} gfal_bulk_run_t;
+
+
+gchar* gfal_bulk_get_endpoint(const char* url)
+{
+    GError* tmp_err = NULL;
+    gfal2_uri* parsed = gfal2_parse_uri(url, &tmp_err);
+    gchar* endpoint;
+
+    if (tmp_err || parsed == NULL) {
+        g_clear_error(&tmp_err);
+        endpoint = g_strdup("");
+    }
+    else {
+        endpoint = g_strdup_printf("%s://%s:%d", parsed->scheme ? parsed->scheme : "",
+            parsed->host ? parsed->host : "", parsed->port);
+    }
+    gfal2_free_uri(parsed);
+    return endpoint;
+}
+
+
+GPtrArray* gfal_bulk_partitions_new(void)
+{
+    return g_ptr_array_new();
+}
+
+
+GHashTable* gfal_bulk_partitions_index_new(void)
+{
+    return g_hash_table_new(g_str_hash, g_str_equal);
+}
+
+
+gfal_bulk_partition_t* gfal_bulk_partitions_add(GPtrArray* partitions, GHashTable* index_by_key, const char* key,
+    gpointer plugin, GError* lookup_error, int index, const char* uri, const char* uri2)
+{
+    gfal_bulk_partition_t* partition = g_hash_table_lookup(index_by_key, key);
+
+    if (partition == NULL) {
+        partition = g_new0(gfal_bulk_partition_t, 1);
+        partition->key = g_strdup(key);
+        partition->plugin = plugin;
+        partition->lookup_error = lookup_error;
+        lookup_error = NULL;
+        g_ptr_array_add(partitions, partition);
+        g_hash_table_insert(index_by_key, partition->key, partition);
+    }
+    g_clear_error(&lookup_error);
+
+    int n = partition->nbfiles++;
+    partition->indexes = g_renew(int, partition->indexes, n + 1);
+    partition->uris = g_renew(const char*, partition->uris, n + 2);
+    partition->uris2 = g_renew(const char*, partition->uris2, n + 2);
+    partition->indexes[n] = index;
+    partition->uris[n] = uri;
+    partition->uris[n + 1] = NULL;
+    partition->uris2[n] = uri2;
+    partition->uris2[n + 1] = NULL;
+    return partition;
+}
+
+
+static void gfal_bulk_partition_execute(gpointer data, gpointer user_data)
+{
+    gfal_bulk_partition_t* partition = (gfal_bulk_partition_t*)data;
+    gfal_bulk_run_t* run = (gfal_bulk_run_t*)user_data;
+    partition->result = run->func(run->context, partition, run->user_data);
+}
+
+
+int gfal_bulk_partitions_run(gfal2_context_t context, GPtrArray* partitions,
+    gfal_bulk_partition_func func, gpointer user_data, GError** errors)
+{
+    gfal_bulk_run_t run = {context, func, user_data};
+    guint i;
+    int j;
+
+    for (i = 0; i < partitions->len; ++i) {
+        gfal_bulk_partition_t* partition = g_ptr_array_index(partitions, i);
+        partition->errors = g_new0(GError*, partition->nbfiles);
+    }
+
+    if (partitions->len == 1) {
+        gfal_bulk_partition_execute(g_ptr_array_index(partitions, 0), &run);
+    }
+    else if (partitions->len > 1) {
+        int nthreads = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP, "BULK_PARTITION_THREADS",
+            GFAL_BULK_DEFAULT_PARTITION_THREADS);
+        if (nthreads <= 0) {
+            nthreads = 1;
+        }
+        gfal2_log(G_LOG_LEVEL_DEBUG, "Bulk request split into %u partitions", partitions->len);
+
+        GThreadPool* pool = g_thread_pool_new(gfal_bulk_partition_execute, &run,
+            MIN(nthreads, (int)partitions->len), FALSE, NULL);
+        for (i = 0; i < partitions->len; ++i) {
+            gfal_bulk_partition_t* partition = g_ptr_array_index(partitions, i);
+            if (pool == NULL || !g_thread_pool_push(pool, partition, NULL)) {
+                gfal_bulk_partition_execute(partition, &run);
+            }
+        }
+        if (pool) {
+            g_thread_pool_free(pool, FALSE, TRUE);
+        }
+    }
+
+    int result = 1;
+    for (i = 0; i < partitions->len; ++i) {
+        gfal_bulk_partition_t* partition = g_ptr_array_index(partitions, i);
+        for (j = 0; j < partition->nbfiles; ++j) {
+            errors[partition->indexes[j]] = partition->errors[j];
+            partition->errors[j] = NULL;
+        }
+        if (i == 0 || partition->result < result) {
+            result = partition->result;
+        }
+    }
+    return result;
+}
+
+
+void gfal_bulk_partitions_free(GPtrArray* partitions)
+{
+    guint i;
+    if (partitions == NULL) {
+        return;
+    }
+    for (i = 0; i < partitions->len; ++i) {
+        gfal_bulk_partition_t* partition = g_ptr_array_index(partitions, i);
+        int j;
+        if (partition->errors) {
+            for (j = 0; j < partition->nbfiles; ++j) {
+                g_clear_error(&partition->errors[j]);
+            }
+        }
+        g_free(partition->errors);
+        g_clear_error(&partition->lookup_error);
+        g_free(partition->indexes);
+        g_free(partition->uris);
+        g_free(partition->uris2);
+        g_free(partition->key);
+        g_free(partition);
+    }
+    g_ptr_array_free(partitions, TRUE);
+}
+
+
+typedef struct {
+    gfal_bulk_partition_t* partition;
+    gfal_bulk_file_func func;
+    gpointer user_data;
+    gint failed;
+} gfal_bulk_foreach_t;
+
+
+static void gfal_bulk_file_execute(gpointer data, gpointer user_data)
+{
+    gfal_bulk_foreach_t* foreach = (gfal_bulk_foreach_t*)user_data;
+    // Indexes are shifted by one, as NULL can not be pushed
+    int i = GPOINTER_TO_INT(data) - 1;
+    if (foreach->func(foreach->partition, i, foreach->user_data) < 0) {
+        g_atomic_int_inc(&foreach->failed);
+    }
+}
+
+
+int gfal_bulk_partition_foreach(gfal_bulk_partition_t* partition, int nthreads,
+    gfal_bulk_file_func func, gpointer user_data)
+{
+    gfal_bulk_foreach_t foreach = {partition, func, user_data, 0};
+    GThreadPool* pool = NULL;
+    int i;
+
+    if (nthreads > 1 && partition->nbfiles > 1) {
+        pool = g_thread_pool_new(gfal_bulk_file_execute, &foreach, MIN(nthreads, partition->nbfiles), FALSE, NULL);
+    }
+    for (i = 0; i < partition->nbfiles; ++i) {
+        if (pool == NULL || !g_thread_pool_push(pool, GINT_TO_POINTER(i + 1), NULL)) {
+            gfal_bulk_file_execute(GINT_TO_POINTER(i + 1), &foreach);
+        }
+    }
+    if (pool) {
+        g_thread_pool_free(pool, FALSE, TRUE);
+    }
+    return foreach.failed ? -1 : 0;
+}
+
+
+GPtrArray* gfal_bulk_partition_by_plugin(gfal2_context_t context, int nbfiles, const char* const* urls, int mode)
+{
+    GPtrArray* partitions = gfal_bulk_partitions_new();
+    GHashTable* index_by_key = gfal_bulk_partitions_index_new();
+    int i;
+
+    for (i = 0; i < nbfiles; ++i) {
+        GError* tmp_err = NULL;
+        gfal_plugin_interface* p = gfal_find_plugin(context, urls[i], mode, &tmp_err);
+        gchar* endpoint = gfal_bulk_get_endpoint(urls[i]);
+        gchar* key;
+
+        if (p) {
+            key = g_strdup_printf("%s@%s", p->getName(), endpoint);
+        }
+        else {
+            // Unsupported urls are kept together
+            key = g_strdup("");
+        }
+        gfal_bulk_partitions_add(partitions, index_by_key, key, p, tmp_err, i, urls[i], NULL);
+
+        g_free(key);
+        g_free(endpoint);
+    }
+    g_hash_table_destroy(index_by_key);
+    return partitions;
+}
+
+
+static size_t gfal_bulk_token_field_size(size_t len)
+{
+    size_t digits = 1, n;
+    for (n = len; n >= 10; n /= 10) {
+        ++digits;
+    }
+    return digits + 1 + len;
+}
+
+
+size_t gfal_bulk_token_min_size(GPtrArray* partitions)
+{
+    guint i;
+
+    if (partitions->len <= 1) {
+        return 1;
+    }
+
+    // Prefix, and at least the key and a one character token per partition, plus the terminating null
+    size_t size = strlen(GFAL_BULK_TOKEN_PREFIX) + 1;
+    for (i = 0; i < partitions->len; ++i) {
+        gfal_bulk_partition_t* partition = g_ptr_array_index(partitions, i);
+        size += gfal_bulk_token_field_size(strlen(partition->key)) + gfal_bulk_token_field_size(1);
+    }
+    return size;
+}
+
+
+static void gfal_bulk_token_append(GString* joined, const char* value)
+{
+    g_string_append_printf(joined, "%zu:%s", strlen(value), value);
+}
+
+
+int gfal_bulk_token_join(GPtrArray* partitions, char** tokens, char* token, size_t tsize)
+{
+    guint i;
+
+    // A single token is kept as it is, unless it could be mistaken for a joined one
+    if (partitions->len == 1 && (tokens[0] == NULL || !g_str_has_prefix(tokens[0], GFAL_BULK_TOKEN_PREFIX))) {
+        return g_strlcpy(token, tokens[0] ? tokens[0] : "", tsize) < tsize ? 0 : -1;
+    }
+
+    GString* joined = g_string_new(GFAL_BULK_TOKEN_PREFIX);
+    for (i = 0; i < partitions->len; ++i) {
+        gfal_bulk_partition_t* partition = g_ptr_array_index(partitions, i);
+        if (tokens[i] && tokens[i][0]) {
+            gfal_bulk_token_append(joined, partition->key);
+            gfal_bulk_token_append(joined, tokens[i]);
+        }
+    }
+    int ret = (g_strlcpy(token, joined->str, tsize) < tsize) ? 0 : -1;
+    g_string_free(joined, TRUE);
+    return ret;
+}
+
+
+// Parse one "<length>:<value>" field, returning where the next one starts, or NULL if malformed
+static const char* gfal_bulk_token_field(const char* p, const char** value, size_t* len)
+{
+    char* end;
+    if (!g_ascii_isdigit(*p)) {
+        return NULL;
+    }
+    errno = 0;
+    unsigned long n = strtoul(p, &end, 10);
+    if (*end != ':' || errno != 0 || strnlen(end + 1, n) < n) {
+        return NULL;
+    }
+    *value = end + 1;
+    *len = n;
+    return end + 1 + n;
+}
+
+
+gchar* gfal_bulk_token_get(const char* token, const gfal_bulk_partition_t* partition)
+{
+    if (token == NULL) {
+        return NULL;
+    }
+    if (!g_str_has_prefix(token, GFAL_BULK_TOKEN_PREFIX)) {
+        return g_strdup(token);
+    }
+
+    size_t key_len = strlen(partition->key);
+    const char* p = token + strlen(GFAL_BULK_TOKEN_PREFIX);
+    while (*p != '\0') {
+        const char *key, *value;
+        size_t klen, vlen;
+        if ((p = gfal_bulk_token_field(p, &key, &klen)) == NULL ||
+            (p = gfal_bulk_token_field(p, &value, &vlen)) == NULL) {
+            gfal2_log(G_LOG_LEVEL_WARNING, "Malformed bulk token: %s", token);
+            return NULL;
+        }
+        if (klen == key_len && strncmp(key, partition->key, klen) == 0) {
+            return g_strndup(value, vlen);
+        }
+    }
+    return NULL;
+}
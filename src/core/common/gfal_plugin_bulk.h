@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef GFAL_PLUGIN_BULK_H_
+#define GFAL_PLUGIN_BULK_H_
+
+#include <glib.h>
+#include "gfal_common.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Bulk requests may mix urls handled by different plugins, or pointing to different endpoints.
+ * They are split into partitions (same plugin, same endpoint), each one dispatched
+ * separately and in parallel. The per-file errors are merged back in the original order.
+ */
+
+typedef struct gfal_bulk_partition_s {
+    gchar* key;                 // plugin and endpoint(s)
+    gpointer plugin;            // plugin handling the partition, NULL if none was found
+    GError* lookup_error;       // why no plugin was found
+    int nbfiles;
+    int* indexes;               // position of each file in the original request
+    const char** uris;          // subset of the urls, NULL terminated
+    const char** uris2;         // subset of the second url list (i.e. copy destinations), if any
+    GError** errors;            // per-file errors of the subset
+    int result;                 // return value of the partition
+} gfal_bulk_partition_t;
+
+typedef int (*gfal_bulk_partition_func)(gfal2_context_t context, gfal_bulk_partition_t* partition, gpointer user_data);
+
+/*
+ * Return the endpoint of the url as scheme://host:port
+ */
+gchar* gfal_bulk_get_endpoint(const char* url);
+
+GPtrArray* gfal_bulk_partitions_new(void);
+
+/*
+ * Lookup table from key to partition used while filling partitions.
+ * It does not own anything, and must be destroyed before the partitions are freed.
+ */
+GHashTable* gfal_bulk_partitions_index_new(void);
+
+/*
+ * Add a file to the partition identified by key, creating it if needed
+ * index_by_key holds the partitions added so far, as made by gfal_bulk_partitions_index_new.
+ * plugin and lookup_error are only used when the partition is created. lookup_error is always consumed.
+ */
+gfal_bulk_partition_t* gfal_bulk_partitions_add(GPtrArray* partitions, GHashTable* index_by_key, const char* key,
+    gpointer plugin, GError* lookup_error, int index, const char* uri, const char* uri2);
+
+/*
+ * Run func for every partition, in parallel if there are several, with up to
+ * CORE:BULK_PARTITION_THREADS at the same time.
+ * The errors of each partition are moved into errors, at their original position.
+ * Returns the lowest result of all partitions.
+ */
+int gfal_bulk_partitions_run(gfal2_context_t context, GPtrArray* partitions,
+    gfal_bulk_partition_func func, gpointer user_data, GError** errors);
+
+void gfal_bulk_partitions_free(GPtrArray* partitions);
+
+typedef int (*gfal_bulk_file_func)(gfal_bulk_partition_t* partition, int i, gpointer user_data);
+
+/*
+ * Run func for every file of the partition, with up to nthreads at the same time
+ * Returns -1 if func failed for any of them, 0 otherwise.
+ */
+int gfal_bulk_partition_foreach(gfal_bulk_partition_t* partition, int nthreads,
+    gfal_bulk_file_func func, gpointer user_data);
+
+/*
+ * Split urls by plugin (as found for mode) and endpoint
+ */
+GPtrArray* gfal_bulk_partition_by_plugin(gfal2_context_t context, int nbfiles, const char* const* urls, int mode);
+
+/*
+ * Tokens of a request spanning several partitions are combined into a single one,
+ * so the follow-up calls (polling, release, abort) can be routed back.
+ * Each key and token is length-prefixed, so they may contain any character.
+ * Returns -1 if it does not fit in tsize.
+ */
+int gfal_bulk_token_join(GPtrArray* partitions, char** tokens, char* token, size_t tsize);
+
+/*
+ * Smallest buffer the joined token may fit in, so a request that can not
+ * possibly fit is rejected before anything is submitted
+ */
+size_t gfal_bulk_token_min_size(GPtrArray* partitions);
+
+/*
+ * Return the token of a given partition, as a newly allocated string
+ * Tokens that were not joined are returned as they are.
+ */
+gchar* gfal_bulk_token_get(const char* token, const gfal_bulk_partition_t* partition);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GFAL_PLUGIN_BULK_H_ */
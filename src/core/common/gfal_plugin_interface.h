@@ -29,6 +29,7 @@
 #include "gfal_common.h"
 #include "gfal_constants.h"
 #include "gfal_file_handle.h"
+#include "gfal_async.h"
 #include <transfer/gfal_transfer_plugins.h>
 
 #include <glib.h>
@@ -742,10 +743,70 @@ struct _gfal_plugin_interface {
                             gboolean write_access, unsigned validity, const char* const* activities,
                             char* buff, size_t s_buff, GError** err);
 
-      // reserved for future usage
-	 //! @cond
-     void* future[4];
-	 //! @endcond
+    // ASYNC API
+
+  /**
+   * OPTIONAL: Execute the request without blocking the caller
+   *
+   * The plugin must eventually call gfal2_async_complete on the request, from any thread,
+   * once the operation has finished.
+   *
+   * @param plugin_data: internal plugin data
+   * @param context: gfal2 context
+   * @param req: the request to execute
+   * @param fh: the file handle for the fd based operations (pread, pwrite), NULL otherwise
+   * @param err: error handle
+   * @return 1 if the plugin took the request, 0 if the core must execute it synchronously,
+   *         -1 if the request failed immediately (err is set)
+   */
+  int (*async_submitG)(plugin_handle plugin_data, gfal2_context_t context,
+                       gfal2_async_request_t req, gfal_file_handle fh, GError** err);
+
+    // BULK NAMESPACE API
+
+  /**
+   * OPTIONAL: stat a list of files with as few round trips as possible
+   *
+   * @param plugin_data: internal plugin data
+   * @param nbfiles: number of files in the list
+   * @param urls: the urls of the files
+   * @param stats: array of nbfiles stat structures to fill
+   * @param errors: array of nbfiles errors, set for the files that could not be stat'ed
+   * @return 0 if all the files were stat'ed, -1 if at least one failed
+   */
+  int (*stat_listG)(plugin_handle plugin_data, int nbfiles, const char* const* urls,
+                    struct stat* stats, GError** errors);
+
+  /**
+   * OPTIONAL: calculate the full checksum of a list of files
+   *
+   * @param plugin_data: internal plugin data
+   * @param nbfiles: number of files in the list
+   * @param urls: the urls of the files
+   * @param check_type: checksum algorithm
+   * @param checksum_buffers: nbfiles buffers for the checksums, of buffer_length bytes each
+   * @param buffer_length: size of each buffer
+   * @param errors: array of nbfiles errors, set for the files whose checksum could not be obtained
+   * @return 0 if all the checksums were obtained, -1 if at least one failed
+   */
+  int (*checksum_listG)(plugin_handle plugin_data, int nbfiles, const char* const* urls,
+                        const char* check_type, char** checksum_buffers, size_t buffer_length,
+                        GError** errors);
+
+    // FILE API
+
+  /**
+   * OPTIONAL: flush the data written so far into stable storage
+   *
+   * @param plugin_data: internal plugin data
+   * @param fd: file handle, opened for writing
+   * @param err: error handle
+   * @return 0 on success, -1 on error
+   */
+  int (*fsyncG)(plugin_handle plugin_data, gfal_file_handle fd, GError** err);
+
+     // The slots reserved for future usage have all been taken by the hooks above.
+     // New hooks are added at the end, and change the size of the structure.
 };
 
 /**
@@ -785,6 +846,7 @@ int gfal_plugin_readG(gfal2_context_t handle, gfal_file_handle fh, void* buff, s
 
 ssize_t gfal_plugin_preadG(gfal2_context_t handle, gfal_file_handle fh, void* buff, size_t s_buff, off_t offset, GError** err);
 ssize_t gfal_plugin_pwriteG(gfal2_context_t handle, gfal_file_handle fh, void* buff, size_t s_buff, off_t offset, GError** err);
+int gfal_plugin_fsyncG(gfal2_context_t handle, gfal_file_handle fh, GError** err);
 
 
 int gfal_plugin_unlinkG(gfal2_context_t handle, const char* path, GError** err);
@@ -834,6 +896,13 @@ int gfal_plugin_release_file_listG(gfal2_context_t handle, int nbfiles, const ch
 
 int gfal_plugin_unlink_listG(gfal2_context_t handle, int nbfiles, const char* const* uris, GError ** errors);
 
+int gfal_plugin_stat_listG(gfal2_context_t handle, int nbfiles, const char* const* uris,
+                           struct stat* stats, GError ** errors);
+
+int gfal_plugin_checksum_listG(gfal2_context_t handle, int nbfiles, const char* const* uris,
+                               const char* check_type, char** checksum_buffers, size_t buffer_length,
+                               GError ** errors);
+
 int gfal_plugin_abort_filesG(gfal2_context_t handle, int nbfiles, const char* const* uris, const char* token, GError ** err);
 
 ssize_t gfal_plugin_qos_check_classes(gfal2_context_t handle, const char* url, const char* type,
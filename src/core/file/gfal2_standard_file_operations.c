@@ -18,6 +18,7 @@
  * limitations under the License.
  */
 
+#include <errno.h>
 #include <file/gfal_file_api.h>
 
 #include <common/gfal_handle.h>
@@ -25,6 +26,7 @@
 #include <common/gfal_error.h>
 #include <common/gfal_cancel.h>
 #include <common/gfal_config.h>
+#include <common/gfal_metrics_internal.h>
 
 int gfal2_access(gfal2_context_t context, const char *url, int amode, GError **err)
 {
@@ -607,6 +609,36 @@ int gfal2_unlink_list(gfal2_context_t context, int nbfiles, const char *const *u
 }
 
 
+int gfal2_stat_list(gfal2_context_t context, int nbfiles, const char *const *urls, struct stat *stats,
+    GError **errors)
+{
+    GError *tmp_err = NULL;
+    int res = 0;
+
+    if (urls == NULL || *urls == NULL || context == NULL || stats == NULL) {
+        g_set_error(&tmp_err, gfal2_get_core_quark(), EFAULT,
+            "urls or/and stats or/and context are an incorrect arguments");
+        res = -1;
+    }
+    else {
+        res = gfal2_start_scope_cancel(context, &tmp_err);
+        if (res == 0) {
+            res = gfal_plugin_stat_listG(context, nbfiles, urls, stats, errors);
+            gfal2_end_scope_cancel(context);
+        }
+    }
+
+    if (tmp_err) {
+        int i;
+        for (i = 0; i < nbfiles; ++i) {
+            errors[i] = g_error_copy(tmp_err);
+        }
+        g_error_free(tmp_err);
+    }
+    return res;
+}
+
+
 int gfal2_abort_files(gfal2_context_t context, int nbfiles, const char *const *urls, const char *token, GError **err)
 {
     GError *tmp_err = NULL;
@@ -660,6 +692,28 @@ int gfal2_archive_poll_list(gfal2_context_t context, int nbfiles, const char* co
 }
 
 
+// If configured, always return Adler32 checksum as 8-byte string
+static void gfal2_format_checksum(gfal2_context_t handle, const char *check_type,
+    char *checksum_buffer, size_t buffer_length)
+{
+    gboolean format_checksum = gfal2_get_opt_boolean_with_default(handle, "CORE", "FORMAT_ADLER32_CHECKSUM", TRUE);
+
+    if (format_checksum && checksum_buffer != NULL &&
+        strncasecmp(check_type, "adler32", strlen(check_type)) == 0) {
+        size_t checksum_len = strlen(checksum_buffer);
+
+        if (checksum_len < GFAL_ADLER_CHKSUM_LEN && buffer_length > GFAL_ADLER_CHKSUM_LEN) {
+            size_t diff = GFAL_ADLER_CHKSUM_LEN - checksum_len;
+            char* tmp_buffer = g_strdup(checksum_buffer);
+            memset(checksum_buffer, '0', diff);
+            g_strlcpy(checksum_buffer + diff, tmp_buffer, buffer_length);
+            gfal2_log(G_LOG_LEVEL_DEBUG, "Formatted adler32 checksum: %s --> %s", tmp_buffer, checksum_buffer);
+            g_free(tmp_buffer);
+        }
+    }
+}
+
+
 int gfal2_checksum(gfal2_context_t handle, const char *url, const char *check_type,
     off_t start_offset, size_t data_length,
     char *checksum_buffer, size_t buffer_length, GError **err)
@@ -676,28 +730,57 @@ int gfal2_checksum(gfal2_context_t handle, const char *url, const char *check_ty
     gfal_plugin_interface *p = gfal_find_plugin(handle, url, GFAL_PLUGIN_CHECKSUM, &tmp_err);
 
     if (p) {
+        gint64 start = gfal_metrics_start();
         res = p->checksum_calcG(gfal_get_plugin_handle(p), url, check_type, checksum_buffer, buffer_length,
             start_offset,
             data_length, &tmp_err);
+        gfal_metrics_record(handle, p, GFAL_METRICS_OP_CHECKSUM, start, res < 0, 0);
     }
     GFAL2_END_SCOPE_CANCEL(handle);
 
-    // If configured, always return Adler32 checksum as 8-byte string
-    gboolean format_checksum = gfal2_get_opt_boolean_with_default(handle, "CORE", "FORMAT_ADLER32_CHECKSUM", TRUE);
+    gfal2_format_checksum(handle, check_type, checksum_buffer, buffer_length);
 
-    if (format_checksum && checksum_buffer != NULL &&
-        strncasecmp(check_type, "adler32", strlen(check_type)) == 0) {
-        size_t checksum_len = strlen(checksum_buffer);
+    G_RETURN_ERR(res, tmp_err, err);
+}
 
-        if (checksum_len < GFAL_ADLER_CHKSUM_LEN && buffer_length > GFAL_ADLER_CHKSUM_LEN) {
-            size_t diff = GFAL_ADLER_CHKSUM_LEN - checksum_len;
-            char* tmp_buffer = g_strdup(checksum_buffer);
-            memset(checksum_buffer, '0', diff);
-            g_strlcpy(checksum_buffer + diff, tmp_buffer, buffer_length);
-            gfal2_log(G_LOG_LEVEL_DEBUG, "Formatted adler32 checksum: %s --> %s", tmp_buffer, checksum_buffer);
-            g_free(tmp_buffer);
+
+int gfal2_checksum_list(gfal2_context_t handle, int nbfiles, const char *const *urls, const char *check_type,
+    char **checksum_buffers, size_t buffer_length, GError **errors)
+{
+    GError *tmp_err = NULL;
+    int res = 0, i;
+
+    // Nowhere to report the error
+    if (errors == NULL || nbfiles <= 0) {
+        errno = (errors == NULL) ? EFAULT : EINVAL;
+        return -1;
+    }
+
+    if (urls == NULL || *urls == NULL || handle == NULL || check_type == NULL
+        || checksum_buffers == NULL || buffer_length == 0) {
+        g_set_error(&tmp_err, gfal2_get_core_quark(), EFAULT, "Invalid parameters to %s", __func__);
+        res = -1;
+    }
+    else {
+        res = gfal2_start_scope_cancel(handle, &tmp_err);
+        if (res == 0) {
+            res = gfal_plugin_checksum_listG(handle, nbfiles, urls, check_type, checksum_buffers, buffer_length,
+                errors);
+            gfal2_end_scope_cancel(handle);
+
+            for (i = 0; i < nbfiles; ++i) {
+                if (errors[i] == NULL) {
+                    gfal2_format_checksum(handle, check_type, checksum_buffers[i], buffer_length);
+                }
+            }
         }
     }
 
-    G_RETURN_ERR(res, tmp_err, err);
+    if (tmp_err) {
+        for (i = 0; i < nbfiles; ++i) {
+            errors[i] = g_error_copy(tmp_err);
+        }
+        g_error_free(tmp_err);
+    }
+    return res;
 }
@@ -91,6 +91,24 @@ int gfal2_checksum(gfal2_context_t context, const char* url, const char* check_t
                  off_t start_offset, size_t data_length,
                 char * checksum_buffer, size_t buffer_length, GError ** err);
 
+/**
+ * @brief compute the checksum of a list of files
+ *
+ * Full file checksums only. Urls are grouped by plugin and endpoint; plugins without
+ * bulk checksum support get one checksum request per file, issued concurrently.
+ * @param context : gfal2 handle, see \ref gfal2_context_new
+ * @param nbfiles : number of files
+ * @param urls : urls of the files
+ * @param check_type : string of the checksum type ( \ref GFAL_CHKSUM_MD5, \ref GFAL_CHKSUM_SHA1, .. )
+ * @param checksum_buffers : nbfiles pre-allocated buffers for the checksums
+ * @param buffer_length : length of each buffer
+ * @param errors : Pre-allocated array with nbfiles pointers to errors.
+ * @return 0 if all the checksums were computed, -1 if at least one failed. Check errors for the individual status.
+ *         -1 with errno set, and nothing else done, if errors is NULL or nbfiles is not positive.
+ */
+int gfal2_checksum_list(gfal2_context_t context, int nbfiles, const char* const* urls, const char* check_type,
+                        char** checksum_buffers, size_t buffer_length, GError ** errors);
+
 /**
  * @brief permission check
  *
@@ -563,6 +581,22 @@ int gfal2_release_file_list(gfal2_context_t context, int nbfiles, const char* co
  */
 int gfal2_unlink_list(gfal2_context_t context, int nbfiles, const char* const* urls, GError ** errors);
 
+/**
+ * @brief Stat a list of files
+ *
+ * @param context : gfal2 handle, see \ref gfal2_context_new
+ * @param nbfiles : number of files
+ * @param urls    : urls of the files
+ * @param stats   : Pre-allocated array of nbfiles stat structures
+ * @param errors  : Pre-allocated array with nbfiles pointers to errors.
+ *                  It is the user's responsability to allocate and free.
+ * @return 0 if all the files were stat'ed, -1 if at least one failed. Check errors for the individual status.
+ * @note Urls are grouped by plugin and endpoint. Plugins without bulk stat support
+ *       get one stat per file, issued concurrently
+ */
+int gfal2_stat_list(gfal2_context_t context, int nbfiles, const char* const* urls,
+                    struct stat* stats, GError ** errors);
+
 /**
  * @brief abort a list of files
  * @param context : gfal2 handle, see \ref gfal2_context_new
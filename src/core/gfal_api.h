@@ -38,6 +38,7 @@
 
 /* log  API */
 #include <logger/gfal_logger.h>
+#include <logger/gfal_trace.h>
 
 /* main gfal2 API for file operations */
 #include <file/gfal_file_api.h>
@@ -45,11 +46,18 @@
 /* operation control API */
 #include <common/gfal_cancel.h>
 
+/* asynchronous operations */
+#include <common/gfal_async.h>
+
+/* metrics */
+#include <common/gfal_metrics.h>
+
 /* posix compatibility layer */
 #include <posix/gfal_posix_api.h>
 
 /* transfers*/
 #include <transfer/gfal_transfer.h>
+#include <transfer/gfal_transfer_scheduler.h>
 
 /* error helpers*/
 #include <common/gfal_error.h>
@@ -25,30 +25,234 @@
 
 #include "gfal_logger.h"
 
+// Size of the per thread buffer where messages are formatted
+#define GFAL_LOG_STAGING_SIZE 1024
+#define GFAL_LOG_DEFAULT_BUDGET (4 * 1024 * 1024)
+
 
 static GLogLevelFlags gfal2_log_level = G_LOG_LEVEL_WARNING;
 
+/*
+ * Asynchronous logging
+ * Producers format into a thread local buffer, copy the message into a record and push it
+ * into an intrusive multiple producers, single consumer queue (Vyukov), which does not need any lock.
+ * A writer thread drains the queue in batches and passes each record to g_log, so handlers set with
+ * gfal2_log_set_handler or g_log_set_handler keep working, only from a different thread.
+ * The writer is only woken up when it sleeps, so a burst of messages costs a single wake up.
+ */
+// Link of the queue. The stub of the queue is only a link, as records end with a flexible array
+typedef struct gfal_log_node {
+    struct gfal_log_node* volatile next;
+} gfal_log_node_t;
+
+typedef struct {
+    gfal_log_node_t node;   // must be first, the queue links records through it
+    GLogLevelFlags level;
+    gsize size;
+    char message[];
+} gfal_log_record_t;
 
+typedef struct {
+    gfal_log_node_t* volatile head;     // producers side
+    gfal_log_node_t* tail;              // writer side
+    gfal_log_node_t stub;
+} gfal_log_queue_t;
 
-void gfal2_log(GLogLevelFlags level, const char* msg, ...)
+static gfal_log_queue_t gfal_log_queue = {&gfal_log_queue.stub, &gfal_log_queue.stub, {NULL}};
+
+static volatile gint gfal_log_async = 0;
+static volatile gsize gfal_log_budget = GFAL_LOG_DEFAULT_BUDGET;
+static volatile gsize gfal_log_queued_bytes = 0;
+static volatile gint gfal_log_pending = 0;
+static volatile guint64 gfal_log_dropped = 0;
+
+static pthread_once_t gfal_log_writer_once = PTHREAD_ONCE_INIT;
+static GMutex* gfal_log_lock = NULL;
+static GCond* gfal_log_wakeup = NULL;
+static GCond* gfal_log_drained = NULL;
+static volatile gint gfal_log_writer_sleeping = 0;
+static __thread gboolean gfal_log_is_writer = FALSE;
+
+
+static void gfal_log_queue_push(gfal_log_queue_t* queue, gfal_log_node_t* node)
 {
-    if (level <= gfal2_log_level) {
-        va_list args;
-        va_start(args, msg);
-        g_logv("GFAL2", level, msg, args);
-        va_end(args);
+    node->next = NULL;
+    gfal_log_node_t* prev = __atomic_exchange_n(&queue->head, node, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+
+// Only called by the writer. May return NULL while a push is half done.
+static gfal_log_record_t* gfal_log_queue_pop(gfal_log_queue_t* queue)
+{
+    gfal_log_node_t* tail = queue->tail;
+    gfal_log_node_t* next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == &queue->stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        queue->tail = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+    if (next != NULL) {
+        queue->tail = next;
+        return (gfal_log_record_t*)tail;
+    }
+    if (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    gfal_log_queue_push(queue, &queue->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next != NULL) {
+        queue->tail = next;
+        return (gfal_log_record_t*)tail;
+    }
+    return NULL;
+}
+
+
+static void gfal_log_dispatch(gfal_log_record_t* record)
+{
+    g_log("GFAL2", record->level, "%s", record->message);
+    __sync_fetch_and_sub(&gfal_log_queued_bytes, record->size);
+    g_free(record);
+    __sync_fetch_and_sub(&gfal_log_pending, 1);
+}
+
+
+static gpointer gfal_log_writer(gpointer data)
+{
+    guint64 reported_dropped = 0;
+    gfal_log_record_t* record;
+
+    gfal_log_is_writer = TRUE;
+    while (1) {
+        // Drain the batch
+        while (g_atomic_int_get(&gfal_log_pending) > 0) {
+            record = gfal_log_queue_pop(&gfal_log_queue);
+            if (record) {
+                gfal_log_dispatch(record);
+            }
+            else {
+                g_thread_yield();
+            }
+        }
+
+        guint64 dropped = __sync_fetch_and_add(&gfal_log_dropped, 0);
+        if (dropped != reported_dropped) {
+            g_log("GFAL2", G_LOG_LEVEL_WARNING, "%" G_GUINT64_FORMAT " log messages dropped, the log buffer is full",
+                dropped - reported_dropped);
+            reported_dropped = dropped;
+        }
+
+        g_mutex_lock(gfal_log_lock);
+        g_cond_broadcast(gfal_log_drained);
+        __sync_lock_test_and_set(&gfal_log_writer_sleeping, 1);
+        __sync_synchronize();
+        if (g_atomic_int_get(&gfal_log_pending) == 0) {
+            g_cond_wait(gfal_log_wakeup, gfal_log_lock);
+        }
+        __sync_lock_test_and_set(&gfal_log_writer_sleeping, 0);
+        g_mutex_unlock(gfal_log_lock);
+    }
+    return NULL;
+}
+
+
+static void gfal_log_wake_writer(void)
+{
+    __sync_synchronize();
+    if (g_atomic_int_get(&gfal_log_writer_sleeping)) {
+        g_mutex_lock(gfal_log_lock);
+        g_cond_signal(gfal_log_wakeup);
+        g_mutex_unlock(gfal_log_lock);
+    }
+}
+
+
+static void gfal_log_writer_start(void)
+{
+    if (!g_thread_supported()) {
+        g_thread_init(NULL);
+    }
+    gfal_log_lock = g_mutex_new();
+    gfal_log_wakeup = g_cond_new();
+    gfal_log_drained = g_cond_new();
+    g_thread_create(gfal_log_writer, NULL, FALSE, NULL);
+    atexit(gfal2_log_flush);
+}
+
+
+// Format in the thread local buffer, and queue a copy
+static void gfal_log_enqueue(GLogLevelFlags level, const char* msg, va_list args)
+{
+    static __thread char staging[GFAL_LOG_STAGING_SIZE];
+    char* formatted = staging;
+    va_list args_copy;
+
+    va_copy(args_copy, args);
+    int len = vsnprintf(staging, sizeof(staging), msg, args_copy);
+    va_end(args_copy);
+    if (len < 0) {
+        return;
+    }
+    if (len >= (int)sizeof(staging)) {
+        formatted = g_strdup_vprintf(msg, args);
+    }
+
+    gsize size = sizeof(gfal_log_record_t) + len + 1;
+    if (__sync_add_and_fetch(&gfal_log_queued_bytes, size) > gfal_log_budget) {
+        __sync_fetch_and_sub(&gfal_log_queued_bytes, size);
+        __sync_fetch_and_add(&gfal_log_dropped, 1);
+    }
+    else {
+        gfal_log_record_t* record = g_malloc(size);
+        record->level = level;
+        record->size = size;
+        memcpy(record->message, formatted, len + 1);
+
+        __sync_fetch_and_add(&gfal_log_pending, 1);
+        gfal_log_queue_push(&gfal_log_queue, &record->node);
+        gfal_log_wake_writer();
+    }
+
+    if (formatted != staging) {
+        g_free(formatted);
     }
 }
 
 
 void gfal2_logv(GLogLevelFlags level, const char* msg, va_list args)
 {
-    if (level <= gfal2_log_level) {
+    if (level > gfal2_log_level) {
+        return;
+    }
+    // Errors and critical messages are never delayed nor dropped
+    if (g_atomic_int_get(&gfal_log_async) && !gfal_log_is_writer && level > G_LOG_LEVEL_CRITICAL) {
+        gfal_log_enqueue(level, msg, args);
+    }
+    else {
+        if (!gfal_log_is_writer) {
+            gfal2_log_flush();
+        }
         g_logv("GFAL2", level, msg, args);
     }
 }
 
 
+void gfal2_log(GLogLevelFlags level, const char* msg, ...)
+{
+    if (level <= gfal2_log_level) {
+        va_list args;
+        va_start(args, msg);
+        gfal2_logv(level, msg, args);
+        va_end(args);
+    }
+}
+
+
 void gfal2_log_set_level(GLogLevelFlags level)
 {
     gfal2_log_level = level;
@@ -66,3 +270,54 @@ int gfal2_log_set_handler(GLogFunc func, gpointer user_data)
     return g_log_set_handler("GFAL2", G_LOG_LEVEL_MASK, func, user_data);
 }
 
+
+void gfal2_log_set_async(gboolean enable, gsize budget)
+{
+    if (enable) {
+        gfal_log_budget = budget ? budget : GFAL_LOG_DEFAULT_BUDGET;
+        pthread_once(&gfal_log_writer_once, gfal_log_writer_start);
+        g_atomic_int_set(&gfal_log_async, 1);
+    }
+    else {
+        g_atomic_int_set(&gfal_log_async, 0);
+        gfal2_log_flush();
+    }
+}
+
+
+gboolean gfal2_log_get_async(void)
+{
+    return g_atomic_int_get(&gfal_log_async);
+}
+
+
+void gfal2_log_flush(void)
+{
+    // Nothing queued, or called from a handler
+    if (gfal_log_lock == NULL || gfal_log_is_writer || g_atomic_int_get(&gfal_log_pending) == 0) {
+        return;
+    }
+    g_mutex_lock(gfal_log_lock);
+    while (g_atomic_int_get(&gfal_log_pending) > 0) {
+        g_cond_signal(gfal_log_wakeup);
+        g_cond_wait(gfal_log_drained, gfal_log_lock);
+    }
+    g_mutex_unlock(gfal_log_lock);
+}
+
+
+guint64 gfal2_log_get_dropped(void)
+{
+    return __sync_fetch_and_add(&gfal_log_dropped, 0);
+}
+
+
+// Asynchronous logging can be enabled from the environment, with an optional budget in bytes
+__attribute__((constructor))
+static void gfal_log_init(void)
+{
+    const char* async = getenv("GFAL2_LOG_ASYNC");
+    if (async != NULL) {
+        gfal2_log_set_async(TRUE, strtoul(async, NULL, 10));
+    }
+}
@@ -69,6 +69,33 @@ GLogLevelFlags gfal2_log_get_level(void);
  */
 int gfal2_log_set_handler(GLogFunc func, gpointer user_data);
 
+/**
+ * Enable or disable asynchronous logging.
+ * When enabled, messages are formatted by the calling thread and passed to the handler
+ * from a background thread, so logging does not serialize the callers.
+ * Critical and error messages are still logged synchronously, after the queued ones.
+ * @param budget Maximum memory used by the queued messages, in bytes. 0 for the default (4 MiB).
+ *               Messages that do not fit are dropped and counted, see gfal2_log_get_dropped.
+ * Also enabled when the environment variable GFAL2_LOG_ASYNC is set, its value being the budget.
+ */
+void gfal2_log_set_async(gboolean enable, gsize budget);
+
+/**
+ * Return TRUE if asynchronous logging is enabled
+ */
+gboolean gfal2_log_get_async(void);
+
+/**
+ * Wait until all the queued messages have been passed to the handler.
+ * Called automatically when the process exits.
+ */
+void gfal2_log_flush(void);
+
+/**
+ * Return the number of messages dropped because the asynchronous log budget was exceeded
+ */
+guint64 gfal2_log_get_dropped(void);
+
 
 #ifdef __cplusplus
 }
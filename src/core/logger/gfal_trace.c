@@ -0,0 +1,560 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <gfal_api.h>
+#include "gfal_trace.h"
+
+#define GFAL_TRACE_DEFAULT_CAPACITY 4096
+#define GFAL_TRACE_MAX_DEPTH 64
+// Bound the walk to the root span, in case of loops
+#define GFAL_TRACE_MAX_ANCESTORS 256
+
+
+typedef struct {
+    const char* category;
+    const char* name;
+    gfal2_span_t id;
+    gfal2_span_t parent;
+    gint64 start;
+    gint64 end;
+    long tid;
+} gfal_trace_record_t;
+
+
+typedef struct {
+    GMutex* lock;               // uncontended, except while exporting
+    long tid;
+    gboolean orphan;            // the thread is gone
+    gfal_trace_record_t* records;
+    gsize capacity;
+    guint64 written;            // records[written % capacity] is the next one
+    // Open spans, only touched by the owner thread
+    gfal_trace_record_t stack[GFAL_TRACE_MAX_DEPTH];
+    int depth;
+} gfal_trace_buffer_t;
+
+
+// Spans begun with gfal2_trace_begin_keyed, by category, name and key
+typedef struct {
+    gconstpointer key;
+    const char* category;
+    const char* name;
+} gfal_trace_key_t;
+
+
+volatile gint gfal2_trace_active = 0;
+
+G_LOCK_DEFINE_STATIC(gfal_trace);
+static GSList* gfal_trace_buffers = NULL;
+static volatile gsize gfal_trace_capacity = GFAL_TRACE_DEFAULT_CAPACITY;
+static volatile guint64 gfal_trace_next_id = 0;
+
+G_LOCK_DEFINE_STATIC(gfal_trace_keyed);
+// Queues of open spans, created on first use
+static GHashTable* volatile gfal_trace_keyed = NULL;
+// Number of spans in those queues, so ending a span when none is open does not take the lock
+static volatile gint gfal_trace_keyed_open = 0;
+
+static pthread_once_t gfal_trace_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t gfal_trace_key;
+static __thread gfal_trace_buffer_t* gfal_trace_local = NULL;
+
+
+static void gfal_trace_thread_exit(void* data)
+{
+    gfal_trace_buffer_t* buffer = (gfal_trace_buffer_t*)data;
+    g_mutex_lock(buffer->lock);
+    buffer->orphan = TRUE;
+    g_mutex_unlock(buffer->lock);
+}
+
+
+static void gfal_trace_key_init(void)
+{
+    pthread_key_create(&gfal_trace_key, gfal_trace_thread_exit);
+}
+
+
+static gfal_trace_buffer_t* gfal_trace_get_buffer(void)
+{
+    if (G_LIKELY(gfal_trace_local != NULL)) {
+        return gfal_trace_local;
+    }
+    pthread_once(&gfal_trace_key_once, gfal_trace_key_init);
+
+    gfal_trace_buffer_t* buffer = g_new0(gfal_trace_buffer_t, 1);
+    buffer->lock = g_mutex_new();
+    buffer->tid = syscall(SYS_gettid);
+    pthread_setspecific(gfal_trace_key, buffer);
+
+    G_LOCK(gfal_trace);
+    gfal_trace_buffers = g_slist_prepend(gfal_trace_buffers, buffer);
+    G_UNLOCK(gfal_trace);
+
+    gfal_trace_local = buffer;
+    return buffer;
+}
+
+
+static void gfal_trace_buffer_free(gfal_trace_buffer_t* buffer)
+{
+    g_mutex_free(buffer->lock);
+    g_free(buffer->records);
+    g_free(buffer);
+}
+
+
+void gfal2_trace_enable(gsize capacity)
+{
+    gfal_trace_capacity = capacity ? capacity : GFAL_TRACE_DEFAULT_CAPACITY;
+    if (gfal_trace_next_id == 0) {
+        // Random base, so traces of different processes can be merged
+        __sync_bool_compare_and_swap(&gfal_trace_next_id, 0, ((guint64)g_random_int()) << 32);
+    }
+    g_atomic_int_set(&gfal2_trace_active, 1);
+}
+
+
+void gfal2_trace_disable(void)
+{
+    g_atomic_int_set(&gfal2_trace_active, 0);
+}
+
+
+void gfal2_trace_clear(void)
+{
+    GSList* i = NULL;
+    GSList* alive = NULL;
+
+    G_LOCK(gfal_trace);
+    for (i = gfal_trace_buffers; i != NULL; i = i->next) {
+        gfal_trace_buffer_t* buffer = (gfal_trace_buffer_t*)i->data;
+        g_mutex_lock(buffer->lock);
+        gboolean orphan = buffer->orphan;
+        buffer->written = 0;
+        g_mutex_unlock(buffer->lock);
+        if (orphan) {
+            gfal_trace_buffer_free(buffer);
+        }
+        else {
+            alive = g_slist_prepend(alive, buffer);
+        }
+    }
+    g_slist_free(gfal_trace_buffers);
+    gfal_trace_buffers = alive;
+    G_UNLOCK(gfal_trace);
+}
+
+
+gfal2_span_t gfal2_trace_span_begin(const char* category, const char* name, gfal2_span_t parent)
+{
+    gfal_trace_buffer_t* buffer = gfal_trace_get_buffer();
+    if (buffer->depth >= GFAL_TRACE_MAX_DEPTH) {
+        return 0;
+    }
+    if (parent == 0 && buffer->depth > 0) {
+        parent = buffer->stack[buffer->depth - 1].id;
+    }
+
+    gfal_trace_record_t* span = &buffer->stack[buffer->depth++];
+    span->category = category;
+    span->name = name;
+    span->id = __sync_add_and_fetch(&gfal_trace_next_id, 1);
+    span->parent = parent;
+    span->tid = buffer->tid;
+    span->start = g_get_monotonic_time();
+    return span->id;
+}
+
+
+static void gfal_trace_record(gfal_trace_buffer_t* buffer, const gfal_trace_record_t* span)
+{
+    g_mutex_lock(buffer->lock);
+    if (buffer->capacity != gfal_trace_capacity) {
+        g_free(buffer->records);
+        buffer->capacity = gfal_trace_capacity;
+        buffer->records = g_new0(gfal_trace_record_t, buffer->capacity);
+        buffer->written = 0;
+    }
+    buffer->records[buffer->written % buffer->capacity] = *span;
+    ++buffer->written;
+    g_mutex_unlock(buffer->lock);
+}
+
+
+void gfal2_trace_span_end(gfal2_span_t span)
+{
+    gfal_trace_buffer_t* buffer = gfal_trace_local;
+    int i;
+
+    if (buffer == NULL || span == 0) {
+        return;
+    }
+    for (i = buffer->depth - 1; i >= 0 && buffer->stack[i].id != span; --i)
+        ;
+    if (i < 0) {
+        return;
+    }
+
+    // Children left open are ended with their parent
+    gint64 now = g_get_monotonic_time();
+    while (buffer->depth > i) {
+        gfal_trace_record_t* closing = &buffer->stack[--buffer->depth];
+        closing->end = now;
+        gfal_trace_record(buffer, closing);
+    }
+}
+
+
+void gfal2_trace_end_by_name(const char* category, const char* name)
+{
+    gfal_trace_buffer_t* buffer = gfal_trace_local;
+    int i;
+
+    if (buffer == NULL) {
+        return;
+    }
+    for (i = buffer->depth - 1; i >= 0; --i) {
+        if (g_strcmp0(buffer->stack[i].category, category) == 0 && g_strcmp0(buffer->stack[i].name, name) == 0) {
+            gfal2_trace_span_end(buffer->stack[i].id);
+            return;
+        }
+    }
+}
+
+
+static guint gfal_trace_key_hash(gconstpointer data)
+{
+    const gfal_trace_key_t* key = (const gfal_trace_key_t*)data;
+    return g_direct_hash(key->key) ^ g_str_hash(key->category) ^ (g_str_hash(key->name) * 31);
+}
+
+
+static gboolean gfal_trace_key_equal(gconstpointer a, gconstpointer b)
+{
+    const gfal_trace_key_t* ka = (const gfal_trace_key_t*)a;
+    const gfal_trace_key_t* kb = (const gfal_trace_key_t*)b;
+    return ka->key == kb->key && strcmp(ka->category, kb->category) == 0 && strcmp(ka->name, kb->name) == 0;
+}
+
+
+static void gfal_trace_keyed_queue_free(gpointer data)
+{
+    GQueue* queue = (GQueue*)data;
+    g_queue_foreach(queue, (GFunc)g_free, NULL);
+    g_queue_free(queue);
+}
+
+
+gfal2_span_t gfal2_trace_span_begin_keyed(const char* category, const char* name, gconstpointer key)
+{
+    gfal_trace_buffer_t* buffer = gfal_trace_get_buffer();
+    gfal_trace_record_t* span = g_new0(gfal_trace_record_t, 1);
+    gfal_trace_key_t lookup = {key, category, name};
+
+    span->category = category;
+    span->name = name;
+    span->id = __sync_add_and_fetch(&gfal_trace_next_id, 1);
+    span->parent = gfal2_trace_current();
+    span->tid = buffer->tid;
+    span->start = g_get_monotonic_time();
+
+    G_LOCK(gfal_trace_keyed);
+    if (gfal_trace_keyed == NULL) {
+        gfal_trace_keyed = g_hash_table_new_full(gfal_trace_key_hash, gfal_trace_key_equal,
+            g_free, gfal_trace_keyed_queue_free);
+    }
+    GQueue* queue = (GQueue*)g_hash_table_lookup(gfal_trace_keyed, &lookup);
+    if (queue == NULL) {
+        queue = g_queue_new();
+        gfal_trace_key_t* stored = g_new(gfal_trace_key_t, 1);
+        *stored = lookup;
+        g_hash_table_insert(gfal_trace_keyed, stored, queue);
+    }
+    g_queue_push_tail(queue, span);
+    g_atomic_int_inc(&gfal_trace_keyed_open);
+    G_UNLOCK(gfal_trace_keyed);
+
+    return span->id;
+}
+
+
+void gfal2_trace_end_keyed(const char* category, const char* name, gconstpointer key)
+{
+    gfal_trace_key_t lookup = {key, category, name};
+    gfal_trace_record_t* span = NULL;
+
+    // Nothing is open, i.e. tracing is disabled
+    if (g_atomic_int_get(&gfal_trace_keyed_open) == 0) {
+        return;
+    }
+
+    G_LOCK(gfal_trace_keyed);
+    GQueue* queue = (GQueue*)g_hash_table_lookup(gfal_trace_keyed, &lookup);
+    if (queue != NULL) {
+        span = (gfal_trace_record_t*)g_queue_pop_head(queue);
+        g_atomic_int_add(&gfal_trace_keyed_open, -1);
+        if (g_queue_is_empty(queue)) {
+            g_hash_table_remove(gfal_trace_keyed, &lookup);
+        }
+    }
+    G_UNLOCK(gfal_trace_keyed);
+
+    if (span != NULL) {
+        span->end = g_get_monotonic_time();
+        gfal_trace_record(gfal_trace_get_buffer(), span);
+        g_free(span);
+    }
+}
+
+
+typedef struct {
+    gconstpointer key;
+    gint dropped;
+} gfal_trace_drop_t;
+
+
+static gboolean gfal_trace_keyed_match(gpointer k, gpointer value, gpointer user_data)
+{
+    gfal_trace_drop_t* drop = (gfal_trace_drop_t*)user_data;
+    if (((gfal_trace_key_t*)k)->key != drop->key) {
+        return FALSE;
+    }
+    drop->dropped += g_queue_get_length((GQueue*)value);
+    return TRUE;
+}
+
+
+void gfal2_trace_drop_keyed(gconstpointer key)
+{
+    gfal_trace_drop_t drop = {key, 0};
+
+    if (g_atomic_int_get(&gfal_trace_keyed_open) == 0) {
+        return;
+    }
+    G_LOCK(gfal_trace_keyed);
+    g_hash_table_foreach_remove(gfal_trace_keyed, gfal_trace_keyed_match, &drop);
+    g_atomic_int_add(&gfal_trace_keyed_open, -drop.dropped);
+    G_UNLOCK(gfal_trace_keyed);
+}
+
+
+gfal2_span_t gfal2_trace_current(void)
+{
+    gfal_trace_buffer_t* buffer = gfal_trace_local;
+    if (buffer == NULL || buffer->depth == 0) {
+        return 0;
+    }
+    return buffer->stack[buffer->depth - 1].id;
+}
+
+
+// Copy all the finished spans, oldest first within each thread
+static GArray* gfal_trace_collect(void)
+{
+    GArray* spans = g_array_new(FALSE, FALSE, sizeof(gfal_trace_record_t));
+    GSList* i;
+
+    G_LOCK(gfal_trace);
+    for (i = gfal_trace_buffers; i != NULL; i = i->next) {
+        gfal_trace_buffer_t* buffer = (gfal_trace_buffer_t*)i->data;
+        g_mutex_lock(buffer->lock);
+        if (buffer->written > 0) {
+            guint64 first = (buffer->written > buffer->capacity) ? buffer->written - buffer->capacity : 0;
+            guint64 n;
+            for (n = first; n < buffer->written; ++n) {
+                g_array_append_val(spans, buffer->records[n % buffer->capacity]);
+            }
+        }
+        g_mutex_unlock(buffer->lock);
+    }
+    G_UNLOCK(gfal_trace);
+    return spans;
+}
+
+
+static void gfal_trace_append_escaped(GString* out, const char* str)
+{
+    for (; *str; ++str) {
+        switch (*str) {
+            case '"':
+                g_string_append(out, "\\\"");
+                break;
+            case '\\':
+                g_string_append(out, "\\\\");
+                break;
+            case '\n':
+                g_string_append(out, "\\n");
+                break;
+            default:
+                g_string_append_c(out, *str);
+        }
+    }
+}
+
+
+static void gfal_trace_chrome(GString* out, GArray* spans)
+{
+    guint i;
+    pid_t pid = getpid();
+
+    g_string_append(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (i = 0; i < spans->len; ++i) {
+        const gfal_trace_record_t* span = &g_array_index(spans, gfal_trace_record_t, i);
+        g_string_append(out, i ? ",\n  {\"name\": \"" : "\n  {\"name\": \"");
+        gfal_trace_append_escaped(out, span->name);
+        g_string_append(out, "\", \"cat\": \"");
+        gfal_trace_append_escaped(out, span->category);
+        g_string_append_printf(out, "\", \"ph\": \"X\", \"ts\": %" G_GINT64_FORMAT ", \"dur\": %" G_GINT64_FORMAT
+            ", \"pid\": %d, \"tid\": %ld, \"args\": {\"span\": \"%016" G_GINT64_MODIFIER "x\""
+            ", \"parent\": \"%016" G_GINT64_MODIFIER "x\"}}",
+            span->start, span->end - span->start, (int)pid, span->tid, span->id, span->parent);
+    }
+    g_string_append(out, "\n]}\n");
+}
+
+
+// The trace of a span is identified by its root, the oldest ancestor recorded
+static gfal2_span_t gfal_trace_root(GHashTable* parents, gfal2_span_t span)
+{
+    int steps;
+    for (steps = 0; steps < GFAL_TRACE_MAX_ANCESTORS; ++steps) {
+        gfal2_span_t* parent = (gfal2_span_t*)g_hash_table_lookup(parents, &span);
+        if (parent == NULL || *parent == 0) {
+            break;
+        }
+        span = *parent;
+    }
+    return span;
+}
+
+
+static void gfal_trace_otlp(GString* out, GArray* spans)
+{
+    GHashTable* parents = g_hash_table_new(g_int64_hash, g_int64_equal);
+    gint64 wall_offset = g_get_real_time() - g_get_monotonic_time();
+    guint i;
+
+    for (i = 0; i < spans->len; ++i) {
+        gfal_trace_record_t* span = &g_array_index(spans, gfal_trace_record_t, i);
+        g_hash_table_insert(parents, &span->id, &span->parent);
+    }
+
+    g_string_append_printf(out, "{\"resourceSpans\": [{\"resource\": {\"attributes\": ["
+        "{\"key\": \"service.name\", \"value\": {\"stringValue\": \"gfal2\"}}, "
+        "{\"key\": \"process.pid\", \"value\": {\"intValue\": \"%d\"}}]}, "
+        "\"scopeSpans\": [{\"scope\": {\"name\": \"gfal2\", \"version\": \"%s\"}, \"spans\": [",
+        (int)getpid(), gfal2_version());
+
+    for (i = 0; i < spans->len; ++i) {
+        const gfal_trace_record_t* span = &g_array_index(spans, gfal_trace_record_t, i);
+        gfal2_span_t root = gfal_trace_root(parents, span->id);
+
+        g_string_append_printf(out, "%s{\"traceId\": \"%016" G_GINT64_MODIFIER "x%016" G_GINT64_MODIFIER "x\""
+            ", \"spanId\": \"%016" G_GINT64_MODIFIER "x\"",
+            i ? ",\n    " : "\n    ", (guint64)getpid(), root, span->id);
+        if (span->parent) {
+            g_string_append_printf(out, ", \"parentSpanId\": \"%016" G_GINT64_MODIFIER "x\"", span->parent);
+        }
+        g_string_append(out, ", \"name\": \"");
+        gfal_trace_append_escaped(out, span->name);
+        g_string_append_printf(out, "\", \"kind\": 1, \"startTimeUnixNano\": \"%" G_GINT64_FORMAT "000\""
+            ", \"endTimeUnixNano\": \"%" G_GINT64_FORMAT "000\", \"attributes\": ["
+            "{\"key\": \"gfal2.category\", \"value\": {\"stringValue\": \"",
+            span->start + wall_offset, span->end + wall_offset);
+        gfal_trace_append_escaped(out, span->category);
+        g_string_append_printf(out, "\"}}, {\"key\": \"thread.id\", \"value\": {\"intValue\": \"%ld\"}}]}",
+            span->tid);
+    }
+    g_string_append(out, "\n]}]}]}\n");
+
+    g_hash_table_destroy(parents);
+}
+
+
+gchar* gfal2_trace_snapshot(gfal2_trace_format_t format, GError** err)
+{
+    if (format != GFAL2_TRACE_CHROME && format != GFAL2_TRACE_OTLP) {
+        gfal2_set_error(err, gfal2_get_core_quark(), EINVAL, __func__, "Unknown trace format %d", format);
+        return NULL;
+    }
+
+    GArray* spans = gfal_trace_collect();
+    GString* out = g_string_new(NULL);
+    if (format == GFAL2_TRACE_CHROME) {
+        gfal_trace_chrome(out, spans);
+    }
+    else {
+        gfal_trace_otlp(out, spans);
+    }
+    g_array_free(spans, TRUE);
+    return g_string_free(out, FALSE);
+}
+
+
+int gfal2_trace_export(const char* path, gfal2_trace_format_t format, GError** err)
+{
+    GError* tmp_err = NULL;
+    g_return_val_err_if_fail(path != NULL, -1, err, "[gfal2_trace_export] Invalid path");
+
+    gchar* content = gfal2_trace_snapshot(format, &tmp_err);
+    if (content != NULL && !g_file_set_contents(path, content, -1, &tmp_err)) {
+        gfal2_set_error(err, gfal2_get_core_quark(), EIO, __func__, "Could not write the trace into %s: %s",
+            path, tmp_err->message);
+        g_clear_error(&tmp_err);
+        g_free(content);
+        return -1;
+    }
+    g_free(content);
+    if (tmp_err) {
+        gfal2_propagate_prefixed_error(err, tmp_err, __func__);
+        return -1;
+    }
+    return 0;
+}
+
+
+static void gfal_trace_atexit(void)
+{
+    GError* error = NULL;
+    const char* path = getenv("GFAL2_TRACE_FILE");
+    const char* format = getenv("GFAL2_TRACE_FORMAT");
+
+    if (gfal2_trace_export(path, (format && strcmp(format, "otlp") == 0) ? GFAL2_TRACE_OTLP : GFAL2_TRACE_CHROME,
+            &error) < 0) {
+        gfal2_log(G_LOG_LEVEL_WARNING, "%s", error->message);
+        g_error_free(error);
+    }
+}
+
+
+// Tracing can be enabled from the environment, and exported when the process exits
+__attribute__((constructor))
+static void gfal_trace_init(void)
+{
+    if (getenv("GFAL2_TRACE_FILE") != NULL) {
+        const char* capacity = getenv("GFAL2_TRACE_CAPACITY");
+        gfal2_trace_enable(capacity ? strtoul(capacity, NULL, 10) : 0);
+        atexit(gfal_trace_atexit);
+    }
+}
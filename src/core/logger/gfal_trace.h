@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef GFAL_TRACE_H_
+#define GFAL_TRACE_H_
+
+#if !defined(__GFAL2_H_INSIDE__) && !defined(__GFAL2_BUILD__)
+#   warning "Direct inclusion of gfal2 headers is deprecated. Please, include only gfal_api.h or gfal_plugins_api.h"
+#endif
+
+#include <glib.h>
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Tracing records spans (a named interval of time) into a ring buffer per thread.
+ * A span begun while another one is open in the same thread is its child. Spans
+ * started in other threads can be attached explicitly with gfal2_trace_begin_child.
+ * When tracing is disabled, beginning and ending a span costs a single branch.
+ *
+ * Categories and names are not copied, they must be static strings.
+ */
+
+/** Span identifier, 0 means no span */
+typedef guint64 gfal2_span_t;
+
+/** Export formats */
+typedef enum {
+    GFAL2_TRACE_CHROME = 0, /**< Chrome trace event format (chrome://tracing, Perfetto) */
+    GFAL2_TRACE_OTLP        /**< OpenTelemetry OTLP/JSON */
+} gfal2_trace_format_t;
+
+/** Non zero while tracing is enabled, do not modify */
+extern volatile gint gfal2_trace_active;
+
+/**
+ * Enable tracing
+ * @param capacity Number of spans kept per thread, the oldest are overwritten. 0 for the default (4096).
+ * Also enabled when the environment variable GFAL2_TRACE_FILE is set. The spans are then written
+ * into that file when the process exits, in Chrome format unless GFAL2_TRACE_FORMAT=otlp.
+ * GFAL2_TRACE_CAPACITY overrides the capacity.
+ */
+void gfal2_trace_enable(gsize capacity);
+
+/**
+ * Disable tracing. Spans already recorded are kept until gfal2_trace_clear.
+ */
+void gfal2_trace_disable(void);
+
+/**
+ * Drop all the spans recorded so far
+ */
+void gfal2_trace_clear(void);
+
+/** Prefer the gfal2_trace_begin macros */
+gfal2_span_t gfal2_trace_span_begin(const char* category, const char* name, gfal2_span_t parent);
+
+/** Prefer the gfal2_trace_end macro */
+void gfal2_trace_span_end(gfal2_span_t span);
+
+/**
+ * End the innermost span of this thread with the given category and name, if any
+ * For when begin and end are far apart (i.e. triggered by events)
+ */
+void gfal2_trace_end_by_name(const char* category, const char* name);
+
+/** Prefer the gfal2_trace_begin_keyed macro */
+gfal2_span_t gfal2_trace_span_begin_keyed(const char* category, const char* name, gconstpointer key);
+
+/**
+ * End a span begun with gfal2_trace_begin_keyed with the same category, name and key.
+ * It can be called from any thread. If several of those spans are open, the oldest one is ended.
+ */
+void gfal2_trace_end_keyed(const char* category, const char* name, gconstpointer key);
+
+/**
+ * Drop the spans begun with gfal2_trace_begin_keyed with this key and not ended yet
+ * To be called before the key is freed.
+ */
+void gfal2_trace_drop_keyed(gconstpointer key);
+
+/**
+ * Return the innermost open span of this thread, or 0
+ * Used to propagate the parent to worker threads.
+ */
+gfal2_span_t gfal2_trace_current(void);
+
+/**
+ * Export the spans recorded so far as a string, to be freed with g_free
+ */
+gchar* gfal2_trace_snapshot(gfal2_trace_format_t format, GError** err);
+
+/**
+ * Export the spans recorded so far into a file
+ * @return 0 on success, -1 on error
+ */
+int gfal2_trace_export(const char* path, gfal2_trace_format_t format, GError** err);
+
+/** Begin a span, child of the innermost one open in this thread */
+#define gfal2_trace_begin(category, name) \
+    (G_UNLIKELY(gfal2_trace_active) ? gfal2_trace_span_begin((category), (name), 0) : 0)
+
+/** Begin a span with an explicit parent, i.e. one begun in another thread */
+#define gfal2_trace_begin_child(category, name, parent) \
+    (G_UNLIKELY(gfal2_trace_active) ? gfal2_trace_span_begin((category), (name), (parent)) : 0)
+
+/**
+ * Begin a span identified by a key (i.e. a transfer), for when begin and end are far apart
+ * and may happen in different threads. Its parent is the innermost span open in this thread,
+ * but it does not become the parent of the spans begun after it.
+ */
+#define gfal2_trace_begin_keyed(category, name, key) \
+    (G_UNLIKELY(gfal2_trace_active) ? gfal2_trace_span_begin_keyed((category), (name), (key)) : 0)
+
+/** End a span, must be called from the thread that began it */
+#define gfal2_trace_end(span) \
+    do { if (span) gfal2_trace_span_end(span); } while (0)
+
+
+#ifdef __cplusplus
+}
+
+namespace Gfal {
+
+/**
+ * Span ended when going out of scope
+ */
+class TraceScope {
+public:
+    TraceScope(const char* category, const char* name, gfal2_span_t parent = 0):
+        span(gfal2_trace_begin_child(category, name, parent)) {}
+
+    ~TraceScope() {
+        gfal2_trace_end(span);
+    }
+
+    gfal2_span_t id() const {
+        return span;
+    }
+
+private:
+    gfal2_span_t span;
+
+    TraceScope(const TraceScope&);
+    TraceScope& operator = (const TraceScope&);
+};
+
+}
+
+#endif
+
+#endif /* GFAL_TRACE_H_ */
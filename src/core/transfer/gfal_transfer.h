@@ -28,6 +28,7 @@
 
 
 #include <common/gfal_common.h>
+#include <common/gfal_async.h>
 #include <logger/gfal_logger.h>
 #include <common/gfal_constants.h>
 
@@ -131,6 +132,21 @@ typedef struct _gfalt_event* gfalt_event_t;
  */
 typedef void (*gfalt_event_func)(const gfalt_event_t e, gpointer user_data);
 
+/**
+ * Return the description of an event passed to a gfalt_event_func,
+ * formatting it if needed (see gfalt_set_lazy_event_description)
+ * The returned string is only valid during the callback.
+ * For events not triggered by gfal2, this is the description field.
+ */
+const char* gfalt_event_get_description(gfalt_event_t e);
+
+/**
+ * Return the monotonic time of an event passed to a gfalt_event_func,
+ * in microseconds, as given by g_get_monotonic_time
+ * For events not triggered by gfal2, it is estimated from the timestamp field.
+ */
+gint64 gfalt_event_get_monotonic_time(gfalt_event_t e);
+
 /**
  * Checksum verification mode
  */
@@ -329,6 +345,18 @@ gint gfalt_set_create_parent_dir(gfalt_params_t, gboolean create_parent, GError*
  */
 gboolean gfalt_get_create_parent_dir(gfalt_params_t, GError** err);
 
+/**
+ * Enable or disable resumable streamed copies (default: false, or CORE:COPY_RESUME)
+ * Streamed copies then record in the destination how much has been written and synced,
+ * and a later copy of the same source into the same destination continues from there.
+ */
+gint gfalt_set_resume(gfalt_params_t, gboolean resume, GError** err);
+
+/**
+ * Get the resume value
+ */
+gboolean gfalt_get_resume(gfalt_params_t, GError** err);
+
 /**
  * Enable or disable usage of TPC proxy delegation
  */
@@ -399,6 +427,19 @@ gint gfalt_add_event_callback(gfalt_params_t params, gfalt_event_func callback,
  */
 gint gfalt_remove_event_callback(gfalt_params_t params, gfalt_event_func callback, GError** err);
 
+/**
+ * @brief Let event callbacks ask for the description, instead of having it always formatted
+ * When enabled, the description field of the events is NULL unless the text was needed anyway
+ * (i.e. for logging), and callbacks must use gfalt_event_get_description to read it.
+ * Disabled by default.
+ */
+gint gfalt_set_lazy_event_description(gfalt_params_t params, gboolean value, GError** err);
+
+/**
+ * @brief Return whether event descriptions are formatted on demand
+ */
+gboolean gfalt_get_lazy_event_description(gfalt_params_t params, GError** err);
+
 /**
  *	@brief copy function
  *  start a synchronous copy of the file
@@ -422,6 +463,15 @@ int gfalt_copy_bulk(gfal2_context_t context, gfalt_params_t params, size_t nbfil
         const char* const * srcs, const char* const * dsts, const char* const* checksums,
         GError** op_error, GError*** file_erros);
 
+/**
+ * @brief asynchronous copy
+ * Submit a copy of req->url into req->url2 to the completion queue.
+ * req->params can be a parameter handle, or NULL for the defaults. It must remain valid
+ * until the request completes.
+ * The result and error are the ones \ref gfalt_copy_file would have returned.
+ */
+int gfalt_copy_file_async(gfal2_async_queue_t queue, gfal2_async_request_t req, GError** err);
+
 /**
  * Get a transfer status indicator
  */
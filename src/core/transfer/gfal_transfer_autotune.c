@@ -0,0 +1,386 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <common/gfal_config.h>
+#include <common/gfal_handle.h>
+#include <common/gfal_plugin_bulk.h>
+#include <transfer/gfal_transfer_internal.h>
+
+#define AUTOTUNE_DEFAULT_MAX_STREAMS    16
+#define AUTOTUNE_DEFAULT_HALF_LIFE      3600    // seconds
+#define AUTOTUNE_DEFAULT_MIN_SIZE       32      // MiB
+
+// One copy out of AUTOTUNE_PROBE_EVERY on a link tries a neighbour of the best known settings
+#define AUTOTUNE_PROBE_EVERY            4
+// A neighbour has to be this much faster to replace the best known settings
+#define AUTOTUNE_MIN_GAIN               0.05
+// Weight of a new throughput sample of the best known settings
+#define AUTOTUNE_SMOOTHING              0.3
+// Links not used for this many half lives start over from the initial settings
+#define AUTOTUNE_FORGET_HALF_LIVES      10
+
+#define AUTOTUNE_MIN_TCP_BUFFER         (256 * 1024)
+#define AUTOTUNE_MIN_COPY_BUFFER        (64 * 1024)
+#define AUTOTUNE_MAX_BUFFER             (64 * 1024 * 1024)
+
+
+// Coordinate hill climbing: the best known settings of a link are kept with
+// their throughput, and from time to time a copy moves one setting a step
+// in its current direction. If that is faster, the step is kept and the next
+// probe goes further the same way. Otherwise the direction of that setting
+// is reversed and the next probe moves another one.
+// The throughput decays with time, so a link that got faster or slower is
+// explored again instead of sticking to a stale optimum.
+struct _gfal_autotune {
+    GMutex* lock;
+    GHashTable* links;          // link => autotune_link_t
+    guint max_streams;
+    gint64 half_life;
+};
+
+
+typedef struct {
+    guint64 values[GFAL_AUTOTUNE_DIMENSIONS];   // best known settings
+    double score;               // their throughput in bytes/s
+    gint64 updated;             // last time the link was used
+    guint transfers;
+    int next_dim;               // next setting to probe
+    int directions[GFAL_AUTOTUNE_DIMENSIONS];
+    int probe_dim;              // setting being probed, -1 if none
+    guint64 probe_value;
+} autotune_link_t;
+
+
+static const char* autotune_names[GFAL_AUTOTUNE_DIMENSIONS] = {
+    "streams", "tcp buffer", "copy buffer"
+};
+
+
+gfal_autotune_t* gfal_autotune_new(guint max_streams, gint64 half_life)
+{
+    gfal_autotune_t* tuner = g_new0(gfal_autotune_t, 1);
+    tuner->lock = g_mutex_new();
+    tuner->links = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    tuner->max_streams = max_streams > 0 ? max_streams : 1;
+    tuner->half_life = half_life;
+    return tuner;
+}
+
+
+void gfal_autotune_free(gpointer data)
+{
+    gfal_autotune_t* tuner = (gfal_autotune_t*)data;
+    if (tuner == NULL) {
+        return;
+    }
+    g_hash_table_destroy(tuner->links);
+    g_mutex_free(tuner->lock);
+    g_free(tuner);
+}
+
+
+// Neighbour of value in the given direction, value itself at the edges
+static guint64 autotune_step(const gfal_autotune_t* tuner, int dim, guint64 value, int direction)
+{
+    switch (dim) {
+        case GFAL_AUTOTUNE_STREAMS:
+            if (direction > 0) {
+                return value < tuner->max_streams ? value + 1 : value;
+            }
+            return value > 1 ? value - 1 : value;
+        case GFAL_AUTOTUNE_TCP_BUFFER:
+            if (direction > 0) {
+                if (value == 0) {
+                    return AUTOTUNE_MIN_TCP_BUFFER;
+                }
+                return value < AUTOTUNE_MAX_BUFFER ? MIN(value * 2, AUTOTUNE_MAX_BUFFER) : value;
+            }
+            return value > AUTOTUNE_MIN_TCP_BUFFER ? value / 2 : 0;
+        default:
+            if (direction > 0) {
+                return value < AUTOTUNE_MAX_BUFFER ? MIN(value * 2, AUTOTUNE_MAX_BUFFER) : value;
+            }
+            return value > AUTOTUNE_MIN_COPY_BUFFER ? MAX(value / 2, AUTOTUNE_MIN_COPY_BUFFER) : value;
+    }
+}
+
+
+static void autotune_decay(const gfal_autotune_t* tuner, autotune_link_t* link, gint64 now)
+{
+    if (now > link->updated && tuner->half_life > 0) {
+        link->score *= pow(0.5, (double)(now - link->updated) / tuner->half_life);
+    }
+    link->updated = now;
+}
+
+
+static gboolean autotune_is_stale(gpointer key, gpointer value, gpointer user_data)
+{
+    const gint64* oldest = (const gint64*)user_data;
+    return ((autotune_link_t*)value)->updated < *oldest;
+}
+
+
+// Must be called with the lock held
+static autotune_link_t* autotune_get_link(gfal_autotune_t* tuner, const char* key, const guint64* initial,
+        gint64 now)
+{
+    // Without a half life, nothing is ever forgotten
+    gint64 oldest = G_MININT64;
+    if (tuner->half_life > 0) {
+        oldest = now - AUTOTUNE_FORGET_HALF_LIVES * tuner->half_life;
+    }
+
+    autotune_link_t* link = g_hash_table_lookup(tuner->links, key);
+    if (link != NULL && link->updated >= oldest) {
+        return link;
+    }
+
+    // Drop this and any other forgotten link
+    g_hash_table_foreach_remove(tuner->links, autotune_is_stale, &oldest);
+
+    link = g_new0(autotune_link_t, 1);
+    memcpy(link->values, initial, sizeof(link->values));
+    link->updated = now;
+    link->probe_dim = -1;
+    int i;
+    for (i = 0; i < GFAL_AUTOTUNE_DIMENSIONS; ++i) {
+        link->directions[i] = 1;
+    }
+    g_hash_table_insert(tuner->links, g_strdup(key), link);
+    return link;
+}
+
+
+// Must be called with the lock held
+static void autotune_probe(const gfal_autotune_t* tuner, autotune_link_t* link, int dimensions,
+        gfal_autotune_ticket_t* ticket)
+{
+    int i;
+    for (i = 0; i < GFAL_AUTOTUNE_DIMENSIONS; ++i) {
+        int dim = (link->next_dim + i) % GFAL_AUTOTUNE_DIMENSIONS;
+        if (!(dimensions & GFAL_AUTOTUNE_MASK(dim))) {
+            continue;
+        }
+        guint64 value = autotune_step(tuner, dim, link->values[dim], link->directions[dim]);
+        if (value == link->values[dim]) {
+            link->directions[dim] = -link->directions[dim];
+            value = autotune_step(tuner, dim, link->values[dim], link->directions[dim]);
+        }
+        if (value != link->values[dim]) {
+            link->probe_dim = dim;
+            link->probe_value = value;
+            ticket->probe_dim = dim;
+            ticket->values[dim] = value;
+            return;
+        }
+    }
+}
+
+
+void gfal_autotune_next(gfal_autotune_t* tuner, const char* link_key, int dimensions,
+        const guint64* initial, gint64 now, gfal_autotune_ticket_t* ticket)
+{
+    memset(ticket, 0, sizeof(*ticket));
+    ticket->link = g_strdup(link_key);
+    ticket->dimensions = dimensions;
+    ticket->probe_dim = -1;
+
+    g_mutex_lock(tuner->lock);
+    autotune_link_t* link = autotune_get_link(tuner, link_key, initial, now);
+    autotune_decay(tuner, link, now);
+    memcpy(ticket->values, link->values, sizeof(ticket->values));
+
+    // Probe only once the best known settings have been measured, and one at a time
+    ++link->transfers;
+    if (link->score > 0 && link->probe_dim < 0 && link->transfers % AUTOTUNE_PROBE_EVERY == 0) {
+        autotune_probe(tuner, link, dimensions, ticket);
+    }
+    g_mutex_unlock(tuner->lock);
+}
+
+
+void gfal_autotune_feedback(gfal_autotune_t* tuner, const gfal_autotune_ticket_t* ticket,
+        double throughput, gint64 now)
+{
+    g_mutex_lock(tuner->lock);
+
+    autotune_link_t* link = g_hash_table_lookup(tuner->links, ticket->link);
+    if (link == NULL) {
+        g_mutex_unlock(tuner->lock);
+        return;
+    }
+    autotune_decay(tuner, link, now);
+
+    int dim = ticket->probe_dim;
+    if (dim >= 0) {
+        if (link->probe_dim == dim && link->probe_value == ticket->values[dim]) {
+            link->probe_dim = -1;
+            if (throughput <= 0) {
+                // Nothing learned, it will be probed again
+            }
+            else if (throughput > link->score * (1 + AUTOTUNE_MIN_GAIN)) {
+                gfal2_log(G_LOG_LEVEL_INFO, "Auto-tuning %s: %s %" G_GUINT64_FORMAT " => %" G_GUINT64_FORMAT
+                        " (%.0f => %.0f bytes/s)", ticket->link, autotune_names[dim], link->values[dim],
+                        ticket->values[dim], link->score, throughput);
+                link->values[dim] = ticket->values[dim];
+                link->score = throughput;
+                link->next_dim = dim;
+            }
+            else {
+                link->directions[dim] = -link->directions[dim];
+                link->next_dim = (dim + 1) % GFAL_AUTOTUNE_DIMENSIONS;
+            }
+        }
+    }
+    else if (throughput > 0 && memcmp(ticket->values, link->values, sizeof(link->values)) == 0) {
+        if (link->score > 0) {
+            link->score += AUTOTUNE_SMOOTHING * (throughput - link->score);
+        }
+        else {
+            link->score = throughput;
+        }
+    }
+
+    g_mutex_unlock(tuner->lock);
+}
+
+
+// The tuner of the context is created on first use
+static gfal_autotune_t* autotune_get(gfal2_context_t context)
+{
+    gfal_autotune_t* tuner = (gfal_autotune_t*)g_atomic_pointer_get(&context->autotune);
+    if (tuner != NULL) {
+        return tuner;
+    }
+
+    guint max_streams = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP,
+            "COPY_AUTOTUNE_MAX_STREAMS", AUTOTUNE_DEFAULT_MAX_STREAMS);
+    gint64 half_life = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP,
+            "COPY_AUTOTUNE_HALF_LIFE", AUTOTUNE_DEFAULT_HALF_LIFE);
+    tuner = gfal_autotune_new(max_streams, half_life * G_USEC_PER_SEC);
+
+    context->autotune_free = gfal_autotune_free;
+    if (!g_atomic_pointer_compare_and_exchange(&context->autotune, NULL, tuner)) {
+        gfal_autotune_free(tuner);
+        tuner = (gfal_autotune_t*)g_atomic_pointer_get(&context->autotune);
+    }
+    return tuner;
+}
+
+
+static void autotune_monitor(gfalt_transfer_status_t status, const char* src, const char* dst,
+        gpointer user_data)
+{
+    gfal_autotune_ticket_t* ticket = (gfal_autotune_ticket_t*)user_data;
+    ticket->bytes = gfalt_copy_get_bytes_transfered(status, NULL);
+    ticket->baudrate = gfalt_copy_get_average_baudrate(status, NULL);
+}
+
+
+int gfal_autotune_dimensions(const char* plugin_name)
+{
+    if (plugin_name == NULL) {
+        return GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_COPY_BUFFER);
+    }
+    if (strncmp(plugin_name, "gridftp-", 8) == 0) {
+        return GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_STREAMS) | GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_TCP_BUFFER);
+    }
+    if (strncmp(plugin_name, "xrootd-", 7) == 0) {
+        return GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_STREAMS);
+    }
+    return 0;
+}
+
+
+gfalt_params_t gfal_autotune_begin(gfal2_context_t context, gfalt_params_t params,
+        const char* src, const char* dst, int dimensions, gfal_autotune_ticket_t* ticket)
+{
+    memset(ticket, 0, sizeof(*ticket));
+    ticket->probe_dim = -1;
+
+    if (dimensions == 0 || !gfal2_get_opt_boolean_with_default(context, CORE_CONFIG_GROUP, "COPY_AUTOTUNE", FALSE)) {
+        return params;
+    }
+
+    // What the user set explicitly is left alone
+    if (params->nb_data_streams != 0) {
+        dimensions &= ~GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_STREAMS);
+    }
+    if (params->tcp_buffer_size != 0) {
+        dimensions &= ~GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_TCP_BUFFER);
+    }
+    if (dimensions == 0) {
+        return params;
+    }
+
+    guint64 initial[GFAL_AUTOTUNE_DIMENSIONS];
+    initial[GFAL_AUTOTUNE_STREAMS] = 1;
+    initial[GFAL_AUTOTUNE_TCP_BUFFER] = 0;
+    initial[GFAL_AUTOTUNE_COPY_BUFFER] = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP,
+            "COPY_BUFFERSIZE", DEFAULT_BUFFER_SIZE);
+
+    gchar* src_endpoint = gfal_bulk_get_endpoint(src);
+    gchar* dst_endpoint = gfal_bulk_get_endpoint(dst);
+    gchar* link = g_strdup_printf("%s>%s", src_endpoint, dst_endpoint);
+    gfal_autotune_next(autotune_get(context), link, dimensions, initial, g_get_monotonic_time(), ticket);
+    g_free(link);
+    g_free(src_endpoint);
+    g_free(dst_endpoint);
+
+    gfalt_params_t tuned = gfalt_params_handle_copy(params, NULL);
+    if (dimensions & GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_STREAMS)) {
+        tuned->nb_data_streams = ticket->values[GFAL_AUTOTUNE_STREAMS];
+    }
+    if (dimensions & GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_TCP_BUFFER)) {
+        tuned->tcp_buffer_size = ticket->values[GFAL_AUTOTUNE_TCP_BUFFER];
+    }
+    if (dimensions & GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_COPY_BUFFER)) {
+        tuned->copy_buffer_size = ticket->values[GFAL_AUTOTUNE_COPY_BUFFER];
+    }
+    gfalt_add_monitor_callback(tuned, autotune_monitor, ticket, NULL, NULL);
+
+    gfal2_log(G_LOG_LEVEL_DEBUG, "Auto-tuned %s: %" G_GUINT64_FORMAT " streams, tcp buffer %" G_GUINT64_FORMAT
+            ", copy buffer %" G_GUINT64_FORMAT "%s", ticket->link,
+            ticket->values[GFAL_AUTOTUNE_STREAMS], ticket->values[GFAL_AUTOTUNE_TCP_BUFFER],
+            ticket->values[GFAL_AUTOTUNE_COPY_BUFFER], ticket->probe_dim >= 0 ? " (probe)" : "");
+    return tuned;
+}
+
+
+void gfal_autotune_end(gfal2_context_t context, gfalt_params_t tuned, gfal_autotune_ticket_t* ticket,
+        int result)
+{
+    if (ticket->link == NULL) {
+        return;
+    }
+
+    // Small files say more about latency than about the settings
+    guint64 min_size = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP,
+            "COPY_AUTOTUNE_MIN_SIZE", AUTOTUNE_DEFAULT_MIN_SIZE);
+    double throughput = 0;
+    if (result == 0 && ticket->bytes >= min_size * 1024 * 1024) {
+        throughput = ticket->baudrate;
+    }
+    gfal_autotune_feedback(autotune_get(context), ticket, throughput, g_get_monotonic_time());
+
+    gfalt_params_handle_delete(tuned, NULL);
+    g_free(ticket->link);
+    ticket->link = NULL;
+}
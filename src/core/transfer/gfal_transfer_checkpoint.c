@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <gfal_api.h>
+#include <common/gfal_plugin_interface.h>
+#include <checksums/checksums.h>
+#include "gfal_transfer_internal.h"
+
+// The checkpoint is kept in an extended attribute of the destination,
+// or in a file next to it when the storage has no extended attributes
+#define CHECKPOINT_XATTR        "user.gfal2.checkpoint"
+#define CHECKPOINT_SIDECAR      ".gfal2-checkpoint"
+#define CHECKPOINT_VERSION      1
+
+enum {
+    CHECKPOINT_STORE_NONE = 0,
+    CHECKPOINT_STORE_XATTR,
+    CHECKPOINT_STORE_SIDECAR
+};
+
+
+static void checkpoint_reset(gfal_checkpoint_t *cp)
+{
+    cp->offset = 0;
+    cp->adler32 = 1;
+}
+
+
+gchar *gfal_checkpoint_format(const gfal_checkpoint_t *cp, const char *src)
+{
+    return g_strdup_printf("%d %lld %08lx %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %s",
+        CHECKPOINT_VERSION, (long long)cp->offset, cp->adler32, cp->src_size, cp->src_mtime, src);
+}
+
+
+gboolean gfal_checkpoint_parse(const char *value, const char *src, gfal_checkpoint_t *cp)
+{
+    int version = 0, consumed = 0;
+    long long offset, src_size, src_mtime;
+    unsigned long adler32;
+
+    if (sscanf(value, "%d %lld %lx %lld %lld %n", &version, &offset, &adler32,
+            &src_size, &src_mtime, &consumed) != 5 || consumed == 0) {
+        return FALSE;
+    }
+    if (version != CHECKPOINT_VERSION || offset < 0 || strcmp(value + consumed, src) != 0) {
+        return FALSE;
+    }
+    cp->offset = offset;
+    cp->adler32 = adler32;
+    cp->src_size = src_size;
+    cp->src_mtime = src_mtime;
+    return TRUE;
+}
+
+
+static ssize_t checkpoint_read_sidecar(gfal2_context_t context, const char *sidecar, char *buffer, size_t size)
+{
+    GError *tmp_err = NULL;
+    ssize_t total = 0, ret = 1;
+
+    int expected = gfal2_expect_errno_begin(ENOENT);
+    gfal_file_handle fh = gfal_plugin_openG(context, sidecar, O_RDONLY, 0, &tmp_err);
+    gfal2_expect_errno_end(expected);
+    if (fh == NULL) {
+        g_clear_error(&tmp_err);
+        return -1;
+    }
+    while (ret > 0 && (size_t)total < size) {
+        ret = gfal_plugin_readG(context, fh, buffer + total, size - total, &tmp_err);
+        if (ret > 0) {
+            total += ret;
+        }
+    }
+    gfal_plugin_closeG(context, fh, tmp_err ? NULL : &tmp_err);
+    if (tmp_err) {
+        g_clear_error(&tmp_err);
+        return -1;
+    }
+    return total;
+}
+
+
+static int checkpoint_write_sidecar(gfal2_context_t context, const char *sidecar, const char *value,
+    GError **err)
+{
+    GError *tmp_err = NULL;
+
+    gfal_file_handle fh = gfal_plugin_openG(context, sidecar, O_WRONLY | O_CREAT | O_TRUNC, 0644, &tmp_err);
+    if (fh == NULL) {
+        gfal2_propagate_prefixed_error(err, tmp_err, __func__);
+        return -1;
+    }
+    if (gfal_plugin_writeG(context, fh, (void*)value, strlen(value), &tmp_err) >= 0) {
+        // Best effort, the data it refers to is already synced
+        int expected = gfal2_expect_errno_begin(ENOSYS);
+        GError *sync_err = NULL;
+        gfal_plugin_fsyncG(context, fh, &sync_err);
+        gfal2_expect_errno_end(expected);
+        g_clear_error(&sync_err);
+    }
+    gfal_plugin_closeG(context, fh, tmp_err ? NULL : &tmp_err);
+    if (tmp_err) {
+        gfal2_propagate_prefixed_error(err, tmp_err, __func__);
+        return -1;
+    }
+    return 0;
+}
+
+
+off_t gfal_checkpoint_load(gfal2_context_t context, const char *src, const struct stat *src_st,
+    const char *dst, gfal_checkpoint_t *cp)
+{
+    char value[GFAL_URL_MAX_LEN + 128];
+    GError *tmp_err = NULL;
+    ssize_t len;
+
+    memset(cp, 0, sizeof(*cp));
+    checkpoint_reset(cp);
+    cp->src_size = src_st->st_size;
+    cp->src_mtime = src_st->st_mtime;
+
+    int expected = gfal2_expect_errno_begin(ENOENT);
+    len = gfal_plugin_getxattrG(context, dst, CHECKPOINT_XATTR, value, sizeof(value) - 1, &tmp_err);
+    gfal2_expect_errno_end(expected);
+    if (len > 0) {
+        cp->store = CHECKPOINT_STORE_XATTR;
+    }
+    else {
+        g_clear_error(&tmp_err);
+        gchar *sidecar = g_strconcat(dst, CHECKPOINT_SIDECAR, NULL);
+        len = checkpoint_read_sidecar(context, sidecar, value, sizeof(value) - 1);
+        g_free(sidecar);
+        if (len <= 0) {
+            return 0;
+        }
+        cp->store = CHECKPOINT_STORE_SIDECAR;
+    }
+    value[len] = '\0';
+
+    gfal_checkpoint_t saved = *cp;
+    if (!gfal_checkpoint_parse(value, src, &saved)) {
+        gfal2_log(G_LOG_LEVEL_DEBUG, "Ignoring the checkpoint of %s, it belongs to another copy", dst);
+        return 0;
+    }
+    if (saved.src_size != cp->src_size || saved.src_mtime != cp->src_mtime || saved.offset > cp->src_size) {
+        gfal2_log(G_LOG_LEVEL_MESSAGE, "The source %s changed since the checkpoint of %s, starting over", src, dst);
+        return 0;
+    }
+    if (saved.offset == 0) {
+        return 0;
+    }
+
+    struct stat dst_st;
+    if (gfal2_stat(context, dst, &dst_st, &tmp_err) < 0 || dst_st.st_size < saved.offset) {
+        gfal2_log(G_LOG_LEVEL_MESSAGE, "The destination %s is shorter than its checkpoint, starting over", dst);
+        g_clear_error(&tmp_err);
+        return 0;
+    }
+
+    // Make sure what is there is what was written
+    char expected_checksum[64], actual_checksum[1024];
+    g_snprintf(expected_checksum, sizeof(expected_checksum), "%08lx", saved.adler32);
+    if (gfal2_checksum(context, dst, "ADLER32", 0, saved.offset, actual_checksum, sizeof(actual_checksum),
+            &tmp_err) < 0) {
+        gfal2_log(G_LOG_LEVEL_MESSAGE, "Could not verify the checkpoint of %s, starting over: %s",
+            dst, tmp_err->message);
+        g_clear_error(&tmp_err);
+        return 0;
+    }
+    if (gfal_compare_checksums(expected_checksum, actual_checksum, sizeof(actual_checksum)) != 0) {
+        gfal2_log(G_LOG_LEVEL_MESSAGE, "The first %lld bytes of %s do not match its checkpoint (%s != %s), starting over",
+            (long long)saved.offset, dst, actual_checksum, expected_checksum);
+        return 0;
+    }
+
+    cp->offset = saved.offset;
+    cp->adler32 = saved.adler32;
+    gfal2_log(G_LOG_LEVEL_MESSAGE, "Resuming the copy into %s from byte %lld", dst, (long long)cp->offset);
+    return cp->offset;
+}
+
+
+int gfal_checkpoint_save(gfal2_context_t context, const char *src, const char *dst,
+    gfal_checkpoint_t *cp, GError **err)
+{
+    GError *tmp_err = NULL;
+    gchar *value = gfal_checkpoint_format(cp, src);
+    int ret = -1;
+
+    if (cp->store != CHECKPOINT_STORE_SIDECAR) {
+        ret = gfal_plugin_setxattrG(context, dst, CHECKPOINT_XATTR, value, strlen(value), 0, &tmp_err);
+        if (ret == 0) {
+            cp->store = CHECKPOINT_STORE_XATTR;
+        }
+        else {
+            gfal2_log(G_LOG_LEVEL_DEBUG, "Could not keep the checkpoint in %s as an attribute, using a file: %s",
+                dst, tmp_err->message);
+            g_clear_error(&tmp_err);
+        }
+    }
+    if (ret < 0) {
+        gchar *sidecar = g_strconcat(dst, CHECKPOINT_SIDECAR, NULL);
+        ret = checkpoint_write_sidecar(context, sidecar, value, &tmp_err);
+        g_free(sidecar);
+        if (ret == 0) {
+            cp->store = CHECKPOINT_STORE_SIDECAR;
+        }
+    }
+    g_free(value);
+
+    if (ret == 0) {
+        gfal2_log(G_LOG_LEVEL_DEBUG, "Checkpoint of %s at byte %lld", dst, (long long)cp->offset);
+    }
+    G_RETURN_ERR(ret, tmp_err, err);
+}
+
+
+void gfal_checkpoint_clear(gfal2_context_t context, const char *dst, gfal_checkpoint_t *cp)
+{
+    GError *tmp_err = NULL;
+
+    switch (cp->store) {
+        case CHECKPOINT_STORE_XATTR:
+            // There is no removexattr, an empty value is not a valid checkpoint
+            gfal_plugin_setxattrG(context, dst, CHECKPOINT_XATTR, "", 0, 0, &tmp_err);
+            break;
+        case CHECKPOINT_STORE_SIDECAR: {
+            gchar *sidecar = g_strconcat(dst, CHECKPOINT_SIDECAR, NULL);
+            gfal_plugin_unlinkG(context, sidecar, &tmp_err);
+            g_free(sidecar);
+            break;
+        }
+        default:
+            break;
+    }
+    if (tmp_err) {
+        gfal2_log(G_LOG_LEVEL_WARNING, "Could not clear the checkpoint of %s: %s", dst, tmp_err->message);
+        g_error_free(tmp_err);
+    }
+    cp->store = CHECKPOINT_STORE_NONE;
+    checkpoint_reset(cp);
+}
@@ -18,11 +18,17 @@
  * limitations under the License.
  */
 
+#include <string.h>
+
 #include <common/gfal_plugin.h>
 #include <common/gfal_error.h>
 #include <transfer/gfal_transfer_plugins.h>
 #include <transfer/gfal_transfer_internal.h>
 #include <common/gfal_cancel.h>
+#include <uri/gfal2_uri.h>
+#include <common/gfal_plugin_bulk.h>
+#include <common/gfal_metrics_internal.h>
+#include <logger/gfal_trace.h>
 
 static GQuark scope_copy_domain() {
     return g_quark_from_static_string("GFAL2:CORE:COPY");
@@ -121,7 +127,11 @@ static int perform_copy(gfal2_context_t context, gfalt_params_t params, const ch
     if (tmp_err == NULL) {
         if (plugin == NULL) {
             if (gfalt_get_local_transfer_perm(params, NULL)) {
-                res = perform_local_copy(context, params, src, dst, &tmp_err);
+                gfal_autotune_ticket_t ticket;
+                gfalt_params_t tuned = gfal_autotune_begin(context, params, src, dst,
+                        gfal_autotune_dimensions(NULL), &ticket);
+                res = perform_local_copy(context, tuned, src, dst, &tmp_err);
+                gfal_autotune_end(context, tuned, &ticket, res);
             }
             else {
                 gfal2_set_error(error, scope_copy_domain(), EPROTONOSUPPORT, __func__,
@@ -131,7 +141,14 @@ static int perform_copy(gfal2_context_t context, gfalt_params_t params, const ch
             }
         }
         else {
-            res = plugin->copy_file(plugin_data, context, params, src, dst, &tmp_err);
+            gfal_autotune_ticket_t ticket;
+            // Only what the plugin makes use of, for the others it would be noise
+            gfalt_params_t tuned = gfal_autotune_begin(context, params, src, dst,
+                    gfal_autotune_dimensions(plugin->getName()), &ticket);
+            gint64 start = gfal_metrics_start();
+            res = plugin->copy_file(plugin_data, context, tuned, src, dst, &tmp_err);
+            gfal_metrics_record(context, plugin, GFAL_METRICS_OP_COPY, start, res < 0, 0);
+            gfal_autotune_end(context, tuned, &ticket, res);
         }
     }
 
@@ -143,7 +160,7 @@ static int perform_copy(gfal2_context_t context, gfalt_params_t params, const ch
 }
 
 
-static int set_checksum(gfalt_params_t params, const char* checksum, GError **err)
+int gfal_transfer_set_checksum(gfalt_params_t params, const char* checksum, GError **err)
 {
     gfalt_checksum_mode_t mode = gfalt_get_checksum_mode(params, err);
     if (*err) {
@@ -160,41 +177,341 @@ static int set_checksum(gfalt_params_t params, const char* checksum, GError **er
         else {
             char chktype[64];
             size_t chktype_len = colon - checksum;
-            g_strlcpy(chktype, checksum, chktype_len < 64 ? chktype_len : 64);
+            g_strlcpy(chktype, checksum, MIN(chktype_len + 1, sizeof(chktype)));
             return gfalt_set_checksum(params, mode, chktype, colon + 1, err);
         }
     }
 }
 
 
+gboolean gfal_transfer_has_native_bulk(gfal2_context_t context, const char* src, const char* dst)
+{
+    void* plugin_data = NULL;
+    gfal_plugin_interface* plugin = find_copy_plugin(context, GFAL_BULK_COPY, src, dst, &plugin_data, NULL);
+    return plugin != NULL;
+}
+
+
+#define BULK_COPY_DEFAULT_THREADS           8
+#define BULK_COPY_DEFAULT_MAX_PER_SOURCE    4
+#define BULK_COPY_DEFAULT_MAX_PER_DESTINATION 4
+
+
+// Shared state of a bulk copy run by bulk_fallback
+typedef struct {
+    gfal2_context_t context;
+    gfalt_params_t params;
+    size_t nbfiles;
+    const char* const * srcs;
+    const char* const * dsts;
+    const char* const * checksums;
+    GError** file_errors;
+
+    GMutex* lock;
+    GCond* cond;
+    gboolean* started;
+    size_t next_pending;        // first index that may not have started yet
+    size_t done;
+    int failed;
+    int max_per_src, max_per_dst;
+    gchar** src_hosts;
+    gchar** dst_hosts;
+    GHashTable* src_active;     // host => number of running transfers
+    GHashTable* dst_active;
+} bulk_copy_t;
+
+
+static gchar* bulk_get_host(const char* url)
+{
+    GError* tmp_err = NULL;
+    gfal2_uri* parsed = gfal2_parse_uri(url, &tmp_err);
+    gchar* host;
+    if (tmp_err || parsed == NULL || parsed->host == NULL) {
+        g_clear_error(&tmp_err);
+        host = g_strdup("");
+    }
+    else {
+        host = g_strdup(parsed->host);
+    }
+    gfal2_free_uri(parsed);
+    return host;
+}
+
+
+static int bulk_count(GHashTable* active, const gchar* host)
+{
+    return GPOINTER_TO_INT(g_hash_table_lookup(active, host));
+}
+
+
+static void bulk_add(GHashTable* active, const gchar* host, int delta)
+{
+    g_hash_table_insert(active, (gpointer)host, GINT_TO_POINTER(bulk_count(active, host) + delta));
+}
+
+
+// Pick the next file whose endpoints are below their limits
+// Must be called with the lock held. Returns nbfiles if there is none right now.
+static size_t bulk_pick(bulk_copy_t* bulk)
+{
+    size_t i;
+    for (i = bulk->next_pending; i < bulk->nbfiles; ++i) {
+        if (bulk->started[i]) {
+            continue;
+        }
+        if (bulk->max_per_src > 0 && bulk_count(bulk->src_active, bulk->src_hosts[i]) >= bulk->max_per_src) {
+            continue;
+        }
+        if (bulk->max_per_dst > 0 && bulk_count(bulk->dst_active, bulk->dst_hosts[i]) >= bulk->max_per_dst) {
+            continue;
+        }
+        return i;
+    }
+    return bulk->nbfiles;
+}
+
+
+static int bulk_copy_one(bulk_copy_t* bulk, size_t i)
+{
+    GError** file_error = &bulk->file_errors[i];
+
+    if (gfal2_is_canceled(bulk->context)) {
+        gfal2_set_error(file_error, scope_copy_domain(), ECANCELED, __func__, "Transfer canceled");
+        return -1;
+    }
+
+    // Each file gets its own copy of the parameters, whose callbacks are called one at a time
+    gfalt_params_t file_params = gfalt_params_handle_copy_serialized(bulk->params, file_error);
+    if (file_params == NULL) {
+        return -1;
+    }
+
+    int ret = gfal_transfer_set_checksum(file_params, bulk->checksums ? bulk->checksums[i] : NULL, file_error);
+    if (ret == 0) {
+        ret = perform_copy(bulk->context, file_params, bulk->srcs[i], bulk->dsts[i], file_error);
+    }
+
+    gfalt_params_handle_delete(file_params, NULL);
+    return ret;
+}
+
+
+static gpointer bulk_worker(gpointer data)
+{
+    bulk_copy_t* bulk = (bulk_copy_t*)data;
+
+    g_mutex_lock(bulk->lock);
+    while (bulk->next_pending < bulk->nbfiles) {
+        size_t i = bulk_pick(bulk);
+        if (i >= bulk->nbfiles) {
+            // Everything left is waiting for a busy endpoint
+            g_cond_wait(bulk->cond, bulk->lock);
+            continue;
+        }
+
+        bulk->started[i] = TRUE;
+        while (bulk->next_pending < bulk->nbfiles && bulk->started[bulk->next_pending]) {
+            ++bulk->next_pending;
+        }
+        bulk_add(bulk->src_active, bulk->src_hosts[i], 1);
+        bulk_add(bulk->dst_active, bulk->dst_hosts[i], 1);
+        g_mutex_unlock(bulk->lock);
+
+        int ret = bulk_copy_one(bulk, i);
+
+        g_mutex_lock(bulk->lock);
+        bulk_add(bulk->src_active, bulk->src_hosts[i], -1);
+        bulk_add(bulk->dst_active, bulk->dst_hosts[i], -1);
+        ++bulk->done;
+        if (ret < 0) {
+            ++bulk->failed;
+        }
+        gfal2_log(G_LOG_LEVEL_DEBUG, "Bulk copy: %zu/%zu files done, %d failed",
+                bulk->done, bulk->nbfiles, bulk->failed);
+        g_cond_broadcast(bulk->cond);
+    }
+    g_mutex_unlock(bulk->lock);
+    return NULL;
+}
+
+
+// Used when the plugin has no native bulk support.
+// Files are copied by a pool of workers, with at most CORE:BULK_COPY_MAX_PER_SOURCE
+// and CORE:BULK_COPY_MAX_PER_DESTINATION transfers running against the same host.
 static int bulk_fallback(gfal2_context_t context, gfalt_params_t params, size_t nbfiles,
         const char* const * srcs, const char* const * dsts, const char* const * checksums,
         GError** op_error, GError*** file_errors)
 {
     *file_errors = g_new0(GError*, nbfiles);
-    int ret = 0;
+    if (nbfiles == 0) {
+        return 0;
+    }
+
+    bulk_copy_t bulk;
+    memset(&bulk, 0, sizeof(bulk));
+    bulk.context = context;
+    bulk.params = params;
+    bulk.nbfiles = nbfiles;
+    bulk.srcs = srcs;
+    bulk.dsts = dsts;
+    bulk.checksums = checksums;
+    bulk.file_errors = *file_errors;
+    bulk.max_per_src = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP,
+            "BULK_COPY_MAX_PER_SOURCE", BULK_COPY_DEFAULT_MAX_PER_SOURCE);
+    bulk.max_per_dst = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP,
+            "BULK_COPY_MAX_PER_DESTINATION", BULK_COPY_DEFAULT_MAX_PER_DESTINATION);
+
+    int nthreads = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP,
+            "BULK_COPY_THREADS", BULK_COPY_DEFAULT_THREADS);
+    if (nthreads <= 0) {
+        nthreads = 1;
+    }
+    if ((size_t)nthreads > nbfiles) {
+        nthreads = nbfiles;
+    }
+
     size_t i;
+    bulk.started = g_new0(gboolean, nbfiles);
+    bulk.src_hosts = g_new0(gchar*, nbfiles + 1);
+    bulk.dst_hosts = g_new0(gchar*, nbfiles + 1);
     for (i = 0; i < nbfiles; ++i) {
-        int subret = 0;
+        bulk.src_hosts[i] = bulk_get_host(srcs[i]);
+        bulk.dst_hosts[i] = bulk_get_host(dsts[i]);
+    }
+    bulk.src_active = g_hash_table_new(g_str_hash, g_str_equal);
+    bulk.dst_active = g_hash_table_new(g_str_hash, g_str_equal);
+    bulk.lock = g_mutex_new();
+    bulk.cond = g_cond_new();
+
+    gfal2_log(G_LOG_LEVEL_INFO, "Bulk copy of %zu files with %d workers", nbfiles, nthreads);
+
+    // The calling thread is one of the workers
+    GThread** workers = g_new0(GThread*, nthreads);
+    int w;
+    for (w = 1; w < nthreads; ++w) {
+        workers[w] = g_thread_create(bulk_worker, &bulk, TRUE, NULL);
+        if (workers[w] == NULL) {
+            gfal2_log(G_LOG_LEVEL_WARNING, "Could only start %d bulk copy workers", w);
+            break;
+        }
+    }
+    bulk_worker(&bulk);
+    for (w = 1; w < nthreads && workers[w] != NULL; ++w) {
+        g_thread_join(workers[w]);
+    }
+    g_free(workers);
+
+    g_cond_free(bulk.cond);
+    g_mutex_free(bulk.lock);
+    g_hash_table_destroy(bulk.src_active);
+    g_hash_table_destroy(bulk.dst_active);
+    g_strfreev(bulk.src_hosts);
+    g_strfreev(bulk.dst_hosts);
+    g_free(bulk.started);
 
-        if (checksums) {
-            const char* checksum = checksums[i];
-            subret = set_checksum(params, checksum, &(*file_errors)[i]);
+    return -bulk.failed;
+}
+
+
+// Shared by the partitions of a bulk copy
+typedef struct {
+    const char* const * checksums;
+    gfalt_params_t params;
+    GMutex* lock;
+    GError* op_error;           // first operation error reported by a partition
+} bulk_partitions_t;
+
+
+static int bulk_copy_partition(gfal2_context_t context, gfal_bulk_partition_t* partition, gpointer user_data)
+{
+    bulk_partitions_t* shared = (bulk_partitions_t*)user_data;
+    gfal_plugin_interface* plugin = (gfal_plugin_interface*)partition->plugin;
+    GError* op_error = NULL;
+    GError** file_errors = NULL;
+    int i, res;
+
+    const char** checksums = NULL;
+    if (shared->checksums) {
+        checksums = g_new0(const char*, partition->nbfiles + 1);
+        for (i = 0; i < partition->nbfiles; ++i) {
+            checksums[i] = shared->checksums[partition->indexes[i]];
         }
-        else {
-            subret = set_checksum(params, NULL, &(*file_errors)[i]);
+    }
+
+    // Each partition gets its own copy of the parameters, whose callbacks are called one at a time
+    GError* tmp_err = NULL;
+    gfalt_params_t params = gfalt_params_handle_copy_serialized(shared->params, &tmp_err);
+    if (params == NULL) {
+        for (i = 0; i < partition->nbfiles; ++i) {
+            partition->errors[i] = g_error_copy(tmp_err);
         }
-        if (subret < 0) {
-            ret -= 1;
-            continue;
+        g_error_free(tmp_err);
+        g_free(checksums);
+        return -partition->nbfiles;
+    }
+
+    if (plugin == NULL) {
+        res = bulk_fallback(context, params, partition->nbfiles, partition->uris, partition->uris2,
+                checksums, &op_error, &file_errors);
+    }
+    else {
+        gint64 start = gfal_metrics_start();
+        res = plugin->copy_bulk(plugin->plugin_data, context, params, partition->nbfiles,
+                partition->uris, partition->uris2, checksums, &op_error, &file_errors);
+        gfal_metrics_record(context, plugin, GFAL_METRICS_OP_COPY_LIST, start, res < 0, 0);
+    }
+
+    if (file_errors) {
+        for (i = 0; i < partition->nbfiles; ++i) {
+            partition->errors[i] = file_errors[i];
         }
+        g_free(file_errors);
+    }
+    if (op_error) {
+        g_mutex_lock(shared->lock);
+        if (shared->op_error == NULL) {
+            shared->op_error = op_error;
+            op_error = NULL;
+        }
+        g_mutex_unlock(shared->lock);
+        g_clear_error(&op_error);
+    }
 
-        subret = perform_copy(context, params, srcs[i], dsts[i], &(*file_errors)[i]);
-        if (subret < 0) {
-            ret -= 1;
+    gfalt_params_handle_delete(params, NULL);
+    g_free(checksums);
+    return res;
+}
+
+
+// Pairs with a native bulk copy are grouped by plugin and endpoints,
+// the rest go together through the generic fallback
+static GPtrArray* bulk_partition_by_endpoints(gfal2_context_t context, size_t nbfiles,
+        const char* const * srcs, const char* const * dsts)
+{
+    GPtrArray* partitions = gfal_bulk_partitions_new();
+    GHashTable* index_by_key = gfal_bulk_partitions_index_new();
+    size_t i;
+
+    for (i = 0; i < nbfiles; ++i) {
+        void* plugin_data = NULL;
+        gfal_plugin_interface* plugin = find_copy_plugin(context, GFAL_BULK_COPY, srcs[i], dsts[i],
+                &plugin_data, NULL);
+        gchar* key;
+        if (plugin) {
+            gchar* src_endpoint = gfal_bulk_get_endpoint(srcs[i]);
+            gchar* dst_endpoint = gfal_bulk_get_endpoint(dsts[i]);
+            key = g_strdup_printf("%s@%s>%s", plugin->getName(), src_endpoint, dst_endpoint);
+            g_free(src_endpoint);
+            g_free(dst_endpoint);
         }
+        else {
+            key = g_strdup("");
+        }
+        gfal_bulk_partitions_add(partitions, index_by_key, key, plugin, NULL, i, srcs[i], dsts[i]);
+        g_free(key);
     }
-    return ret;
+    g_hash_table_destroy(index_by_key);
+    return partitions;
 }
 
 
@@ -216,25 +533,44 @@ static int perform_bulk_copy(gfal2_context_t context, gfalt_params_t params,
         return -1;
     }
 
-    void *plugin_data = NULL;
-    gfal_plugin_interface *plugin = find_copy_plugin(context, GFAL_BULK_COPY, srcs[0],
-            dsts[0], &plugin_data, &tmp_err);
+    GPtrArray* partitions = bulk_partition_by_endpoints(context, nbfiles, srcs, dsts);
 
-    if (tmp_err == NULL) {
+    if (partitions->len <= 1) {
+        gfal_plugin_interface* plugin = NULL;
+        if (partitions->len == 1) {
+            plugin = ((gfal_bulk_partition_t*)g_ptr_array_index(partitions, 0))->plugin;
+        }
         if (plugin == NULL) {
             res = bulk_fallback(context, params, nbfiles, srcs, dsts, checksums, op_error,
                     file_errors);
         }
         else {
-            res = plugin->copy_bulk(plugin_data, context, params, nbfiles, srcs, dsts, checksums,
+            gint64 start = gfal_metrics_start();
+            res = plugin->copy_bulk(plugin->plugin_data, context, params, nbfiles, srcs, dsts, checksums,
                     op_error, file_errors);
+            gfal_metrics_record(context, plugin, GFAL_METRICS_OP_COPY_LIST, start, res < 0, 0);
         }
     }
+    else {
+        gfal2_log(G_LOG_LEVEL_INFO, "Bulk copy of %zu files split into %u partitions", nbfiles, partitions->len);
+
+        bulk_partitions_t shared;
+        memset(&shared, 0, sizeof(shared));
+        shared.checksums = checksums;
+        shared.params = params;
+        shared.lock = g_mutex_new();
+
+        *file_errors = g_new0(GError*, nbfiles);
+        res = gfal_bulk_partitions_run(context, partitions, bulk_copy_partition, &shared, *file_errors);
+        if (shared.op_error) {
+            g_propagate_error(op_error, shared.op_error);
+        }
 
-    gfal2_log(G_LOG_LEVEL_DEBUG, " <- Gfal::Transfer::BulkFileCopy");
+        g_mutex_free(shared.lock);
+    }
+    gfal_bulk_partitions_free(partitions);
 
-    if (tmp_err != NULL)
-        gfal2_propagate_prefixed_error(op_error, tmp_err, __func__);
+    gfal2_log(G_LOG_LEVEL_DEBUG, " <- Gfal::Transfer::BulkFileCopy");
     return res;
 }
 
@@ -250,6 +586,7 @@ int gfalt_copy_file(gfal2_context_t handle, gfalt_params_t params, const char* s
 
     int ret = -1;
     GError* nested_error = NULL;
+    gfal2_span_t span = gfal2_trace_begin("transfer", "copy");
     if (params == NULL) {
         p = gfalt_params_handle_new(NULL);
         ret = perform_copy(handle, p, src, dst, &nested_error);
@@ -257,6 +594,7 @@ int gfalt_copy_file(gfal2_context_t handle, gfalt_params_t params, const char* s
     else {
         ret = perform_copy(handle, params, src, dst, &nested_error);
     }
+    gfal2_trace_end(span);
     gfalt_params_handle_delete(p, NULL);
 
     GFAL2_END_SCOPE_CANCEL(handle);
@@ -264,6 +602,22 @@ int gfalt_copy_file(gfal2_context_t handle, gfalt_params_t params, const char* s
 }
 
 
+static ssize_t copy_file_async_func(gfal2_context_t context, gfal2_async_request_t req, GError** err)
+{
+    return gfalt_copy_file(context, (gfalt_params_t)req->params, req->url, req->url2, err);
+}
+
+
+int gfalt_copy_file_async(gfal2_async_queue_t queue, gfal2_async_request_t req, GError** err)
+{
+    g_return_val_err_if_fail(req && req->url && req->url2, -1, err,
+            "invalid source or/and destination values");
+    req->op = GFAL2_ASYNC_CALL;
+    req->func = copy_file_async_func;
+    return gfal2_async_submit(queue, req, err);
+}
+
+
 int gfalt_copy_bulk(gfal2_context_t context, gfalt_params_t params, size_t nbfiles,
         const char* const * srcs, const char* const * dsts, const char* const * checksums,
         GError** op_error, GError*** file_errors)
@@ -280,8 +634,10 @@ int gfalt_copy_bulk(gfal2_context_t context, gfalt_params_t params, size_t nbfil
 
     GFAL2_BEGIN_SCOPE_CANCEL(context, -1, op_error);
 
+    gfal2_span_t span = gfal2_trace_begin("transfer", "copy_bulk");
     ret = perform_bulk_copy(context, params, nbfiles, srcs, dsts, checksums, op_error,
             file_errors);
+    gfal2_trace_end(span);
     gfalt_params_handle_delete(p, NULL);
 
     GFAL2_END_SCOPE_CANCEL(context);
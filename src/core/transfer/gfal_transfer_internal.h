@@ -25,6 +25,7 @@
 #include "gfal_transfer.h"
 #include "gfal_transfer_plugins.h"
 #include <sys/types.h>
+#include <sys/stat.h>
 
 struct _gfalt_params_t {
     gboolean lock;              // lock enabled after the start of the transfer
@@ -36,6 +37,7 @@ struct _gfalt_params_t {
     gboolean strict_mode;       // state of the strict copy mode
     gboolean local_transfers;   // local transfer authorized
     gboolean parent_dir_create; // force the creation of the parent dir
+    gboolean resume;            // resume streamed copies from their checkpoint
     gboolean proxy_delegation;  // use TPC proxy delegation
     // disk residency management for tape endpoints
     gboolean evict;             // evict file from disk buffer
@@ -52,6 +54,11 @@ struct _gfalt_params_t {
     // callback lists
     GSList *monitor_callbacks;
     GSList *event_callbacks;
+    gboolean lazy_event_description;    // event callbacks use gfalt_event_get_description
+
+    guint64 copy_buffer_size;   // set by the auto-tuner, 0 for CORE:COPY_BUFFERSIZE
+
+    GMutex *callbacks_lock;     // serializes the callbacks forwarded by gfalt_params_handle_copy_serialized
 };
 
 
@@ -64,4 +71,86 @@ struct _gfalt_callback_entry {
 int perform_local_copy(gfal2_context_t context, gfalt_params_t params,
     const char *src, const char *dst, GError **error);
 
+// TRUE if a copy run with a behaves as with b, the callbacks are compared by function and user data
+gboolean gfalt_params_equal(gfalt_params_t a, gfalt_params_t b);
+
+// Set the checksum of params from "type:value", or only "value"
+int gfal_transfer_set_checksum(gfalt_params_t params, const char *checksum, GError **err);
+
+// TRUE if a plugin provides a native bulk copy from src to dst
+gboolean gfal_transfer_has_native_bulk(gfal2_context_t context, const char *src, const char *dst);
+
+// Progress of a resumable streamed copy, kept with the destination
+typedef struct {
+    off_t offset;               // bytes written and synced
+    unsigned long adler32;      // of those bytes
+    gint64 src_size;            // the source must not change in between
+    gint64 src_mtime;
+    int store;                  // where it is kept
+} gfal_checkpoint_t;
+
+// Serialization of the checkpoint of a copy from src
+gchar *gfal_checkpoint_format(const gfal_checkpoint_t *cp, const char *src);
+gboolean gfal_checkpoint_parse(const char *value, const char *src, gfal_checkpoint_t *cp);
+
+// Offset from where the copy of src into dst can continue, 0 if there is no valid checkpoint
+off_t gfal_checkpoint_load(gfal2_context_t context, const char *src, const struct stat *src_st,
+    const char *dst, gfal_checkpoint_t *cp);
+
+// Record cp, the data it covers must be already synced
+int gfal_checkpoint_save(gfal2_context_t context, const char *src, const char *dst,
+    gfal_checkpoint_t *cp, GError **err);
+
+// Drop the checkpoint once the copy is complete
+void gfal_checkpoint_clear(gfal2_context_t context, const char *dst, gfal_checkpoint_t *cp);
+
+// Default of CORE:COPY_BUFFERSIZE
+extern const size_t DEFAULT_BUFFER_SIZE;
+
+// Settings adjusted by the auto-tuner
+typedef enum {
+    GFAL_AUTOTUNE_STREAMS = 0,  // gfalt_set_nbstreams
+    GFAL_AUTOTUNE_TCP_BUFFER,   // gfalt_set_tcp_buffer_size, 0 leaves it to the system
+    GFAL_AUTOTUNE_COPY_BUFFER,  // buffer of the streamed copy
+    GFAL_AUTOTUNE_DIMENSIONS
+} gfal_autotune_dimension_t;
+
+#define GFAL_AUTOTUNE_MASK(dim) (1 << (dim))
+
+typedef struct _gfal_autotune gfal_autotune_t;
+
+// Settings picked for one copy, and what was observed while it ran
+typedef struct {
+    gchar *link;                // NULL if the copy is not tuned
+    int dimensions;             // mask of the tuned settings
+    guint64 values[GFAL_AUTOTUNE_DIMENSIONS];
+    int probe_dim;              // setting that differs from the best known, -1 if none
+    guint64 bytes;              // from the performance markers
+    guint64 baudrate;
+} gfal_autotune_ticket_t;
+
+// Per link cache of the best known settings, whose throughput halves every half_life microseconds
+gfal_autotune_t *gfal_autotune_new(guint max_streams, gint64 half_life);
+void gfal_autotune_free(gpointer tuner);
+
+// Settings for the next copy over link, initial is used when the link is unknown
+void gfal_autotune_next(gfal_autotune_t *tuner, const char *link, int dimensions,
+    const guint64 *initial, gint64 now, gfal_autotune_ticket_t *ticket);
+
+// Throughput in bytes/s achieved with the settings of ticket, <= 0 if unknown
+void gfal_autotune_feedback(gfal_autotune_t *tuner, const gfal_autotune_ticket_t *ticket,
+    double throughput, gint64 now);
+
+// Settings used by the copies of the plugin, NULL for the streamed copies done by the core
+int gfal_autotune_dimensions(const char *plugin_name);
+
+// Parameters to use for a copy from src to dst, params itself if CORE:COPY_AUTOTUNE is disabled
+// or there is nothing to tune. Only the given dimensions are tuned.
+gfalt_params_t gfal_autotune_begin(gfal2_context_t context, gfalt_params_t params,
+    const char *src, const char *dst, int dimensions, gfal_autotune_ticket_t *ticket);
+
+// Learn from the copy, and release what gfal_autotune_begin allocated
+void gfal_autotune_end(gfal2_context_t context, gfalt_params_t tuned, gfal_autotune_ticket_t *ticket,
+    int result);
+
 #endif /* GFAL_TRANSFER_INTERNAL_H_ */
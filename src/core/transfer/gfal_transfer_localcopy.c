@@ -28,6 +28,7 @@
 
 
 const size_t DEFAULT_BUFFER_SIZE = 4194304;
+const gint64 DEFAULT_CHECKPOINT_INTERVAL = 268435456;
 
 
 static GQuark local_copy_domain() {
@@ -65,7 +66,10 @@ static int create_parent(gfal2_context_t context, gfalt_params_t params,
 
     GError* nested_error = NULL;
     struct stat st;
-    if (gfal2_stat(context, parent, &st, &nested_error) < 0) {
+    int expected = gfal2_expect_errno_begin(ENOENT);
+    int ret = gfal2_stat(context, parent, &st, &nested_error);
+    gfal2_expect_errno_end(expected);
+    if (ret < 0) {
         if (nested_error->code != ENOENT) {
             gfal2_propagate_prefixed_error(error, nested_error, __func__);
             return -1;
@@ -91,7 +95,10 @@ static int unlink_if_exists(gfal2_context_t context, gfalt_params_t params,
 {
     GError* nested_error = NULL;
     struct stat st;
-    if (gfal2_stat(context, surl, &st, &nested_error) != 0) {
+    int expected = gfal2_expect_errno_begin(ENOENT);
+    int ret = gfal2_stat(context, surl, &st, &nested_error);
+    gfal2_expect_errno_end(expected);
+    if (ret != 0) {
         if (nested_error->code == ENOENT) {
             g_error_free(nested_error);
             return 0;
@@ -110,7 +117,9 @@ static int unlink_if_exists(gfal2_context_t context, gfalt_params_t params,
         return -1;
     }
 
+    expected = gfal2_expect_errno_begin(ENOENT);
     gfal2_unlink(context, surl, &nested_error);
+    gfal2_expect_errno_end(expected);
     if (nested_error != NULL) {
         if (nested_error->code != ENOENT) {
             gfal2_propagate_prefixed_error(error, nested_error, __func__);
@@ -151,8 +160,51 @@ static void send_performance_data(gfalt_params_t params, const char* src, const
 }
 
 
+// Sync what has been written up to offset, and record it in the checkpoint
+// Returns -1 if the destination could not be synced, 1 if the checkpoint could not be recorded
+static int commit_checkpoint(gfal2_context_t context, gfal_file_handle f_dst,
+        const char* src, const char* dst, gfal_checkpoint_t* checkpoint,
+        off_t offset, unsigned long adler32, GError** error)
+{
+    GError* nested_error = NULL;
+    if (gfal_plugin_fsyncG(context, f_dst, &nested_error) < 0) {
+        gfal2_propagate_prefixed_error(error, nested_error, __func__);
+        return -1;
+    }
+    checkpoint->offset = offset;
+    checkpoint->adler32 = adler32;
+    if (gfal_checkpoint_save(context, src, dst, checkpoint, &nested_error) < 0) {
+        gfal2_log(G_LOG_LEVEL_MESSAGE, "Could not record the checkpoint, the copy will not be resumable: %s",
+                nested_error->message);
+        g_error_free(nested_error);
+        return 1;
+    }
+    return 0;
+}
+
+
+// Write the whole buffer at offset
+static int write_at(gfal2_context_t context, gfal_file_handle f_dst, char* buffer, size_t count,
+        off_t offset, GError** error)
+{
+    while (count > 0) {
+        ssize_t written = gfal_plugin_pwriteG(context, f_dst, buffer, count, offset, error);
+        if (written < 0) {
+            return -1;
+        }
+        buffer += written;
+        count -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+
+// Copy from offset onwards. When offset is not 0, the source and destination are accessed
+// with pread and pwrite. When checkpoint is not NULL, the destination is synced and the
+// progress recorded every CORE:COPY_CHECKPOINT_INTERVAL bytes, and when the copy fails.
 static int streamed_copy(gfal2_context_t context, gfalt_params_t params,
-        const char* src, const char* dst, GError** error)
+        const char* src, const char* dst, off_t offset, gfal_checkpoint_t* checkpoint, GError** error)
 {
     GError *nested_error = NULL;
 
@@ -164,7 +216,10 @@ static int streamed_copy(gfal2_context_t context, gfalt_params_t params,
         "%s", GFAL_TRANSFER_TYPE_STREAMED);
 
     size_t alignment = gfal2_get_opt_integer_with_default(context, "CORE", "COPY_BUFFER_ALIGNMENT", 512);
-    size_t buffersize = gfal2_get_opt_integer_with_default(context, "CORE", "COPY_BUFFERSIZE", DEFAULT_BUFFER_SIZE);
+    size_t buffersize = params->copy_buffer_size;
+    if (buffersize == 0) {
+        buffersize = gfal2_get_opt_integer_with_default(context, "CORE", "COPY_BUFFERSIZE", DEFAULT_BUFFER_SIZE);
+    }
     char *buffer;
     errno = posix_memalign((void**)&buffer, alignment, buffersize);
     if (errno) {
@@ -220,12 +275,48 @@ static int streamed_copy(gfal2_context_t context, gfalt_params_t params,
     const time_t timeout = perf_data.start + gfalt_get_timeout(params, NULL);
     ssize_t s_file = 1;
 
-    gfal2_log(G_LOG_LEVEL_DEBUG, "  begin local transfer %s ->  %s with buffer size %ld", src, dst, buffersize);
+    const gboolean positional = (offset > 0);
+    const gint64 checkpoint_interval = gfal2_get_opt_integer_with_default(context, "CORE",
+            "COPY_CHECKPOINT_INTERVAL", DEFAULT_CHECKPOINT_INTERVAL / 1048576) * (gint64)1048576;
+    gboolean checkpointing = (checkpoint != NULL);
+    unsigned long adler32 = checkpoint ? checkpoint->adler32 : 1;
+
+    gfal2_log(G_LOG_LEVEL_DEBUG, "  begin local transfer %s ->  %s with buffer size %ld from offset %lld",
+            src, dst, buffersize, (long long)offset);
 
     while (s_file > 0 && !nested_error) {
-        s_file = gfal_plugin_readG(context, f_src, buffer, buffersize, &nested_error);
-        if (s_file > 0) {
-            gfal_plugin_writeG(context, f_dst, buffer, s_file, &nested_error);
+        if (positional) {
+            s_file = gfal_plugin_preadG(context, f_src, buffer, buffersize, offset, &nested_error);
+            if (s_file > 0) {
+                write_at(context, f_dst, buffer, s_file, offset, &nested_error);
+            }
+        }
+        else {
+            s_file = gfal_plugin_readG(context, f_src, buffer, buffersize, &nested_error);
+            if (s_file > 0) {
+                gfal_plugin_writeG(context, f_dst, buffer, s_file, &nested_error);
+            }
+        }
+
+        if (s_file > 0 && !nested_error) {
+            offset += s_file;
+            if (checkpointing) {
+                adler32 = gfal2_adler32(adler32, buffer, s_file);
+                if (offset - checkpoint->offset >= checkpoint_interval) {
+                    int expected = gfal2_expect_errno_begin(ENOSYS);
+                    int ret = commit_checkpoint(context, f_dst, src, dst, checkpoint, offset, adler32, &nested_error);
+                    gfal2_expect_errno_end(expected);
+                    if (ret > 0) {
+                        checkpointing = FALSE;
+                    }
+                    else if (ret < 0 && nested_error->code == ENOSYS) {
+                        gfal2_log(G_LOG_LEVEL_MESSAGE, "The destination can not be synced, so the copy will not be resumable: %s",
+                                nested_error->message);
+                        g_clear_error(&nested_error);
+                        checkpointing = FALSE;
+                    }
+                }
+            }
         }
 
         perf_data.done += s_file;
@@ -252,6 +343,11 @@ static int streamed_copy(gfal2_context_t context, gfalt_params_t params,
     }
     free(buffer);
 
+    // Keep what made it, so the next attempt does not start over
+    if (nested_error && checkpointing && offset > checkpoint->offset) {
+        commit_checkpoint(context, f_dst, src, dst, checkpoint, offset, adler32, NULL);
+    }
+
     gfal_plugin_closeG(context, f_dst, (nested_error)?NULL:(&nested_error));
     gfal_plugin_closeG(context, f_src, (nested_error)?NULL:(&nested_error));
 
@@ -260,6 +356,9 @@ static int streamed_copy(gfal2_context_t context, gfalt_params_t params,
         return -1;
     }
     else {
+        if (checkpoint) {
+            gfal_checkpoint_clear(context, dst, checkpoint);
+        }
         plugin_trigger_event(params, local_copy_domain(), GFAL_EVENT_NONE,
                 GFAL_EVENT_TRANSFER_EXIT, "%s => %s", src, dst);
         return 0;
@@ -310,6 +409,28 @@ int perform_local_copy(gfal2_context_t context, gfalt_params_t params,
         }
     }
 
+    // Resume a previous attempt, or from where the caller said
+    off_t offset = params->start_offset;
+    gfal_checkpoint_t checkpoint;
+    gfal_checkpoint_t* resumable = NULL;
+
+    if (offset == 0 && !is_strict_mode &&
+        (gfalt_get_resume(params, NULL) || gfal2_get_opt_boolean_with_default(context, "CORE", "COPY_RESUME", FALSE))) {
+        struct stat src_stat;
+        if (gfal2_get_opt_boolean_with_default(context, "CORE", "COPY_DIRECT_IO", FALSE)) {
+            gfal2_log(G_LOG_LEVEL_MESSAGE, "Copies with direct io can not be resumed");
+        }
+        else if (gfal2_stat(context, src, &src_stat, &nested_error) < 0) {
+            gfal2_log(G_LOG_LEVEL_MESSAGE, "Could not stat the source, the copy will not be resumable: %s",
+                    nested_error->message);
+            g_clear_error(&nested_error);
+        }
+        else {
+            resumable = &checkpoint;
+            offset = gfal_checkpoint_load(context, src, &src_stat, dst, resumable);
+        }
+    }
+
     if (!is_strict_mode) {
         // Parent directory
         create_parent(context, params, dst, &nested_error);
@@ -318,8 +439,8 @@ int perform_local_copy(gfal2_context_t context, gfalt_params_t params,
             return -1;
         }
 
-        // Remove if exists and overwrite is set
-        if (!is_strict_mode) {
+        // Remove if exists and overwrite is set, unless continuing into it
+        if (offset == 0) {
             unlink_if_exists(context, params, dst, &nested_error);
             if (nested_error != NULL) {
                 gfal2_propagate_prefixed_error(error, nested_error, __func__);
@@ -329,7 +450,7 @@ int perform_local_copy(gfal2_context_t context, gfalt_params_t params,
     }
 
     // Do the transfer
-    streamed_copy(context, params, src, dst, &nested_error);
+    streamed_copy(context, params, src, dst, offset, resumable, &nested_error);
     if (nested_error != NULL) {
         gfal2_propagate_prefixed_error(error, nested_error, __func__);
         return -1;
@@ -37,11 +37,14 @@ static void gfalt_params_handle_init(gfalt_params_t p, GError ** err)
     p->local_transfers = TRUE;
     p->strict_mode = FALSE;
     p->parent_dir_create = FALSE;
+    p->resume = FALSE;
     p->proxy_delegation = TRUE;
     p->evict = FALSE;
 
     p->monitor_callbacks = NULL;
     p->event_callbacks = NULL;
+    p->lazy_event_description = FALSE;
+    p->copy_buffer_size = 0;
 }
 
 
@@ -73,11 +76,138 @@ gfalt_params_t gfalt_params_handle_copy(gfalt_params_t params, GError ** err)
 
     p->monitor_callbacks = gfalt_params_copy_callbacks(params->monitor_callbacks);
     p->event_callbacks = gfalt_params_copy_callbacks(params->event_callbacks);
+    p->callbacks_lock = NULL;
 
     return p;
 }
 
 
+static gboolean gfalt_params_equal_callbacks(const GSList* a, const GSList* b)
+{
+    while (a && b) {
+        const struct _gfalt_callback_entry* ea = (const struct _gfalt_callback_entry*)a->data;
+        const struct _gfalt_callback_entry* eb = (const struct _gfalt_callback_entry*)b->data;
+        if (ea->func != eb->func || ea->udata != eb->udata) {
+            return FALSE;
+        }
+        a = g_slist_next(a);
+        b = g_slist_next(b);
+    }
+    return a == NULL && b == NULL;
+}
+
+
+gboolean gfalt_params_equal(gfalt_params_t a, gfalt_params_t b)
+{
+    if (a == b) {
+        return TRUE;
+    }
+    return a->timeout == b->timeout &&
+        a->tcp_buffer_size == b->tcp_buffer_size &&
+        a->replace_existing == b->replace_existing &&
+        a->start_offset == b->start_offset &&
+        a->nb_data_streams == b->nb_data_streams &&
+        a->strict_mode == b->strict_mode &&
+        a->local_transfers == b->local_transfers &&
+        a->parent_dir_create == b->parent_dir_create &&
+        a->resume == b->resume &&
+        a->proxy_delegation == b->proxy_delegation &&
+        a->evict == b->evict &&
+        g_strcmp0(a->stage_request_id, b->stage_request_id) == 0 &&
+        g_strcmp0(a->transfer_metadata, b->transfer_metadata) == 0 &&
+        g_strcmp0(a->src_space_token, b->src_space_token) == 0 &&
+        g_strcmp0(a->dst_space_token, b->dst_space_token) == 0 &&
+        a->checksum_mode == b->checksum_mode &&
+        g_strcmp0(a->checksum_value, b->checksum_value) == 0 &&
+        g_strcmp0(a->checksum_type, b->checksum_type) == 0 &&
+        a->lazy_event_description == b->lazy_event_description &&
+        a->copy_buffer_size == b->copy_buffer_size &&
+        gfalt_params_equal_callbacks(a->monitor_callbacks, b->monitor_callbacks) &&
+        gfalt_params_equal_callbacks(a->event_callbacks, b->event_callbacks);
+}
+
+
+G_LOCK_DEFINE_STATIC(gfalt_params_serialized);
+
+
+static void gfalt_params_serialized_monitor(gfalt_transfer_status_t h, const char* src, const char* dst,
+        gpointer user_data)
+{
+    gfalt_params_t params = (gfalt_params_t)user_data;
+    GSList* item;
+    g_mutex_lock(params->callbacks_lock);
+    for (item = params->monitor_callbacks; item != NULL; item = g_slist_next(item)) {
+        struct _gfalt_callback_entry* entry = (struct _gfalt_callback_entry*)item->data;
+        ((gfalt_monitor_func)entry->func)(h, src, dst, entry->udata);
+    }
+    g_mutex_unlock(params->callbacks_lock);
+}
+
+
+static void gfalt_params_serialized_event(const gfalt_event_t e, gpointer user_data)
+{
+    gfalt_params_t params = (gfalt_params_t)user_data;
+    GSList* item;
+    g_mutex_lock(params->callbacks_lock);
+    for (item = params->event_callbacks; item != NULL; item = g_slist_next(item)) {
+        struct _gfalt_callback_entry* entry = (struct _gfalt_callback_entry*)item->data;
+        ((gfalt_event_func)entry->func)(e, entry->udata);
+    }
+    g_mutex_unlock(params->callbacks_lock);
+}
+
+
+gfalt_params_t gfalt_params_handle_copy_serialized(gfalt_params_t params, GError ** err)
+{
+    g_return_val_err_if_fail(params != NULL, NULL, err, "[BUG] invalid params handle");
+
+    G_LOCK(gfalt_params_serialized);
+    if (params->callbacks_lock == NULL) {
+        params->callbacks_lock = g_mutex_new();
+    }
+    G_UNLOCK(gfalt_params_serialized);
+
+    gfalt_params_t p = gfalt_params_handle_copy(params, err);
+    if (p == NULL) {
+        return NULL;
+    }
+    g_slist_foreach(p->monitor_callbacks, (GFunc)g_free, NULL);
+    g_slist_free(p->monitor_callbacks);
+    g_slist_foreach(p->event_callbacks, (GFunc)g_free, NULL);
+    g_slist_free(p->event_callbacks);
+    p->monitor_callbacks = NULL;
+    p->event_callbacks = NULL;
+    if (params->monitor_callbacks) {
+        gfalt_add_monitor_callback(p, gfalt_params_serialized_monitor, params, NULL, NULL);
+    }
+    if (params->event_callbacks) {
+        gfalt_add_event_callback(p, gfalt_params_serialized_event, params, NULL, NULL);
+    }
+    return p;
+}
+
+
+gfalt_params_t gfalt_params_handle_copy_bulk_file(gfalt_params_t params, const char* checksum, GError ** err)
+{
+    gfalt_params_t p = gfalt_params_handle_copy_serialized(params, err);
+    if (p == NULL || checksum == NULL || checksum[0] == '\0') {
+        return p;
+    }
+
+    gfalt_checksum_mode_t mode = gfalt_get_checksum_mode(params, NULL);
+    const char* separator = strchr(checksum, ':');
+    if (separator) {
+        char* type = g_strndup(checksum, separator - checksum);
+        gfalt_set_checksum(p, mode, type, separator + 1, NULL);
+        g_free(type);
+    }
+    else {
+        gfalt_set_checksum(p, mode, NULL, checksum, NULL);
+    }
+    return p;
+}
+
+
 gfalt_params_t gfalt_params_handle_new(GError ** err)
 {
 
@@ -109,6 +239,11 @@ void gfalt_params_handle_delete(gfalt_params_t params, GError ** err)
         g_slist_free(params->monitor_callbacks);
         g_slist_foreach(params->event_callbacks, gfalt_params_free_callback , NULL);
         g_slist_free(params->event_callbacks);
+        if (params->callbacks_lock) {
+            g_mutex_free(params->callbacks_lock);
+        }
+        // Spans of events never ended
+        gfal2_trace_drop_keyed(params);
 
         g_free(params);
     }
@@ -301,6 +436,21 @@ gint gfalt_remove_event_callback(gfalt_params_t params, gfalt_event_func callbac
 }
 
 
+gint gfalt_set_lazy_event_description(gfalt_params_t params, gboolean value, GError** err)
+{
+    g_return_val_err_if_fail(params != NULL, -1, err, "[BUG] invalid params handle");
+    params->lazy_event_description = value;
+    return 0;
+}
+
+
+gboolean gfalt_get_lazy_event_description(gfalt_params_t params, GError** err)
+{
+    g_return_val_err_if_fail(params != NULL, FALSE, err, "[BUG] invalid params handle");
+    return params->lazy_event_description;
+}
+
+
 guint gfalt_get_nbstreams(gfalt_params_t params, GError** err)
 {
     g_return_val_err_if_fail(params != NULL, -1, err, "[BUG] invalid parameter handle");
@@ -367,6 +517,21 @@ gboolean gfalt_get_create_parent_dir(gfalt_params_t params, GError** err)
     return params->parent_dir_create;
 }
 
+
+gint gfalt_set_resume(gfalt_params_t params, gboolean resume, GError** err)
+{
+    g_return_val_err_if_fail(params != NULL, -1, err, "[BUG] invalid params handle");
+    params->resume = resume;
+    return 0;
+}
+
+
+gboolean gfalt_get_resume(gfalt_params_t params, GError** err)
+{
+    g_return_val_err_if_fail(params != NULL, FALSE, err, "[BUG] invalid params handle");
+    return params->resume;
+}
+
 gint gfalt_set_use_proxy_delegation(gfalt_params_t params, gboolean proxy_delegation, GError** err)
 {
     g_return_val_err_if_fail(params != NULL, -1, err, "[BUG] invalid params handle");
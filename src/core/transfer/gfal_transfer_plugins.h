@@ -64,6 +64,22 @@ int plugin_trigger_event(gfalt_params_t params, GQuark domain,
 int plugin_trigger_monitor(gfalt_params_t params, gfalt_transfer_status_t status,
         const char* src, const char* dst);
 
+/**
+ * Copy of the transfer parameters for one of several copies a plugin runs at the same time.
+ * Its monitor and event callbacks forward to those of params, one at a time, so the
+ * user callbacks are never called concurrently.
+ * params must not be freed before the copy.
+ */
+gfalt_params_t gfalt_params_handle_copy_serialized(gfalt_params_t params, GError ** err);
+
+/**
+ * Same as gfalt_params_handle_copy_serialized, with the user checksum set to the one
+ * given for a file of a bulk copy, either "type:value" or only the value.
+ * The checksum mode, and the type when only the value is given, stay those of params.
+ * A NULL or empty checksum keeps the one of params.
+ */
+gfalt_params_t gfalt_params_handle_copy_bulk_file(gfalt_params_t params, const char* checksum, GError ** err);
+
 /**
  * Convenience error methods for copy implementations
  */
@@ -0,0 +1,682 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <common/gfal_config.h>
+#include <common/gfal_error.h>
+#include <common/gfal_cancel.h>
+#include <common/gfal_plugin_bulk.h>
+#include <transfer/gfal_transfer_internal.h>
+#include <transfer/gfal_transfer_scheduler.h>
+
+#define SCHEDULER_DEFAULT_MAX_ACTIVE            8
+#define SCHEDULER_DEFAULT_MAX_PER_SOURCE        4
+#define SCHEDULER_DEFAULT_MAX_PER_DESTINATION   4
+#define SCHEDULER_DEFAULT_MAX_PER_LINK          0
+#define SCHEDULER_DEFAULT_MAX_BATCH             100
+#define SCHEDULER_DEFAULT_GROUP                 "default"
+
+
+static GQuark scope_scheduler_domain() {
+    return g_quark_from_static_string("GFAL2:CORE:SCHEDULER");
+}
+
+
+typedef struct sched_group_s sched_group_t;
+
+typedef struct {
+    guint64 id;
+    gfalt_params_t params;      // own copy, copies with equal ones can go in the same bulk
+    gboolean native_bulk;
+    gchar* src;
+    gchar* dst;
+    gchar* checksum;
+    gchar* src_se;
+    gchar* dst_se;
+    gchar* link;
+    int priority;
+    gfalt_scheduler_done_func done;
+    gpointer user_data;
+    GError* error;
+} sched_job_t;
+
+
+struct sched_group_s {
+    gchar* name;
+    guint weight;
+    gint64 deficit;             // copies the group can still start in this round, can go into debt
+    GQueue* jobs;               // by priority, then submission order
+};
+
+
+struct _gfalt_scheduler {
+    gfal2_context_t context;
+    GMutex* lock;
+    GCond* cond;                // a copy was queued, or a slot released
+    GCond* idle;                // nothing left to run
+    int limits[GFALT_SCHEDULER_MAX_BATCH + 1];
+
+    GPtrArray* groups;          // in round robin order
+    GHashTable* groups_by_name;
+    guint cursor;
+
+    GHashTable* src_active;     // storage => active transfers
+    GHashTable* dst_active;
+    GHashTable* link_active;
+
+    guint64 next_id;
+    guint queued;
+    guint active;               // copies being transferred, bound by GFALT_SCHEDULER_MAX_ACTIVE
+    guint running;              // including their done callbacks
+    guint failed;               // since the last gfalt_scheduler_wait
+    int idle_workers;
+    gboolean paused, shutdown;
+    GPtrArray* workers;
+};
+
+
+static int sched_count(GHashTable* active, const gchar* key)
+{
+    return GPOINTER_TO_INT(g_hash_table_lookup(active, key));
+}
+
+
+static void sched_add(GHashTable* active, const gchar* key, int delta)
+{
+    int count = sched_count(active, key) + delta;
+    if (count > 0) {
+        g_hash_table_insert(active, g_strdup(key), GINT_TO_POINTER(count));
+    }
+    else {
+        g_hash_table_remove(active, key);
+    }
+}
+
+
+static int sched_limit_headroom(int limit, GHashTable* active, const gchar* key, int headroom)
+{
+    if (limit > 0) {
+        int left = limit - sched_count(active, key);
+        if (left < headroom) {
+            headroom = left;
+        }
+    }
+    return headroom;
+}
+
+
+// How many more transfers can start over the link of the job, 0 or less if none
+// Must be called with the lock held
+static int sched_headroom(gfalt_scheduler_t s, const sched_job_t* job)
+{
+    int headroom = G_MAXINT;
+    headroom = sched_limit_headroom(s->limits[GFALT_SCHEDULER_MAX_PER_SOURCE], s->src_active, job->src_se, headroom);
+    headroom = sched_limit_headroom(s->limits[GFALT_SCHEDULER_MAX_PER_DESTINATION], s->dst_active, job->dst_se, headroom);
+    headroom = sched_limit_headroom(s->limits[GFALT_SCHEDULER_MAX_PER_LINK], s->link_active, job->link, headroom);
+    return headroom;
+}
+
+
+static void sched_job_free(sched_job_t* job)
+{
+    gfalt_params_handle_delete(job->params, NULL);
+    g_free(job->src);
+    g_free(job->dst);
+    g_free(job->checksum);
+    g_free(job->src_se);
+    g_free(job->dst_se);
+    g_free(job->link);
+    g_clear_error(&job->error);
+    g_free(job);
+}
+
+
+// Higher priority first, then submission order
+static gint sched_job_compare(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    const sched_job_t* ja = (const sched_job_t*)a;
+    const sched_job_t* jb = (const sched_job_t*)b;
+    if (ja->priority != jb->priority) {
+        return ja->priority > jb->priority ? -1 : 1;
+    }
+    if (ja->id != jb->id) {
+        return ja->id < jb->id ? -1 : 1;
+    }
+    return 0;
+}
+
+
+static void sched_group_push(sched_group_t* group, sched_job_t* job)
+{
+    // Most submissions go at the end
+    sched_job_t* tail = (sched_job_t*)g_queue_peek_tail(group->jobs);
+    if (tail == NULL || sched_job_compare(tail, job, NULL) < 0) {
+        g_queue_push_tail(group->jobs, job);
+    }
+    else {
+        g_queue_insert_sorted(group->jobs, job, sched_job_compare, NULL);
+    }
+}
+
+
+static sched_group_t* sched_get_group(gfalt_scheduler_t s, const char* name)
+{
+    sched_group_t* group = (sched_group_t*)g_hash_table_lookup(s->groups_by_name, name);
+    if (group == NULL) {
+        group = g_new0(sched_group_t, 1);
+        group->name = g_strdup(name);
+        group->weight = 1;
+        group->jobs = g_queue_new();
+        g_hash_table_insert(s->groups_by_name, group->name, group);
+        g_ptr_array_add(s->groups, group);
+    }
+    return group;
+}
+
+
+// First copy of the group that can start now, NULL if none
+static GList* sched_group_pick(gfalt_scheduler_t s, sched_group_t* group)
+{
+    GList* item;
+    for (item = g_queue_peek_head_link(group->jobs); item != NULL; item = g_list_next(item)) {
+        if (sched_headroom(s, (sched_job_t*)item->data) > 0) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+
+// Take the copy out of the queue, together with those that can go
+// in the same native bulk copy as long as the limits allow
+static GPtrArray* sched_batch(gfalt_scheduler_t s, sched_group_t* group, GList* first_item)
+{
+    sched_job_t* first = (sched_job_t*)first_item->data;
+    GPtrArray* batch = g_ptr_array_new();
+    int max = 1;
+
+    if (first->native_bulk) {
+        max = MIN(sched_headroom(s, first), s->limits[GFALT_SCHEDULER_MAX_ACTIVE] - (int)s->active);
+        if (s->limits[GFALT_SCHEDULER_MAX_BATCH] > 0 && max > s->limits[GFALT_SCHEDULER_MAX_BATCH]) {
+            max = s->limits[GFALT_SCHEDULER_MAX_BATCH];
+        }
+    }
+
+    // Copies before first_item are over their limits, so they are not on the same link
+    GList* item = first_item;
+    while (item != NULL && (int)batch->len < max) {
+        GList* next = g_list_next(item);
+        sched_job_t* job = (sched_job_t*)item->data;
+        if (item == first_item ||
+            (job->native_bulk && strcmp(job->link, first->link) == 0 &&
+             gfalt_params_equal(job->params, first->params))) {
+            g_ptr_array_add(batch, job);
+            g_queue_delete_link(group->jobs, item);
+        }
+        item = next;
+    }
+    return batch;
+}
+
+
+// Deficit round robin over the groups, where each copy costs one
+// Must be called with the lock held. Returns NULL if nothing can start right now.
+static GPtrArray* sched_pick(gfalt_scheduler_t s)
+{
+    guint ngroups = s->groups->len;
+
+    if (s->paused || s->queued == 0 || s->active >= (guint)s->limits[GFALT_SCHEDULER_MAX_ACTIVE]) {
+        return NULL;
+    }
+
+    // Each pass adds the weight to the groups in debt, so this ends
+    while (TRUE) {
+        gboolean eligible = FALSE;
+        guint k;
+        for (k = 0; k < ngroups; ++k) {
+            sched_group_t* group = (sched_group_t*)g_ptr_array_index(s->groups, s->cursor);
+            GList* item = sched_group_pick(s, group);
+            if (item != NULL) {
+                eligible = TRUE;
+                if (group->deficit <= 0) {
+                    group->deficit += group->weight;
+                }
+                if (group->deficit > 0) {
+                    GPtrArray* batch = sched_batch(s, group, item);
+                    group->deficit -= batch->len;
+                    if (group->deficit <= 0) {
+                        s->cursor = (s->cursor + 1) % ngroups;
+                    }
+                    return batch;
+                }
+            }
+            else if (g_queue_is_empty(group->jobs)) {
+                // Idle groups do not accumulate credit
+                group->deficit = 0;
+            }
+            s->cursor = (s->cursor + 1) % ngroups;
+        }
+        if (!eligible) {
+            return NULL;
+        }
+    }
+}
+
+
+static void sched_account(gfalt_scheduler_t s, GPtrArray* batch, int delta)
+{
+    guint i;
+    for (i = 0; i < batch->len; ++i) {
+        sched_job_t* job = (sched_job_t*)g_ptr_array_index(batch, i);
+        sched_add(s->src_active, job->src_se, delta);
+        sched_add(s->dst_active, job->dst_se, delta);
+        sched_add(s->link_active, job->link, delta);
+    }
+}
+
+
+static void sched_run(gfalt_scheduler_t s, GPtrArray* batch)
+{
+    sched_job_t* first = (sched_job_t*)g_ptr_array_index(batch, 0);
+    guint i;
+
+    if (gfal2_is_canceled(s->context)) {
+        for (i = 0; i < batch->len; ++i) {
+            sched_job_t* job = (sched_job_t*)g_ptr_array_index(batch, i);
+            gfal2_set_error(&job->error, scope_scheduler_domain(), ECANCELED, __func__, "Transfer canceled");
+        }
+        return;
+    }
+
+    if (batch->len == 1) {
+        if (first->checksum == NULL ||
+            gfal_transfer_set_checksum(first->params, first->checksum, &first->error) == 0) {
+            gfalt_copy_file(s->context, first->params, first->src, first->dst, &first->error);
+        }
+        return;
+    }
+
+    gfal2_log(G_LOG_LEVEL_DEBUG, "Scheduler: %u copies over %s dispatched as a bulk copy", batch->len, first->link);
+
+    const char** srcs = g_new0(const char*, batch->len + 1);
+    const char** dsts = g_new0(const char*, batch->len + 1);
+    const char** checksums = NULL;
+    for (i = 0; i < batch->len; ++i) {
+        sched_job_t* job = (sched_job_t*)g_ptr_array_index(batch, i);
+        srcs[i] = job->src;
+        dsts[i] = job->dst;
+        if (job->checksum) {
+            if (checksums == NULL) {
+                checksums = g_new0(const char*, batch->len + 1);
+            }
+            checksums[i] = job->checksum;
+        }
+    }
+
+    // The parameters of all the copies in the batch are the same
+    GError* op_error = NULL;
+    GError** file_errors = NULL;
+    gfalt_copy_bulk(s->context, first->params, batch->len, srcs, dsts, checksums, &op_error, &file_errors);
+
+    for (i = 0; i < batch->len; ++i) {
+        sched_job_t* job = (sched_job_t*)g_ptr_array_index(batch, i);
+        if (file_errors && file_errors[i]) {
+            job->error = file_errors[i];
+        }
+        else if (op_error) {
+            job->error = g_error_copy(op_error);
+        }
+    }
+
+    g_clear_error(&op_error);
+    g_free(file_errors);
+    g_free(checksums);
+    g_free(dsts);
+    g_free(srcs);
+}
+
+
+static void sched_complete(gfalt_scheduler_t s, sched_job_t* job)
+{
+    if (job->error) {
+        gfal2_log(G_LOG_LEVEL_DEBUG, "Scheduler: copy %" G_GUINT64_FORMAT " failed: %s", job->id,
+                job->error->message);
+    }
+    if (job->done) {
+        job->done(s, job->id, job->src, job->dst, job->error, job->user_data);
+    }
+    sched_job_free(job);
+}
+
+
+// Scheduler whose worker is this thread, if any
+static __thread gfalt_scheduler_t sched_current = NULL;
+
+
+static gpointer sched_worker(gpointer data)
+{
+    gfalt_scheduler_t s = (gfalt_scheduler_t)data;
+    guint i;
+
+    sched_current = s;
+    g_mutex_lock(s->lock);
+    while (!s->shutdown) {
+        GPtrArray* batch = sched_pick(s);
+        if (batch == NULL) {
+            ++s->idle_workers;
+            g_cond_wait(s->cond, s->lock);
+            --s->idle_workers;
+            continue;
+        }
+
+        s->queued -= batch->len;
+        s->active += batch->len;
+        s->running += batch->len;
+        sched_account(s, batch, 1);
+        g_mutex_unlock(s->lock);
+
+        sched_run(s, batch);
+
+        g_mutex_lock(s->lock);
+        sched_account(s, batch, -1);
+        s->active -= batch->len;
+        for (i = 0; i < batch->len; ++i) {
+            if (((sched_job_t*)g_ptr_array_index(batch, i))->error) {
+                ++s->failed;
+            }
+        }
+        g_cond_broadcast(s->cond);
+        g_mutex_unlock(s->lock);
+
+        // Without the lock, so the callbacks can submit more copies
+        guint ndone = batch->len;
+        for (i = 0; i < ndone; ++i) {
+            sched_complete(s, (sched_job_t*)g_ptr_array_index(batch, i));
+        }
+        g_ptr_array_free(batch, TRUE);
+
+        g_mutex_lock(s->lock);
+        s->running -= ndone;
+        if (s->running == 0 && (s->queued == 0 || s->paused)) {
+            g_cond_broadcast(s->idle);
+        }
+    }
+    g_mutex_unlock(s->lock);
+    return NULL;
+}
+
+
+// Start a worker if there are more copies queued than idle workers
+// Must be called with the lock held
+static int sched_spawn(gfalt_scheduler_t s, GError** err)
+{
+    if ((guint)s->idle_workers >= s->queued ||
+        s->workers->len >= (guint)s->limits[GFALT_SCHEDULER_MAX_ACTIVE]) {
+        return 0;
+    }
+
+    GError* tmp_err = NULL;
+    GThread* worker = g_thread_create(sched_worker, s, TRUE, &tmp_err);
+    if (worker == NULL) {
+        if (s->workers->len == 0) {
+            gfal2_propagate_prefixed_error(err, tmp_err, __func__);
+            return -1;
+        }
+        // The existing workers will take care
+        gfal2_log(G_LOG_LEVEL_WARNING, "Could only start %u scheduler workers: %s", s->workers->len,
+                tmp_err->message);
+        g_error_free(tmp_err);
+        return 0;
+    }
+    g_ptr_array_add(s->workers, worker);
+    return 0;
+}
+
+
+gfalt_scheduler_t gfalt_scheduler_new(gfal2_context_t context, GError** err)
+{
+    g_return_val_err_if_fail(context, NULL, err, "[gfalt_scheduler_new] invalid context");
+
+    gfalt_scheduler_t s = g_new0(struct _gfalt_scheduler, 1);
+    s->context = context;
+    s->lock = g_mutex_new();
+    s->cond = g_cond_new();
+    s->idle = g_cond_new();
+    s->groups = g_ptr_array_new();
+    s->groups_by_name = g_hash_table_new(g_str_hash, g_str_equal);
+    s->src_active = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    s->dst_active = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    s->link_active = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    s->workers = g_ptr_array_new();
+
+    s->limits[GFALT_SCHEDULER_MAX_ACTIVE] = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP,
+            "SCHEDULER_MAX_ACTIVE", SCHEDULER_DEFAULT_MAX_ACTIVE);
+    s->limits[GFALT_SCHEDULER_MAX_PER_SOURCE] = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP,
+            "BULK_COPY_MAX_PER_SOURCE", SCHEDULER_DEFAULT_MAX_PER_SOURCE);
+    s->limits[GFALT_SCHEDULER_MAX_PER_DESTINATION] = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP,
+            "BULK_COPY_MAX_PER_DESTINATION", SCHEDULER_DEFAULT_MAX_PER_DESTINATION);
+    s->limits[GFALT_SCHEDULER_MAX_PER_LINK] = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP,
+            "SCHEDULER_MAX_PER_LINK", SCHEDULER_DEFAULT_MAX_PER_LINK);
+    s->limits[GFALT_SCHEDULER_MAX_BATCH] = gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP,
+            "SCHEDULER_MAX_BATCH", SCHEDULER_DEFAULT_MAX_BATCH);
+    if (s->limits[GFALT_SCHEDULER_MAX_ACTIVE] <= 0) {
+        s->limits[GFALT_SCHEDULER_MAX_ACTIVE] = 1;
+    }
+
+    sched_get_group(s, SCHEDULER_DEFAULT_GROUP);
+    return s;
+}
+
+
+void gfalt_scheduler_free(gfalt_scheduler_t s)
+{
+    if (s == NULL) {
+        return;
+    }
+    // It would wait for the very worker calling it
+    g_return_if_fail(sched_current != s);
+
+    GSList* canceled = NULL;
+    guint i;
+
+    g_mutex_lock(s->lock);
+    for (i = 0; i < s->groups->len; ++i) {
+        sched_group_t* group = (sched_group_t*)g_ptr_array_index(s->groups, i);
+        sched_job_t* job;
+        while ((job = (sched_job_t*)g_queue_pop_head(group->jobs)) != NULL) {
+            canceled = g_slist_prepend(canceled, job);
+        }
+    }
+    s->queued = 0;
+    s->shutdown = TRUE;
+    g_cond_broadcast(s->cond);
+    g_mutex_unlock(s->lock);
+
+    GSList* item;
+    canceled = g_slist_reverse(canceled);
+    for (item = canceled; item != NULL; item = g_slist_next(item)) {
+        sched_job_t* job = (sched_job_t*)item->data;
+        gfal2_set_error(&job->error, scope_scheduler_domain(), ECANCELED, __func__,
+                "Transfer canceled before starting");
+        sched_complete(s, job);
+    }
+    g_slist_free(canceled);
+
+    for (i = 0; i < s->workers->len; ++i) {
+        g_thread_join((GThread*)g_ptr_array_index(s->workers, i));
+    }
+    g_ptr_array_free(s->workers, TRUE);
+
+    for (i = 0; i < s->groups->len; ++i) {
+        sched_group_t* group = (sched_group_t*)g_ptr_array_index(s->groups, i);
+        g_queue_free(group->jobs);
+        g_free(group->name);
+        g_free(group);
+    }
+    g_ptr_array_free(s->groups, TRUE);
+    g_hash_table_destroy(s->groups_by_name);
+    g_hash_table_destroy(s->src_active);
+    g_hash_table_destroy(s->dst_active);
+    g_hash_table_destroy(s->link_active);
+    g_cond_free(s->idle);
+    g_cond_free(s->cond);
+    g_mutex_free(s->lock);
+    g_free(s);
+}
+
+
+int gfalt_scheduler_set_limit(gfalt_scheduler_t s, gfalt_scheduler_limit_t limit, int value, GError** err)
+{
+    g_return_val_err_if_fail(s, -1, err, "[gfalt_scheduler_set_limit] invalid scheduler");
+
+    if ((int)limit < GFALT_SCHEDULER_MAX_ACTIVE || limit > GFALT_SCHEDULER_MAX_BATCH || value < 0 ||
+        (limit == GFALT_SCHEDULER_MAX_ACTIVE && value == 0)) {
+        gfal2_set_error(err, scope_scheduler_domain(), EINVAL, __func__, "Invalid limit %d = %d", limit, value);
+        return -1;
+    }
+
+    g_mutex_lock(s->lock);
+    s->limits[limit] = value;
+    int ret = sched_spawn(s, err);
+    g_cond_broadcast(s->cond);
+    g_mutex_unlock(s->lock);
+    return ret;
+}
+
+
+int gfalt_scheduler_set_group_weight(gfalt_scheduler_t s, const char* group, guint weight, GError** err)
+{
+    g_return_val_err_if_fail(s && group, -1, err, "[gfalt_scheduler_set_group_weight] invalid value");
+
+    if (weight == 0) {
+        gfal2_set_error(err, scope_scheduler_domain(), EINVAL, __func__, "The weight of a group can not be 0");
+        return -1;
+    }
+
+    g_mutex_lock(s->lock);
+    sched_get_group(s, group)->weight = weight;
+    g_mutex_unlock(s->lock);
+    return 0;
+}
+
+
+guint64 gfalt_scheduler_submit(gfalt_scheduler_t s, gfalt_params_t params,
+        const char* src, const char* dst, const char* checksum,
+        const char* group, int priority,
+        gfalt_scheduler_done_func done, gpointer user_data, GError** err)
+{
+    g_return_val_err_if_fail(s && src && dst, 0, err, "invalid source or/and destination values");
+
+    sched_job_t* job = g_new0(sched_job_t, 1);
+    job->params = params ? gfalt_params_handle_copy(params, NULL) : gfalt_params_handle_new(NULL);
+    job->src = g_strdup(src);
+    job->dst = g_strdup(dst);
+    job->checksum = g_strdup(checksum);
+    job->src_se = gfal_bulk_get_endpoint(src);
+    job->dst_se = gfal_bulk_get_endpoint(dst);
+    job->link = g_strconcat(job->src_se, " => ", job->dst_se, NULL);
+    job->priority = priority;
+    job->done = done;
+    job->user_data = user_data;
+    // Outside of the lock, the plugins may take their time to answer
+    job->native_bulk = gfal_transfer_has_native_bulk(s->context, src, dst);
+
+    g_mutex_lock(s->lock);
+    if (s->shutdown) {
+        g_mutex_unlock(s->lock);
+        sched_job_free(job);
+        gfal2_set_error(err, scope_scheduler_domain(), ECANCELED, __func__, "The scheduler is being freed");
+        return 0;
+    }
+
+    sched_group_t* sched_group = sched_get_group(s, group ? group : SCHEDULER_DEFAULT_GROUP);
+    job->id = ++s->next_id;
+    sched_group_push(sched_group, job);
+    ++s->queued;
+
+    if (sched_spawn(s, err) < 0) {
+        g_queue_remove(sched_group->jobs, job);
+        --s->queued;
+        g_mutex_unlock(s->lock);
+        sched_job_free(job);
+        return 0;
+    }
+
+    guint64 id = job->id;
+    g_cond_broadcast(s->cond);
+    g_mutex_unlock(s->lock);
+    return id;
+}
+
+
+void gfalt_scheduler_pause(gfalt_scheduler_t s)
+{
+    g_mutex_lock(s->lock);
+    s->paused = TRUE;
+    if (s->running == 0) {
+        g_cond_broadcast(s->idle);
+    }
+    g_mutex_unlock(s->lock);
+}
+
+
+void gfalt_scheduler_resume(gfalt_scheduler_t s)
+{
+    g_mutex_lock(s->lock);
+    s->paused = FALSE;
+    g_cond_broadcast(s->cond);
+    g_mutex_unlock(s->lock);
+}
+
+
+int gfalt_scheduler_wait(gfalt_scheduler_t s, GError** err)
+{
+    g_return_val_err_if_fail(s, -1, err, "[gfalt_scheduler_wait] invalid scheduler");
+
+    if (sched_current == s) {
+        gfal2_set_error(err, scope_scheduler_domain(), EDEADLK, __func__,
+                "Can not wait for the scheduler from one of its done callbacks");
+        return -1;
+    }
+
+    g_mutex_lock(s->lock);
+    while (s->running > 0 || (s->queued > 0 && !s->paused)) {
+        g_cond_wait(s->idle, s->lock);
+    }
+    guint failed = s->failed;
+    s->failed = 0;
+    g_mutex_unlock(s->lock);
+
+    if (failed > 0) {
+        gfal2_set_error(err, scope_scheduler_domain(), EIO, __func__, "%u copies failed", failed);
+        return -1;
+    }
+    return 0;
+}
+
+
+void gfalt_scheduler_get_counts(gfalt_scheduler_t s, guint* queued, guint* running)
+{
+    g_mutex_lock(s->lock);
+    if (queued) {
+        *queued = s->queued;
+    }
+    if (running) {
+        *running = s->running;
+    }
+    g_mutex_unlock(s->lock);
+}
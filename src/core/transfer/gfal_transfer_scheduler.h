@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef GFAL_TRANSFER_SCHEDULER_H_
+#define GFAL_TRANSFER_SCHEDULER_H_
+
+#if !defined(__GFAL2_H_INSIDE__) && !defined(__GFAL2_BUILD__)
+#   warning "Direct inclusion of gfal2 headers is deprecated. Please, include only gfal_api.h or gfal_plugins_api.h"
+#endif
+
+#include <transfer/gfal_transfer.h>
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+    \addtogroup transfer_group
+    @{
+*/
+
+/**
+ * @brief Transfer scheduler
+ * Queues copies and runs them with a pool of workers, without going over the limits
+ * of active transfers per source storage, per destination storage and per link
+ * (source and destination pair). A storage is identified by its scheme, host and port.
+ *
+ * Each copy belongs to a group. Groups are served by weighted round robin (deficit
+ * round robin), so a group with a long queue does not starve the others. Inside
+ * a group, copies with a higher priority go first.
+ *
+ * Copies queued with equal parameters, over the same link, and supported
+ * by a plugin with native bulk copies are dispatched together with \ref gfalt_copy_bulk,
+ * as many as the limits allow. The rest are dispatched with \ref gfalt_copy_file.
+ */
+typedef struct _gfalt_scheduler* gfalt_scheduler_t;
+
+/**
+ * @brief Limits enforced by the scheduler
+ * 0 means no limit, except for GFALT_SCHEDULER_MAX_ACTIVE
+ */
+typedef enum {
+    GFALT_SCHEDULER_MAX_ACTIVE = 0,         /**< Number of copies running at the same time, those in a bulk copy included */
+    GFALT_SCHEDULER_MAX_PER_SOURCE,         /**< Active transfers reading from the same storage */
+    GFALT_SCHEDULER_MAX_PER_DESTINATION,    /**< Active transfers writing into the same storage */
+    GFALT_SCHEDULER_MAX_PER_LINK,           /**< Active transfers between the same source and destination */
+    GFALT_SCHEDULER_MAX_BATCH               /**< Transfers dispatched in a single native bulk copy */
+} gfalt_scheduler_limit_t;
+
+/**
+ * @brief Called when a copy finishes, from one of the workers
+ * @param id As returned by \ref gfalt_scheduler_submit
+ * @param error NULL on success. Owned by the scheduler.
+ */
+typedef void (*gfalt_scheduler_done_func)(gfalt_scheduler_t scheduler, guint64 id,
+        const char* src, const char* dst, const GError* error, gpointer user_data);
+
+/**
+ * Create a scheduler
+ * Limits are initialized from the configuration, CORE:SCHEDULER_MAX_ACTIVE,
+ * CORE:SCHEDULER_MAX_PER_LINK, CORE:SCHEDULER_MAX_BATCH, and
+ * CORE:BULK_COPY_MAX_PER_SOURCE and CORE:BULK_COPY_MAX_PER_DESTINATION.
+ * The context must outlive the scheduler.
+ */
+gfalt_scheduler_t gfalt_scheduler_new(gfal2_context_t context, GError** err);
+
+/**
+ * Free the scheduler
+ * Queued copies are not started, and completed with ECANCELED.
+ * Waits for the running ones. Use \ref gfal2_cancel to abort them.
+ * Must not be called from a done callback, it does nothing then.
+ */
+void gfalt_scheduler_free(gfalt_scheduler_t scheduler);
+
+/**
+ * Change a limit. Copies already running are not affected.
+ */
+int gfalt_scheduler_set_limit(gfalt_scheduler_t scheduler, gfalt_scheduler_limit_t limit,
+        int value, GError** err);
+
+/**
+ * Set the weight of a group, 1 by default
+ * A group with weight 2 gets twice as many copies started as one with weight 1,
+ * when both have copies waiting.
+ */
+int gfalt_scheduler_set_group_weight(gfalt_scheduler_t scheduler, const char* group,
+        guint weight, GError** err);
+
+/**
+ * Queue a copy
+ * @param params Parameters of the copy, or NULL for the defaults. They are copied,
+ *               so they can be modified or freed after this call. Their callbacks
+ *               may be called concurrently by different workers.
+ * @param checksum NULL, or the expected checksum as "type:value"
+ * @param group Group of the copy, NULL for the default one
+ * @param priority Higher goes first inside the group
+ * @param done Called when the copy finishes, can be NULL
+ * @return The identifier of the copy, 0 on error
+ */
+guint64 gfalt_scheduler_submit(gfalt_scheduler_t scheduler, gfalt_params_t params,
+        const char* src, const char* dst, const char* checksum,
+        const char* group, int priority,
+        gfalt_scheduler_done_func done, gpointer user_data, GError** err);
+
+/**
+ * Stop starting queued copies, i.e. to submit a batch at once
+ */
+void gfalt_scheduler_pause(gfalt_scheduler_t scheduler);
+
+/**
+ * Resume starting queued copies
+ */
+void gfalt_scheduler_resume(gfalt_scheduler_t scheduler);
+
+/**
+ * Wait until there are no queued nor running copies, or only queued ones while paused
+ * Fails with EDEADLK if called from a done callback.
+ * @return 0 if all the copies finished since the previous call succeeded, -1 otherwise
+ */
+int gfalt_scheduler_wait(gfalt_scheduler_t scheduler, GError** err);
+
+/**
+ * Number of queued and running copies
+ */
+void gfalt_scheduler_get_counts(gfalt_scheduler_t scheduler, guint* queued, guint* running);
+
+/**
+    @}
+*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GFAL_TRANSFER_SCHEDULER_H_ */
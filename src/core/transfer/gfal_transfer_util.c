@@ -18,12 +18,14 @@
  * limitations under the License.
  */
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <glib.h>
 #include <time.h>
 
 #include <transfer/gfal_transfer_internal.h>
 #include <common/gfal_error.h>
+#include <logger/gfal_trace.h>
 
 
 
@@ -72,6 +74,69 @@ static void init_event_quarks() {
 }
 
 
+// Event as built by plugin_trigger_event
+// The callbacks run while plugin_trigger_event is still on the stack, so the arguments
+// are kept as they are, and the description is only formatted when something needs it
+struct _gfalt_event_internal {
+    struct _gfalt_event event;
+    gint64 monotonic;
+    const char* fmt;
+    va_list args;
+    char buffer[512];
+    struct _gfalt_event_internal* previous;
+};
+
+// Events being delivered by this thread, innermost first.
+// The getters only look at the events of this list, so they are safe with any other event
+static __thread struct _gfalt_event_internal* gfalt_current_event = NULL;
+
+
+static struct _gfalt_event_internal* gfalt_event_find_internal(gfalt_event_t e)
+{
+    struct _gfalt_event_internal* internal;
+    for (internal = gfalt_current_event; internal != NULL; internal = internal->previous) {
+        if (&internal->event == e) {
+            return internal;
+        }
+    }
+    return NULL;
+}
+
+
+static const char* gfalt_event_format(struct _gfalt_event_internal* internal)
+{
+    if (internal->event.description == NULL) {
+        vsnprintf(internal->buffer, sizeof(internal->buffer), internal->fmt, internal->args);
+        internal->event.description = internal->buffer;
+    }
+    return internal->event.description;
+}
+
+
+const char* gfalt_event_get_description(gfalt_event_t e)
+{
+    if (e->description) {
+        return e->description;
+    }
+    struct _gfalt_event_internal* internal = gfalt_event_find_internal(e);
+    if (internal == NULL) {
+        return NULL;
+    }
+    return gfalt_event_format(internal);
+}
+
+
+gint64 gfalt_event_get_monotonic_time(gfalt_event_t e)
+{
+    struct _gfalt_event_internal* internal = gfalt_event_find_internal(e);
+    if (internal != NULL) {
+        return internal->monotonic;
+    }
+    // Not built by gfal2, estimated from the wall clock timestamp
+    return g_get_monotonic_time() - (g_get_real_time() - e->timestamp * 1000);
+}
+
+
 static void plugin_trigger_event_callback(gpointer data, gpointer user_data)
 {
 
@@ -83,44 +148,99 @@ static void plugin_trigger_event_callback(gpointer data, gpointer user_data)
 }
 
 
+static const char* gfalt_event_side_str(gfal_event_side_t side)
+{
+    switch (side) {
+        case GFAL_EVENT_SOURCE:
+            return "SOURCE";
+        case GFAL_EVENT_DESTINATION:
+            return "DESTINATION";
+        default:
+            return "BOTH";
+    }
+}
+
+
+// Pairs of ENTER and EXIT events are traced as spans, named after the stage.
+// Both events may come from different threads, so the spans are keyed by the transfer parameters
+static void gfalt_event_trace(gfalt_params_t params, gfal_event_side_t side, GQuark stage)
+{
+    const char* side_str = gfalt_event_side_str(side);
+
+    if (stage == GFAL_EVENT_PREPARE_ENTER) {
+        gfal2_trace_begin_keyed(side_str, "PREPARE", params);
+    }
+    else if (stage == GFAL_EVENT_TRANSFER_ENTER) {
+        gfal2_trace_begin_keyed(side_str, "TRANSFER", params);
+    }
+    else if (stage == GFAL_EVENT_CHECKSUM_ENTER) {
+        gfal2_trace_begin_keyed(side_str, "CHECKSUM", params);
+    }
+    else if (stage == GFAL_EVENT_CLOSE_ENTER) {
+        gfal2_trace_begin_keyed(side_str, "CLOSE", params);
+    }
+    else if (stage == GFAL_EVENT_PREPARE_EXIT) {
+        gfal2_trace_end_keyed(side_str, "PREPARE", params);
+    }
+    else if (stage == GFAL_EVENT_TRANSFER_EXIT) {
+        gfal2_trace_end_keyed(side_str, "TRANSFER", params);
+    }
+    else if (stage == GFAL_EVENT_CHECKSUM_EXIT) {
+        gfal2_trace_end_keyed(side_str, "CHECKSUM", params);
+    }
+    else if (stage == GFAL_EVENT_CLOSE_EXIT) {
+        gfal2_trace_end_keyed(side_str, "CLOSE", params);
+    }
+}
+
+
 int plugin_trigger_event(gfalt_params_t params, GQuark domain, gfal_event_side_t side,
         GQuark stage, const char* fmt, ...)
 {
-    char buffer[512] = { 0 };
-    va_list msg_args;
-    va_start(msg_args, fmt);
-    if (fmt) {
-        vsnprintf(buffer, sizeof(buffer), fmt, msg_args);
+    gboolean log_enabled = gfal2_log_get_level() >= G_LOG_LEVEL_MESSAGE;
+
+    gfalt_event_trace(params, side, stage);
+
+    // Nobody is listening
+    if (params->event_callbacks == NULL && !log_enabled) {
+        return 0;
     }
-    va_end(msg_args);
 
-    struct _gfalt_event event;
-    GTimeVal tmst;
+    struct _gfalt_event_internal internal;
+    internal.event.domain = domain;
+    internal.event.side = side;
+    internal.event.stage = stage;
+    internal.event.timestamp = g_get_real_time() / 1000;
+    internal.event.description = NULL;
+    internal.monotonic = g_get_monotonic_time();
+    internal.fmt = fmt;
+    internal.buffer[0] = '\0';
 
-    g_get_current_time(&tmst);
+    // Callbacks that did not ask for lazy descriptions may read the field directly
+    va_list args;
+    va_start(args, fmt);
+    va_copy(internal.args, args);
+    if (fmt == NULL) {
+        internal.event.description = internal.buffer;
+    }
+    else if (log_enabled || !params->lazy_event_description) {
+        gfalt_event_format(&internal);
+    }
 
-    event.domain = domain;
-    event.side = side;
-    event.stage = stage;
-    event.timestamp = tmst.tv_sec * 1000 + tmst.tv_usec / 1000;
-    event.description = buffer;
+    internal.previous = gfalt_current_event;
+    gfalt_current_event = &internal;
 
-    g_slist_foreach(params->event_callbacks, plugin_trigger_event_callback, &event);
+    g_slist_foreach(params->event_callbacks, plugin_trigger_event_callback, &internal.event);
 
-    const char* side_str;
-    switch (side) {
-        case GFAL_EVENT_SOURCE:
-            side_str = "SOURCE";
-            break;
-        case GFAL_EVENT_DESTINATION:
-            side_str = "DESTINATION";
-            break;
-        default:
-            side_str = "BOTH";
+    gfalt_current_event = internal.previous;
+    va_end(internal.args);
+    va_end(args);
+
+    if (log_enabled) {
+        gfal2_log(G_LOG_LEVEL_MESSAGE, "Event triggered: %s %s %s %s", gfalt_event_side_str(side),
+                g_quark_to_string(domain), g_quark_to_string(stage), internal.event.description);
     }
 
-    gfal2_log(G_LOG_LEVEL_MESSAGE, "Event triggered: %s %s %s %s", side_str,
-            g_quark_to_string(domain), g_quark_to_string(stage), buffer);
     return 0;
 }
 
@@ -337,6 +337,18 @@ ssize_t gfal_plugin_file_pwrite(plugin_handle plugin_data, gfal_file_handle fh,
     return ret;
 }
 
+/*
+ * map to the local fsync call
+ */
+int gfal_plugin_file_fsync(plugin_handle plugin_data, gfal_file_handle fh, GError **err)
+{
+    errno = 0;
+    const int ret = fsync(GPOINTER_TO_INT(gfal_file_handle_get_fdesc(fh)));
+    if (ret < 0)
+        gfal_plugin_file_report_error(__func__, err);
+    return ret;
+}
+
 int gfal_plugin_file_close(plugin_handle plugin_data, gfal_file_handle fh, GError **err)
 {
     errno = 0;
@@ -595,6 +607,7 @@ gfal_plugin_interface gfal_plugin_init(gfal2_context_t handle, GError **err)
     file_plugin.preadG = &gfal_plugin_file_pread;
     file_plugin.writeG = &gfal_plugin_file_write;
     file_plugin.pwriteG = &gfal_plugin_file_pwrite;
+    file_plugin.fsyncG = &gfal_plugin_file_fsync;
     file_plugin.chmodG = &gfal_plugin_file_chmod;
     file_plugin.lseekG = &gfal_plugin_file_lseek;
     file_plugin.unlinkG = &gfal_plugin_file_unlink;
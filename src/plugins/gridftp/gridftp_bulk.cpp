@@ -77,6 +77,7 @@ struct GridFTPBulkData {
 
 struct GridFTPBulkPerformance {
     std::string source, destination;
+    gfal2_context_t context;
     gfalt_params_t params;
     bool ipv6;
     time_t start_time;
@@ -169,8 +170,8 @@ static void gridftp_bulk_begin_cb(void * user_specific,
     plugin_trigger_event(pd->params, GSIFTP_BULK_DOMAIN, GFAL_EVENT_NONE,
             GFAL_EVENT_TRANSFER_ENTER,
             "(%s) %s => (%s) %s",
-            return_host_and_port(source_url, pd->ipv6).c_str(), source_url,
-            return_host_and_port(dest_url, pd->ipv6).c_str(), dest_url);
+            return_host_and_port(pd->context, source_url, pd->ipv6).c_str(), source_url,
+            return_host_and_port(pd->context, dest_url, pd->ipv6).c_str(), dest_url);
     plugin_trigger_event(pd->params, GFAL_GRIDFTP_DOMAIN_GSIFTP,
         GFAL_EVENT_NONE, GFAL_EVENT_TRANSFER_TYPE,
         "%s", GFAL_TRANSFER_TYPE_PUSH);
@@ -272,6 +273,7 @@ int gridftp_pipeline_transfer(plugin_handle plugin_data,
     pairs->started[pairs->index] = true;
 
     GridFTPBulkPerformance perf;
+    perf.context = context;
     perf.params = pairs->params;
     perf.ipv6 = gfal2_get_opt_boolean_with_default(context, GRIDFTP_CONFIG_GROUP, GRIDFTP_CONFIG_IPV6, false);
     perf.plugin = &throughput_plugin;
@@ -390,15 +392,75 @@ int gridftp_pipeline_transfer(plugin_handle plugin_data,
 }
 
 
+// Checksum the given files of one side with a single bulk request,
+// and validate them against the expected checksums (or remember them if there were none)
+static
+void gridftp_bulk_checksum(plugin_handle plugin_data, GridFTPBulkData* pairs,
+        const std::vector<size_t>& indexes, gfal_event_side_t side, const char* chk_type,
+        GError** file_errors)
+{
+    const size_t nfiles = indexes.size();
+    if (nfiles == 0)
+        return;
+
+    const char* const* urls = (side == GFAL_EVENT_SOURCE) ? pairs->srcs : pairs->dsts;
+    const size_t chk_len = 128;
+    std::vector<const char*> subset(nfiles);
+    std::vector<char> values(nfiles * chk_len, '\0');
+    std::vector<char*> buffers(nfiles);
+    std::vector<GError*> errors(nfiles, NULL);
+
+    for (size_t k = 0; k < nfiles; ++k) {
+        subset[k] = urls[indexes[k]];
+        buffers[k] = &values[k * chk_len];
+        plugin_trigger_event(pairs->params, GSIFTP_BULK_DOMAIN, side, GFAL_EVENT_CHECKSUM_ENTER,
+                "%s", subset[k]);
+    }
+
+    gfal_gridftp_checksum_listG(plugin_data, nfiles, subset.data(), chk_type, buffers.data(), chk_len,
+            errors.data());
+
+    for (size_t k = 0; k < nfiles; ++k) {
+        size_t i = indexes[k];
+        if (errors[k] != NULL) {
+            file_errors[i] = errors[k];
+            pairs->errn[i] = errors[k]->code;
+        }
+        else if (pairs->checksums[i].empty()) {
+            pairs->checksums[i] = buffers[k];
+        }
+        else if (gfal_compare_checksums(pairs->checksums[i].c_str(), buffers[k], chk_len) != 0) {
+            if (side == GFAL_EVENT_SOURCE) {
+                gfalt_set_error(&(file_errors[i]), GSIFTP_BULK_DOMAIN, EIO, __func__,
+                        GFALT_ERROR_SOURCE, GFALT_ERROR_CHECKSUM_MISMATCH,
+                        "User checksum and source checksum do not match: %s != %s",
+                        pairs->checksums[i].c_str(), buffers[k]);
+            }
+            else {
+                gfalt_set_error(&(file_errors[i]), GSIFTP_BULK_DOMAIN, EIO, __func__,
+                        GFALT_ERROR_DESTINATION, GFALT_ERROR_CHECKSUM_MISMATCH,
+                        "Destination checksum do not match: %s != %s",
+                        pairs->checksums[i].c_str(), buffers[k]);
+            }
+            pairs->errn[i] = EIO;
+        }
+
+        plugin_trigger_event(pairs->params, GSIFTP_BULK_DOMAIN, side, GFAL_EVENT_CHECKSUM_EXIT,
+                "%s", subset[k]);
+    }
+}
+
+
 static
 int gridftp_bulk_check_sources(plugin_handle plugin_data, gfal2_context_t context,
         GridFTPBulkData* pairs, GError** file_errors)
 {
     struct stat st;
-    int nfailed = 0, ret = 0;
-    char chk_type[32] = {0}, chk_value[128], dummy[1];
+    int nfailed = 0;
+    char chk_type[32] = {0}, dummy[1];
     gfalt_checksum_mode_t checksum_mode = gfalt_get_checksum(pairs->params,
         chk_type, sizeof(chk_type), dummy, 0, NULL);
+    std::vector<size_t> to_checksum;
 
     for (size_t i = 0; i < pairs->nbfiles; ++i) {
         if (gfal2_is_canceled(context)) {
@@ -419,36 +481,14 @@ int gridftp_bulk_check_sources(plugin_handle plugin_data, gfal2_context_t contex
             pairs->fsize[i] = st.st_size;
 
             if (checksum_mode & GFALT_CHECKSUM_SOURCE) {
-                plugin_trigger_event(pairs->params, GSIFTP_BULK_DOMAIN,
-                                     GFAL_EVENT_SOURCE, GFAL_EVENT_CHECKSUM_ENTER,
-                                     "%s", pairs->srcs[i]);
-
-                ret = gfal_gridftp_checksumG(plugin_data, pairs->srcs[i], chk_type,
-                        chk_value, sizeof(chk_value), 0, 0, &(file_errors[i]));
-                if (ret == 0) {
-                    if (!pairs->checksums[i].empty()) {
-                        if (gfal_compare_checksums(pairs->checksums[i].c_str(), chk_value, sizeof(chk_value)) != 0) {
-                            gfalt_set_error(&(file_errors[i]), GSIFTP_BULK_DOMAIN, EIO,
-                                    GFALT_ERROR_SOURCE, GFALT_ERROR_CHECKSUM_MISMATCH,
-                                    __func__, "User checksum and source checksum do not match: %s != %s",
-                                    pairs->checksums[i].c_str(), chk_value);
-                            pairs->errn[i] = EIO;
-                        }
-                    }
-                    else {
-                        pairs->checksums[i] = chk_value;
-                    }
-                }
-                else {
-                    pairs->errn[i] = file_errors[i]->code;
-                }
-
-                plugin_trigger_event(pairs->params, GSIFTP_BULK_DOMAIN,
-                        GFAL_EVENT_SOURCE, GFAL_EVENT_CHECKSUM_EXIT, "%s",
-                        pairs->srcs[i]);
+                to_checksum.push_back(i);
             }
         }
+    }
 
+    gridftp_bulk_checksum(plugin_data, pairs, to_checksum, GFAL_EVENT_SOURCE, chk_type, file_errors);
+
+    for (size_t i = 0; i < pairs->nbfiles; ++i) {
         if (file_errors[i] != NULL)
             ++nfailed;
     }
@@ -529,17 +569,19 @@ static
 int gridftp_bulk_close(plugin_handle plugin_data,
         gfal2_context_t context, GridFTPBulkData* pairs, GError** file_errors)
 {
-    int nfailed = 0, ret = 0;
+    int nfailed = 0;
     struct stat st;
-    char chk_type[32] = {0}, chk_value[128], dummy[1];
+    char chk_type[32] = {0}, dummy[1];
     gfalt_checksum_mode_t checksum_mode = gfalt_get_checksum(pairs->params,
         chk_type, sizeof(chk_type), dummy, 0, NULL);
+    std::vector<size_t> checked, to_checksum;
 
     plugin_trigger_event(pairs->params, GSIFTP_BULK_DOMAIN,
             GFAL_EVENT_NONE, GFAL_EVENT_CLOSE_ENTER, "");
 
     for (size_t i = 0; i < pairs->nbfiles; ++i) {
         if (pairs->errn[i] == 0) {
+            checked.push_back(i);
             if (gfal2_is_canceled(context)) {
                 gfal2_set_error(&(file_errors[i]), GSIFTP_BULK_DOMAIN, EINTR,
                         __func__, "Operation canceled");
@@ -558,43 +600,19 @@ int gridftp_bulk_close(plugin_handle plugin_data,
                     pairs->errn[i] = EIO;
                 }
                 else if (checksum_mode & GFALT_CHECKSUM_TARGET) {
-                    plugin_trigger_event(pairs->params, GSIFTP_BULK_DOMAIN,
-                            GFAL_EVENT_DESTINATION, GFAL_EVENT_CHECKSUM_ENTER, "%s",
-                            pairs->dsts[i]);
-
-                    ret = gfal_gridftp_checksumG(plugin_data, pairs->dsts[i],
-                            chk_type, chk_value, sizeof(chk_value), 0, 0, &(file_errors[i]));
-                    if (ret == 0) {
-                        if (!pairs->checksums[i].empty()) {
-                            if (gfal_compare_checksums(
-                                    pairs->checksums[i].c_str(), chk_value,
-                                    sizeof(chk_value)) != 0) {
-                                gfalt_set_error(&(file_errors[i]), GSIFTP_BULK_DOMAIN, EIO, __func__,
-                                        GFALT_ERROR_DESTINATION, GFALT_ERROR_CHECKSUM_MISMATCH,
-                                        "Destination checksum do not match: %s != %s",
-                                        pairs->checksums[i].c_str(), chk_value);
-                                pairs->errn[i] = EIO;
-                            }
-                        }
-                        else {
-                            pairs->checksums[i] = chk_value;
-                        }
-                    }
-                    else {
-                        pairs->errn[i] = file_errors[i]->code;
-                    }
-
-                    plugin_trigger_event(pairs->params, GSIFTP_BULK_DOMAIN,
-                            GFAL_EVENT_DESTINATION, GFAL_EVENT_CHECKSUM_EXIT, "%s",
-                            pairs->srcs[i]);
+                    to_checksum.push_back(i);
                 }
             }
-
-            if (file_errors[i] != NULL)
-                ++nfailed;
         }
     }
 
+    gridftp_bulk_checksum(plugin_data, pairs, to_checksum, GFAL_EVENT_DESTINATION, chk_type, file_errors);
+
+    for (size_t i : checked) {
+        if (file_errors[i] != NULL)
+            ++nfailed;
+    }
+
     plugin_trigger_event(pairs->params, GSIFTP_BULK_DOMAIN,
                 GFAL_EVENT_NONE, GFAL_EVENT_CLOSE_EXIT, "");
     return nfailed;
@@ -45,75 +45,26 @@
 static const GQuark GFAL_GRIDFTP_SCOPE_FILECOPY = g_quark_from_string("GridFTPFileCopyModule::FileCopy");
 const GQuark GFAL_GRIDFTP_DOMAIN_GSIFTP = g_quark_from_string("GSIFTP");
 
-/*IPv6 compatible lookup*/
-std::string lookup_host(const char *host, bool ipv6_enabled, bool *got_ipv6)
+/*IPv6 compatible lookup, shares the DNS cache of the copy resolution*/
+std::string lookup_host(gfal2_context_t context, const char *host, bool ipv6_enabled, bool *got_ipv6)
 {
-    struct addrinfo hints, *addresses = NULL;
-    int errcode;
-    char addrstr[100] = { 0 };
-    char ip4str[16] = { 0 };
-    char ip6str[46] = { 0 };
-    void *ptr = NULL;
-
-    if (!host) {
-        return std::string("cant.be.resolved");
-    }
-
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = PF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_flags |= AI_CANONNAME;
-
-    errcode = getaddrinfo(host, NULL, &hints, &addresses);
-    if (errcode != 0) {
-        return std::string("cant.be.resolved");
-    }
+    gboolean has_ipv6 = FALSE;
+    char* address = gfal2_resolve_dns_to_address(context, host, ipv6_enabled, &has_ipv6);
 
     if (got_ipv6) {
-        *got_ipv6 = false;
-    }
-
-    struct addrinfo *i = addresses;
-    while (i) {
-        inet_ntop(i->ai_family, i->ai_addr->sa_data, addrstr, sizeof(addrstr));
-
-        switch (i->ai_family) {
-        case AF_INET:
-            ptr = &((struct sockaddr_in *) i->ai_addr)->sin_addr;
-            if (ptr) {
-                inet_ntop(i->ai_family, ptr, ip4str, sizeof(ip4str));
-            }
-            break;
-        case AF_INET6:
-            ptr = &((struct sockaddr_in6 *) i->ai_addr)->sin6_addr;
-            if (ptr) {
-                inet_ntop(i->ai_family, ptr, ip6str, sizeof(ip6str));
-                if (got_ipv6) {
-                    *got_ipv6 = true;
-                }
-            }
-            break;
-        }
-        i = i->ai_next;
-    }
-
-    if (addresses) {
-        freeaddrinfo(addresses);
-    }
-
-    if (ipv6_enabled && ip6str[0]) {
-        return std::string("[").append(ip6str).append("]");
-    }
-    else if (ip4str[0]) {
-        return std::string(ip4str);
+        *got_ipv6 = has_ipv6;
     }
-    else {
+    if (!address) {
         return std::string("cant.be.resolved");
     }
+
+    std::string result(address);
+    g_free(address);
+    return result;
 }
 
 
-std::string return_host_and_port(const std::string &uri, gboolean use_ipv6)
+std::string return_host_and_port(gfal2_context_t context, const std::string &uri, gboolean use_ipv6)
 {
     GError* error = NULL;
     gfal2_uri *parsed = gfal2_parse_uri(uri.c_str(), &error);
@@ -121,12 +72,24 @@ std::string return_host_and_port(const std::string &uri, gboolean use_ipv6)
         throw Gfal::CoreException(error);
     }
     std::ostringstream str;
-    str << lookup_host(parsed->host, use_ipv6, NULL) << ":" << parsed->port;
+    str << lookup_host(context, parsed->host, use_ipv6, NULL) << ":" << parsed->port;
     gfal2_free_uri(parsed);
     return str.str();
 }
 
 
+// Feed the outcome of the transfer back into the DNS alias selection
+static void report_resolved_endpoints(gboolean resolve_dns, const char* src, const char* dst,
+        gboolean success, time_t start, globus_off_t transferred)
+{
+    if (resolve_dns) {
+        double elapsed = difftime(time(NULL), start);
+        gfal2_resolve_dns_report(src, success, transferred, elapsed);
+        gfal2_resolve_dns_report(dst, success, transferred, elapsed);
+    }
+}
+
+
 // return 1 if deleted something
 int gridftp_filecopy_delete_existing(GridFTPModule* module,
         gfalt_params_t params, const char * url)
@@ -253,9 +216,9 @@ struct CallbackHandler {
 
     CallbackHandler(gfal2_context_t context, gfalt_params_t params,
             GridFTPRequestState* req, const char* src, const char* dst,
-            size_t src_size):
+            size_t src_size, globus_off_t* transferred):
                 params(params), req(req), src(src), dst(dst), start_time(0), timeout_value(0),
-                timeout_time(0), timer_pthread(0), source_size(src_size)
+                timeout_time(0), timer_pthread(0), source_size(src_size), transferred(transferred)
     {
         timeout_value = gfal2_get_opt_integer_with_default(context,
                     GRIDFTP_CONFIG_GROUP, GRIDFTP_CONFIG_TRANSFER_PERF_TIMEOUT, 180);
@@ -290,6 +253,8 @@ struct CallbackHandler {
     time_t timeout_time;
     pthread_t timer_pthread;
     globus_off_t source_size;
+    // Last amount reported by the performance markers
+    globus_off_t* transferred;
 };
 
 
@@ -303,6 +268,7 @@ void gsiftp_3rd_callback(void* user_args, globus_gass_copy_handle_t* handle,
     status.average_baudrate = (size_t) avg_throughput;
     status.instant_baudrate = (size_t) throughput;
     status.transfer_time = (time(NULL) - args->start_time);
+    *args->transferred = total_bytes;
 
     plugin_trigger_monitor(args->params, &status, args->src, args->dst);
 
@@ -384,7 +350,7 @@ void gridftp_do_copy_inner(GridFTPModule* module, GridFTPFactory* factory,
 static
 void gridftp_do_copy(GridFTPModule* module, GridFTPFactory* factory,
     gfalt_params_t params, const char* src, const char* dst,
-    GridFTPRequestState& req, time_t timeout)
+    GridFTPRequestState& req, time_t timeout, globus_off_t* transferred)
 {
     if (strncmp(src, "ftp:", 4) == 0 || strncmp(dst, "ftp:", 4) == 0) {
         gfal2_log(G_LOG_LEVEL_DEBUG,
@@ -392,7 +358,7 @@ void gridftp_do_copy(GridFTPModule* module, GridFTPFactory* factory,
         gridftp_do_copy_inner(module, factory, params, src, dst, req, timeout);
     }
     else {
-        CallbackHandler callback_handler(factory->get_gfal2_context(), params, &req, src, dst, 0);
+        CallbackHandler callback_handler(factory->get_gfal2_context(), params, &req, src, dst, 0, transferred);
         gfal2_log(G_LOG_LEVEL_DEBUG,
                   "[GridFTPFileCopyModule::filecopy] start gridftp transfer with performance markers enabled (timeout %d)",
                   callback_handler.timeout_value);
@@ -405,7 +371,7 @@ void gridftp_do_copy(GridFTPModule* module, GridFTPFactory* factory,
 static
 int gridftp_filecopy_copy_file_internal(GridFTPModule* module,
         GridFTPFactory * factory, gfalt_params_t params, const char* src,
-        const char* dst)
+        const char* dst, globus_off_t* transferred)
 {
     GError * tmp_err = NULL;
 
@@ -461,7 +427,7 @@ int gridftp_filecopy_copy_file_internal(GridFTPModule* module,
     }
 
     try {
-        gridftp_do_copy(module, factory, params, src, dst, req, timeout);
+        gridftp_do_copy(module, factory, params, src, dst, req, timeout, transferred);
     }
     catch (Gfal::CoreException& e) {
         // Try again if the failure was related to udt
@@ -475,7 +441,7 @@ int gridftp_filecopy_copy_file_internal(GridFTPModule* module,
                     e.what());
 
             handler.session->set_udt(false);
-            gridftp_do_copy(module, factory, params, src, dst, req, timeout);
+            gridftp_do_copy(module, factory, params, src, dst, req, timeout, transferred);
         }
         // Else, rethrow
         else {
@@ -525,8 +491,10 @@ void GridFTPModule::filecopy(gfalt_params_t params, const char* src,
 
     // DMC-1348: DNS resolution mechanism
     if (resolve_dns) {
-        char* resolved_src_ptr = resolve_dns_helper(src, "Resolving source");
-        char* resolved_dst_ptr = resolve_dns_helper(dst, "Resolving destination");
+        gfal2_context_t context = _handle_factory->get_gfal2_context();
+        gfal2_resolve_dns_prefetch(context, dst);
+        char* resolved_src_ptr = resolve_dns_helper(context, src, "Resolving source");
+        char* resolved_dst_ptr = resolve_dns_helper(context, dst, "Resolving destination");
 
         if (resolved_src_ptr) {
             g_strlcpy(resolved_src, resolved_src_ptr, sizeof(resolved_src));
@@ -605,38 +573,44 @@ void GridFTPModule::filecopy(gfalt_params_t params, const char* src,
 
     plugin_trigger_event(params, GFAL_GRIDFTP_DOMAIN_GSIFTP, GFAL_EVENT_NONE,
             GFAL_EVENT_TRANSFER_ENTER, "(%s) %s => (%s) %s",
-            return_host_and_port(src, use_ipv6).c_str(), src,
-            return_host_and_port(dst, use_ipv6).c_str(), dst);
+            return_host_and_port(_handle_factory->get_gfal2_context(), src, use_ipv6).c_str(), src,
+            return_host_and_port(_handle_factory->get_gfal2_context(), dst, use_ipv6).c_str(), dst);
     plugin_trigger_event(params, GFAL_GRIDFTP_DOMAIN_GSIFTP,
         GFAL_EVENT_NONE, GFAL_EVENT_TRANSFER_TYPE,
         "%s", GFAL_TRANSFER_TYPE_PUSH);
 
+    time_t transfer_start = time(NULL);
+    globus_off_t transferred = 0;
     try {
-        gridftp_filecopy_copy_file_internal(this, _handle_factory, params, src, dst);
+        gridftp_filecopy_copy_file_internal(this, _handle_factory, params, src, dst, &transferred);
     }
     catch (Gfal::TransferException & e) {
-
+        report_resolved_endpoints(resolve_dns, src, dst, FALSE, transfer_start, transferred);
         throw;
     }
     catch (const Gfal::CoreException & e) {
+        report_resolved_endpoints(resolve_dns, src, dst, FALSE, transfer_start, transferred);
         autoCleanFileCopy(params, e.code(), dst);
         throw Gfal::TransferException(e.domain(), e.code(), e.what(),
                 GFALT_ERROR_TRANSFER);
     }
     catch (std::exception & e) {
+        report_resolved_endpoints(resolve_dns, src, dst, FALSE, transfer_start, transferred);
         autoCleanFileCopy(params, EIO, dst);
         throw Gfal::TransferException(GFAL_GRIDFTP_DOMAIN_GSIFTP, EIO, e.what(),
                 GFALT_ERROR_TRANSFER, "UNEXPECTED");
     }
     catch (...) {
+        report_resolved_endpoints(resolve_dns, src, dst, FALSE, transfer_start, transferred);
         autoCleanFileCopy(params, EIO, dst);
         throw;
     }
+    report_resolved_endpoints(resolve_dns, src, dst, TRUE, transfer_start, transferred);
 
     plugin_trigger_event(params, GFAL_GRIDFTP_DOMAIN_GSIFTP, GFAL_EVENT_NONE,
             GFAL_EVENT_TRANSFER_EXIT, "(%s) %s => (%s) %s",
-            return_host_and_port(src, use_ipv6).c_str(), src,
-            return_host_and_port(dst, use_ipv6).c_str(), dst);
+            return_host_and_port(_handle_factory->get_gfal2_context(), src, use_ipv6).c_str(), src,
+            return_host_and_port(_handle_factory->get_gfal2_context(), dst, use_ipv6).c_str(), dst);
 
     // Validate destination checksum
     if (checksum_mode & GFALT_CHECKSUM_TARGET) {
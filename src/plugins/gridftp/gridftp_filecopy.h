@@ -50,8 +50,8 @@ void gridftp_create_parent_copy(GridFTPModule* module, gfalt_params_t params,
  *                      If NULL, it will be ignored.
  * @return An IP associated with host.
  */
-std::string lookup_host(const char *host, bool ipv6_enabled, bool *got_ipv6);
+std::string lookup_host(gfal2_context_t context, const char *host, bool ipv6_enabled, bool *got_ipv6);
 
-std::string return_host_and_port(const std::string &uri, gboolean use_ipv6);
+std::string return_host_and_port(gfal2_context_t context, const std::string &uri, gboolean use_ipv6);
 
 #endif /* GRIFTP_IFCE_FILECOPY_H */
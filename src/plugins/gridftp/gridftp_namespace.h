@@ -68,6 +68,9 @@ int gfal_gridftp_checksumG(plugin_handle handle, const char* url,
         const char* check_type, char * checksum_buffer, size_t buffer_length,
         off_t start_offset, size_t data_length, GError ** err);
 
+int gfal_gridftp_checksum_listG(plugin_handle handle, int nbfiles, const char* const* urls,
+        const char* check_type, char** checksum_buffers, size_t buffer_length, GError** errors);
+
 ssize_t gfal_gridftp_getxattrG(plugin_handle handle, const char* path,
         const char *name, void *buff, size_t s_buff, GError** err);
 
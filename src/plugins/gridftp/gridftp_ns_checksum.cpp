@@ -24,6 +24,10 @@
 #include "gridftp_plugin.h"
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 
 static const GQuark GFAL_GRIDFTP_SCOPE_CHECKSUM = g_quark_from_static_string("GridFTPModule::checksum");
@@ -52,6 +56,48 @@ extern "C" int gfal_gridftp_checksumG(plugin_handle handle, const char* url,
     G_RETURN_ERR(ret, tmp_err, err);
 }
 
+// globus_ftp_client can not pipeline CKSM commands on a control channel, so the
+// checksums are spread over up to CHECKSUM_LIST_CONCURRENCY sessions instead.
+// Each worker keeps reusing the session cached by the factory.
+extern "C" int gfal_gridftp_checksum_listG(plugin_handle handle, int nbfiles, const char* const* urls,
+        const char* check_type, char** checksum_buffers, size_t buffer_length, GError** errors)
+{
+    GridFTPModule* module = static_cast<GridFTPModule*>(handle);
+    int concurrency = gfal2_get_opt_integer_with_default(module->get_session_factory()->get_gfal2_context(),
+            GRIDFTP_CONFIG_GROUP, GRIDFTP_CONFIG_CHECKSUM_LIST_CONCURRENCY, 4);
+    concurrency = std::max(1, std::min(concurrency, nbfiles));
+
+    Gfal::TraceScope trace("gridftp", "checksum_list");
+    std::atomic<int> next(0), failed(0);
+    auto worker = [&]() {
+        Gfal::TraceScope worker_trace("gridftp", "checksum_worker", trace.id());
+        int i;
+        while ((i = next++) < nbfiles) {
+            if (gfal_gridftp_checksumG(handle, urls[i], check_type, checksum_buffers[i], buffer_length,
+                    0, 0, &errors[i]) < 0) {
+                ++failed;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    try {
+        for (int w = 1; w < concurrency; ++w) {
+            workers.emplace_back(worker);
+        }
+    }
+    catch (const std::system_error& e) {
+        gfal2_log(G_LOG_LEVEL_WARNING, "Could only start %zu checksum workers: %s", workers.size() + 1, e.what());
+    }
+    worker();
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    return failed ? -1 : 0;
+}
+
+
 bool string_is_valid(const std::string &str)
 {
     for(size_t i=0; i < str.length(); i++){
@@ -65,7 +111,7 @@ void GridFTPModule::checksum(const char* url, const char* check_type,
         char * checksum_buffer, size_t buffer_length, off_t start_offset,
         size_t data_length)
 {
-    gfal2_log(G_LOG_LEVEL_DEBUG, " -> [GridFTPModule::checksum] ");
+    Gfal::TraceScope trace("gridftp", "checksum");
     gfal2_log(G_LOG_LEVEL_DEBUG, " Checksum calculation %s for url %s",
             check_type, url);
 
@@ -100,6 +146,4 @@ void GridFTPModule::checksum(const char* url, const char* check_type,
         std::string s(16, '0');
 	strncpy(checksum_buffer, s.c_str(), buffer_length);
     }
-
-    gfal2_log(G_LOG_LEVEL_DEBUG, " <- [GridFTPModule::checksum] ");
 }
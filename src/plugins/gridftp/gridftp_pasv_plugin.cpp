@@ -246,7 +246,7 @@ static void gfal2_ftp_client_pasv_response(globus_ftp_client_plugin_t* plugin,
                 bool ipv6_enabled = gfal2_get_opt_boolean_with_default(session->context, GRIDFTP_CONFIG_GROUP,
                     GRIDFTP_CONFIG_IPV6, FALSE);
 
-                g_strlcpy(ip, lookup_host(parsed->host, ipv6_enabled, &is_ipv6).c_str(), sizeof(ip));
+                g_strlcpy(ip, lookup_host(session->context, parsed->host, ipv6_enabled, &is_ipv6).c_str(), sizeof(ip));
             }
             gfal2_ftp_client_pasv_fire_event(session, parsed->host, ip, port, is_ipv6);
             gfal2_free_uri(parsed);
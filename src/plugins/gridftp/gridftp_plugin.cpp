@@ -156,6 +156,7 @@ gfal_plugin_interface gfal_plugin_init(gfal2_context_t handle, GError** err)
     ret.writeG = &gfal_gridftp_writeG;
     ret.lseekG = &gfal_gridftp_lseekG;
     ret.checksum_calcG = &gfal_gridftp_checksumG;
+    ret.checksum_listG = &gfal_gridftp_checksum_listG;
     ret.renameG = &gfal_gridftp_renameG;
     ret.check_plugin_url_transfer = &gridftp_check_url_transfer;
     ret.copy_file = &gridftp_plugin_filecopy;
@@ -42,6 +42,7 @@
 #define GRIDFTP_CONFIG_TRANSFER_PERF_TIMEOUT   "PERF_MARKER_TIMEOUT"
 #define GRIDFTP_CONFIG_TRANSFER_SKIP_CHECKSUM  "SKIP_SOURCE_CHECKSUM"
 #define GRIDFTP_CONFIG_TRANSFER_UDT            "ENABLE_UDT"
+#define GRIDFTP_CONFIG_CHECKSUM_LIST_CONCURRENCY "CHECKSUM_LIST_CONCURRENCY"
 
 
 #ifdef __cplusplus
@@ -433,6 +433,7 @@ GridFTPFactory::GridFTPFactory(gfal2_context_t handle): gfal2_context(handle)
     }
     size_cache = 400;
     globus_mutex_init(&mux_cache, NULL);
+    session_cache_metrics = gfal2_metrics_register_cache(gfal2_context, "gridftp_session");
 }
 
 
@@ -487,6 +488,7 @@ GridFTPSession* GridFTPFactory::get_recycled_handle(const std::string &baseurl)
     else {
         gfal2_log(G_LOG_LEVEL_DEBUG, "no session found in cache for %s!", baseurl.c_str());
     }
+    gfal2_metrics_cache_lookup(session_cache_metrics, session != NULL);
 
     globus_mutex_unlock(&mux_cache);
     return session;
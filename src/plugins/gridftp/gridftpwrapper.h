@@ -182,6 +182,7 @@ private:
     // session cache
     std::multimap<std::string, GridFTPSession*> session_cache;
     globus_mutex_t mux_cache;
+    gfal_metrics_cache_t session_cache_metrics;
 
     void recycle_session(GridFTPSession* sess);
     void clear_cache();
@@ -24,22 +24,43 @@
 #include <network/gfal2_network.h>
 #include <unistd.h>
 #include <checksums/checksums.h>
+#include <uri/gfal2_uri.h>
 #include <cryptopp/base64.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
+#include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <system_error>
+#include <thread>
+#include <vector>
 #include "gfal_http_plugin.h"
+#include "gfal_http_stream_prefetcher.h"
 
 using CopyMode = HttpCopyMode::CopyMode;
 
+// S3 limits on multipart uploads
+#define GFAL_HTTP_MULTIPART_MIN_PART_SIZE (5 * 1024 * 1024)
+#define GFAL_HTTP_MULTIPART_MAX_PARTS 10000
+
 struct PerfCallbackData {
     gfalt_params_t     params;
 
     std::string        source;
     std::string        destination;
+    // Last amount reported by the performance markers
+    guint64            transferred;
+    // The IP family is reported once per transfer
+    bool               ipevent_sent;
     PerfCallbackData(gfalt_params_t params, const std::string& src, const std::string& dst):
-         params(params), source(src), destination(dst)
+         params(params), source(src), destination(dst), transferred(0), ipevent_sent(false)
     {
     }
 };
@@ -422,7 +443,6 @@ static bool gfal_http_cancellationcopy_callback(void* data)
 static void gfal_http_3rdcopy_perfcallback(const Davix::PerformanceData& perfData, void* data)
 {
     PerfCallbackData* pdata = static_cast<PerfCallbackData*>(data);
-    static int ipevent_sent = false;
 
     if (pdata)
     {
@@ -432,12 +452,13 @@ static void gfal_http_3rdcopy_perfcallback(const Davix::PerformanceData& perfDat
         status.bytes_transfered = static_cast<size_t>(perfData.totalTransferred());
         status.instant_baudrate = static_cast<size_t>(perfData.diffTransfer());
         status.transfer_time    = perfData.absElapsed();
+        pdata->transferred = perfData.totalTransferred();
 
-        if ((!ipevent_sent) && (perfData.ipflag != Davix::undefined)) {
+        if ((!pdata->ipevent_sent) && (perfData.ipflag != Davix::undefined)) {
             GQuark ipevent = (perfData.ipflag == Davix::IPv6) ? GFAL_EVENT_IPV6 : GFAL_EVENT_IPV4;
             plugin_trigger_event(pdata->params, http_plugin_domain,
                                  GFAL_EVENT_DESTINATION, ipevent, "TRUE");
-            ipevent_sent = true;
+            pdata->ipevent_sent = true;
         }
         plugin_trigger_monitor(pdata->params, &status, pdata->source.c_str(), pdata->destination.c_str());
     }
@@ -505,6 +526,8 @@ static std::string get_canonical_uri(const std::string& original)
 struct HttpTransferHosts {
     std::string sourceHost;
     std::string destHost;
+    // Bytes moved by the last attempt, as reported by the transfer status
+    guint64 transferred = 0;
 };
 
 
@@ -591,6 +614,7 @@ static int gfal_http_third_party_copy(gfal2_context_t context,
     copy.copy(src_uri, dst_uri,
               gfalt_get_nbstreams(params, NULL),
               &davError);
+    transferHosts.transferred = perfCallbackData.transferred;
 
     if (davError != NULL) {
         davix2gliberr(davError, err, __func__);
@@ -622,12 +646,14 @@ struct HttpStreamProvider {
     dav_ssize_t read_instant;
     _gfalt_transfer_status perf;
     GError* stream_err;
+    HttpStreamPrefetcher* prefetcher;
 
     HttpStreamProvider(const char *source, const char *destination,
-                       gfal2_context_t context, int source_fd, gfalt_params_t params) :
+                       gfal2_context_t context, int source_fd, gfalt_params_t params,
+                       HttpStreamPrefetcher* prefetcher) :
         source(source), destination(destination),
         context(context), params(params), source_fd(source_fd), start(time(NULL)),
-        last_update(start), read_instant(0), stream_err(NULL)
+        last_update(start), read_instant(0), stream_err(NULL), prefetcher(prefetcher)
     {
         memset(&perf, 0, sizeof(perf));
     }
@@ -649,11 +675,20 @@ static dav_ssize_t gfal_http_streamed_provider(void *userdata,
         data->perf.instant_baudrate = 0;
         data->start = data->last_update = now;
 
-        if (gfal2_lseek(data->context, data->source_fd, 0, SEEK_SET, &error) < 0)
+        if (data->prefetcher) {
+            ret = data->prefetcher->Rewind(&error);
+        }
+        else if (gfal2_lseek(data->context, data->source_fd, 0, SEEK_SET, &error) < 0) {
             ret = -1;
+        }
     }
     else {
-        ret = gfal2_read(data->context, data->source_fd, buffer, buflen, &error);
+        if (data->prefetcher) {
+            ret = data->prefetcher->Read(buffer, buflen, &error);
+        }
+        else {
+            ret = gfal2_read(data->context, data->source_fd, buffer, buflen, &error);
+        }
         if (ret > 0)
             data->read_instant += ret;
 
@@ -678,11 +713,137 @@ static dav_ssize_t gfal_http_streamed_provider(void *userdata,
 }
 
 
+int gfal_http_multipart_upload(const HttpMultipartDestination& dest,
+        const std::function<dav_ssize_t(void* buffer, dav_size_t count)>& read,
+        off_t size, size_t part_size, int concurrency, size_t max_memory, GError** dest_err)
+{
+    std::string upload_id;
+    try {
+        upload_id = dest.initiate();
+    }
+    catch (Davix::DavixException& ex) {
+        g_set_error(dest_err, http_plugin_domain, ex.code(), "%s", ex.what());
+        return -1;
+    }
+
+    // Each part in flight holds a buffer of its size
+    size_t nparts = (size + part_size - 1) / part_size;
+    if (max_memory > 0) {
+        concurrency = std::min<size_t>(concurrency, std::max<size_t>(1, max_memory / part_size));
+    }
+    concurrency = std::max(1, std::min<int>(concurrency, nparts));
+    gfal2_log(G_LOG_LEVEL_DEBUG, "Multipart upload %s: parts of %zu bytes, %d in parallel",
+        upload_id.c_str(), part_size, concurrency);
+
+    std::vector<std::string> etags(nparts);
+    std::mutex read_mutex, result_mutex;
+    off_t next_offset = 0;
+    size_t next_part = 0;
+    bool failed = false, source_ended = false;
+
+    auto worker = [&]() {
+        std::vector<char> buffer;
+        while (true) {
+            size_t part;
+            size_t part_len;
+            {
+                std::lock_guard<std::mutex> lock(read_mutex);
+                if (failed || next_offset >= size) {
+                    return;
+                }
+                part = next_part++;
+                part_len = std::min<off_t>(part_size, size - next_offset);
+                next_offset += part_len;
+                buffer.resize(part_len);
+
+                size_t done = 0;
+                while (done < part_len) {
+                    dav_ssize_t n = read(buffer.data() + done, part_len - done);
+                    if (n <= 0) {
+                        // A source error is kept by the reader
+                        source_ended = (n == 0);
+                        failed = true;
+                        return;
+                    }
+                    done += n;
+                }
+            }
+
+            try {
+                // Part numbers start at 1
+                std::string etag = dest.upload_part(upload_id, part + 1, buffer.data(), part_len);
+                std::lock_guard<std::mutex> lock(result_mutex);
+                etags[part] = etag;
+            }
+            catch (Davix::DavixException& ex) {
+                std::lock_guard<std::mutex> lock(read_mutex);
+                if (!failed) {
+                    g_set_error(dest_err, http_plugin_domain, ex.code(), "%s", ex.what());
+                }
+                failed = true;
+                return;
+            }
+        }
+    };
+
+    gfal_http_run_workers(concurrency, worker);
+
+    if (!failed) {
+        try {
+            dest.commit(upload_id, etags);
+            return 0;
+        }
+        catch (Davix::DavixException& ex) {
+            g_set_error(dest_err, http_plugin_domain, ex.code(), "%s", ex.what());
+        }
+    }
+    else if (source_ended && *dest_err == NULL) {
+        g_set_error(dest_err, http_plugin_domain, EIO, "Source ended before %lld bytes", (long long)size);
+    }
+
+    // Otherwise the parts already uploaded are kept, and billed, until the bucket lifecycle removes them
+    try {
+        dest.abort(upload_id);
+    }
+    catch (Davix::DavixException& ex) {
+        gfal2_log(G_LOG_LEVEL_WARNING, "Failed to abort the multipart upload %s: %s", upload_id.c_str(), ex.what());
+    }
+    return -1;
+}
+
+
+// S3 multipart calls over a destination file
+static HttpMultipartDestination gfal_http_s3_multipart(Davix::Context& context, Davix::DavFile& dest,
+        Davix::RequestParams& req_params)
+{
+    HttpMultipartDestination multipart;
+    multipart.initiate = [&dest, &req_params]() {
+        return dest.initiateMultipart(&req_params);
+    };
+    multipart.upload_part = [&dest, &req_params](const std::string& upload_id, size_t part_number,
+            const char* data, size_t len) {
+        Davix::BufferContentProvider content(data, len);
+        return dest.uploadPart(&req_params, upload_id, part_number, content);
+    };
+    multipart.commit = [&dest, &req_params](const std::string& upload_id, const std::vector<std::string>& etags) {
+        dest.commitChunks(&req_params, upload_id, etags);
+    };
+    // Davix has no call for it, AbortMultipartUpload is a DELETE of the object with the upload id
+    multipart.abort = [&context, &dest, &req_params](const std::string& upload_id) {
+        Davix::Uri upload_uri(dest.getUri());
+        upload_uri.addQueryParam("uploadId", upload_id);
+        Davix::DavFile upload(context, req_params, upload_uri);
+        upload.deletion(&req_params);
+    };
+    return multipart;
+}
+
+
 static int gfal_http_streamed_copy(gfal2_context_t context,
         GfalHttpPluginData* davix,
         const char* src, const char* dst,
         gfalt_checksum_mode_t checksum_mode, const char *checksum_type, const char *user_checksum,
-        gfalt_params_t params,
+        gfalt_params_t params, HttpTransferHosts& transferHosts,
         GError** err)
 {
     gfal2_log(G_LOG_LEVEL_MESSAGE, "Performing a HTTP streamed copy");
@@ -694,24 +855,40 @@ static int gfal_http_streamed_copy(gfal2_context_t context,
         return -1;
     }
 
+    // Parallel transfers use as many connections as requested streams
+    int nbstreams = static_cast<int>(gfalt_get_nbstreams(params, NULL));
+
+    // Prefetch the source while uploading, unless disabled
+    int read_ahead = gfal2_get_opt_integer_with_default(context, "HTTP PLUGIN", "STREAM_READ_AHEAD_DEPTH", 4);
+    int buffer_size = gfal2_get_opt_integer_with_default(context, "HTTP PLUGIN", "STREAM_BUFFER_SIZE", 4194304);
+
+    // HTTP sources are fetched with parallel ranged GETs, without opening the source
+    bool ranged_source = read_ahead > 0 && buffer_size > 0 && nbstreams > 1 &&
+        is_http_scheme(src) && src_stat.st_size > buffer_size;
+
     // Must reset the HTTP OPERATION_TIMEOUT to the transfer timeout
     bool reset_operation_timeout = is_http_scheme(src);
     int transfer_timeout = static_cast<int>(gfalt_get_timeout(params, NULL));
     int previous_timeout = 0;
+    int source_fd = -1;
 
-    if (reset_operation_timeout) {
+    if (ranged_source) {
+        gfal2_log(G_LOG_LEVEL_DEBUG, "Reading the source with %d parallel ranged requests", nbstreams);
+    }
+    else if (reset_operation_timeout) {
+        // The timeout is a context option, concurrent copies must not restore each other's
+        std::lock_guard<std::mutex> lock(davix->operation_timeout_mutex);
         previous_timeout = davix->get_operation_timeout();
         davix->set_operation_timeout(transfer_timeout);
         gfal2_log(G_LOG_LEVEL_DEBUG, "Source HTTP Open transfer timeout=%d", transfer_timeout);
-    }
-
-    int source_fd = gfal2_open(context, src, O_RDONLY, &nested_err);
-
-    if (reset_operation_timeout) {
+        source_fd = gfal2_open(context, src, O_RDONLY, &nested_err);
         davix->set_operation_timeout(previous_timeout);
     }
+    else {
+        source_fd = gfal2_open(context, src, O_RDONLY, &nested_err);
+    }
 
-    if (source_fd < 0) {
+    if (!ranged_source && source_fd < 0) {
         gfal2_propagate_prefixed_error(err, nested_err, __func__);
         return -1;
     }
@@ -725,7 +902,8 @@ static int gfal_http_streamed_copy(gfal2_context_t context,
     req_params.setOperationTimeout(&opTimeout);
 
     // Set MD5 header on the PUT
-    if (checksum_mode & GFALT_CHECKSUM_TARGET && strcasecmp(checksum_type, "md5") == 0 && user_checksum[0]) {
+    bool content_md5 = checksum_mode & GFALT_CHECKSUM_TARGET && strcasecmp(checksum_type, "md5") == 0 && user_checksum[0];
+    if (content_md5) {
     	req_params.addHeader("Content-MD5", user_checksum);
     }
 
@@ -746,31 +924,84 @@ static int gfal_http_streamed_copy(gfal2_context_t context,
 
     Davix::DavFile dest(davix->context,req_params, dst_uri );
 
-    HttpStreamProvider provider(src, dst, context, source_fd, params);
-
-    try {
-    	dest.put(&req_params, std::bind(&gfal_http_streamed_provider,&provider,
-        		  std::placeholders::_1, std::placeholders::_2), src_stat.st_size);
-
-    } catch (Davix::DavixException& ex) {
-        GError* tmp_err = NULL;
+    std::unique_ptr<HttpStreamPrefetcher> prefetcher;
+    Davix::Uri src_uri(src);
+    Davix::RequestParams src_params;
+    std::unique_ptr<Davix::DavFile> source;
+
+    if (read_ahead > 0 && buffer_size > 0) {
+        int depth = ranged_source ? std::max(read_ahead, nbstreams) : read_ahead;
+        gfal2_log(G_LOG_LEVEL_DEBUG, "Streamed copy with %d read-ahead buffers of %d bytes", depth, buffer_size);
+        prefetcher.reset(new HttpStreamPrefetcher(context, source_fd, depth, buffer_size));
+
+        if (ranged_source) {
+            davix->get_params(&src_params, src_uri, GfalHttpPluginData::OP::READ);
+            src_params.setOperationTimeout(&opTimeout);
+            source.reset(new Davix::DavFile(davix->context, src_params, src_uri));
+            Davix::DavFile* source_file = source.get();
+            Davix::RequestParams* source_params = &src_params;
+            prefetcher->SetRangeReader([source_file, source_params](void* buffer, dav_size_t count, dav_off_t offset, GError** err) -> dav_ssize_t {
+                try {
+                    return source_file->readPartial(source_params, buffer, count, offset);
+                }
+                catch (Davix::DavixException& ex) {
+                    g_set_error(err, http_plugin_domain, ex.code(), "%s", ex.what());
+                    return -1;
+                }
+            }, src_stat.st_size, nbstreams);
+        }
+        prefetcher->Start();
+    }
 
-        // Propagate the source error first, then the destination error
-        if (provider.stream_err != NULL) {
-            tmp_err = provider.stream_err;
-        } else {
-            tmp_err = g_error_new(http_plugin_domain, ex.code(), "%s", ex.what());
+    HttpStreamProvider provider(src, dst, context, source_fd, params, prefetcher.get());
+
+    // Object store destinations take the file in parts uploaded in parallel.
+    // A Content-MD5 header would apply to every part, so it disables multipart uploads
+    size_t part_size = std::max<long long>(
+        gfal2_get_opt_integer_with_default(context, "HTTP PLUGIN", "STREAM_PART_SIZE", 16777216),
+        GFAL_HTTP_MULTIPART_MIN_PART_SIZE);
+    part_size = std::max<size_t>(part_size, (src_stat.st_size + GFAL_HTTP_MULTIPART_MAX_PARTS - 1) / GFAL_HTTP_MULTIPART_MAX_PARTS);
+    bool multipart = req_params.getProtocol() == Davix::RequestProtocol::AwsS3 && nbstreams > 1 &&
+        src_stat.st_size > static_cast<off_t>(part_size) && !content_md5;
+
+    GError* dest_err = NULL;
+    bool failed = false;
+    if (multipart) {
+        size_t max_memory = gfal2_get_opt_integer_with_default(context, "HTTP PLUGIN", "STREAM_MULTIPART_MAX_MEMORY",
+            268435456);
+        failed = gfal_http_multipart_upload(gfal_http_s3_multipart(davix->context, dest, req_params),
+            std::bind(&gfal_http_streamed_provider, &provider, std::placeholders::_1, std::placeholders::_2),
+            src_stat.st_size, part_size, nbstreams, max_memory, &dest_err) < 0;
+    }
+    else {
+        try {
+            dest.put(&req_params, std::bind(&gfal_http_streamed_provider,&provider,
+                      std::placeholders::_1, std::placeholders::_2), src_stat.st_size);
+        } catch (Davix::DavixException& ex) {
+            dest_err = g_error_new(http_plugin_domain, ex.code(), "%s", ex.what());
+            failed = true;
         }
+    }
 
+    if (failed) {
+        // Propagate the source error first, then the destination error
+        GError* tmp_err = provider.stream_err ? provider.stream_err : dest_err;
         gfal2_set_error(err, http_plugin_domain, tmp_err->code, __func__, "%s (%s)",
                         tmp_err->message, (provider.stream_err) ? "source" : "destination");
-        g_clear_error(&tmp_err);
+        g_clear_error(&provider.stream_err);
+        g_clear_error(&dest_err);
     }
 
-    gfal2_close(context, source_fd, &nested_err);
-    // Throw away this error
-    if (nested_err)
-        g_error_free(nested_err);
+    transferHosts.transferred = failed ? provider.perf.bytes_transfered : src_stat.st_size;
+
+    // The reader must be done with the descriptor before closing it
+    prefetcher.reset();
+    if (source_fd >= 0) {
+        gfal2_close(context, source_fd, &nested_err);
+        // Throw away this error
+        if (nested_err)
+            g_error_free(nested_err);
+    }
 
     return *err == NULL ? 0 : -1;
 }
@@ -798,7 +1029,7 @@ static void resolve_url(const gfal2_context_t& context, const char* url, char* u
     gboolean resolve_dns = gfal2_get_opt_boolean_with_default(context, CORE_CONFIG_GROUP, RESOLVE_DNS, FALSE);
 
     if (resolve_dns && is_http_scheme(url)) {
-        char *url_tmp = resolve_dns_helper(url, "Resolving url");
+        char *url_tmp = resolve_dns_helper(context, url, "Resolving url");
         if (url_tmp) {
             g_strlcpy(url_resolved, url_tmp, url_size);
             free(url_tmp);
@@ -827,6 +1058,10 @@ int gfal_http_copy(plugin_handle plugin_data, gfal2_context_t context,
 
     // Determine if we need to resolve DNS alias
     char src[GFAL_URL_MAX_LEN], dst[GFAL_URL_MAX_LEN];
+    gboolean resolve_dns = gfal2_get_opt_boolean_with_default(context, CORE_CONFIG_GROUP, RESOLVE_DNS, FALSE);
+    if (resolve_dns && is_http_scheme(stripped_dst)) {
+        gfal2_resolve_dns_prefetch(context, stripped_dst);
+    }
     resolve_url(context, stripped_src, src, sizeof(src));
     resolve_url(context, stripped_dst, dst, sizeof(dst));
 
@@ -846,6 +1081,9 @@ int gfal_http_copy(plugin_handle plugin_data, gfal2_context_t context,
     }
 
     // Source checksum
+    // Source and destination are not checksummed together with gfal2_checksum_list: the source one
+    // must fail the transfer before anything is copied, and the destination one only exists afterwards.
+    // Bulk copies overlap the checksums of different pairs instead, as each runs on its own worker.
     if (checksum_mode & GFALT_CHECKSUM_SOURCE) {
         plugin_trigger_event(params, http_plugin_domain, GFAL_EVENT_SOURCE,
                 GFAL_EVENT_CHECKSUM_ENTER, "");
@@ -904,6 +1142,7 @@ int gfal_http_copy(plugin_handle plugin_data, gfal2_context_t context,
                          GFAL_EVENT_NONE, GFAL_EVENT_TRANSFER_ENTER,
                          "%s => %s", src_full, dst_full);
 
+    time_t transfer_start = time(NULL);
     do {
         // Perform the copy, going through the different fallback copy modes
         gfal2_log(G_LOG_LEVEL_MESSAGE, "Trying copying with mode %s", copyMode.str());
@@ -911,12 +1150,13 @@ int gfal_http_copy(plugin_handle plugin_data, gfal2_context_t context,
                              GFAL_EVENT_NONE, GFAL_EVENT_TRANSFER_TYPE,
                              "%s", copyMode.str());
         g_clear_error(&nested_error);
+        transferHosts.transferred = 0;
 
         if (copyMode.value() == CopyMode::STREAM) {
             if (copyMode.isStreamingEnabled()) {
                 ret = gfal_http_streamed_copy(context, davix, src, dst,
                                               checksum_mode, checksum_type, user_checksum,
-                                              params, &nested_error);
+                                              params, transferHosts, &nested_error);
             } else if (copyMode.isStreamingOnly()) {
                 gfal2_set_error(&nested_error, http_plugin_domain, EINVAL, __func__,
                                 "STREAMED DISABLED Only streamed copy possible but streaming is disabled");
@@ -944,6 +1184,12 @@ int gfal_http_copy(plugin_handle plugin_data, gfal2_context_t context,
              is_http_3rdcopy_fallback_enabled(context, stripped_src, stripped_dst) &&
              gfal_http_copy_should_fallback(nested_error->code));
 
+    if (resolve_dns) {
+        double elapsed = difftime(time(NULL), transfer_start);
+        gfal2_resolve_dns_report(src, ret == 0, transferHosts.transferred, elapsed);
+        gfal2_resolve_dns_report(dst, ret == 0, transferHosts.transferred, elapsed);
+    }
+
     if (ret == 0) {
         std::ostringstream msg;
         msg << src;
@@ -1041,10 +1287,130 @@ int gfal_http_copy(plugin_handle plugin_data, gfal2_context_t context,
 }
 
 
+// Endpoint pair of a transfer, used to keep the transfers between the same storages together
+static std::string gfal_http_copy_endpoints(const char* src, const char* dst)
+{
+    GError* tmp_err = NULL;
+    std::string key;
+    gfal2_uri* src_uri = gfal2_parse_uri(src, &tmp_err);
+    g_clear_error(&tmp_err);
+    gfal2_uri* dst_uri = gfal2_parse_uri(dst, &tmp_err);
+    g_clear_error(&tmp_err);
+
+    if (src_uri && src_uri->host) {
+        key.append(src_uri->host).append(":").append(std::to_string(src_uri->port));
+    }
+    key.append(" => ");
+    if (dst_uri && dst_uri->host) {
+        key.append(dst_uri->host).append(":").append(std::to_string(dst_uri->port));
+    }
+
+    gfal2_free_uri(src_uri);
+    gfal2_free_uri(dst_uri);
+    return key;
+}
+
+
+static int gfal_http_copy_bulk_file(plugin_handle plugin_data, gfal2_context_t context, gfalt_params_t params,
+        const char* src, const char* dst, const char* checksum, GError** err)
+{
+    if (gfal2_is_canceled(context)) {
+        gfal2_set_error(err, http_plugin_domain, ECANCELED, __func__, "Transfer canceled");
+        return -1;
+    }
+
+    GError* tmp_err = NULL;
+    // Callbacks of the concurrent copies are delivered one at a time
+    gfalt_params_t file_params = gfalt_params_handle_copy_bulk_file(params, checksum, &tmp_err);
+    if (file_params == NULL) {
+        gfal2_propagate_prefixed_error(err, tmp_err, __func__);
+        return -1;
+    }
+
+    int ret;
+    if (gfal_http_copy_check(plugin_data, context, src, dst, GFAL_FILE_COPY)) {
+        ret = gfal_http_copy(plugin_data, context, file_params, src, dst, &tmp_err);
+    }
+    else {
+        // Not every pair in the bulk is necessarily for us
+        ret = gfalt_copy_file(context, file_params, src, dst, &tmp_err);
+    }
+
+    gfalt_params_handle_delete(file_params, NULL);
+    if (ret < 0) {
+        gfal2_propagate_prefixed_error(err, tmp_err, __func__);
+    }
+    return ret;
+}
+
+
+int gfal_http_copy_bulk(plugin_handle plugin_data, gfal2_context_t context, gfalt_params_t params,
+        size_t nbfiles, const char* const* srcs, const char* const* dsts, const char* const* checksums,
+        GError** op_error, GError*** file_errors)
+{
+    *file_errors = g_new0(GError*, nbfiles);
+    if (nbfiles == 0) {
+        return 0;
+    }
+
+    int concurrency = gfal2_get_opt_integer_with_default(context, "HTTP PLUGIN", "BULK_COPY_CONCURRENCY", 8);
+    if (concurrency <= 0) {
+        concurrency = 1;
+    }
+    size_t nworkers = std::min<size_t>(concurrency, nbfiles);
+
+    // Transfers between the same pair of endpoints are issued next to each other,
+    // so they share the connections pooled by the Davix context
+    std::vector<size_t> order(nbfiles);
+    std::vector<std::string> endpoints(nbfiles);
+    for (size_t i = 0; i < nbfiles; ++i) {
+        order[i] = i;
+        endpoints[i] = gfal_http_copy_endpoints(srcs[i], dsts[i]);
+    }
+    std::stable_sort(order.begin(), order.end(), [&endpoints](size_t a, size_t b) {
+        return endpoints[a] < endpoints[b];
+    });
+
+    gfal2_log(G_LOG_LEVEL_INFO, "Bulk copy of %zu files with up to %zu concurrent transfers", nbfiles, nworkers);
+
+    // Each worker runs the full copy of one file at a time, so the checksum,
+    // overwrite and parent creation round trips of different files overlap
+    std::atomic<size_t> next(0);
+    std::atomic<int> failed(0);
+    auto worker = [&]() {
+        size_t n;
+        while ((n = next++) < nbfiles) {
+            size_t i = order[n];
+            const char* checksum = checksums ? checksums[i] : NULL;
+            if (gfal_http_copy_bulk_file(plugin_data, context, params, srcs[i], dsts[i], checksum,
+                                         &(*file_errors)[i]) < 0) {
+                ++failed;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    try {
+        for (size_t w = 1; w < nworkers; ++w) {
+            workers.emplace_back(worker);
+        }
+    }
+    catch (const std::system_error& e) {
+        gfal2_log(G_LOG_LEVEL_WARNING, "Could only start %zu bulk copy workers: %s", workers.size() + 1, e.what());
+    }
+    worker();
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    return -failed.load();
+}
+
+
 int gfal_http_copy_check(plugin_handle plugin_data, gfal2_context_t context, const char* src,
         const char* dst, gfal_url2_check check)
 {
-    if (check != GFAL_FILE_COPY)
+    if (check != GFAL_FILE_COPY && check != GFAL_BULK_COPY)
         return 0;
     // This plugin handles everything that writes into an http endpoint
     // It will try to decide if it is better to do a third party copy, or a streamed copy later on
@@ -152,121 +152,151 @@ static bool gfal_http_get_x509_cert_pair(gfal2_context_t handle, const Davix::Ur
 
 char* GfalHttpPluginData::find_se_token(const Davix::Uri& uri, const OP& operation)
 {
-    using credTuple = std::pair<std::string, std::string>;
     bool write_access = writeFlagFromOperation(operation);
     bool extended_search = searchFlagFromOperation(operation);
+    time_t expiry_margin = gfal2_get_opt_integer_with_default(handle, "HTTP PLUGIN", "BEARER_TOKEN_EXPIRY_MARGIN", 60);
 
     // Helper function to find a token in the Gfal HTTP internal token map
-    auto find_in_token_map = [&](const char* token, const char* token_path, bool write_access) -> bool {
+    auto find_in_token_map = [&](const std::string& token_path, const std::string& token) -> bool {
+        if (token_cache.state(token, expiry_margin) == TokenCache::State::EXPIRED) {
+            gfal2_log(G_LOG_LEVEL_DEBUG, "(SEToken) Token in credential_map[%s] expired", token_path.c_str());
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(token_map_mutex);
         auto it = token_map.find(token);
 
         if (it == token_map.end()) {
             gfal2_log(G_LOG_LEVEL_DEBUG,
                       "(SEToken) Retrieved token not in token access map (path=%s) (assuming user-set)",
-                      token_path);
+                      token_path.c_str());
             return true;
         }
 
         if (it->second || (write_access == it->second)) {
             gfal2_log(G_LOG_LEVEL_DEBUG, "(SEToken) Found token in credential_map[%s] (access=%s) (needed=%s)",
-                      token_path, it->second ? "write" : "read", write_access ? "write" : "read");
+                      token_path.c_str(), it->second ? "write" : "read", write_access ? "write" : "read");
             return true;
         }
 
         return false;
     };
 
-    // Helper function to extract all credentials of type "BEARER"
-    auto cred_map_callback = [](const char* url_prefix, const gfal2_cred_t* cred, void* user_data) {
-        auto cred_list = static_cast<std::list<credTuple>*>(user_data);
-
-        if (strcmp(cred->type, GFAL_CRED_BEARER) == 0) {
-            cred_list->emplace_back(url_prefix, cred->value);
-        }
-    };
-
-    // Helper function to check whether a path contains the search path
-    auto path_contains = [](const std::string& path, const std::string& search) -> bool {
-        size_t pos = path.find(search);
-
-        if (pos == 0) {
-            return (path.size() == search.size()) ||
-                   (path.at(search.size() - 1) == '/') ||
-                   (path.at(search.size()) == '/');
-        }
-
-        return false;
-    };
+    std::string token_path, token;
 
-    std::list<credTuple> cred_list;
-    gfal2_cred_foreach(handle, cred_map_callback, &cred_list);
+    if (token_cache.find(handle, uri.getString(), extended_search, find_in_token_map, token_path, token)) {
+        // Past half of its lifetime, a SE-issued token is replaced in the background
+        if (token_cache.state(token, expiry_margin) == TokenCache::State::STALE) {
+            TokenCache::Entry replacement;
 
-    for (auto cred = cred_list.begin(); cred != cred_list.end(); cred++) {
-        if (path_contains(uri.getString(), cred->first) ||
-            (extended_search && path_contains(cred->first, uri.getString()))) {
-            if (find_in_token_map(cred->second.c_str(), cred->first.c_str(), write_access)) {
-                return g_strdup(cred->second.c_str());
+            if (token_cache.take_refreshed(token, replacement)) {
+                store_se_token(replacement);
+                token = replacement.token;
+            } else if (gfal2_get_opt_boolean_with_default(handle, "HTTP PLUGIN", "BEARER_TOKEN_BACKGROUND_REFRESH", TRUE)) {
+                token_cache.refresh(token, [this](const TokenCache::Entry& entry) {
+                    return exchange_se_token(Davix::Uri(entry.prefix), entry.write_access, entry.validity);
+                });
             }
         }
+
+        return g_strdup(token.c_str());
     }
 
     // Search token for the full host (backwards compatibility with FTS)
     GError* error = NULL;
-    char* token = gfal2_cred_get(handle, GFAL_CRED_BEARER, uri.getHost().c_str(), NULL, &error);
+    char* host_token = gfal2_cred_get(handle, GFAL_CRED_BEARER, uri.getHost().c_str(), NULL, &error);
     g_clear_error(&error);
 
-    return token;
+    return host_token;
 }
 
-char* GfalHttpPluginData::retrieve_and_store_se_token(const Davix::Uri& uri, const OP& operation, unsigned validity)
+std::string GfalHttpPluginData::exchange_se_token(const Davix::Uri& uri, bool write_access, unsigned validity)
 {
-    bool retrieve_token = gfal2_get_opt_boolean_with_default(handle, "HTTP PLUGIN", "RETRIEVE_BEARER_TOKEN", false);
-    GError* error = NULL;
-    char* token = NULL;
-
-    if (!retrieve_token || !allowsBearerTokenRetrieve(uri, operation)) {
-        return NULL;
-    }
-
     Davix::RequestParams params = reference_params;
     get_params_internal(params, uri);
     get_certificate(params, uri);
 
-    bool write_access = writeFlagFromOperation(operation);
     TokenRetriever* retriever = token_retriever_chain.get();
 
     while (retriever != NULL) {
         try {
             gfal_http_token_t http_token = retriever->retrieve_token(uri, params, write_access, validity);
-            token = strdup(http_token.token.c_str());
-            break;
+            return http_token.token;
         } catch (const Gfal::CoreException& e) {
             gfal2_log(G_LOG_LEVEL_INFO, "(SEToken) Error during token retrieval: %s", e.what());
             retriever = retriever->next();
         }
     }
 
-    if (!token) {
-        gfal2_log(G_LOG_LEVEL_WARNING, "(SEToken) Could not retrieve any token for %s", uri.getString().c_str());
-        return NULL;
-    }
+    gfal2_log(G_LOG_LEVEL_WARNING, "(SEToken) Could not retrieve any token for %s", uri.getString().c_str());
+    return std::string();
+}
+
+void GfalHttpPluginData::store_se_token(const TokenCache::Entry& entry)
+{
+    GError* error = NULL;
 
     // Tokens are treated as opaque, therefor they are cached in the TokenAccessMap
     // together with write access and validity info
-    gfal2_cred_t* token_cred = gfal2_cred_new(GFAL_CRED_BEARER, token);
+    gfal2_cred_t* token_cred = gfal2_cred_new(GFAL_CRED_BEARER, entry.token.c_str());
+    guint generation = gfal2_cred_get_generation(handle);
 
-    if (gfal2_cred_set(handle, uri.getString().c_str(), token_cred, &error) < 0) {
+    if (gfal2_cred_set(handle, entry.prefix.c_str(), token_cred, &error) < 0) {
         gfal2_log(G_LOG_LEVEL_DEBUG, "(SEToken) Failed to set bearer token in credential_map[%s] due to error: %s",
-                  uri.getString().c_str(), error->message);
+                  entry.prefix.c_str(), error->message);
         g_clear_error(&error);
     } else {
         gfal2_log(G_LOG_LEVEL_DEBUG, "(SEToken) Set bearer token in credential_map[%s] (access=%s) (validity=%u)",
-                  uri.getString().c_str(), write_access ? "write" : "read" , validity);
-        token_map[token] = write_access;
+                  entry.prefix.c_str(), entry.write_access ? "write" : "read" , entry.validity);
+        {
+            std::lock_guard<std::mutex> lock(token_map_mutex);
+            token_map[entry.token] = entry.write_access;
+        }
+        token_cache.add(handle, generation, entry);
+
+        // The token this one replaces, if any, is not needed any more once expired
+        std::vector<std::string> evicted = token_cache.evict_expired(handle);
+        if (!evicted.empty()) {
+            std::lock_guard<std::mutex> lock(token_map_mutex);
+            for (auto& token : evicted) {
+                token_map.erase(token);
+            }
+            gfal2_log(G_LOG_LEVEL_DEBUG, "(SEToken) Forgot %zu expired tokens", evicted.size());
+        }
     }
 
     gfal2_cred_free(token_cred);
-    return token;
+}
+
+char* GfalHttpPluginData::retrieve_and_store_se_token(const Davix::Uri& uri, const OP& operation, unsigned validity)
+{
+    bool retrieve_token = gfal2_get_opt_boolean_with_default(handle, "HTTP PLUGIN", "RETRIEVE_BEARER_TOKEN", false);
+
+    if (!retrieve_token || !allowsBearerTokenRetrieve(uri, operation)) {
+        return NULL;
+    }
+
+    bool write_access = writeFlagFromOperation(operation);
+    std::string scope = uri.getString() + (write_access ? "#write" : "#read");
+
+    // Concurrent requests for the same scope share a single exchange
+    std::string token = token_cache.exchange(scope, [&]() -> std::string {
+        // The token may have been stored since the caller looked for it
+        char* found = find_se_token(uri, operation);
+        if (found) {
+            std::string existing(found);
+            g_free(found);
+            return existing;
+        }
+
+        TokenCache::Entry entry{uri.getString(), exchange_se_token(uri, write_access, validity), write_access, validity};
+        if (!entry.token.empty()) {
+            store_se_token(entry);
+        }
+        return entry.token;
+    });
+
+    return token.empty() ? NULL : strdup(token.c_str());
 }
 
 GfalHttpPluginData::tape_endpoint_info_t
@@ -283,16 +313,18 @@ GfalHttpPluginData::retrieve_and_store_tape_endpoint(const std::string& endpoint
     request.setParameters(params);
 
     if (request.executeRequest(&reqerr)) {
-        gfal2_set_error(err, http_plugin_domain, davix2errno(reqerr->getStatus()), __func__,
+        gfal2_set_error(err, http_plugin_domain, davix_request_errno(reqerr), __func__,
                         "[Tape REST API] Failed to query /.well-known/wlcg-tape-rest-api: %s",
-                        reqerr->getErrMsg().c_str());
+                        davix_request_errmsg(reqerr, request.getRequestCode()).c_str());
+        Davix::DavixError::clearError(&reqerr);
         return tape_endpoint_info{};
     }
 
     if (request.getRequestCode() != 200) {
         gfal2_set_error(err, http_plugin_domain, EINVAL, __func__,
                         "[Tape REST API] Failed to query /.well-known/wlcg-tape-rest-api: %s: %s",
-                        reqerr->getErrMsg().c_str(), request.getAnswerContent());
+                        davix_request_errmsg(reqerr, request.getRequestCode()).c_str(), request.getAnswerContent());
+        Davix::DavixError::clearError(&reqerr);
         return tape_endpoint_info{};
     }
 
@@ -382,17 +414,21 @@ GfalHttpPluginData::retrieve_and_store_tape_endpoint(const std::string& endpoint
         return tape_endpoint_info{};
     }
 
-    tape_endpoint_map[endpoint] = tape_endpoint_info{sitename, tape_endpoint_uri, tape_endpoint_version};
-    return tape_endpoint_map[endpoint];
+    int ttl = gfal2_get_opt_integer_with_default(handle, "HTTP PLUGIN", "TAPE_REST_API_DISCOVERY_TTL", 3600);
+    tape_endpoint_info_t info{sitename, tape_endpoint_uri, tape_endpoint_version, ttl > 0 ? time(NULL) + ttl : 0};
+
+    std::lock_guard<std::mutex> lock(tape_endpoint_mutex);
+    tape_endpoint_map[endpoint] = info;
+    return info;
 }
 
-std::string gfal_http_discover_tape_endpoint(GfalHttpPluginData* davix, const char* url, const char* method, GError** err)
+GfalHttpPluginData::tape_endpoint_info_t GfalHttpPluginData::get_tape_endpoint(const char* url, GError** err)
 {
     Davix::Uri uri(url);
 
     if (uri.getStatus() != StatusCode::OK) {
         gfal2_set_error(err, http_plugin_domain, EINVAL, __func__, "Invalid URL: %s", url);
-        return NULL;
+        return tape_endpoint_info{};
     }
 
     // Construct remote storage endpoint
@@ -403,20 +439,30 @@ std::string gfal_http_discover_tape_endpoint(GfalHttpPluginData* davix, const ch
         endpoint << ":" << uri.getPort();
     }
 
-    auto it = davix->tape_endpoint_map.find(endpoint.str());
-
-    if (it == davix->tape_endpoint_map.end()) {
-        davix->retrieve_and_store_tape_endpoint(endpoint.str(), err);
+    {
+        std::lock_guard<std::mutex> lock(tape_endpoint_mutex);
+        auto it = tape_endpoint_map.find(endpoint.str());
 
-        if (*err != NULL) {
-            return "";
+        if (it != tape_endpoint_map.end() && (it->second.expires == 0 || it->second.expires > time(NULL))) {
+            return it->second;
         }
+    }
+
+    return retrieve_and_store_tape_endpoint(endpoint.str(), err);
+}
 
-        it = davix->tape_endpoint_map.find(endpoint.str());
+std::string gfal_http_discover_tape_endpoint(GfalHttpPluginData* davix, const char* url, const char* method, GError** err)
+{
+    GError* tmp_err = NULL;
+    GfalHttpPluginData::tape_endpoint_info_t info = davix->get_tape_endpoint(url, &tmp_err);
+
+    if (tmp_err != NULL) {
+        g_propagate_error(err, tmp_err);
+        return "";
     }
 
     std::stringstream tape_endpoint;
-    tape_endpoint << it->second.uri;
+    tape_endpoint << info.uri;
 
     if (tape_endpoint.str().back() != '/') {
         tape_endpoint << "/";
@@ -1048,14 +1094,38 @@ int davix2errno(StatusCode::Code code)
 }
 
 
+int davix_request_errno(const DavixError* daverr)
+{
+    return daverr ? davix2errno(daverr->getStatus()) : EIO;
+}
+
+
+std::string davix_request_errmsg(const DavixError* daverr, int http_code)
+{
+    if (daverr) {
+        return daverr->getErrMsg();
+    }
+    return "HTTP " + std::to_string(http_code);
+}
+
+
 void davix2gliberr(const DavixError* daverr, GError** err, const gchar* function)
 {
+    int code = davix2errno(daverr->getStatus());
+    if (err == NULL) {
+        return;
+    }
+    // Existence probes only check the code, skip the escaping
+    if (gfal2_errno_is_expected(code)) {
+        gfal2_set_error(err, http_plugin_domain, code, function, "%s", "");
+        return;
+    }
+
     const char *str = daverr->getErrMsg().c_str();
     size_t str_len = daverr->getErrMsg().length();
     gchar *escaped_str = gfal2_utf8escape_string(str, str_len, NULL);
 
-    gfal2_set_error(err, http_plugin_domain, davix2errno(daverr->getStatus()), function,
-                    "%s", escaped_str);
+    gfal2_set_error(err, http_plugin_domain, code, function, "%s", escaped_str);
 
     g_free(escaped_str);
 }
@@ -1118,6 +1188,8 @@ extern "C" gfal_plugin_interface gfal_plugin_init(gfal2_context_t handle, GError
     http_plugin.plugin_delete = &gfal_http_delete;
 
     http_plugin.statG = &gfal_http_stat;
+    http_plugin.stat_listG = &gfal_http_stat_list;
+    http_plugin.checksum_listG = &gfal_http_checksum_list;
     http_plugin.accessG = &gfal_http_access;
     http_plugin.mkdirpG = &gfal_http_mkdirpG;
     http_plugin.unlinkG = &gfal_http_unlinkG;
@@ -1146,6 +1218,7 @@ extern "C" gfal_plugin_interface gfal_plugin_init(gfal2_context_t handle, GError
     // Bind 3rd party copy
     http_plugin.check_plugin_url_transfer = gfal_http_copy_check;
     http_plugin.copy_file = gfal_http_copy;
+    http_plugin.copy_bulk = gfal_http_copy_bulk;
 
     // QoS
     http_plugin.check_qos_classes = &gfal_http_check_classes;
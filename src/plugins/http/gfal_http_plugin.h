@@ -21,7 +21,12 @@
 #ifndef _GFAL_HTTP_PLUGIN_H
 #define _GFAL_HTTP_PLUGIN_H
 
+#include <ctime>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include <gfal_plugins_api.h>
 #include <davix.hpp>
@@ -63,6 +68,8 @@ public:
 
     int get_operation_timeout() const;
     void set_operation_timeout(int timeout);
+    /// held by the copies that override the operation timeout for a while
+    std::mutex operation_timeout_mutex;
 
     friend ssize_t gfal_http_token_retrieve(plugin_handle plugin_data, const char* url, const char* issuer,
                                             gboolean write_access, unsigned validity, const char* const* activities,
@@ -88,6 +95,7 @@ private:
         std::string sitename;
         std::string uri;
         std::string version;
+        time_t expires;     // 0 if it does not expire
 
         tape_endpoint_info() = default;
     } tape_endpoint_info_t;
@@ -99,10 +107,17 @@ private:
     Davix::RequestParams reference_params;
     /// map a token with read/write access flag
     TokenAccessMap token_map;
+    /// the token map is shared by the concurrent transfers of a bulk copy
+    std::mutex token_map_mutex;
     /// token retriever object (can be chained)
     std::unique_ptr<TokenRetriever> token_retriever_chain;
+    /// index of the bearer tokens, with expiry of the SE-issued ones.
+    /// Declared after the retriever chain, as it waits for the background refreshes using it
+    TokenCache token_cache;
     /// map a url with a tape endpoint info struct
     TapeEndpointMap tape_endpoint_map;
+    /// the tape endpoint map is shared by the concurrent bulk requests
+    std::mutex tape_endpoint_mutex;
 
     // Set up general request parameters
     void get_params_internal(Davix::RequestParams& params, const Davix::Uri& uri);
@@ -133,12 +148,25 @@ private:
     // @return the SE-issued token or null
     char* retrieve_and_store_se_token(const Davix::Uri& uri, const OP& operation, unsigned validity);
 
-    // Discover tape endpoint and cache it
+    // Exchange the x509 certificate for a SE-issued token, going through the retriever chain
+    // @return the token, or an empty string if none could be obtained
+    std::string exchange_se_token(const Davix::Uri& uri, bool write_access, unsigned validity);
+
+    // Store a SE-issued token in the credential map and in the token cache
+    void store_se_token(const TokenCache::Entry& entry);
+
+    // Discover tape endpoint and cache it for TAPE_REST_API_DISCOVERY_TTL seconds
     // @param endpoint the SE, defined as protocol://host
     // @param err error handle
     // @return the tape endpoint
     tape_endpoint_info_t retrieve_and_store_tape_endpoint(const std::string& endpoint, GError** err);
 
+    // Tape endpoint of the SE of a url, from the cache unless missing or expired
+    // @param url any url of the SE
+    // @param err error handle
+    // @return the tape endpoint
+    tape_endpoint_info_t get_tape_endpoint(const char* url, GError** err);
+
     // Obtain request parameters + credentials for an AWS endpoint
     void get_aws_params(Davix::RequestParams& params, const Davix::Uri& uri);
 
@@ -176,6 +204,12 @@ void http2gliberr(GError** err, int http, const char* func, const char* msg);
 // Returns errno from Davix StatusCode
 int davix2errno(Davix::StatusCode::Code code);
 
+// Returns errno of a failed request, EIO if Davix did not report an error
+int davix_request_errno(const Davix::DavixError* daverr);
+
+// Returns the error message of a failed request, the HTTP status if Davix did not report an error
+std::string davix_request_errmsg(const Davix::DavixError* daverr, int http_code);
+
 // Returns whether HTTP remote copy is enabled for the involved Storage Endpoints
 bool is_http_3rdcopy_enabled(gfal2_context_t context, const char* src, const char* dst);
 
@@ -188,6 +222,25 @@ bool is_http_3rdcopy_fallback_enabled(gfal2_context_t context, const char* src,
 // Removes +3rd from the url, if there
 void strip_3rd_from_url(const char* url_full, char* url, size_t url_size);
 
+// Run worker on the calling thread, plus up to concurrency - 1 other threads
+void gfal_http_run_workers(int concurrency, const std::function<void()>& worker);
+
+// Destination of a multipart upload. The calls throw Davix::DavixException on failure
+struct HttpMultipartDestination {
+    std::function<std::string()> initiate;
+    std::function<std::string(const std::string& upload_id, size_t part_number, const char* data, size_t len)> upload_part;
+    std::function<void(const std::string& upload_id, const std::vector<std::string>& etags)> commit;
+    std::function<void(const std::string& upload_id)> abort;
+};
+
+// Upload size bytes taken in order from read as a multipart object, with up to concurrency parts
+// in flight, but no more than max_memory bytes of parts buffered (0 for no limit).
+// The upload is aborted if it can not be completed.
+// Destination errors are put into dest_err, source errors are left to the reader.
+int gfal_http_multipart_upload(const HttpMultipartDestination& dest,
+        const std::function<dav_ssize_t(void* buffer, dav_size_t count)>& read,
+        off_t size, size_t part_size, int concurrency, size_t max_memory, GError** dest_err);
+
 // Find tape endpoint for a given method
 std::string gfal_http_discover_tape_endpoint(GfalHttpPluginData* davix, const char* url, const char* method,
                                              GError** err);
@@ -197,6 +250,20 @@ void gfal_http_delete(plugin_handle plugin_data);
 
 int gfal_http_stat(plugin_handle plugin_data, const char* url, struct stat* buf, GError** err);
 
+int gfal_http_stat_list(plugin_handle plugin_data, int nbfiles, const char* const* urls,
+                        struct stat* buffs, GError** errors);
+
+// Files of a bulk stat sharing the same parent, by unescaped name
+// A name maps to all the positions it was requested at
+struct StatListGroup {
+    std::string parent;
+    std::map<std::string, std::vector<int>> names;
+};
+
+// Group the urls of a bulk stat by parent, keeping only the parents with at least
+// min_per_parent distinct names. None if min_per_parent is 0
+std::vector<StatListGroup> gfal_http_stat_list_groups(const std::vector<std::string>& urls, int min_per_parent);
+
 int gfal_http_rename(plugin_handle plugin_data, const char* oldurl, const char* newurl, GError** err);
 
 int gfal_http_access(plugin_handle plugin_data, const char* url, int mode, GError** err);
@@ -232,6 +299,10 @@ int gfal_http_checksum(plugin_handle data, const char* url, const char* check_ty
                        off_t start_offset, size_t data_length,
                        GError ** err);
 
+int gfal_http_checksum_list(plugin_handle plugin_data, int nbfiles, const char* const* urls,
+                            const char* check_type, char** checksum_buffers, size_t buffer_length,
+                            GError** errors);
+
 // Extended attributes
 ssize_t gfal_http_getxattrG(plugin_handle plugin_data, const char* url, const char* key,
                             void* buff, size_t s_buff, GError** err);
@@ -246,6 +317,10 @@ int gfal_http_setxattrG(plugin_handle plugin_data, const char* url, const char*
 int gfal_http_copy(plugin_handle plugin_data, gfal2_context_t context, gfalt_params_t params,
         const char* src, const char* dst, GError** err);
 
+int gfal_http_copy_bulk(plugin_handle plugin_data, gfal2_context_t context, gfalt_params_t params,
+        size_t nbfiles, const char* const* srcs, const char* const* dsts, const char* const* checksums,
+        GError** op_error, GError*** file_errors);
+
 int gfal_http_copy_check(plugin_handle plugin_data, gfal2_context_t context,
         const char* src, const char* dst, gfal_url2_check check);
 
@@ -273,6 +348,17 @@ int gfal_http_release_file_list(plugin_handle plugin_data, int nbfiles, const ch
 
 int gfal_http_archive_poll(plugin_handle plugin_data, const char* url, GError** err);
 
+// A bring online token holds one or several stage request IDs. A single ID is kept as it is,
+// several are written as GFAL_HTTP_TAPE_TOKEN_PREFIX followed by "<length>:<id>" for each of them,
+// so the IDs can contain any character
+#define GFAL_HTTP_TAPE_TOKEN_PREFIX "gfal2-reqids:"
+
+// Encode stage request IDs into a token
+std::string gfal_http_tape_token_encode(const std::vector<std::string>& reqids);
+
+// Decode the stage request IDs of a token. Returns false if the token is empty or malformed
+bool gfal_http_tape_token_decode(const char* token, std::vector<std::string>& reqids);
+
 int gfal_http_archive_poll_list(plugin_handle plugin_data, int nbfiles, const char* const* urls,
                                 GError** errors);
 
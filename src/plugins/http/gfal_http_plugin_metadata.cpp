@@ -18,8 +18,16 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <cerrno>
+#include <functional>
+#include <map>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
 #include <glib.h>
 #include <unistd.h>
 #include "gfal_http_plugin.h"
@@ -69,6 +77,154 @@ int gfal_http_stat(plugin_handle plugin_data, const char* url,
 
 
 
+void gfal_http_run_workers(int concurrency, const std::function<void()>& worker)
+{
+    std::vector<std::thread> workers;
+    try {
+        for (int w = 1; w < concurrency; ++w) {
+            workers.emplace_back(worker);
+        }
+    }
+    catch (const std::system_error& e) {
+        gfal2_log(G_LOG_LEVEL_WARNING, "Could only start %zu bulk workers: %s", workers.size() + 1, e.what());
+    }
+    worker();
+    for (auto& t : workers) {
+        t.join();
+    }
+}
+
+
+std::vector<StatListGroup> gfal_http_stat_list_groups(const std::vector<std::string>& urls, int min_per_parent)
+{
+    std::map<std::string, StatListGroup> by_parent;
+    for (size_t i = 0; i < urls.size(); ++i) {
+        const std::string& url = urls[i];
+        size_t slash = url.rfind('/');
+        if (slash == std::string::npos || slash + 1 >= url.size() || url.find('?') != std::string::npos) {
+            continue;
+        }
+        std::string parent = url.substr(0, slash + 1);
+        char* unescaped = g_uri_unescape_string(url.c_str() + slash + 1, NULL);
+        std::string name = unescaped ? unescaped : url.substr(slash + 1);
+        g_free(unescaped);
+
+        // The same file may be asked for more than once
+        by_parent[parent].names[name].push_back((int)i);
+    }
+
+    std::vector<StatListGroup> groups;
+    if (min_per_parent <= 0) {
+        return groups;
+    }
+    for (auto& entry : by_parent) {
+        if ((int)entry.second.names.size() >= min_per_parent) {
+            entry.second.parent = entry.first;
+            groups.push_back(std::move(entry.second));
+        }
+    }
+    return groups;
+}
+
+
+// Stat the files of a group with a single PROPFIND over their parent
+// Returns false if the listing failed. Files missing from the listing are left to the caller.
+static bool gfal_http_stat_list_parent(GfalHttpPluginData* davix, const StatListGroup& group,
+        struct stat* buffs, std::vector<char>& done)
+{
+    Davix::DavixError* daverr = NULL;
+    Davix::RequestParams req_params;
+    davix->get_params(&req_params, Davix::Uri(group.parent), GfalHttpPluginData::OP::READ);
+    if (req_params.getProtocol() != Davix::RequestProtocol::Http &&
+        req_params.getProtocol() != Davix::RequestProtocol::Webdav) {
+        return false;
+    }
+    req_params.setProtocol(Davix::RequestProtocol::Webdav);
+
+    DAVIX_DIR* dir = davix->posix.opendirpp(&req_params, group.parent.c_str(), &daverr);
+    if (dir == NULL) {
+        gfal2_log(G_LOG_LEVEL_DEBUG, "Could not list %s, stat files one by one: %s",
+                  group.parent.c_str(), daverr ? daverr->getErrMsg().c_str() : "");
+        Davix::DavixError::clearError(&daverr);
+        return false;
+    }
+
+    // Stop reading as soon as all the requested names were seen
+    size_t remaining = group.names.size();
+    struct stat st;
+    struct dirent* de;
+    while (remaining > 0 && (de = davix->posix.readdirpp(dir, &st, &daverr)) != NULL) {
+        auto entry = group.names.find(de->d_name);
+        if (entry != group.names.end()) {
+            for (int index : entry->second) {
+                if (!done[index]) {
+                    buffs[index] = st;
+                    done[index] = 1;
+                }
+            }
+            --remaining;
+        }
+    }
+    Davix::DavixError::clearError(&daverr);
+    davix->posix.closedir(dir, &daverr);
+    Davix::DavixError::clearError(&daverr);
+    return true;
+}
+
+
+int gfal_http_stat_list(plugin_handle plugin_data, int nbfiles, const char* const* urls,
+        struct stat* buffs, GError** errors)
+{
+    GfalHttpPluginData* davix = gfal_http_get_plugin_context(plugin_data);
+    int min_per_parent = gfal2_get_opt_integer_with_default(davix->handle, "HTTP PLUGIN",
+                                                            "STAT_LIST_MIN_PER_PARENT", 0);
+    int concurrency = gfal2_get_opt_integer_with_default(davix->handle, "HTTP PLUGIN",
+                                                         "STAT_LIST_CONCURRENCY", 8);
+    if (concurrency <= 0) {
+        concurrency = 1;
+    }
+
+    // The stripped urls are kept for the per-file stats
+    std::vector<std::string> stripped(nbfiles);
+    for (int i = 0; i < nbfiles; ++i) {
+        char stripped_url[GFAL_URL_MAX_LEN];
+        strip_3rd_from_url(urls[i], stripped_url, sizeof(stripped_url));
+        stripped[i] = stripped_url;
+    }
+    std::vector<StatListGroup> groups = gfal_http_stat_list_groups(stripped, min_per_parent);
+
+    // Groups are listed first, then whatever is left is stat'ed individually
+    // Each group only touches its own files, so done needs no locking
+    std::vector<char> done(nbfiles, 0);
+    std::atomic<size_t> next_group(0), next_file(0);
+
+    auto group_worker = [&]() {
+        size_t g;
+        while ((g = next_group++) < groups.size()) {
+            gfal_http_stat_list_parent(davix, groups[g], buffs, done);
+        }
+    };
+    auto file_worker = [&]() {
+        size_t i;
+        while ((i = next_file++) < (size_t)nbfiles) {
+            if (!done[i]) {
+                gfal_http_stat(plugin_data, stripped[i].c_str(), &buffs[i], &errors[i]);
+            }
+        }
+    };
+
+    gfal_http_run_workers(concurrency, group_worker);
+    gfal_http_run_workers(concurrency, file_worker);
+
+    for (int i = 0; i < nbfiles; ++i) {
+        if (errors[i] != NULL) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
 int gfal_http_mkdirpG(plugin_handle plugin_data, const char* url, mode_t mode, gboolean rec_flag, GError** err)
 {
     char stripped_url[GFAL_URL_MAX_LEN];
@@ -383,6 +539,30 @@ int gfal_http_checksum(plugin_handle plugin_data, const char* url, const char* c
 }
 
 
+// Each checksum is a HEAD (or a GET of the checksum) request, so they are just issued concurrently
+int gfal_http_checksum_list(plugin_handle plugin_data, int nbfiles, const char* const* urls,
+        const char* check_type, char** checksum_buffers, size_t buffer_length, GError** errors)
+{
+    GfalHttpPluginData* davix = gfal_http_get_plugin_context(plugin_data);
+    int concurrency = gfal2_get_opt_integer_with_default(davix->handle, "HTTP PLUGIN",
+                                                         "CHECKSUM_LIST_CONCURRENCY", 8);
+    concurrency = std::max(1, std::min(concurrency, nbfiles));
+
+    std::atomic<int> next(0), failed(0);
+    gfal_http_run_workers(concurrency, [&]() {
+        int i;
+        while ((i = next++) < nbfiles) {
+            if (gfal_http_checksum(plugin_data, urls[i], check_type, checksum_buffers[i], buffer_length,
+                                   0, 0, &errors[i]) < 0) {
+                ++failed;
+            }
+        }
+    });
+
+    return failed ? -1 : 0;
+}
+
+
 ssize_t gfal_http_getxattrG(plugin_handle plugin_data, const char* url, const char* key,
                             void* buff, size_t s_buff, GError** err)
 {
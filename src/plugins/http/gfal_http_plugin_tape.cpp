@@ -14,8 +14,15 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 #include <json.h>
 
 #include "uri/gfal2_parsing.h"
@@ -111,10 +118,13 @@ namespace tape_rest_api {
         g_error_free(tmp_err);
     }
 
-    // Run through the full response and identify the JSON item corresponding to our path
-    // Very inefficient O(N^2) complexity but avoids complicated data structures (tape polling is time permissive)
-    struct json_object* polling_get_item_by_path(struct json_object* response, const std::string& surl) {
+    typedef std::unordered_map<std::string, struct json_object*> item_index_t;
+
+    // Index the items of a response by their path, so each file is matched in constant time
+    void index_items_by_path(struct json_object* response, item_index_t& index) {
         const int len = json_object_array_length(response);
+        index.reserve(index.size() + len);
+
         for (int i = 0; i < len; i++) {
             auto item = json_object_array_get_idx(response, i);
 
@@ -124,17 +134,104 @@ namespace tape_rest_api {
                 std::string path = item_path ? json_object_get_string(item_path) : "";
 
                 if (!path.empty()) {
-                    std::string cpath = collapse_slashes(path);
-                    std::string csurl = collapse_slashes(surl);
-
-                    if (cpath == csurl) {
-                        return item;
-                    }
+                    // Keep the first item, if the same path is listed twice
+                    index.emplace(collapse_slashes(path), item);
                 }
             }
         }
+    }
+
+    struct json_object* find_item_by_path(const item_index_t& index, const std::string& surl) {
+        auto it = index.find(collapse_slashes(surl));
+        return (it != index.end()) ? it->second : NULL;
+    }
+
+    // Send "GET /stage/<id>" and return the parsed response, checked to be about that request
+    // On failure, sets the "err" object and returns NULL
+    struct json_object* poll_stage_request(GfalHttpPluginData* davix, const char* url, const std::string& reqid,
+                                           GError** err)
+    {
+        std::string method = "/stage/" + reqid;
+        std::string tapeEndpoint = gfal_http_discover_tape_endpoint(davix, url, method.c_str(), err);
+
+        if (*err != NULL) {
+            return NULL;
+        }
+
+        Davix::DavixError* reqerr = NULL;
+        Davix::Uri uri(tapeEndpoint);
+        Davix::RequestParams params;
+
+        GetRequest request(davix->context, uri, &reqerr);
+        davix->get_params(&params, uri, GfalHttpPluginData::OP::TAPE);
+        request.setParameters(params);
+
+        if (request.executeRequest(&reqerr)) {
+            gfal2_set_error(err, http_plugin_domain, davix_request_errno(reqerr), __func__,
+                            "[Tape REST API] Stage pooling call failed: %s",
+                            davix_request_errmsg(reqerr, request.getRequestCode()).c_str());
+            Davix::DavixError::clearError(&reqerr);
+            return NULL;
+        }
+
+        if (request.getRequestCode() != 200) {
+            gfal2_set_error(err, http_plugin_domain, EINVAL, __func__,
+                            "[Tape REST API] Stage call failed: %s: %s)",
+                            davix_request_errmsg(reqerr, request.getRequestCode()).c_str(), request.getAnswerContent());
+            Davix::DavixError::clearError(&reqerr);
+            return NULL;
+        }
+
+        std::string content = std::string(request.getAnswerContent());
+
+        if (content.empty()) {
+            gfal2_set_error(err, http_plugin_domain, ENOMSG, __func__,
+                            "[Tape REST API] Response with no data");
+            return NULL;
+        }
+
+        struct json_object* json_response = json_tokener_parse(content.c_str());
+
+        if (!json_response) {
+            gfal2_set_error(err, http_plugin_domain, ENOMSG, __func__,
+                            "[Tape REST API] Malformed served response");
+            return NULL;
+        }
+
+        // Check if "id" attribute exists
+        struct json_object* id = 0;
+        bool foundId = json_object_object_get_ex(json_response, "id", &id);
+        std::string response_id = foundId ? json_object_get_string(id) : "";
+
+        // Check if "request_id" attribute matches
+        if (response_id.empty()) {
+            gfal2_set_error(err, http_plugin_domain, ENOMSG, __func__,
+                            "[Tape REST API] Request ID missing from polling response (expected id=%s)",
+                            reqid.c_str());
+            json_object_put(json_response);
+            return NULL;
+        }
+
+        if (response_id != reqid) {
+            gfal2_set_error(err, http_plugin_domain, ENOMSG, __func__,
+                            "[Tape REST API] Request ID mismatch. Expected id=%s but received id=%s",
+                            reqid.c_str(), response_id.c_str());
+            json_object_put(json_response);
+            return NULL;
+        }
 
-        return NULL;
+        // Check if "files" attribute exists
+        struct json_object* files = 0;
+        bool foundFiles = json_object_object_get_ex(json_response, "files", &files);
+
+        if (!foundFiles) {
+            gfal2_set_error(err, http_plugin_domain, ENOMSG, __func__,
+                            "[Tape REST API] Files attribute missing from server poll response");
+            json_object_put(json_response);
+            return NULL;
+        }
+
+        return json_response;
     }
 
     std::string get_archiveinfo(plugin_handle plugin_data, int nbfiles, const char* const* urls, GError** err)
@@ -162,8 +259,9 @@ namespace tape_rest_api {
         request.setRequestBody(tape_rest_api::list_files_body(nbfiles, urls));
 
         if (request.executeRequest(&reqerr)) {
-            gfal2_set_error(err, http_plugin_domain, davix2errno(reqerr->getStatus()), __func__,
-                            "[Tape REST API] Archive polling call failed: %s", reqerr->getErrMsg().c_str());
+            gfal2_set_error(err, http_plugin_domain, davix_request_errno(reqerr), __func__,
+                            "[Tape REST API] Archive polling call failed: %s",
+                            davix_request_errmsg(reqerr, request.getRequestCode()).c_str());
             Davix::DavixError::clearError(&reqerr);
             return "";
         }
@@ -171,7 +269,7 @@ namespace tape_rest_api {
         if (request.getRequestCode() != 200) {
             gfal2_set_error(err, http_plugin_domain, EINVAL, __func__,
                             "[Tape REST API] Archive polling call failed: %s: %s",
-                            reqerr->getErrMsg().c_str(), request.getAnswerContent());
+                            davix_request_errmsg(reqerr, request.getRequestCode()).c_str(), request.getAnswerContent());
             Davix::DavixError::clearError(&reqerr);
             return "";
         }
@@ -246,46 +344,77 @@ namespace tape_rest_api {
     }
 }
 
-ssize_t gfal_http_getxattr_internal(plugin_handle plugin_data, const char* url, const char *key,
-                                    char* buff, size_t s_buff, GError** err)
+std::string gfal_http_tape_token_encode(const std::vector<std::string>& reqids)
 {
-    GError* tmp_err = NULL;
-    GfalHttpPluginData* davix = gfal_http_get_plugin_context(plugin_data);
-    Davix::Uri uri(url);
+    static const std::string prefix(GFAL_HTTP_TAPE_TOKEN_PREFIX);
 
-    if (uri.getStatus() != StatusCode::OK) {
-        gfal2_set_error(err, http_plugin_domain, EINVAL, __func__, "Invalid URL: %s", url);
-        return -1;
+    // A single ID that looks like an encoded token must be encoded too
+    if (reqids.size() == 1 && reqids[0].compare(0, prefix.size(), prefix) != 0) {
+        return reqids[0];
+    }
+
+    std::stringstream token;
+    token << prefix;
+
+    for (auto it = reqids.begin(); it != reqids.end(); ++it) {
+        token << it->size() << ":" << *it;
     }
 
-    // Construct remote storage endpoint
-    std::stringstream endpoint;
-    endpoint << uri.getProtocol() << "://" << uri.getHost();
+    return token.str();
+}
+
+bool gfal_http_tape_token_decode(const char* token, std::vector<std::string>& reqids)
+{
+    static const size_t prefix_len = strlen(GFAL_HTTP_TAPE_TOKEN_PREFIX);
+    reqids.clear();
 
-    if (uri.getPort()) {
-        endpoint << ":" << uri.getPort();
+    if (!token || token[0] == '\0') {
+        return false;
     }
 
-    auto it = davix->tape_endpoint_map.find(endpoint.str());
+    if (strncmp(token, GFAL_HTTP_TAPE_TOKEN_PREFIX, prefix_len) != 0) {
+        reqids.emplace_back(token);
+        return true;
+    }
 
-    if (it == davix->tape_endpoint_map.end()) {
-        davix->retrieve_and_store_tape_endpoint(endpoint.str(), &tmp_err);
+    const char* p = token + prefix_len;
 
-        if (tmp_err != NULL) {
-            *err = g_error_copy(tmp_err);
-            g_clear_error(&tmp_err);
-            return -1;
+    while (*p != '\0') {
+        char* end = NULL;
+        errno = 0;
+        unsigned long len = strtoul(p, &end, 10);
+
+        if (!isdigit((unsigned char) *p) || *end != ':' || errno != 0 || len == 0 || strnlen(end + 1, len) < len) {
+            reqids.clear();
+            return false;
         }
 
-        it = davix->tape_endpoint_map.find(endpoint.str());
+        reqids.emplace_back(end + 1, len);
+        p = end + 1 + len;
+    }
+
+    return !reqids.empty();
+}
+
+ssize_t gfal_http_getxattr_internal(plugin_handle plugin_data, const char* url, const char *key,
+                                    char* buff, size_t s_buff, GError** err)
+{
+    GError* tmp_err = NULL;
+    GfalHttpPluginData* davix = gfal_http_get_plugin_context(plugin_data);
+    GfalHttpPluginData::tape_endpoint_info_t info = davix->get_tape_endpoint(url, &tmp_err);
+
+    if (tmp_err != NULL) {
+        *err = g_error_copy(tmp_err);
+        g_clear_error(&tmp_err);
+        return -1;
     }
 
     if (strcmp(key, GFAL_XATTR_TAPE_API_VERSION) == 0) {
-        strncpy(buff, it->second.version.c_str(), s_buff);
+        strncpy(buff, info.version.c_str(), s_buff);
     } else if (strcmp(key, GFAL_XATTR_TAPE_API_URI) == 0) {
-        strncpy(buff, it->second.uri.c_str(), s_buff);
+        strncpy(buff, info.uri.c_str(), s_buff);
     } else if (strcmp(key, GFAL_XATTR_TAPE_API_SITENAME) == 0) {
-        strncpy(buff, it->second.sitename.c_str(), s_buff);
+        strncpy(buff, info.sitename.c_str(), s_buff);
     } else {
         gfal2_set_error(err, http_plugin_domain, ENODATA, __func__,
                         "Failed to get the xattr \"%s\" (No data available)", key);
@@ -375,8 +504,9 @@ int gfal_http_bring_online_list_v2(plugin_handle plugin_data, int nbfiles, const
     request.setRequestBody(tape_rest_api::stage_request_body(pintime, nbfiles, urls, metadata));
 
     if (request.executeRequest(&reqerr)) {
-        gfal2_set_error(&tmp_err, http_plugin_domain, davix2errno(reqerr->getStatus()), __func__,
-                        "[Tape REST API] Stage call failed: %s", reqerr->getErrMsg().c_str());
+        gfal2_set_error(&tmp_err, http_plugin_domain, davix_request_errno(reqerr), __func__,
+                        "[Tape REST API] Stage call failed: %s",
+                        davix_request_errmsg(reqerr, request.getRequestCode()).c_str());
         tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
         Davix::DavixError::clearError(&reqerr);
         return -1;
@@ -385,7 +515,7 @@ int gfal_http_bring_online_list_v2(plugin_handle plugin_data, int nbfiles, const
     if (request.getRequestCode() != 201) {
         gfal2_set_error(&tmp_err, http_plugin_domain, EINVAL, __func__,
                         "[Tape REST API] Stage call failed: %s: %s",
-                        reqerr->getErrMsg().c_str(), request.getAnswerContent());
+                        davix_request_errmsg(reqerr, request.getRequestCode()).c_str(), request.getAnswerContent());
         tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
         Davix::DavixError::clearError(&reqerr);
         return -1;
@@ -419,14 +549,22 @@ int gfal_http_bring_online_list_v2(plugin_handle plugin_data, int nbfiles, const
         return -1;
     }
 
-    std::string reqid = json_object_get_string(id);
-
-    // Copy request id to token buffer
-    g_strlcpy(token, reqid.c_str(), tsize);
+    std::string reqid = gfal_http_tape_token_encode({json_object_get_string(id)});
 
     // Free the top JSON object
     json_object_put(json_response);
 
+    // A truncated request id could not be polled
+    if (reqid.size() >= tsize) {
+        gfal2_set_error(&tmp_err, http_plugin_domain, ENOBUFS, __func__,
+                        "[Tape REST API] The token buffer is too small for the request ID %s", reqid.c_str());
+        tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
+        return -1;
+    }
+
+    // Copy request id to token buffer
+    g_strlcpy(token, reqid.c_str(), tsize);
+
     return 0;
 }
 
@@ -438,15 +576,24 @@ int gfal_http_abort_files(plugin_handle plugin_data, int nbfiles, const char* co
     }
 
     GError* tmp_err = NULL;
-    if (!token || strlen(token) == 0) {
+    std::vector<std::string> reqids;
+    if (!gfal_http_tape_token_decode(token, reqids)) {
+        gfal2_set_error(&tmp_err, http_plugin_domain, EINVAL, __func__,
+                        "The request ID was not provided or is malformed");
+        tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
+        return -1;
+    }
+
+    // The files must belong to the request they are cancelled from
+    if (reqids.size() > 1) {
         gfal2_set_error(&tmp_err, http_plugin_domain, EINVAL, __func__,
-                        "The request ID was not provided");
+                        "Files can only be cancelled from one stage request at a time");
         tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
         return -1;
     }
 
     std::stringstream method;
-    method << "/stage/" << token << "/cancel";
+    method << "/stage/" << reqids[0] << "/cancel";
 
     // Find out Tape Rest API endpoint
     GfalHttpPluginData* davix = gfal_http_get_plugin_context(plugin_data);
@@ -469,8 +616,9 @@ int gfal_http_abort_files(plugin_handle plugin_data, int nbfiles, const char* co
     request.setRequestBody(tape_rest_api::list_files_body(nbfiles, urls));
 
     if (request.executeRequest(&reqerr)) {
-        gfal2_set_error(&tmp_err, http_plugin_domain, davix2errno(reqerr->getStatus()), __func__,
-                        "[Tape REST API] Cancel call failed: %s", reqerr->getErrMsg().c_str());
+        gfal2_set_error(&tmp_err, http_plugin_domain, davix_request_errno(reqerr), __func__,
+                        "[Tape REST API] Cancel call failed: %s",
+                        davix_request_errmsg(reqerr, request.getRequestCode()).c_str());
         tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
         Davix::DavixError::clearError(&reqerr);
         return -1;
@@ -479,7 +627,7 @@ int gfal_http_abort_files(plugin_handle plugin_data, int nbfiles, const char* co
     if (request.getRequestCode() != 200) {
         gfal2_set_error(&tmp_err, http_plugin_domain, EINVAL, __func__,
                         "[Tape REST API] Stage call failed: %s: %s",
-                        reqerr->getErrMsg().c_str(), request.getAnswerContent());
+                        davix_request_errmsg(reqerr, request.getRequestCode()).c_str(), request.getAnswerContent());
         tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
         Davix::DavixError::clearError(&reqerr);
         return -1;
@@ -510,97 +658,63 @@ int gfal_http_bring_online_poll_list(plugin_handle plugin_data, int nbfiles, con
     }
 
     GError* tmp_err = NULL;
-    if (!token || strlen(token) == 0) {
-        gfal2_set_error(&tmp_err, http_plugin_domain, EINVAL, __func__,
-                        "The request ID was not provided");
-        tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
-        return -1;
-    }
-
-    std::stringstream method;
-    method << "/stage/" << token;
 
-    // Find out Tape Rest API endpoint
-    GfalHttpPluginData* davix = gfal_http_get_plugin_context(plugin_data);
-    std::string tapeEndpoint = gfal_http_discover_tape_endpoint(davix, urls[0], method.str().c_str(), &tmp_err);
+    // Files of several stage requests can be polled at once, see gfal_http_tape_token_encode
+    std::vector<std::string> reqids;
 
-    if (tmp_err != NULL) {
-        tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
-        return -1;
-    }
-
-    // Construct and send "GET /stage/<token>" request
-    Davix::DavixError* reqerr = NULL;
-    Davix::Uri uri(tapeEndpoint);
-    Davix::RequestParams params;
-
-    GetRequest request(davix->context, uri, &reqerr);
-    davix->get_params(&params, uri, GfalHttpPluginData::OP::TAPE);
-    request.setParameters(params);
-
-    if (request.executeRequest(&reqerr)) {
-        gfal2_set_error(&tmp_err, http_plugin_domain, davix2errno(reqerr->getStatus()), __func__,
-                        "[Tape REST API] Stage pooling call failed: %s", reqerr->getErrMsg().c_str());
-        tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
-        Davix::DavixError::clearError(&reqerr);
-        return -1;
-    }
-
-    if (request.getRequestCode() != 200) {
+    if (!gfal_http_tape_token_decode(token, reqids)) {
         gfal2_set_error(&tmp_err, http_plugin_domain, EINVAL, __func__,
-                        "[Tape REST API] Stage call failed: %s: %s)",
-                        reqerr->getErrMsg().c_str(), request.getAnswerContent());
+                        "The request ID was not provided or is malformed");
         tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
-        Davix::DavixError::clearError(&reqerr);
         return -1;
     }
 
-    std::string content = std::string(request.getAnswerContent());
-
-    if (content.empty()) {
-        gfal2_set_error(&tmp_err, http_plugin_domain, ENOMSG, __func__,
-                        "[Tape REST API] Response with no data");
-        tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
-        return -1;
-    }
-
-    struct json_object* json_response = json_tokener_parse(content.c_str());
+    // Find out Tape Rest API endpoint once, before the concurrent polls
+    GfalHttpPluginData* davix = gfal_http_get_plugin_context(plugin_data);
+    gfal_http_discover_tape_endpoint(davix, urls[0], "/stage/", &tmp_err);
 
-    if (!json_response) {
-        gfal2_set_error(&tmp_err, http_plugin_domain, ENOMSG, __func__,
-                        "[Tape REST API] Malformed served response");
+    if (tmp_err != NULL) {
         tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
         return -1;
     }
 
-    // Check if "id" attribute exists
-    struct json_object* id = 0;
-    bool foundId = json_object_object_get_ex(json_response, "id", &id);
-    std::string reqid = foundId ? json_object_get_string(id) : "";
+    // Each request is polled with its own "GET /stage/<id>", a few of them at the same time
+    std::vector<struct json_object*> responses(reqids.size(), NULL);
+    std::vector<GError*> request_errors(reqids.size(), NULL);
+    std::atomic<size_t> next(0);
 
-    // Check if "request_id" attribute matches
-    if (reqid.empty()) {
-        gfal2_set_error(&tmp_err, http_plugin_domain, ENOMSG, __func__,
-                        "[Tape REST API] Request ID missing from polling response (expected id=%s)", token);
-        tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
-        return -1;
-    }
+    int concurrency = gfal2_get_opt_integer_with_default(davix->handle, "HTTP PLUGIN",
+                                                         "TAPE_REST_API_POLL_CONCURRENCY", 8);
+    concurrency = std::max(1, std::min<int>(concurrency, reqids.size()));
 
-    if (reqid != token) {
-        gfal2_set_error(&tmp_err, http_plugin_domain, ENOMSG, __func__,
-                        "[Tape REST API] Request ID mismatch. Expected id=%s but received id=%s", token, reqid.c_str());
-        tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
-        return -1;
+    gfal_http_run_workers(concurrency, [&]() {
+        for (size_t r = next++; r < reqids.size(); r = next++) {
+            responses[r] = tape_rest_api::poll_stage_request(davix, urls[0], reqids[r], &request_errors[r]);
+        }
+    });
+
+    // Match the files against the items of all the responses
+    tape_rest_api::item_index_t index;
+    GError* request_error = NULL;
+    size_t failed_requests = 0;
+
+    for (size_t r = 0; r < reqids.size(); ++r) {
+        if (responses[r]) {
+            struct json_object* files = 0;
+            json_object_object_get_ex(responses[r], "files", &files);
+            tape_rest_api::index_items_by_path(files, index);
+        } else {
+            failed_requests++;
+            if (request_error == NULL) {
+                request_error = request_errors[r];
+                request_errors[r] = NULL;
+            }
+            g_clear_error(&request_errors[r]);
+        }
     }
 
-    // Check if "files" attribute exists
-    struct json_object* files = 0;
-    bool foundFiles = json_object_object_get_ex(json_response, "files", &files);
-
-    if (!foundFiles) {
-        gfal2_set_error(&tmp_err, http_plugin_domain, ENOMSG, __func__,
-                        "[Tape REST API] Files attribute missing from server poll response");
-        tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
+    if (failed_requests == reqids.size()) {
+        tape_rest_api::copyErrors(request_error, nbfiles, errors);
         return -1;
     }
 
@@ -610,12 +724,17 @@ int gfal_http_bring_online_poll_list(plugin_handle plugin_data, int nbfiles, con
 
     for (int i = 0; i < nbfiles; ++i) {
         std::string path = Davix::Uri(urls[i]).getPath();
-        struct json_object* file = tape_rest_api::polling_get_item_by_path(files, path);
+        struct json_object* file = tape_rest_api::find_item_by_path(index, path);
 
         if (file == NULL) {
             error_count++;
-            gfal2_set_error(&errors[i], http_plugin_domain, ENOMSG, __func__,
-                            "[Tape REST API] Missing response item for path=%s", path.c_str());
+            // The file may belong to a request that could not be polled
+            if (request_error != NULL) {
+                errors[i] = g_error_copy(request_error);
+            } else {
+                gfal2_set_error(&errors[i], http_plugin_domain, ENOMSG, __func__,
+                                "[Tape REST API] Missing response item for path=%s", path.c_str());
+            }
             continue;
         }
 
@@ -683,8 +802,13 @@ int gfal_http_bring_online_poll_list(plugin_handle plugin_data, int nbfiles, con
         }
     }
 
-    // Free the top JSON object
-    json_object_put(json_response);
+    // Free the top JSON objects
+    for (auto response : responses) {
+        if (response) {
+            json_object_put(response);
+        }
+    }
+    g_clear_error(&request_error);
 
     // All files are on disk: return 1
     if (online_count == nbfiles) {
@@ -726,7 +850,9 @@ ssize_t gfal_http_status_getxattr(plugin_handle plugin_data, const char* url, ch
     }
 
     std::string path = Uri(url).getPath();
-    struct json_object* file = tape_rest_api::polling_get_item_by_path(json_response, path);
+    tape_rest_api::item_index_t index;
+    tape_rest_api::index_items_by_path(json_response, index);
+    struct json_object* file = tape_rest_api::find_item_by_path(index, path);
     tape_rest_api::file_locality_t locality = tape_rest_api::get_file_locality(file, path, &tmp_err);
 
     // Free the top JSON object
@@ -792,13 +918,16 @@ int gfal_http_archive_poll_list(plugin_handle plugin_data, int nbfiles, const ch
         return -1;
     }
 
+    tape_rest_api::item_index_t index;
+    tape_rest_api::index_items_by_path(json_response, index);
+
     // Iterate over the file list
     int ontape_count = 0;
     int error_count = 0;
 
     for (int i = 0; i < nbfiles; ++i) {
         std::string path = Davix::Uri(urls[i]).getPath();
-        struct json_object* file = tape_rest_api::polling_get_item_by_path(json_response, path);
+        struct json_object* file = tape_rest_api::find_item_by_path(index, path);
         auto locality = tape_rest_api::get_file_locality(file, path, &tmp_err);
 
         if (tmp_err != NULL) {
@@ -860,8 +989,24 @@ int gfal_http_release_file_list(plugin_handle plugin_data, int nbfiles, const ch
     }
 
     GError* tmp_err = NULL;
+    std::vector<std::string> reqids;
+
+    if (request_id && strlen(request_id) > 0 && !gfal_http_tape_token_decode(request_id, reqids)) {
+        gfal2_set_error(&tmp_err, http_plugin_domain, EINVAL, __func__,
+                        "Malformed request ID: %s", request_id);
+        tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
+        return -1;
+    }
+
+    if (reqids.size() > 1) {
+        gfal2_set_error(&tmp_err, http_plugin_domain, EINVAL, __func__,
+                        "Files can only be released from one stage request at a time");
+        tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
+        return -1;
+    }
+
     std::stringstream method;
-    method << "/release/" << ((request_id && strlen(request_id) > 0) ? request_id : "gfal2-placeholder-id");
+    method << "/release/" << (!reqids.empty() ? reqids[0] : "gfal2-placeholder-id");
 
     // Find out Tape REST API endpoint
     GfalHttpPluginData* davix = gfal_http_get_plugin_context(plugin_data);
@@ -884,8 +1029,9 @@ int gfal_http_release_file_list(plugin_handle plugin_data, int nbfiles, const ch
     request.setRequestBody(tape_rest_api::list_files_body(nbfiles, urls));
 
     if (request.executeRequest(&reqerr)) {
-        gfal2_set_error(&tmp_err, http_plugin_domain, davix2errno(reqerr->getStatus()), __func__,
-                        "[Tape REST API] Release call failed: %s", reqerr->getErrMsg().c_str());
+        gfal2_set_error(&tmp_err, http_plugin_domain, davix_request_errno(reqerr), __func__,
+                        "[Tape REST API] Release call failed: %s",
+                        davix_request_errmsg(reqerr, request.getRequestCode()).c_str());
         tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
         Davix::DavixError::clearError(&reqerr);
         return -1;
@@ -894,7 +1040,7 @@ int gfal_http_release_file_list(plugin_handle plugin_data, int nbfiles, const ch
     if (request.getRequestCode() != 200) {
         gfal2_set_error(&tmp_err, http_plugin_domain, EINVAL, __func__,
                         "[Tape REST API] Release call failed: %s: %s",
-                        reqerr->getErrMsg().c_str(), request.getAnswerContent());
+                        davix_request_errmsg(reqerr, request.getRequestCode()).c_str(), request.getAnswerContent());
         tape_rest_api::copyErrors(tmp_err, nbfiles, errors);
         Davix::DavixError::clearError(&reqerr);
         return -1;
@@ -18,8 +18,11 @@
  * limitations under the License.
  */
 
+#include <set>
 #include <sstream>
 #include <cstring>
+#include <thread>
+#include <vector>
 #include "json.h"
 
 #include "gfal_http_plugin.h"
@@ -466,3 +469,241 @@ void SciTokensRetriever::prepare_request(HttpRequest& request, const std::string
     request.addHeaderField("Content-Type", "application/x-www-form-urlencoded");
     request.setRequestBody("grant_type=client_credentials");
 }
+
+TokenCache::TokenCache(): generation(0), indexed(false), refreshes(0)
+{
+}
+
+TokenCache::~TokenCache()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    refreshes_cv.wait(lock, [this] { return refreshes == 0; });
+}
+
+void TokenCache::reindex(gfal2_context_t handle)
+{
+    auto cred_map_callback = [](const char* url_prefix, const gfal2_cred_t* cred, void* user_data) {
+        auto bearers = static_cast<std::map<std::string, std::string, std::greater<std::string>>*>(user_data);
+
+        if (strcmp(cred->type, GFAL_CRED_BEARER) == 0) {
+            (*bearers)[url_prefix] = cred->value;
+        }
+    };
+
+    bearers.clear();
+    generation = gfal2_cred_get_generation(handle);
+    gfal2_cred_foreach(handle, cred_map_callback, &bearers);
+    indexed = true;
+}
+
+bool TokenCache::find(gfal2_context_t handle, const std::string& url, bool extended_search,
+                      const Filter& filter, std::string& prefix, std::string& token)
+{
+    std::vector<std::pair<std::string, std::string>> candidates;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!indexed || generation != gfal2_cred_get_generation(handle)) {
+            reindex(handle);
+        }
+
+        // Tokens of paths below the url sort right before it
+        if (extended_search) {
+            for (auto it = bearers.lower_bound(url + '\xff'); it != bearers.end(); ++it) {
+                const std::string& path = it->first;
+
+                if (path.compare(0, url.size(), url) != 0) {
+                    break;
+                }
+                if (path.size() > url.size() && (url.back() == '/' || path[url.size()] == '/')) {
+                    candidates.emplace_back(*it);
+                }
+            }
+        }
+
+        // Then the url itself and its parents, cut before or after each slash
+        auto add_candidate = [&](const std::string& path) {
+            auto it = bearers.find(path);
+
+            if (it != bearers.end() && (candidates.empty() || candidates.back().first != path)) {
+                candidates.emplace_back(*it);
+            }
+        };
+
+        add_candidate(url);
+        for (size_t pos = url.rfind('/'); pos != std::string::npos && pos > 0; pos = url.rfind('/', pos - 1)) {
+            add_candidate(url.substr(0, pos + 1));
+            add_candidate(url.substr(0, pos));
+        }
+    }
+
+    // The filter may take other locks, so it runs without holding this one
+    for (auto& candidate : candidates) {
+        if (filter(candidate.first, candidate.second)) {
+            prefix = candidate.first;
+            token = candidate.second;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void TokenCache::add(gfal2_context_t handle, guint previous_generation, const Entry& entry)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    time_t now = time(NULL);
+
+    // Update the index in place if nothing else changed the credential map meanwhile
+    guint current = gfal2_cred_get_generation(handle);
+    if (indexed && generation == previous_generation && current == previous_generation + 1) {
+        bearers[entry.prefix] = entry.token;
+        generation = current;
+    }
+
+    Issued& issued_token = issued[entry.token];
+    issued_token.entry = entry;
+    issued_token.issued = now;
+    issued_token.expires = now + static_cast<time_t>(entry.validity) * 60;
+    issued_token.refreshing = false;
+    issued_token.replacement.clear();
+}
+
+TokenCache::State TokenCache::state(const std::string& token, time_t margin)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = issued.find(token);
+
+    if (it == issued.end()) {
+        return State::UNKNOWN;
+    }
+
+    time_t now = time(NULL);
+    const Issued& issued_token = it->second;
+
+    if (now + margin >= issued_token.expires) {
+        return State::EXPIRED;
+    }
+    if (now >= issued_token.issued + (issued_token.expires - issued_token.issued) / 2) {
+        return State::STALE;
+    }
+    return State::VALID;
+}
+
+std::string TokenCache::exchange(const std::string& scope, const Exchange& exchange)
+{
+    std::shared_ptr<Inflight> flight;
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = inflight.find(scope);
+
+    if (it != inflight.end()) {
+        flight = it->second;
+        gfal2_log(G_LOG_LEVEL_DEBUG, "(SEToken) Waiting for the token exchange already running for %s", scope.c_str());
+        ++flight->waiters;
+        flight->cv.wait(lock, [&flight] { return flight->done; });
+        --flight->waiters;
+        return flight->token;
+    }
+
+    flight = std::make_shared<Inflight>();
+    inflight[scope] = flight;
+    lock.unlock();
+
+    std::string token;
+    try {
+        token = exchange();
+    } catch (...) {
+        // Waiting threads must be released in any case
+    }
+
+    lock.lock();
+    flight->done = true;
+    flight->token = token;
+    inflight.erase(scope);
+    lock.unlock();
+    flight->cv.notify_all();
+    return token;
+}
+
+void TokenCache::refresh(const std::string& token, const Refresh& refresh)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = issued.find(token);
+
+    // A failed refresh is not retried, the token will be exchanged again once expired
+    if (it == issued.end() || it->second.refreshing) {
+        return;
+    }
+
+    it->second.refreshing = true;
+    ++refreshes;
+    Entry entry = it->second.entry;
+
+    gfal2_log(G_LOG_LEVEL_DEBUG, "(SEToken) Refreshing token of credential_map[%s] in the background",
+              entry.prefix.c_str());
+
+    std::thread([this, entry, refresh]() {
+        std::string replacement;
+        try {
+            replacement = refresh(entry);
+        } catch (...) {
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = issued.find(entry.token);
+        if (it != issued.end()) {
+            it->second.replacement = replacement;
+        }
+        --refreshes;
+        refreshes_cv.notify_all();
+    }).detach();
+}
+
+bool TokenCache::take_refreshed(const std::string& token, Entry& replacement)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = issued.find(token);
+
+    if (it == issued.end() || it->second.replacement.empty()) {
+        return false;
+    }
+
+    replacement = it->second.entry;
+    replacement.token = it->second.replacement;
+    it->second.replacement.clear();
+    return true;
+}
+
+std::vector<std::string> TokenCache::evict_expired(gfal2_context_t handle)
+{
+    std::vector<std::string> evicted;
+    std::lock_guard<std::mutex> lock(mutex);
+    time_t now = time(NULL);
+
+    if (!indexed || generation != gfal2_cred_get_generation(handle)) {
+        reindex(handle);
+    }
+
+    std::set<std::string> in_use;
+    for (auto& bearer : bearers) {
+        in_use.insert(bearer.second);
+    }
+
+    for (auto it = issued.begin(); it != issued.end();) {
+        if (it->second.expires <= now && !it->second.refreshing && in_use.count(it->first) == 0) {
+            evicted.push_back(it->first);
+            it = issued.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return evicted;
+}
+
+int TokenCache::exchange_waiters(const std::string& scope)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = inflight.find(scope);
+    return (it == inflight.end()) ? 0 : it->second->waiters;
+}
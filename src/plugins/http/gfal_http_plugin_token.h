@@ -21,6 +21,13 @@
 #ifndef _GFAL_HTTP_PLUGIN_TOKEN_H
 #define _GFAL_HTTP_PLUGIN_TOKEN_H
 
+#include <condition_variable>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <davix.hpp>
 
 #include "gfal_http_plugin.h"
@@ -215,4 +222,112 @@ protected:
                          bool write_access, unsigned validity, const char* const* activities) override;
 };
 
+/**
+ * Index of the bearer tokens found in the Gfal2 credential map, together with
+ * the expiry of the SE-issued ones.
+ *
+ * The index is only rebuilt when the credential map changes, so finding the token of a url
+ * costs a few map searches (one per directory level) instead of a walk over all the credentials.
+ * SE-issued tokens past half of their lifetime are refreshed in the background, and concurrent
+ * exchanges for the same scope (url and access mode) are coalesced into a single one.
+ */
+class TokenCache {
+public:
+    enum class State {
+        UNKNOWN,    // not issued through the cache (i.e. user-set), assumed valid
+        VALID,
+        STALE,      // still valid, but should be refreshed
+        EXPIRED
+    };
+
+    /// SE-issued token, as stored in the credential map
+    struct Entry {
+        std::string prefix;
+        std::string token;
+        bool write_access;
+        unsigned validity;  // requested validity, in minutes
+    };
+
+    typedef std::function<bool(const std::string& prefix, const std::string& token)> Filter;
+    typedef std::function<std::string()> Exchange;
+    typedef std::function<std::string(const Entry& entry)> Refresh;
+
+    TokenCache();
+
+    /// Wait for the background refreshes
+    ~TokenCache();
+
+    /**
+     * Find the bearer token of the credential map for the url, in the same order
+     * as a walk over the credential map: longest matching prefix first, preceded,
+     * when extended_search is set, by tokens of paths below the url.
+     * @param filter called for each candidate, returns false to skip it
+     * @return true if a token was found, with its prefix
+     */
+    bool find(gfal2_context_t handle, const std::string& url, bool extended_search,
+              const Filter& filter, std::string& prefix, std::string& token);
+
+    /**
+     * Record a token the caller just stored in the credential map
+     * @param generation credential map generation before the token was stored
+     */
+    void add(gfal2_context_t handle, guint generation, const Entry& entry);
+
+    /// Expiry state of a token. It expires margin seconds ahead of its end of validity
+    State state(const std::string& token, time_t margin);
+
+    /**
+     * Run exchange for scope, or, if another thread is already doing it,
+     * wait for that one and return its result
+     */
+    std::string exchange(const std::string& scope, const Exchange& exchange);
+
+    /// Obtain a replacement for the token in the background, if not already in progress
+    void refresh(const std::string& token, const Refresh& refresh);
+
+    /// Return the replacement of the token obtained by a background refresh, if any
+    bool take_refreshed(const std::string& token, Entry& replacement);
+
+    /**
+     * Forget the expired tokens that are no longer in the credential map
+     * Those still in it are kept, so they keep being seen as expired instead of user-set
+     * @return the tokens forgotten
+     */
+    std::vector<std::string> evict_expired(gfal2_context_t handle);
+
+    /// Number of threads waiting for the exchange running for scope
+    int exchange_waiters(const std::string& scope);
+
+private:
+    struct Issued {
+        Entry entry;
+        time_t issued, expires;
+        bool refreshing;
+        std::string replacement;
+    };
+
+    struct Inflight {
+        bool done = false;
+        int waiters = 0;
+        std::string token;
+        std::condition_variable cv;
+    };
+
+    void reindex(gfal2_context_t handle);
+
+    std::mutex mutex;
+    /// credential map generation the index was built from
+    guint generation;
+    bool indexed;
+    /// bearer tokens by url prefix, sorted as in the credential map (longest first)
+    std::map<std::string, std::string, std::greater<std::string>> bearers;
+    /// SE-issued tokens
+    std::map<std::string, Issued> issued;
+    /// exchanges in progress, by scope
+    std::map<std::string, std::shared_ptr<Inflight>> inflight;
+    /// background refreshes in progress
+    int refreshes;
+    std::condition_variable refreshes_cv;
+};
+
 #endif //_GFAL_HTTP_PLUGIN_TOKEN_H
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) CERN 2023
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _GFAL_HTTP_STREAM_PREFETCHER_H
+#define _GFAL_HTTP_STREAM_PREFETCHER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <davix.hpp>
+
+#include "gfal_http_plugin.h"
+
+// Reads the source ahead of the upload into a ring of buffers,
+// so the source fetch overlaps with the upload of the previous chunks.
+// Chunks are numbered in source order, and the consumer drains them in that order.
+// By default a single reader fills them sequentially; with a range reader, several
+// readers fetch disjoint ranges of the source at the same time.
+class HttpStreamPrefetcher {
+public:
+    typedef std::function<dav_ssize_t(void* buffer, dav_size_t count, dav_off_t offset, GError** err)> RangeReader;
+
+    HttpStreamPrefetcher(gfal2_context_t context, int source_fd, size_t depth, size_t buffer_size):
+        context(context), source_fd(source_fd), total_size(0), nreaders(1), ring(depth),
+        next_fill(0), next_consume(0), end(SIZE_MAX), stop(false), error(NULL)
+    {
+        for (auto& chunk : ring) {
+            chunk.data.resize(buffer_size);
+        }
+    }
+
+    ~HttpStreamPrefetcher()
+    {
+        Stop();
+        g_clear_error(&error);
+    }
+
+    // Fetch the source with nreaders parallel ranged reads instead of reading source_fd
+    // Must be called before Start
+    void SetRangeReader(const RangeReader& reader, off_t size, size_t n)
+    {
+        range_reader = reader;
+        total_size = size;
+        nreaders = std::max<size_t>(1, std::min(n, ring.size()));
+    }
+
+    void Start()
+    {
+        stop = false;
+        next_fill = next_consume = 0;
+        end = SIZE_MAX;
+        for (auto& chunk : ring) {
+            chunk.ready = false;
+        }
+        for (size_t i = 0; i < nreaders; ++i) {
+            readers.emplace_back(&HttpStreamPrefetcher::Run, this);
+        }
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        readers.clear();
+    }
+
+    // Restart from the beginning of the source
+    int Rewind(GError** err)
+    {
+        Stop();
+        g_clear_error(&error);
+        if (!range_reader && gfal2_lseek(context, source_fd, 0, SEEK_SET, err) < 0) {
+            return -1;
+        }
+        Start();
+        return 0;
+    }
+
+    // Copy up to buflen bytes of the next prefetched chunk into buffer
+    // Returns 0 at the end of the source, -1 on error
+    dav_ssize_t Read(void* buffer, size_t buflen, GError** err)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return next_consume >= end || ring[next_consume % ring.size()].ready; });
+        if (next_consume >= end) {
+            if (error) {
+                g_propagate_error(err, g_error_copy(error));
+                return -1;
+            }
+            return 0;
+        }
+        Chunk& chunk = ring[next_consume % ring.size()];
+        lock.unlock();
+
+        // The readers do not touch a ready chunk, so it can be drained without the lock
+        size_t n = std::min(buflen, chunk.size - chunk.consumed);
+        memcpy(buffer, chunk.data.data() + chunk.consumed, n);
+        chunk.consumed += n;
+
+        if (chunk.consumed == chunk.size) {
+            lock.lock();
+            chunk.ready = false;
+            ++next_consume;
+            lock.unlock();
+            cv.notify_all();
+        }
+        return n;
+    }
+
+private:
+    struct Chunk {
+        std::vector<char> data;
+        size_t size = 0;
+        size_t consumed = 0;
+        bool ready = false;
+    };
+
+    // Fill the whole chunk from its range of the source
+    dav_ssize_t ReadRange(Chunk& chunk, size_t seq, GError** err)
+    {
+        off_t offset = seq * chunk.data.size();
+        if (offset >= total_size) {
+            return 0;
+        }
+        size_t count = std::min<off_t>(chunk.data.size(), total_size - offset);
+        size_t done = 0;
+        while (done < count) {
+            dav_ssize_t n = range_reader(chunk.data.data() + done, count - done, offset + done, err);
+            if (n < 0) {
+                return -1;
+            }
+            else if (n == 0) {
+                gfal2_set_error(err, http_plugin_domain, EIO, __func__,
+                    "Source ended at %lld, expected %lld bytes", (long long)(offset + done), (long long)total_size);
+                return -1;
+            }
+            done += n;
+        }
+        return done;
+    }
+
+    void Run()
+    {
+        while (true) {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return stop || next_fill >= end || next_fill - next_consume < ring.size(); });
+            if (stop || next_fill >= end) {
+                return;
+            }
+            size_t seq = next_fill++;
+            Chunk& chunk = ring[seq % ring.size()];
+            lock.unlock();
+
+            GError* tmp_err = NULL;
+            dav_ssize_t n;
+            if (range_reader) {
+                n = ReadRange(chunk, seq, &tmp_err);
+            }
+            else {
+                n = gfal2_read(context, source_fd, chunk.data.data(), chunk.data.size(), &tmp_err);
+            }
+
+            lock.lock();
+            if (n <= 0) {
+                // Keep the error of the earliest failed chunk, the later ones are never consumed
+                if (seq < end) {
+                    end = seq;
+                    g_clear_error(&error);
+                    error = tmp_err;
+                    tmp_err = NULL;
+                }
+                g_clear_error(&tmp_err);
+            }
+            else {
+                chunk.size = n;
+                chunk.consumed = 0;
+                chunk.ready = true;
+            }
+            lock.unlock();
+            cv.notify_all();
+        }
+    }
+
+    gfal2_context_t context;
+    int source_fd;
+    RangeReader range_reader;
+    off_t total_size;
+    size_t nreaders;
+    std::vector<Chunk> ring;
+    size_t next_fill, next_consume, end;
+    bool stop;
+    GError* error;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::thread> readers;
+};
+
+#endif // _GFAL_HTTP_STREAM_PREFETCHER_H
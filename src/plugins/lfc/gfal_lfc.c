@@ -374,9 +374,11 @@ static int lfc_lstatG(plugin_handle handle, const char *path, struct stat *st, G
             if ((ret = gsimplecache_take_one_kstr(ops->cache_stat, url_path, st)) ==
                 0) { // take the version of the buffer
                 gfal2_log(G_LOG_LEVEL_DEBUG, " lfc_lstatG -> value taken from cache");
+                gfal2_metrics_cache_lookup(ops->cache_stat_metrics, TRUE);
             }
             else {
                 gfal2_log(G_LOG_LEVEL_DEBUG, " lfc_lstatG -> value not in cache, do normal call");
+                gfal2_metrics_cache_lookup(ops->cache_stat_metrics, FALSE);
                 gfal_auto_maintain_session(ops, &tmp_err);
                 if (!tmp_err) {
                     ret = ops->lstat(url_path, &statbuf);
@@ -1023,6 +1025,7 @@ gfal_plugin_interface gfal_plugin_init(gfal2_context_t handle, GError **err)
     ops->handle = handle;
 
     ops->cache_stat = gsimplecache_new(5000, &internal_stat_copy, sizeof(struct stat));
+    ops->cache_stat_metrics = gfal2_metrics_register_cache(handle, "lfc_stat");
     gfal_lfc_regex_compile(&(ops->rex), err);
     lfc_plugin.plugin_data = (void *) ops;
     lfc_plugin.priority = GFAL_PLUGIN_PRIORITY_CATALOG;
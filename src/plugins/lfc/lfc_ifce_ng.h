@@ -56,6 +56,7 @@ struct lfc_ops {
     regex_t rex; // regular expression compiled
     gfal2_context_t handle;
     GSimpleCache* cache_stat;
+    gfal_metrics_cache_t cache_stat_metrics;
 
     // Store X509_USER_* environment prior to setenv calls so it can be restored
     char *env_user_cert, *env_user_key, *env_user_proxy;
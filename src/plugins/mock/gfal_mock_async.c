@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gfal_mock_plugin.h"
+#include <string.h>
+
+
+// A request waiting for its emulated latency to pass
+// All of them are served by a single thread, the same way a real plugin
+// would wait for the replies on its connections
+typedef struct {
+    GTimeVal deadline;
+    gfal2_async_request_t req;
+    MockNetwork net;
+} MockAsyncEntry;
+
+
+static gint gfal_plugin_mock_time_compare(const GTimeVal *a, const GTimeVal *b)
+{
+    if (a->tv_sec != b->tv_sec) {
+        return a->tv_sec < b->tv_sec ? -1 : 1;
+    }
+    if (a->tv_usec != b->tv_usec) {
+        return a->tv_usec < b->tv_usec ? -1 : 1;
+    }
+    return 0;
+}
+
+
+static gint gfal_plugin_mock_async_compare(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    return gfal_plugin_mock_time_compare(&((const MockAsyncEntry*)a)->deadline,
+        &((const MockAsyncEntry*)b)->deadline);
+}
+
+
+static void gfal_plugin_mock_async_reply(MockPluginData *mdata, MockAsyncEntry *entry)
+{
+    gfal2_async_request_t req = entry->req;
+    GError *error = NULL;
+
+    ssize_t result = gfal_plugin_mock_network_fail(&entry->net, &error);
+    if (result == 0) {
+        switch (req->op) {
+            case GFAL2_ASYNC_STAT:
+            case GFAL2_ASYNC_LSTAT:
+                result = gfal_plugin_mock_stat_reply(mdata, req->url, &req->stat, &error);
+                break;
+            default:
+                result = gfal_mock_checksum_reply(req->url, &entry->net, req->checksum_type,
+                    req->buffer, req->size, req->offset, req->length, &error);
+        }
+    }
+    gfal2_async_complete(req, result, error);
+}
+
+
+static gpointer gfal_plugin_mock_async_loop(gpointer data)
+{
+    MockPluginData *mdata = data;
+
+    g_mutex_lock(mdata->async_lock);
+    while (!mdata->async_stop) {
+        MockAsyncEntry *entry = g_queue_peek_head(&mdata->async_pending);
+        if (entry == NULL) {
+            g_cond_wait(mdata->async_cond, mdata->async_lock);
+            continue;
+        }
+
+        GTimeVal now;
+        g_get_current_time(&now);
+        if (gfal_plugin_mock_time_compare(&now, &entry->deadline) < 0) {
+            // Woken up earlier if a request with a closer deadline arrives
+            g_cond_timed_wait(mdata->async_cond, mdata->async_lock, &entry->deadline);
+            continue;
+        }
+
+        g_queue_pop_head(&mdata->async_pending);
+        g_mutex_unlock(mdata->async_lock);
+        gfal_plugin_mock_async_reply(mdata, entry);
+        g_free(entry);
+        g_mutex_lock(mdata->async_lock);
+    }
+    g_mutex_unlock(mdata->async_lock);
+    return NULL;
+}
+
+
+void gfal_plugin_mock_async_init(MockPluginData *mdata)
+{
+    mdata->async_lock = g_mutex_new();
+    mdata->async_cond = g_cond_new();
+    g_queue_init(&mdata->async_pending);
+}
+
+
+void gfal_plugin_mock_async_free(MockPluginData *mdata)
+{
+    g_mutex_lock(mdata->async_lock);
+    mdata->async_stop = TRUE;
+    g_cond_broadcast(mdata->async_cond);
+    g_mutex_unlock(mdata->async_lock);
+
+    if (mdata->async_thread) {
+        g_thread_join(mdata->async_thread);
+    }
+
+    // Whatever was still waiting is not going to be answered
+    MockAsyncEntry *entry;
+    while ((entry = g_queue_pop_head(&mdata->async_pending)) != NULL) {
+        GError *error = NULL;
+        gfal_plugin_mock_report_error("Plugin unloaded", ECANCELED, &error);
+        gfal2_async_complete(entry->req, -1, error);
+        g_free(entry);
+    }
+
+    g_cond_free(mdata->async_cond);
+    g_mutex_free(mdata->async_lock);
+}
+
+
+int gfal_plugin_mock_async_submit(plugin_handle plugin_data, gfal2_context_t context,
+    gfal2_async_request_t req, gfal_file_handle fh, GError **err)
+{
+    MockPluginData *mdata = plugin_data;
+    char arg_buffer[64];
+    int i;
+
+    switch (req->op) {
+        case GFAL2_ASYNC_STAT:
+        case GFAL2_ASYNC_LSTAT:
+        case GFAL2_ASYNC_CHECKSUM:
+            break;
+        default:
+            return 0;
+    }
+
+    // Blocking on a connection, sleeping, signals and content generation
+    // would stall every other request, so they are left to the workers
+    static const char *blocking[] = {"wait", "signal", "max_connections", "seed", NULL};
+    for (i = 0; blocking[i] != NULL; ++i) {
+        gfal_plugin_mock_get_value(req->url, blocking[i], arg_buffer, sizeof(arg_buffer));
+        if (arg_buffer[0] != '\0') {
+            return 0;
+        }
+    }
+
+    MockAsyncEntry *entry = g_new0(MockAsyncEntry, 1);
+    entry->req = req;
+    gfal_plugin_mock_network_parse(req->url, &entry->net);
+    g_get_current_time(&entry->deadline);
+    g_time_val_add(&entry->deadline, gfal_plugin_mock_network_delay(&entry->net, FALSE));
+
+    g_mutex_lock(mdata->async_lock);
+    if (mdata->async_stop) {
+        g_mutex_unlock(mdata->async_lock);
+        g_free(entry);
+        return 0;
+    }
+    if (mdata->async_thread == NULL) {
+        mdata->async_thread = g_thread_create(gfal_plugin_mock_async_loop, mdata, TRUE, NULL);
+        if (mdata->async_thread == NULL) {
+            g_mutex_unlock(mdata->async_lock);
+            g_free(entry);
+            return 0;
+        }
+    }
+    g_queue_insert_sorted(&mdata->async_pending, entry, gfal_plugin_mock_async_compare, NULL);
+    g_cond_signal(mdata->async_cond);
+    g_mutex_unlock(mdata->async_lock);
+    return 1;
+}
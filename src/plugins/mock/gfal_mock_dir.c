@@ -19,6 +19,8 @@
  */
 
 #include "gfal_mock_plugin.h"
+#include <dirent.h>
+#include <stdio.h>
 #include <string.h>
 
 
@@ -31,6 +33,11 @@ typedef struct {
 typedef struct {
     GSList *list;
     GSList *item;
+    // Synthetic namespace, generated as it is read
+    MockPluginDirEntry synthetic;
+    long long entries, entry_dirs, next;
+    off_t entry_size;
+    MockNetwork net;
 } MockPluginDirectory;
 
 
@@ -53,6 +60,15 @@ gfal_file_handle gfal_plugin_mock_opendir(plugin_handle plugin_data,
     MockPluginDirectory *dir = g_malloc0(sizeof(MockPluginDirectory));
     dir->list = NULL;
 
+    char arg_buffer[64];
+    gfal_plugin_mock_get_value(url, "entries", arg_buffer, sizeof(arg_buffer));
+    dir->entries = gfal_plugin_mock_get_int_from_str(arg_buffer);
+    gfal_plugin_mock_get_value(url, "entry_dirs", arg_buffer, sizeof(arg_buffer));
+    dir->entry_dirs = gfal_plugin_mock_get_int_from_str(arg_buffer);
+    gfal_plugin_mock_get_value(url, "entry_size", arg_buffer, sizeof(arg_buffer));
+    dir->entry_size = gfal_plugin_mock_get_int_from_str(arg_buffer);
+    gfal_plugin_mock_network_parse(url, &dir->net);
+
     // Populate list
     char *saveptr = NULL, *p;
     p = strtok_r(file_list, ",", &saveptr);
@@ -96,12 +112,48 @@ int gfal_plugin_mock_closedir(plugin_handle plugin_data,
 }
 
 
+// Listings are paginated as by a remote server, one round trip per page
+#define MOCK_DIR_PAGE_SIZE 1000
+
+static struct dirent *gfal_plugin_mock_readdir_synthetic(MockPluginDirectory *dir, struct stat *st,
+    GError **err)
+{
+    if (dir->next >= dir->entries) {
+        return NULL;
+    }
+    if (dir->next > 0 && dir->next % MOCK_DIR_PAGE_SIZE == 0) {
+        if (gfal_plugin_mock_network_wait(&dir->net, FALSE, err) < 0) {
+            return NULL;
+        }
+    }
+
+    MockPluginDirEntry *entry = &dir->synthetic;
+    memset(entry, 0, sizeof(*entry));
+    if (dir->next < dir->entry_dirs) {
+        snprintf(entry->de.d_name, sizeof(entry->de.d_name), "dir%08lld", dir->next);
+        entry->st.st_mode = S_IFDIR | 0755;
+        entry->de.d_type = DT_DIR;
+    }
+    else {
+        snprintf(entry->de.d_name, sizeof(entry->de.d_name), "file%08lld", dir->next);
+        entry->st.st_mode = S_IFREG | 0644;
+        entry->st.st_size = dir->entry_size;
+        entry->de.d_type = DT_REG;
+    }
+    entry->de.d_reclen = strnlen(entry->de.d_name, 256);
+    ++dir->next;
+
+    memcpy(st, &entry->st, sizeof(struct stat));
+    return &entry->de;
+}
+
+
 struct dirent *gfal_plugin_mock_readdirpp(plugin_handle plugin_data,
     gfal_file_handle dir_desc, struct stat *st, GError **err)
 {
     MockPluginDirectory *dir = gfal_file_handle_get_fdesc(dir_desc);
     if (!dir->item) {
-        return NULL;
+        return gfal_plugin_mock_readdir_synthetic(dir, st, err);
     }
 
     MockPluginDirEntry *entry = (MockPluginDirEntry *) (dir->item->data);
@@ -27,10 +27,11 @@
 #endif
 
 typedef struct {
-    const char *url;
-    int fd;
+    char *url;
+    int flag;
     off_t size;
     off_t offset;
+    MockNetwork net;
 } MockFile;
 
 
@@ -50,26 +51,27 @@ gfal_file_handle gfal_plugin_mock_open(plugin_handle plugin_data, const char *ur
         return NULL;
     }
 
-    MockFile *fd = g_malloc(sizeof(MockFile));
-    fd->url = url;
-    fd->size = st.st_size;
-    fd->offset = 0;
-    if (flag == O_RDONLY) {
-        fd->fd = open("/dev/urandom", O_RDONLY);
-    }
-    else if (flag == O_WRONLY) {
-        fd->fd = open("/dev/null", O_WRONLY);
-    }
-    else {
+    if (flag != O_RDONLY && flag != O_WRONLY) {
         gfal_plugin_mock_report_error("Mock plugin does not support read and write", ENOSYS, err);
         return NULL;
     }
 
-    if (fd->fd < 0) {
-        gfal_plugin_mock_report_error("Could not open the file!", errno, err);
+    // The connection is kept until the file is closed
+    MockNetwork net;
+    gfal_plugin_mock_network_parse(url, &net);
+    gfal_plugin_mock_network_acquire(plugin_data, url, &net);
+    if (gfal_plugin_mock_network_wait(&net, FALSE, err) < 0) {
+        gfal_plugin_mock_network_release(plugin_data, url, &net);
         return NULL;
     }
 
+    MockFile *fd = g_malloc(sizeof(MockFile));
+    fd->url = g_strdup(url);
+    fd->flag = flag;
+    fd->size = st.st_size;
+    fd->offset = 0;
+    fd->net = net;
+
     return gfal_file_handle_new2(gfal_mock_plugin_getName(), fd, NULL, url);
 }
 
@@ -97,19 +99,21 @@ ssize_t gfal_plugin_mock_read(plugin_handle plugin_data, gfal_file_handle fd, vo
         count = remaining;
     }
 
-    if (count < 0) {
+    if (remaining < 0) {
         gfal_plugin_mock_report_error("Reading passed end of file", EBADFD, err);
         return -1;
     }
 
-    off_t nread = read(mfd->fd, buff, count);
-    if (nread < 0) {
-        gfal_plugin_mock_report_error("Failed to read file", errno, err);
+    if (gfal_plugin_mock_network_wait(&mfd->net, TRUE, err) < 0) {
         return -1;
     }
+    gfal_plugin_mock_network_throttle(plugin_data, mfd->url, &mfd->net, count);
+
+    // Deterministic content, so the checksum can be known in advance
+    gfal_plugin_mock_fill(mfd->net.seed, mfd->offset, buff, count);
 
-    mfd->offset += nread;
-    return nread;
+    mfd->offset += count;
+    return count;
 }
 
 ssize_t gfal_plugin_mock_write(plugin_handle plugin_data, gfal_file_handle fd, const void *buff, size_t count,
@@ -117,20 +121,25 @@ ssize_t gfal_plugin_mock_write(plugin_handle plugin_data, gfal_file_handle fd, c
 {
     MockFile *mfd = gfal_file_handle_get_fdesc(fd);
 
-    off_t nwrite = write(mfd->fd, buff, count);
-    if (nwrite < 0) {
-        gfal_plugin_mock_report_error("Failed to write file", errno, err);
+    if (mfd->flag != O_WRONLY) {
+        gfal_plugin_mock_report_error("Failed to write file", EBADF, err);
+        return -1;
+    }
+    if (gfal_plugin_mock_network_wait(&mfd->net, TRUE, err) < 0) {
+        return -1;
     }
+    gfal_plugin_mock_network_throttle(plugin_data, mfd->url, &mfd->net, count);
 
-    mfd->offset += nwrite;
-    return nwrite;
+    mfd->offset += count;
+    return count;
 }
 
 
 int gfal_plugin_mock_close(plugin_handle plugin_data, gfal_file_handle fd, GError **err)
 {
     MockFile *mfd = gfal_file_handle_get_fdesc(fd);
-    close(mfd->fd);
+    gfal_plugin_mock_network_release(plugin_data, mfd->url, &mfd->net);
+    g_free(mfd->url);
     g_free(mfd);
     return 0;
 }
@@ -27,14 +27,8 @@ int gfal_plugin_mock_stat(plugin_handle plugin_data, const char *path, struct st
     MockPluginData *mdata = plugin_data;
 
     char arg_buffer[64] = {0};
-    int errcode = 0;
     int signum = 0;
-    long long size = 0, wait_time = 0;
-
-    // Is fts_url_copy calling us?
-    const char *agent, *version;
-    gfal2_get_user_agent(mdata->handle, &agent, &version);
-    int is_url_copy = (agent && strncmp(agent, "fts_url_copy", 12) == 0);
+    long long wait_time = 0;
 
     // Wait a bit?
     gfal_plugin_mock_get_value(path, "wait", arg_buffer, sizeof(arg_buffer));
@@ -51,6 +45,28 @@ int gfal_plugin_mock_stat(plugin_handle plugin_data, const char *path, struct st
         raise(signum);
     }
 
+    // Emulated network
+    MockNetwork net;
+    gfal_plugin_mock_network_parse(path, &net);
+    if (gfal_plugin_mock_network_roundtrip(mdata, path, &net, err) < 0) {
+        return -1;
+    }
+
+    return gfal_plugin_mock_stat_reply(mdata, path, buf, err);
+}
+
+
+int gfal_plugin_mock_stat_reply(MockPluginData *mdata, const char *path, struct stat *buf, GError **err)
+{
+    char arg_buffer[64] = {0};
+    int errcode = 0;
+    long long size = 0;
+
+    // Is fts_url_copy calling us?
+    const char *agent, *version;
+    gfal2_get_user_agent(mdata->handle, &agent, &version);
+    int is_url_copy = (agent && strncmp(agent, "fts_url_copy", 12) == 0);
+
     // Check errno first
     gfal_plugin_mock_get_value(path, "errno", arg_buffer, sizeof(arg_buffer));
     errcode = gfal_plugin_mock_get_int_from_str(arg_buffer);
@@ -96,6 +112,9 @@ int gfal_plugin_mock_stat(plugin_handle plugin_data, const char *path, struct st
 
     arg_buffer[0] = '\0';
     gfal_plugin_mock_get_value(path, "list", arg_buffer, sizeof(arg_buffer));
+    if (arg_buffer[0] == '\0') {
+        gfal_plugin_mock_get_value(path, "entries", arg_buffer, sizeof(arg_buffer));
+    }
     if (arg_buffer[0]) {
         buf->st_mode |= S_IFDIR;
     }
@@ -118,6 +137,22 @@ int gfal_plugin_mock_unlink(plugin_handle plugin_data, const char *url, GError *
 int gfal_mock_checksumG(plugin_handle plugin_data, const char* url,
         const char* check_type, char * checksum_buffer, size_t buffer_length,
         off_t start_offset, size_t data_length, GError ** err)
+{
+    MockNetwork net;
+
+    gfal_plugin_mock_network_parse(url, &net);
+    if (gfal_plugin_mock_network_roundtrip(plugin_data, url, &net, err) < 0) {
+        return -1;
+    }
+
+    return gfal_mock_checksum_reply(url, &net, check_type, checksum_buffer, buffer_length,
+        start_offset, data_length, err);
+}
+
+
+int gfal_mock_checksum_reply(const char *url, const MockNetwork *net,
+        const char *check_type, char *checksum_buffer, size_t buffer_length,
+        off_t start_offset, size_t data_length, GError **err)
 {
     char arg_buffer[GFAL_URL_MAX_LEN] = {0};
     int errcode = 0;
@@ -132,8 +167,24 @@ int gfal_mock_checksumG(plugin_handle plugin_data, const char* url,
     }
 
     gfal_plugin_mock_get_value(url, "checksum", arg_buffer, sizeof(arg_buffer));
-    g_strlcpy(checksum_buffer, arg_buffer, buffer_length);
+    if (arg_buffer[0] != '\0') {
+        g_strlcpy(checksum_buffer, arg_buffer, buffer_length);
+        return 0;
+    }
+
+    // Checksum of the generated content
+    gfal_plugin_mock_get_value(url, "seed", arg_buffer, sizeof(arg_buffer));
+    if (arg_buffer[0] != '\0') {
+        gfal_plugin_mock_get_value(url, "size", arg_buffer, sizeof(arg_buffer));
+        off_t size = gfal_plugin_mock_get_int_from_str(arg_buffer);
+        if (data_length > 0 && start_offset + (off_t)data_length < size) {
+            size = start_offset + data_length;
+        }
+        return gfal_plugin_mock_content_checksum(net->seed, start_offset, MAX(size - start_offset, 0),
+            check_type, checksum_buffer, buffer_length, err);
+    }
 
+    checksum_buffer[0] = '\0';
     return 0;
 }
 
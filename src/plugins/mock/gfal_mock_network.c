@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gfal_mock_plugin.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <checksums/checksums.h>
+
+
+// State shared by all the operations on the same host
+typedef struct {
+    int connections;
+    GCond *released;
+    double tokens;
+    gint64 last_refill;
+} MockHost;
+
+
+static void gfal_plugin_mock_host_free(gpointer data)
+{
+    MockHost *host = data;
+    g_cond_free(host->released);
+    g_free(host);
+}
+
+
+void gfal_plugin_mock_network_init(MockPluginData *mdata)
+{
+    mdata->network_lock = g_mutex_new();
+    mdata->hosts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, gfal_plugin_mock_host_free);
+}
+
+
+void gfal_plugin_mock_network_free(MockPluginData *mdata)
+{
+    g_hash_table_destroy(mdata->hosts);
+    g_mutex_free(mdata->network_lock);
+}
+
+
+// Must be called with the network lock held
+static MockHost *gfal_plugin_mock_get_host(MockPluginData *mdata, const char *url)
+{
+    const char *begin = strstr(url, "://");
+    begin = begin ? begin + 3 : url;
+    size_t len = strcspn(begin, "/?");
+
+    char *name = g_strndup(begin, len);
+    MockHost *host = g_hash_table_lookup(mdata->hosts, name);
+    if (host == NULL) {
+        host = g_new0(MockHost, 1);
+        host->released = g_cond_new();
+        host->last_refill = g_get_monotonic_time();
+        g_hash_table_insert(mdata->hosts, name, host);
+    }
+    else {
+        g_free(name);
+    }
+    return host;
+}
+
+
+void gfal_plugin_mock_network_parse(const char *url, MockNetwork *net)
+{
+    memset(net, 0, sizeof(*net));
+    net->io_latency = -1;
+    net->fail_errno = EIO;
+
+    const char *query = strchr(url, '?');
+    if (query == NULL) {
+        return;
+    }
+
+    char **args = g_strsplit(query + 1, "&", 0);
+    int i;
+    for (i = 0; args[i] != NULL; ++i) {
+        char *value = strchr(args[i], '=');
+        if (value == NULL) {
+            continue;
+        }
+        *value++ = '\0';
+
+        if (strcmp(args[i], "latency") == 0) {
+            net->latency = gfal_plugin_mock_get_int_from_str(value);
+        }
+        else if (strcmp(args[i], "io_latency") == 0) {
+            net->io_latency = gfal_plugin_mock_get_int_from_str(value);
+        }
+        else if (strcmp(args[i], "jitter") == 0) {
+            net->jitter = gfal_plugin_mock_get_int_from_str(value);
+        }
+        else if (strcmp(args[i], "jitter_dist") == 0) {
+            if (strcmp(value, "normal") == 0) {
+                net->jitter_dist = MOCK_JITTER_NORMAL;
+            }
+            else if (strcmp(value, "exponential") == 0) {
+                net->jitter_dist = MOCK_JITTER_EXPONENTIAL;
+            }
+            else {
+                net->jitter_dist = MOCK_JITTER_UNIFORM;
+            }
+        }
+        else if (strcmp(args[i], "bandwidth") == 0) {
+            net->bandwidth = gfal_plugin_mock_get_int_from_str(value);
+        }
+        else if (strcmp(args[i], "burst") == 0) {
+            net->burst = gfal_plugin_mock_get_int_from_str(value);
+        }
+        else if (strcmp(args[i], "fail_probability") == 0) {
+            net->fail_probability = g_ascii_strtod(value, NULL);
+        }
+        else if (strcmp(args[i], "fail_errno") == 0) {
+            net->fail_errno = gfal_plugin_mock_get_int_from_str(value);
+        }
+        else if (strcmp(args[i], "max_connections") == 0) {
+            net->max_connections = gfal_plugin_mock_get_int_from_str(value);
+        }
+        else if (strcmp(args[i], "seed") == 0) {
+            net->seed = g_ascii_strtoull(value, NULL, 10);
+        }
+    }
+    g_strfreev(args);
+
+    if (net->bandwidth > 0 && net->burst <= 0) {
+        net->burst = MAX(net->bandwidth / 10, 65536);
+    }
+}
+
+
+static gint64 gfal_plugin_mock_delay(gint64 latency, const MockNetwork *net)
+{
+    double delay = latency;
+
+    if (net->jitter > 0) {
+        switch (net->jitter_dist) {
+            case MOCK_JITTER_NORMAL: {
+                // Box-Muller
+                double u1 = g_random_double_range(DBL_MIN, 1.0);
+                double u2 = g_random_double();
+                delay += net->jitter * sqrt(-2.0 * log(u1)) * cos(2.0 * G_PI * u2);
+                break;
+            }
+            case MOCK_JITTER_EXPONENTIAL:
+                // Long tail, only ever adds up
+                delay += -net->jitter * log(g_random_double_range(DBL_MIN, 1.0));
+                break;
+            default:
+                delay += g_random_double_range(-net->jitter, net->jitter);
+        }
+    }
+    return delay > 0 ? (gint64)delay : 0;
+}
+
+
+void gfal_plugin_mock_network_acquire(MockPluginData *mdata, const char *url, const MockNetwork *net)
+{
+    if (net->max_connections > 0) {
+        g_mutex_lock(mdata->network_lock);
+        MockHost *host = gfal_plugin_mock_get_host(mdata, url);
+        while (host->connections >= net->max_connections) {
+            g_cond_wait(host->released, mdata->network_lock);
+        }
+        ++host->connections;
+        g_mutex_unlock(mdata->network_lock);
+    }
+}
+
+
+void gfal_plugin_mock_network_release(MockPluginData *mdata, const char *url, const MockNetwork *net)
+{
+    if (net->max_connections > 0) {
+        g_mutex_lock(mdata->network_lock);
+        MockHost *host = gfal_plugin_mock_get_host(mdata, url);
+        --host->connections;
+        g_cond_signal(host->released);
+        g_mutex_unlock(mdata->network_lock);
+    }
+}
+
+
+gint64 gfal_plugin_mock_network_delay(const MockNetwork *net, gboolean io)
+{
+    gint64 latency = (io && net->io_latency >= 0) ? net->io_latency : net->latency;
+    return gfal_plugin_mock_delay(latency, net);
+}
+
+
+int gfal_plugin_mock_network_fail(const MockNetwork *net, GError **err)
+{
+    if (net->fail_probability > 0 && g_random_double() < net->fail_probability) {
+        gfal_plugin_mock_report_error(strerror(net->fail_errno), net->fail_errno, err);
+        return -1;
+    }
+    return 0;
+}
+
+
+int gfal_plugin_mock_network_wait(const MockNetwork *net, gboolean io, GError **err)
+{
+    gint64 delay = gfal_plugin_mock_network_delay(net, io);
+    if (delay > 0) {
+        g_usleep(delay);
+    }
+    return gfal_plugin_mock_network_fail(net, err);
+}
+
+
+int gfal_plugin_mock_network_roundtrip(MockPluginData *mdata, const char *url, const MockNetwork *net,
+    GError **err)
+{
+    gfal_plugin_mock_network_acquire(mdata, url, net);
+    int ret = gfal_plugin_mock_network_wait(net, FALSE, err);
+    gfal_plugin_mock_network_release(mdata, url, net);
+    return ret;
+}
+
+
+// Token bucket shared by all the transfers from or to the same host.
+// The bucket can go into debt, so concurrent transfers share the bandwidth.
+void gfal_plugin_mock_network_throttle(MockPluginData *mdata, const char *url, const MockNetwork *net,
+    gint64 nbytes)
+{
+    if (net->bandwidth <= 0 || nbytes <= 0) {
+        return;
+    }
+
+    g_mutex_lock(mdata->network_lock);
+    MockHost *host = gfal_plugin_mock_get_host(mdata, url);
+    gint64 now = g_get_monotonic_time();
+    host->tokens += (now - host->last_refill) * net->bandwidth / (double)G_USEC_PER_SEC;
+    if (host->tokens > net->burst) {
+        host->tokens = net->burst;
+    }
+    host->last_refill = now;
+    host->tokens -= nbytes;
+    double debt = -host->tokens;
+    g_mutex_unlock(mdata->network_lock);
+
+    if (debt > 0) {
+        g_usleep(debt * G_USEC_PER_SEC / net->bandwidth);
+    }
+}
+
+
+// splitmix64, so any offset can be generated without the previous ones
+static guint64 gfal_plugin_mock_word(guint64 seed, guint64 index)
+{
+    guint64 z = seed + (index + 1) * G_GUINT64_CONSTANT(0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * G_GUINT64_CONSTANT(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * G_GUINT64_CONSTANT(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+
+void gfal_plugin_mock_fill(guint64 seed, off_t offset, void *buffer, size_t count)
+{
+    unsigned char *out = buffer;
+
+    while (count > 0) {
+        guint64 word = GUINT64_TO_LE(gfal_plugin_mock_word(seed, offset / 8));
+        size_t shift = offset % 8;
+        size_t n = MIN(8 - shift, count);
+        memcpy(out, ((unsigned char*)&word) + shift, n);
+        out += n;
+        offset += n;
+        count -= n;
+    }
+}
+
+
+int gfal_plugin_mock_content_checksum(guint64 seed, off_t offset, off_t size, const char *check_type,
+    char *checksum_buffer, size_t buffer_length, GError **err)
+{
+    char block[65536];
+    off_t end = offset + size;
+    gboolean is_adler32 = (g_ascii_strcasecmp(check_type, "ADLER32") == 0);
+    gboolean is_crc32 = (g_ascii_strcasecmp(check_type, "CRC32") == 0);
+    gboolean is_md5 = (g_ascii_strcasecmp(check_type, "MD5") == 0);
+    unsigned long value = is_adler32 ? adler32(0L, Z_NULL, 0) : crc32(0L, Z_NULL, 0);
+    GFAL_MD5_CTX md5;
+
+    if (!is_adler32 && !is_crc32 && !is_md5) {
+        gfal_plugin_mock_report_error("Unsupported checksum type", ENOTSUP, err);
+        return -1;
+    }
+    if (is_md5) {
+        if (buffer_length < 33) {
+            gfal_plugin_mock_report_error("Buffer too short for the checksum", ENOBUFS, err);
+            return -1;
+        }
+        gfal2_md5_init(&md5);
+    }
+
+    while (offset < end) {
+        size_t n = MIN((off_t)sizeof(block), end - offset);
+        gfal_plugin_mock_fill(seed, offset, block, n);
+        if (is_adler32) {
+            value = adler32(value, (const Bytef*)block, n);
+        }
+        else if (is_crc32) {
+            value = crc32(value, (const Bytef*)block, n);
+        }
+        else {
+            gfal2_md5_update(&md5, block, n);
+        }
+        offset += n;
+    }
+
+    // Same formatting as the file plugin
+    if (is_adler32) {
+        snprintf(checksum_buffer, buffer_length, "%08lx", value);
+    }
+    else if (is_crc32) {
+        snprintf(checksum_buffer, buffer_length, "%ld", value);
+    }
+    else {
+        unsigned char digest[16];
+        gfal2_md5_final(digest, &md5);
+        gfal2_md5_to_hex_string(digest, checksum_buffer, sizeof(digest));
+    }
+    return 0;
+}
@@ -35,9 +35,40 @@ typedef struct {
     gfal2_context_t handle;
     StatStage stat_stage;
     char enable_signals;
+    // Emulated network state per host, see gfal_mock_network.c
+    GMutex *network_lock;
+    GHashTable *hosts;
+    // Requests completed natively, see gfal_mock_async.c
+    GMutex *async_lock;
+    GCond *async_cond;
+    GQueue async_pending;
+    GThread *async_thread;
+    gboolean async_stop;
 } MockPluginData;
 
 
+typedef enum {
+    MOCK_JITTER_UNIFORM = 0,
+    MOCK_JITTER_NORMAL,
+    MOCK_JITTER_EXPONENTIAL
+} MockJitterDistribution;
+
+
+// Network behaviour requested by the query arguments of an url
+typedef struct {
+    gint64 latency;         // microseconds, per operation
+    gint64 io_latency;      // microseconds, per read or write, -1 to use latency
+    gint64 jitter;          // microseconds
+    MockJitterDistribution jitter_dist;
+    gint64 bandwidth;       // bytes per second, 0 for unlimited
+    gint64 burst;           // bytes
+    double fail_probability;
+    int fail_errno;
+    int max_connections;    // per host, 0 for unlimited
+    guint64 seed;           // content generation
+} MockNetwork;
+
+
 // Helpers
 const char *gfal_mock_plugin_getName();
 
@@ -49,10 +80,49 @@ void gfal_plugin_mock_get_value(const char *url, const char *key, char *value, s
 
 long long gfal_plugin_mock_get_int_from_str(const char* buff);
 
+// Network emulation
+void gfal_plugin_mock_network_init(MockPluginData *mdata);
+
+void gfal_plugin_mock_network_free(MockPluginData *mdata);
+
+void gfal_plugin_mock_network_parse(const char *url, MockNetwork *net);
+
+// Take a connection to the host, waiting if max_connections are already taken
+void gfal_plugin_mock_network_acquire(MockPluginData *mdata, const char *url, const MockNetwork *net);
+
+void gfal_plugin_mock_network_release(MockPluginData *mdata, const char *url, const MockNetwork *net);
+
+// Latency of one request (io for reads and writes), jitter included
+gint64 gfal_plugin_mock_network_delay(const MockNetwork *net, gboolean io);
+
+// Fail with fail_probability
+int gfal_plugin_mock_network_fail(const MockNetwork *net, GError **err);
+
+// Wait for the latency of one request (io for reads and writes), and fail with fail_probability
+int gfal_plugin_mock_network_wait(const MockNetwork *net, gboolean io, GError **err);
+
+// A request over its own connection
+int gfal_plugin_mock_network_roundtrip(MockPluginData *mdata, const char *url, const MockNetwork *net,
+    GError **err);
+
+// Wait until the host bandwidth allows sending nbytes
+void gfal_plugin_mock_network_throttle(MockPluginData *mdata, const char *url, const MockNetwork *net,
+    gint64 nbytes);
+
+// Deterministic content of a file generated from seed
+void gfal_plugin_mock_fill(guint64 seed, off_t offset, void *buffer, size_t count);
+
+int gfal_plugin_mock_content_checksum(guint64 seed, off_t offset, off_t size, const char *check_type,
+    char *checksum_buffer, size_t buffer_length, GError **err);
+
 // Metadata operations
 int gfal_plugin_mock_stat(plugin_handle plugin_data,
     const char *path, struct stat *buf, GError **err);
 
+// Reply of a stat, once the network has been emulated
+int gfal_plugin_mock_stat_reply(MockPluginData *mdata,
+    const char *path, struct stat *buf, GError **err);
+
 int gfal_plugin_mock_unlink(plugin_handle plugin_data,
     const char *url, GError **err);
 
@@ -60,6 +130,11 @@ int gfal_mock_checksumG(plugin_handle plugin_data, const char* url,
     const char* check_type, char * checksum_buffer, size_t buffer_length,
     off_t start_offset, size_t data_length, GError ** err);
 
+// Reply of a checksum, once the network has been emulated
+int gfal_mock_checksum_reply(const char *url, const MockNetwork *net,
+    const char *check_type, char *checksum_buffer, size_t buffer_length,
+    off_t start_offset, size_t data_length, GError **err);
+
 ssize_t gfal_mock_getxattrG(plugin_handle plugin_data, const char* url, const char* key,
     void* buff, size_t s_buff, GError** err);
 
@@ -129,9 +204,21 @@ int gfal_plugin_mock_abort_file_list(plugin_handle plugin_data, int nbfiles, con
 
 int gfal_plugin_mock_archive_poll_list(plugin_handle plugin_data, int nbfiles, const char* const* urls, GError** errors);
 
+// Asynchronous requests
+void gfal_plugin_mock_async_init(MockPluginData *mdata);
+
+void gfal_plugin_mock_async_free(MockPluginData *mdata);
+
+int gfal_plugin_mock_async_submit(plugin_handle plugin_data, gfal2_context_t context,
+    gfal2_async_request_t req, gfal_file_handle fh, GError **err);
+
 // Copy
 int gfal_plugin_mock_filecopy(plugin_handle plugin_data,
     gfal2_context_t context, gfalt_params_t params, const char *src,
     const char *dst, GError **err);
 
+int gfal_plugin_mock_copy_bulk(plugin_handle plugin_data, gfal2_context_t context, gfalt_params_t params,
+    size_t nbfiles, const char *const *srcs, const char *const *dsts, const char *const *checksums,
+    GError **op_error, GError ***file_errors);
+
 #endif // GFAL_MOCK_PLUGIN_H
@@ -92,12 +92,10 @@ void gfal_plugin_mock_get_value(const char *url, const char *key, char *value, s
     char **args = g_strsplit(str + 1, "&", 0);
     int i;
     for (i = 0; args[i] != NULL; ++i) {
-        if (strncmp(args[i], key, key_len) == 0) {
-            char *p = strchr(args[i], '=');
-            if (p) {
-                g_strlcpy(value, p + 1, val_size);
-                break;
-            }
+        // The whole key, so "size" does not match "size_pre"
+        if (strncmp(args[i], key, key_len) == 0 && args[i][key_len] == '=') {
+            g_strlcpy(value, args[i] + key_len + 1, val_size);
+            break;
         }
     }
 
@@ -121,6 +119,11 @@ gboolean gfal_plugin_mock_check_url_transfer(plugin_handle handle, gfal2_context
         if (type == GFAL_FILE_COPY && is_mock_uri(src) && is_mock_uri(dst)) {
             res = TRUE;
         }
+        else if (type == GFAL_BULK_COPY && is_mock_uri(src) && is_mock_uri(dst)) {
+            char bulk[64] = {0};
+            gfal_plugin_mock_get_value(src, "bulk", bulk, sizeof(bulk));
+            res = gfal_plugin_mock_get_int_from_str(bulk) > 0;
+        }
     }
     return res;
 }
@@ -128,6 +131,9 @@ gboolean gfal_plugin_mock_check_url_transfer(plugin_handle handle, gfal2_context
 
 void gfal_plugin_mock_delete(plugin_handle plugin_data)
 {
+    MockPluginData *mdata = plugin_data;
+    gfal_plugin_mock_async_free(mdata);
+    gfal_plugin_mock_network_free(mdata);
     free(plugin_data);
 }
 
@@ -178,6 +184,8 @@ gfal_plugin_interface gfal_plugin_init(gfal2_context_t handle, GError **err)
     MockPluginData *mdata = calloc(1, sizeof(MockPluginData));
     mdata->handle = handle;
     mdata->enable_signals = gfal2_get_opt_boolean_with_default(handle, "MOCK PLUGIN", "SIGNALS", FALSE);
+    gfal_plugin_mock_network_init(mdata);
+    gfal_plugin_mock_async_init(mdata);
 
     if (mdata->enable_signals) {
         gfal_mock_seppuku_hook();
@@ -209,6 +217,7 @@ gfal_plugin_interface gfal_plugin_init(gfal2_context_t handle, GError **err)
 
     mock_plugin.check_plugin_url_transfer = &gfal_plugin_mock_check_url_transfer;
     mock_plugin.copy_file = &gfal_plugin_mock_filecopy;
+    mock_plugin.copy_bulk = &gfal_plugin_mock_copy_bulk;
 
     mock_plugin.opendirG = gfal_plugin_mock_opendir;
     mock_plugin.readdirG = gfal_plugin_mock_readdir;
@@ -221,6 +230,8 @@ gfal_plugin_interface gfal_plugin_init(gfal2_context_t handle, GError **err)
     mock_plugin.writeG = gfal_plugin_mock_write;
     mock_plugin.lseekG = gfal_plugin_mock_seek;
 
+    mock_plugin.async_submitG = gfal_plugin_mock_async_submit;
+
     return mock_plugin;
 }
 
@@ -63,6 +63,11 @@ int gfal_plugin_mock_filecopy(plugin_handle plugin_data,
 
     // transfer duration
     int seconds = 0;
+    gint64 remaining_bytes = 0;
+
+    // emulated network, as seen from the destination
+    MockNetwork net;
+    gfal_plugin_mock_network_parse(dst, &net);
 
     // check if the duration is specified in destination
     char time_dst[GFAL_URL_MAX_LEN] = {0};
@@ -72,6 +77,12 @@ int gfal_plugin_mock_filecopy(plugin_handle plugin_data,
         // get the value from destination
         seconds = atoi(time_dst);
     }
+    else if (net.bandwidth > 0) {
+        // or from the size of the source and the bandwidth
+        char size_src[64] = {0};
+        gfal_plugin_mock_get_value(src, "size", size_src, sizeof(size_src));
+        remaining_bytes = gfal_plugin_mock_get_int_from_str(size_src);
+    }
     else {
         // get the range from configuration file
         int max = gfal2_get_opt_integer_with_default(context, "MOCK PLUGIN", "MAX_TRANSFER_TIME", 100);
@@ -86,6 +97,12 @@ int gfal_plugin_mock_filecopy(plugin_handle plugin_data,
     gfal_plugin_mock_get_value(dst, "transfer_errno", transfer_errno_buffer, sizeof(transfer_errno_buffer));
     int transfer_errno = gfal_plugin_mock_get_int_from_str(transfer_errno_buffer);
 
+    gfal_plugin_mock_network_acquire(plugin_data, dst, &net);
+    if (gfal_plugin_mock_network_wait(&net, FALSE, err) < 0) {
+        gfal_plugin_mock_network_release(plugin_data, dst, &net);
+        return -1;
+    }
+
     // mock transfer duration
     gfal_cancel_token_t cancel_token;
     cancel_token = gfal2_register_cancel_callback(context,
@@ -107,6 +124,18 @@ int gfal_plugin_mock_filecopy(plugin_handle plugin_data,
             break;
         }
     }
+    // throttled by bandwidth, a burst at a time so it can be cancelled
+    while (remaining_bytes > 0 && seconds >= 0) {
+        gint64 chunk = MIN(remaining_bytes, net.burst);
+        gfal_plugin_mock_network_throttle(plugin_data, dst, &net, chunk);
+        remaining_bytes -= chunk;
+
+        if (transfer_errno) {
+            gfal_plugin_mock_report_error(strerror(transfer_errno), transfer_errno, err);
+            break;
+        }
+    }
+    gfal_plugin_mock_network_release(plugin_data, dst, &net);
     plugin_trigger_event(params, gfal2_get_plugin_mock_quark(), GFAL_EVENT_NONE,
         GFAL_EVENT_TRANSFER_EXIT, "Mock copy start, sleep %d", seconds);
 
@@ -143,3 +172,36 @@ int gfal_plugin_mock_filecopy(plugin_handle plugin_data,
         return -1;
     return 0;
 }
+
+
+int gfal_plugin_mock_copy_bulk(plugin_handle plugin_data, gfal2_context_t context, gfalt_params_t params,
+    size_t nbfiles, const char *const *srcs, const char *const *dsts, const char *const *checksums,
+    GError **op_error, GError ***file_errors)
+{
+    size_t i;
+    int failed = 0;
+
+    *file_errors = g_new0(GError*, nbfiles);
+
+    // So the callers can tell how the copies were grouped
+    plugin_trigger_event(params, gfal2_get_plugin_mock_quark(), GFAL_EVENT_NONE,
+        GFAL_EVENT_TRANSFER_ENTER, "Mock bulk copy of %zu files", nbfiles);
+
+    for (i = 0; i < nbfiles; ++i) {
+        gfalt_params_t file_params = gfalt_params_handle_copy_bulk_file(params,
+            checksums ? checksums[i] : NULL, &(*file_errors)[i]);
+        if (file_params == NULL) {
+            ++failed;
+            continue;
+        }
+
+        if (gfal_plugin_mock_filecopy(plugin_data, context, file_params, srcs[i], dsts[i], &(*file_errors)[i]) < 0) {
+            ++failed;
+        }
+        gfalt_params_handle_delete(file_params, NULL);
+    }
+
+    plugin_trigger_event(params, gfal2_get_plugin_mock_quark(), GFAL_EVENT_NONE,
+        GFAL_EVENT_TRANSFER_EXIT, "Mock bulk copy of %zu files", nbfiles);
+    return -failed;
+}
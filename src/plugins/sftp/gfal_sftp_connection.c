@@ -18,13 +18,50 @@
 #include <uri/gfal2_uri.h>
 #include <netdb.h>
 #include <arpa/inet.h>
+#include <poll.h>
 #include <pwd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <time.h>
 
 // libssh2_session_handshake introduced with 1.2.8
 #if LIBSSH2_VERSION_NUM < 0x010208
 #   define libssh2_session_handshake libssh2_session_startup
 #endif
 
+#define GFAL_SFTP_DEFAULT_MAX_IDLE_PER_HOST 8
+#define GFAL_SFTP_DEFAULT_IDLE_TIMEOUT 300
+#define GFAL_SFTP_DEFAULT_KEEPALIVE_INTERVAL 60
+
+
+struct gfal_sftp_cache_s {
+    pthread_mutex_t lock;
+
+    // "host:port" => GQueue of idle handles, most recently used first
+    GHashTable *idle;
+
+    int max_idle_per_host;
+    int idle_timeout;
+    int keepalive_interval;
+
+    // Set on the first push, from then on the keeper looks after the pool
+    gboolean registered;
+    // Protected by gfal_sftp_keeper_lock
+    time_t next_sweep;
+
+    gfal_sftp_cache_stats_t stats;
+};
+
+
+// A single thread takes care of the pools of every context, and only while there is
+// at least one that has ever had an idle handle
+static pthread_mutex_t gfal_sftp_keeper_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gfal_sftp_keeper_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_t gfal_sftp_keeper;
+static gboolean gfal_sftp_keeper_running = FALSE;
+static gboolean gfal_sftp_keeper_stop = FALSE;
+static GSList *gfal_sftp_keeper_pools = NULL;
+
 
 void gfal_plugin_sftp_translate_error(const char *func, gfal_sftp_handle_t *handle, GError **err)
 {
@@ -225,11 +262,30 @@ static int gfal_sftp_authn(gfal_sftp_context_t *data, gfal2_uri *parsed, gfal_sf
 }
 
 
+// Also used to clean up handles half way through their creation
+static void gfal_sftp_destroy_handle(gfal_sftp_handle_t *handle, gpointer user_data)
+{
+    if (handle->sock >= 0) {
+        close(handle->sock);
+    }
+    if (handle->sftp_session) {
+        libssh2_sftp_shutdown(handle->sftp_session);
+    }
+    if (handle->ssh_session) {
+        libssh2_session_disconnect(handle->ssh_session, "");
+        libssh2_session_free(handle->ssh_session);
+    }
+    g_free((char*)handle->host);
+    g_free((char*)handle->path);
+    g_free(handle);
+}
+
+
 static gfal_sftp_handle_t *gfal_sftp_new_handle(gfal_sftp_context_t *data, gfal2_uri *parsed, GError **err)
 {
     int rc;
 
-    gfal_sftp_handle_t *handle = g_malloc(sizeof(gfal_sftp_handle_t));
+    gfal_sftp_handle_t *handle = g_new0(gfal_sftp_handle_t, 1);
     handle->host = g_strdup(parsed->host);
     handle->port = parsed->port;
     handle->sock = gfal_sftp_socket(parsed, err);
@@ -263,24 +319,46 @@ static gfal_sftp_handle_t *gfal_sftp_new_handle(gfal_sftp_context_t *data, gfal2
     gfal2_log(G_LOG_LEVEL_DEBUG, "SFTP initialized");
 
     libssh2_session_set_blocking(handle->ssh_session, 1);
+#if LIBSSH2_VERSION_NUM >= 0x010205
+    int keepalive = gfal2_get_opt_integer_with_default(data->gfal2_context, "SFTP PLUGIN", "KEEPALIVE_INTERVAL",
+        GFAL_SFTP_DEFAULT_KEEPALIVE_INTERVAL);
+    if (keepalive > 0) {
+        libssh2_keepalive_config(handle->ssh_session, 1, keepalive);
+    }
+#endif
 
     return handle;
 
     get_handle_failure_ssh:
     gfal_plugin_sftp_translate_error(__func__, handle, err);
     get_handle_failure:
-    g_free(handle);
+    gfal_sftp_destroy_handle(handle, NULL);
     return NULL;
 }
 
 
-static void gfal_sftp_destroy_handle(gfal_sftp_handle_t *handle, gpointer user_data)
+// The server may have dropped the connection since the last sweep of the pool,
+// or the keeper may not be running at all
+static gboolean gfal_sftp_handle_alive(gfal_sftp_handle_t *handle)
 {
-    close(handle->sock);
-    libssh2_sftp_shutdown(handle->sftp_session);
-    libssh2_session_disconnect(handle->ssh_session, "");
-    libssh2_session_free(handle->ssh_session);
-    g_free(handle);
+    // A closed connection is readable, and reads as end of file
+    struct pollfd pfd = {handle->sock, POLLIN, 0};
+    if (poll(&pfd, 1, 0) != 0) {
+        char byte;
+        if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            return FALSE;
+        }
+        if ((pfd.revents & POLLIN) && recv(handle->sock, &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0) {
+            return FALSE;
+        }
+    }
+#if LIBSSH2_VERSION_NUM >= 0x010205
+    int seconds = 0;
+    if (libssh2_keepalive_send(handle->ssh_session, &seconds) < 0) {
+        return FALSE;
+    }
+#endif
+    return TRUE;
 }
 
 
@@ -292,20 +370,20 @@ gfal_sftp_handle_t *gfal_sftp_connect(gfal_sftp_context_t *context, const char *
     }
 
     gfal_sftp_handle_t *handle = gfal_sftp_cache_pop(context->cache, parsed->host, parsed->port);
-    if (!handle) {
-        gfal2_log(G_LOG_LEVEL_DEBUG, "Creating new SFTP handle");
-        handle = gfal_sftp_new_handle(context, parsed, err);
-    } else {
-#if LIBSSH2_VERSION_NUM >= 0x010205
-        int seconds = 10;
+    if (handle) {
         gfal2_log(G_LOG_LEVEL_DEBUG, "Reusing SFTP handle from cache for %s:%d", handle->host, handle->port);
-        int rc = libssh2_keepalive_send(handle->ssh_session, &seconds);
-        if (rc < 0) {
+        if (!gfal_sftp_handle_alive(handle)) {
             gfal2_log(G_LOG_LEVEL_DEBUG, "Recycled SFTP handle failed to send keepalive. Discard and reconnect");
             gfal_sftp_destroy_handle(handle, NULL);
-            handle = gfal_sftp_new_handle(context, parsed, err);
+            pthread_mutex_lock(&context->cache->lock);
+            ++context->cache->stats.dead;
+            pthread_mutex_unlock(&context->cache->lock);
+            handle = NULL;
         }
-#endif
+    }
+    if (!handle) {
+        gfal2_log(G_LOG_LEVEL_DEBUG, "Creating new SFTP handle");
+        handle = gfal_sftp_new_handle(context, parsed, err);
     }
     if (handle) {
         handle->path = g_strdup(parsed->path);
@@ -319,60 +397,300 @@ gfal_sftp_handle_t *gfal_sftp_connect(gfal_sftp_context_t *context, const char *
 void gfal_sftp_release(gfal_sftp_context_t *context, gfal_sftp_handle_t *handle)
 {
     gfal2_log(G_LOG_LEVEL_DEBUG, "Pushing SFTP handle into cache for %s:%d", handle->host, handle->port);
+    g_free((char*)handle->path);
+    handle->path = NULL;
     gfal_sftp_cache_push(context->cache, handle);
 }
 
 
-static void gfal_sftpdestroy_key(gpointer p)
+void gfal_sftp_discard(gfal_sftp_context_t *context, gfal_sftp_handle_t *handle)
 {
-    g_string_free((GString*)p, TRUE);
+    gfal2_log(G_LOG_LEVEL_DEBUG, "Discarding SFTP handle for %s:%d", handle->host, handle->port);
+    pthread_mutex_lock(&context->cache->lock);
+    ++context->cache->stats.discarded;
+    pthread_mutex_unlock(&context->cache->lock);
+    gfal_sftp_destroy_handle(handle, NULL);
 }
 
 
-GHashTable *gfal_sftp_cache_new()
+static gchar *gfal_sftp_cache_key(const char *host, int port)
 {
-    return g_hash_table_new_full((GHashFunc) g_string_hash, (GEqualFunc) g_string_equal,
-        gfal_sftpdestroy_key, NULL);
+    return g_strdup_printf("%s:%d", host, port);
 }
 
 
-gfal_sftp_handle_t *gfal_sftp_cache_pop(GHashTable *cache, const char *host, int port)
+static void gfal_sftp_destroy_queue(gpointer p)
 {
-    GString *key = g_string_new(NULL);
-    g_string_printf(key, "%s:%d", host, port);
-    GSList *list = (GSList*)g_hash_table_lookup(cache, key);
-    if (!list) {
-        g_string_free(key, TRUE);
-        return NULL;
+    GQueue *queue = (GQueue*)p;
+    g_queue_foreach(queue, (GFunc)gfal_sftp_destroy_handle, NULL);
+    g_queue_free(queue);
+}
+
+
+// Must be called with the lock held
+// Returns the handle evicted to make room, if any
+static gfal_sftp_handle_t *gfal_sftp_cache_insert(gfal_sftp_cache_t *cache, gfal_sftp_handle_t *handle)
+{
+    gchar *key = gfal_sftp_cache_key(handle->host, handle->port);
+    GQueue *queue = (GQueue*)g_hash_table_lookup(cache->idle, key);
+    if (!queue) {
+        queue = g_queue_new();
+        g_hash_table_insert(cache->idle, key, queue);
+    }
+    else {
+        g_free(key);
+    }
+
+    g_queue_push_head(queue, handle);
+    if ((int)g_queue_get_length(queue) > cache->max_idle_per_host) {
+        ++cache->stats.evicted;
+        return (gfal_sftp_handle_t*)g_queue_pop_tail(queue);
+    }
+    return NULL;
+}
+
+
+// Must be called with the lock held
+// Detaches from the pool the handles that have expired, or that need a keepalive
+static void gfal_sftp_cache_collect(gfal_sftp_cache_t *cache, time_t now, GSList **expired, GSList **probe)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init(&iter, cache->idle);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        GQueue *queue = (GQueue*)value;
+        GList *link = queue->head;
+        while (link) {
+            GList *next = link->next;
+            gfal_sftp_handle_t *handle = (gfal_sftp_handle_t*)link->data;
+            time_t idle = now - handle->last_used;
+            if (idle >= cache->idle_timeout) {
+                *expired = g_slist_prepend(*expired, handle);
+                g_queue_delete_link(queue, link);
+                ++cache->stats.expired;
+            }
+            else if (cache->keepalive_interval > 0 && idle >= cache->keepalive_interval) {
+                *probe = g_slist_prepend(*probe, handle);
+                g_queue_delete_link(queue, link);
+            }
+            link = next;
+        }
+        if (g_queue_is_empty(queue)) {
+            g_hash_table_iter_remove(&iter);
+        }
     }
-    gfal_sftp_handle_t *handle = (gfal_sftp_handle_t*)list->data;
-    list = g_slist_delete_link(list, list);
-    // g_hash_table_insert acquires ownership of key
-    g_hash_table_insert(cache, key, list);
+}
+
+
+static int gfal_sftp_cache_period(gfal_sftp_cache_t *cache)
+{
+    int period = MIN(cache->idle_timeout, cache->keepalive_interval > 0 ? cache->keepalive_interval : cache->idle_timeout);
+    return period < 1 ? 1 : period;
+}
+
+
+// Closes the expired handles of a pool, and sends a keepalive on those that need it
+static void gfal_sftp_cache_sweep(gfal_sftp_cache_t *cache)
+{
+    GSList *expired = NULL, *probe = NULL, *i;
+
+    pthread_mutex_lock(&cache->lock);
+    gfal_sftp_cache_collect(cache, time(NULL), &expired, &probe);
+    pthread_mutex_unlock(&cache->lock);
+
+    g_slist_foreach(expired, (GFunc)gfal_sftp_destroy_handle, NULL);
+    g_slist_free(expired);
+
+    for (i = probe; i != NULL; i = i->next) {
+        gfal_sftp_handle_t *handle = (gfal_sftp_handle_t*)i->data;
+        int rc = 0;
+#if LIBSSH2_VERSION_NUM >= 0x010205
+        int seconds = 0;
+        rc = libssh2_keepalive_send(handle->ssh_session, &seconds);
+#endif
+        if (rc < 0) {
+            gfal2_log(G_LOG_LEVEL_DEBUG, "Idle SFTP handle for %s:%d failed to send keepalive. Discard",
+                handle->host, handle->port);
+            gfal_sftp_destroy_handle(handle, NULL);
+            pthread_mutex_lock(&cache->lock);
+            ++cache->stats.dead;
+            pthread_mutex_unlock(&cache->lock);
+            continue;
+        }
+        // last_used is left untouched, so the handle still expires
+        pthread_mutex_lock(&cache->lock);
+        gfal_sftp_handle_t *evicted = gfal_sftp_cache_insert(cache, handle);
+        pthread_mutex_unlock(&cache->lock);
+        if (evicted) {
+            gfal_sftp_destroy_handle(evicted, NULL);
+        }
+    }
+    g_slist_free(probe);
+}
+
+
+// Reaps idle handles, and keeps alive the rest, so the request path never pays for it
+// Pools are swept with gfal_sftp_keeper_lock held, so they can not be destroyed meanwhile
+static void *gfal_sftp_cache_keeper(void *data)
+{
+    pthread_mutex_lock(&gfal_sftp_keeper_lock);
+    while (!gfal_sftp_keeper_stop) {
+        time_t now = time(NULL);
+        time_t next = now + GFAL_SFTP_DEFAULT_IDLE_TIMEOUT;
+        GSList *i;
+
+        for (i = gfal_sftp_keeper_pools; i != NULL; i = i->next) {
+            gfal_sftp_cache_t *cache = (gfal_sftp_cache_t*)i->data;
+            if (cache->next_sweep <= now) {
+                gfal_sftp_cache_sweep(cache);
+                cache->next_sweep = now + gfal_sftp_cache_period(cache);
+            }
+            next = MIN(next, cache->next_sweep);
+        }
+
+        struct timespec deadline;
+        deadline.tv_sec = next;
+        deadline.tv_nsec = 0;
+        pthread_cond_timedwait(&gfal_sftp_keeper_wakeup, &gfal_sftp_keeper_lock, &deadline);
+    }
+    pthread_mutex_unlock(&gfal_sftp_keeper_lock);
+    return NULL;
+}
+
+
+// Must be called with gfal_sftp_keeper_lock held
+static void gfal_sftp_keeper_start(void)
+{
+    if (pthread_create(&gfal_sftp_keeper, NULL, gfal_sftp_cache_keeper, NULL) == 0) {
+        gfal_sftp_keeper_running = TRUE;
+    }
+    else {
+        gfal2_log(G_LOG_LEVEL_WARNING, "Could not start the SFTP keepalive thread, idle connections will not be reaped");
+    }
+}
+
+
+// Hands the pool to the keeper, starting it if needed
+static void gfal_sftp_keeper_register(gfal_sftp_cache_t *cache)
+{
+    pthread_mutex_lock(&gfal_sftp_keeper_lock);
+    cache->next_sweep = time(NULL) + gfal_sftp_cache_period(cache);
+    gfal_sftp_keeper_pools = g_slist_prepend(gfal_sftp_keeper_pools, cache);
+    if (!gfal_sftp_keeper_running) {
+        gfal_sftp_keeper_start();
+    }
+    pthread_cond_signal(&gfal_sftp_keeper_wakeup);
+    pthread_mutex_unlock(&gfal_sftp_keeper_lock);
+}
+
+
+// Takes the pool away from the keeper, and stops it if it was the last one
+static void gfal_sftp_keeper_unregister(gfal_sftp_cache_t *cache)
+{
+    if (!cache->registered) {
+        return;
+    }
+
+    pthread_mutex_lock(&gfal_sftp_keeper_lock);
+    gfal_sftp_keeper_pools = g_slist_remove(gfal_sftp_keeper_pools, cache);
+
+    // Whoever sets stop joins the thread
+    if (gfal_sftp_keeper_pools != NULL || !gfal_sftp_keeper_running || gfal_sftp_keeper_stop) {
+        pthread_mutex_unlock(&gfal_sftp_keeper_lock);
+        return;
+    }
+    gfal_sftp_keeper_stop = TRUE;
+    pthread_cond_signal(&gfal_sftp_keeper_wakeup);
+    pthread_mutex_unlock(&gfal_sftp_keeper_lock);
+
+    pthread_join(gfal_sftp_keeper, NULL);
+
+    pthread_mutex_lock(&gfal_sftp_keeper_lock);
+    gfal_sftp_keeper_running = FALSE;
+    gfal_sftp_keeper_stop = FALSE;
+    // A pool registered while stopping found the thread still running
+    if (gfal_sftp_keeper_pools != NULL) {
+        gfal_sftp_keeper_start();
+    }
+    pthread_mutex_unlock(&gfal_sftp_keeper_lock);
+}
+
+
+gfal_sftp_cache_t *gfal_sftp_cache_new(gfal2_context_t context)
+{
+    gfal_sftp_cache_t *cache = g_new0(gfal_sftp_cache_t, 1);
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->idle = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, gfal_sftp_destroy_queue);
+
+    cache->max_idle_per_host = gfal2_get_opt_integer_with_default(context, "SFTP PLUGIN", "MAX_IDLE_PER_HOST",
+        GFAL_SFTP_DEFAULT_MAX_IDLE_PER_HOST);
+    cache->idle_timeout = gfal2_get_opt_integer_with_default(context, "SFTP PLUGIN", "IDLE_TIMEOUT",
+        GFAL_SFTP_DEFAULT_IDLE_TIMEOUT);
+    cache->keepalive_interval = gfal2_get_opt_integer_with_default(context, "SFTP PLUGIN", "KEEPALIVE_INTERVAL",
+        GFAL_SFTP_DEFAULT_KEEPALIVE_INTERVAL);
+    return cache;
+}
+
+
+gfal_sftp_handle_t *gfal_sftp_cache_pop(gfal_sftp_cache_t *cache, const char *host, int port)
+{
+    gfal_sftp_handle_t *handle = NULL;
+    gchar *key = gfal_sftp_cache_key(host, port);
+
+    pthread_mutex_lock(&cache->lock);
+    GQueue *queue = (GQueue*)g_hash_table_lookup(cache->idle, key);
+    if (queue) {
+        handle = (gfal_sftp_handle_t*)g_queue_pop_head(queue);
+    }
+    if (handle) {
+        ++cache->stats.hits;
+    }
+    else {
+        ++cache->stats.misses;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    g_free(key);
     return handle;
 }
 
 
-void gfal_sftp_cache_push(GHashTable *cache, gfal_sftp_handle_t *handle)
+void gfal_sftp_cache_push(gfal_sftp_cache_t *cache, gfal_sftp_handle_t *handle)
 {
-    GString *key = g_string_new(NULL);
-    g_string_printf(key, "%s:%d", handle->host, handle->port);
-    GSList *list = (GSList*)g_hash_table_lookup(cache, key);
-    list = g_slist_prepend(list, handle);
-    // g_hash_table_insert acquires ownership of key
-    g_hash_table_insert(cache, key, list);
+    handle->last_used = time(NULL);
+
+    pthread_mutex_lock(&cache->lock);
+    gfal_sftp_handle_t *evicted = gfal_sftp_cache_insert(cache, handle);
+    gboolean first = !cache->registered;
+    cache->registered = TRUE;
+    pthread_mutex_unlock(&cache->lock);
+
+    if (first) {
+        gfal_sftp_keeper_register(cache);
+    }
+
+    if (evicted) {
+        gfal2_log(G_LOG_LEVEL_DEBUG, "Too many idle SFTP handles for %s:%d, closing the oldest",
+            evicted->host, evicted->port);
+        gfal_sftp_destroy_handle(evicted, NULL);
+    }
 }
 
 
-void gfal_sftp_destroy_cache_entry(gpointer key, gpointer value, gpointer user_data)
+void gfal_sftp_cache_get_stats(gfal_sftp_cache_t *cache, gfal_sftp_cache_stats_t *stats)
 {
-    g_slist_foreach((GSList*)value, (GFunc)gfal_sftp_destroy_handle, NULL);
-    g_slist_free((GSList*)value);
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
 }
 
 
-void gfal_sftp_cache_destroy(GHashTable *cache)
+void gfal_sftp_cache_destroy(gfal_sftp_cache_t *cache)
 {
-    g_hash_table_foreach(cache, gfal_sftp_destroy_cache_entry, NULL);
-    g_hash_table_destroy(cache);
+    gfal_sftp_keeper_unregister(cache);
+
+    g_hash_table_destroy(cache->idle);
+    pthread_mutex_destroy(&cache->lock);
+    g_free(cache);
 }
@@ -27,19 +27,28 @@ struct gfal_sftp_handle_s {
     const char *host;
     int port;
     const char *path;
+    time_t last_used;
 };
 typedef struct gfal_sftp_handle_s gfal_sftp_handle_t;
 
-/// SSH session cache
-struct gfal_sftp_handle_cache_s {
-    GHashTable *caches;
+/// SSH session pool
+typedef struct gfal_sftp_cache_s gfal_sftp_cache_t;
+
+/// SSH session pool counters
+struct gfal_sftp_cache_stats_s {
+    guint64 hits;           ///< Handles reused
+    guint64 misses;         ///< Handles requested when none was idle
+    guint64 evicted;        ///< Handles closed because the host had too many idle
+    guint64 expired;        ///< Handles closed because they were idle for too long
+    guint64 dead;           ///< Handles closed because the keepalive failed, or the server closed them
+    guint64 discarded;      ///< Handles closed instead of released, because they were left unusable
 };
-typedef struct gfal_sftp_handle_cache_s gfal_sftp_handle_cache_t;
+typedef struct gfal_sftp_cache_stats_s gfal_sftp_cache_stats_t;
 
 /// Plugin internal data
 struct gfal_sftp_context_s {
     gfal2_context_t gfal2_context;
-    GHashTable *cache;
+    gfal_sftp_cache_t *cache;
 };
 typedef struct gfal_sftp_context_s gfal_sftp_context_t;
 
@@ -61,22 +70,34 @@ gfal_sftp_handle_t *gfal_sftp_connect(gfal_sftp_context_t *context, const char *
 /// @param handle       The handle we are done with
 void gfal_sftp_release(gfal_sftp_context_t *context, gfal_sftp_handle_t *handle);
 
-/// Creates a new GHashTable that models a connection cache
-GHashTable *gfal_sftp_cache_new();
+/// Closes a handle that can not be reused, i.e. with SFTP requests still in flight
+/// @param context      The SFTP context
+/// @param handle       The handle to close
+void gfal_sftp_discard(gfal_sftp_context_t *context, gfal_sftp_handle_t *handle);
+
+/// Creates a new connection pool
+/// Bounds and timeouts are read from the SFTP PLUGIN configuration group.
+/// Once it holds an idle handle, the pool is kept alive by a keepalive thread shared by all of them.
+/// @param context  gfal2 context
+gfal_sftp_cache_t *gfal_sftp_cache_new(gfal2_context_t context);
 
-/// Gets a handle from the cache
+/// Gets the most recently used idle handle from the pool. Thread safe.
 /// @param cache    An initialized cache
 /// @param host     The remote host
 /// @param port     The remote port
 /// @return         NULL if there is no cached entry
-gfal_sftp_handle_t *gfal_sftp_cache_pop(GHashTable *cache, const char *host, int port);
+gfal_sftp_handle_t *gfal_sftp_cache_pop(gfal_sftp_cache_t *cache, const char *host, int port);
 
-/// Puts a handle back to the cache
+/// Puts a handle back to the pool. Thread safe.
+/// If the host already has too many idle handles, the least recently used is closed.
 /// @param handle   The handle to release
-void gfal_sftp_cache_push(GHashTable *cache, gfal_sftp_handle_t *handle);
+void gfal_sftp_cache_push(gfal_sftp_cache_t *cache, gfal_sftp_handle_t *handle);
+
+/// Copies the pool counters into stats
+void gfal_sftp_cache_get_stats(gfal_sftp_cache_t *cache, gfal_sftp_cache_stats_t *stats);
 
-/// Frees memory and closes connections
-void gfal_sftp_cache_destroy(GHashTable *cache);
+/// Frees memory and closes connections. The keepalive thread stops with the last pool.
+void gfal_sftp_cache_destroy(gfal_sftp_cache_t *cache);
 
 
 #endif // GFAL_SFTP_CONNECTION_H
@@ -0,0 +1,534 @@
+/*
+ * Copyright (c) CERN 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gfal_sftp_plugin.h"
+#include <checksums/checksums.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#define GFAL_SFTP_DEFAULT_COPY_BUFFERSIZE 4194304
+#define GFAL_SFTP_DEFAULT_MIN_STREAM_SIZE 16777216
+#define GFAL_SFTP_MAX_STREAMS 64
+#define GFAL_SFTP_PERF_MARKER_INTERVAL 5
+#define GFAL_SFTP_DEFAULT_BULK_CONCURRENCY 4
+
+
+/// State shared by all the streams of a copy
+struct gfal_sftp_copy_s {
+    gfal2_context_t context;
+    const char *src, *dst;
+    size_t buffersize;
+
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    int running;
+    guint64 done;
+    // First error of any stream. Once set, the other streams stop
+    GError *error;
+};
+typedef struct gfal_sftp_copy_s gfal_sftp_copy_t;
+
+/// A range [begin, end) copied by its own pair of sessions
+struct gfal_sftp_stream_s {
+    gfal_sftp_copy_t *copy;
+    off_t begin, end;
+    pthread_t thread;
+};
+typedef struct gfal_sftp_stream_s gfal_sftp_stream_t;
+
+
+static gboolean is_sftp_uri(const char *url)
+{
+    return strncmp(url, "sftp:", 5) == 0;
+}
+
+
+static gboolean is_local_uri(const char *url)
+{
+    return strncmp(url, "file:", 5) == 0;
+}
+
+
+gboolean gfal_sftp_check_url_transfer(plugin_handle plugin_data, gfal2_context_t context,
+    const char *src, const char *dst, gfal_url2_check check)
+{
+    if (src == NULL || dst == NULL) {
+        return FALSE;
+    }
+    if (check != GFAL_FILE_COPY && check != GFAL_BULK_COPY) {
+        return FALSE;
+    }
+    return (is_sftp_uri(src) && (is_sftp_uri(dst) || is_local_uri(dst))) ||
+           (is_local_uri(src) && is_sftp_uri(dst));
+}
+
+
+static void gfal_sftp_copy_set_error(gfal_sftp_copy_t *copy, GError *error)
+{
+    pthread_mutex_lock(&copy->lock);
+    if (copy->error == NULL) {
+        copy->error = error;
+    }
+    else {
+        g_error_free(error);
+    }
+    pthread_mutex_unlock(&copy->lock);
+}
+
+
+static gboolean gfal_sftp_copy_must_stop(gfal_sftp_copy_t *copy)
+{
+    pthread_mutex_lock(&copy->lock);
+    gboolean stop = (copy->error != NULL);
+    pthread_mutex_unlock(&copy->lock);
+    return stop || gfal2_is_canceled(copy->context);
+}
+
+
+static void *gfal_sftp_copy_stream(void *data)
+{
+    gfal_sftp_stream_t *stream = (gfal_sftp_stream_t*)data;
+    gfal_sftp_copy_t *copy = stream->copy;
+    GError *tmp_err = NULL;
+    int fd_src = -1, fd_dst = -1;
+    char *buffer = g_malloc(copy->buffersize);
+
+    // Each open gets its own SSH session from the pool
+    fd_src = gfal2_open(copy->context, copy->src, O_RDONLY, &tmp_err);
+    if (fd_src >= 0) {
+        fd_dst = gfal2_open(copy->context, copy->dst, O_WRONLY, &tmp_err);
+    }
+
+    off_t offset = stream->begin;
+    while (tmp_err == NULL && offset < stream->end && !gfal_sftp_copy_must_stop(copy)) {
+        size_t chunk = MIN(copy->buffersize, (size_t)(stream->end - offset));
+        ssize_t nread = gfal2_pread(copy->context, fd_src, buffer, chunk, offset, &tmp_err);
+        if (nread == 0) {
+            gfal2_set_error(&tmp_err, gfal2_get_plugin_sftp_quark(), EIO, __func__,
+                "Unexpected end of file at offset %lld", (long long)offset);
+        }
+        if (nread <= 0) {
+            break;
+        }
+
+        ssize_t nwritten = gfal2_pwrite(copy->context, fd_dst, buffer, nread, offset, &tmp_err);
+        if (nwritten < 0) {
+            break;
+        }
+        offset += nread;
+
+        pthread_mutex_lock(&copy->lock);
+        copy->done += nread;
+        pthread_mutex_unlock(&copy->lock);
+    }
+    g_free(buffer);
+
+    if (fd_dst >= 0) {
+        gfal2_close(copy->context, fd_dst, tmp_err ? NULL : &tmp_err);
+    }
+    if (fd_src >= 0) {
+        gfal2_close(copy->context, fd_src, NULL);
+    }
+
+    if (tmp_err) {
+        gfal_sftp_copy_set_error(copy, tmp_err);
+    }
+
+    pthread_mutex_lock(&copy->lock);
+    --copy->running;
+    pthread_cond_signal(&copy->finished);
+    pthread_mutex_unlock(&copy->lock);
+    return NULL;
+}
+
+
+static void gfal_sftp_send_performance_data(gfalt_params_t params, const char *src, const char *dst,
+    time_t start, time_t now, time_t last_update, guint64 done, guint64 done_since_last_update)
+{
+    struct _gfalt_transfer_status status;
+    time_t total_time = now - start;
+    time_t inc_time = now - last_update;
+
+    memset(&status, 0, sizeof(status));
+    status.average_baudrate = total_time ? (size_t)(done / total_time) : 0;
+    status.instant_baudrate = inc_time ? (size_t)(done_since_last_update / inc_time) : 0;
+    status.bytes_transfered = (size_t)done;
+    status.transfer_time = total_time;
+
+    plugin_trigger_monitor(params, &status, src, dst);
+}
+
+
+static int gfal_sftp_prepare_destination(gfal2_context_t context, gfalt_params_t params,
+    const char *dst, GError **err)
+{
+    GError *tmp_err = NULL;
+    struct stat st;
+
+    if (gfal2_stat(context, dst, &st, &tmp_err) == 0) {
+        if (!gfalt_get_replace_existing_file(params, NULL)) {
+            gfalt_set_error(err, gfal2_get_plugin_sftp_quark(), EEXIST, __func__,
+                GFALT_ERROR_DESTINATION, GFALT_ERROR_EXISTS, "The file exists and overwrite is not set");
+            return -1;
+        }
+        plugin_trigger_event(params, gfal2_get_plugin_sftp_quark(),
+            GFAL_EVENT_DESTINATION, GFAL_EVENT_OVERWRITE_DESTINATION, "Truncating %s", dst);
+    }
+    else if (tmp_err->code != ENOENT) {
+        gfal2_propagate_prefixed_error(err, tmp_err, __func__);
+        return -1;
+    }
+    else {
+        g_clear_error(&tmp_err);
+        if (gfalt_get_create_parent_dir(params, NULL)) {
+            char *parent = g_path_get_dirname(dst);
+            if (gfal2_stat(context, parent, &st, &tmp_err) < 0) {
+                if (tmp_err->code == ENOENT) {
+                    g_clear_error(&tmp_err);
+                    gfal2_mkdir_rec(context, parent, 0755, &tmp_err);
+                }
+            }
+            g_free(parent);
+            if (tmp_err) {
+                gfalt_propagate_prefixed_error(err, tmp_err, __func__, GFALT_ERROR_DESTINATION, GFALT_ERROR_PARENT);
+                return -1;
+            }
+        }
+    }
+
+    // Create or truncate once, so the streams only need to write into it
+    int fd = gfal2_open2(context, dst, O_WRONLY | O_CREAT | O_TRUNC, 0755, &tmp_err);
+    if (fd >= 0) {
+        gfal2_close(context, fd, &tmp_err);
+    }
+    if (tmp_err) {
+        gfal2_propagate_prefixed_error_extended(err, tmp_err, __func__, "Could not create the destination: ");
+        return -1;
+    }
+    return 0;
+}
+
+
+static int gfal_sftp_get_checksum(gfal2_context_t context, gfalt_params_t params, const char *url,
+    gfal_event_side_t side, const char *type, char *buffer, size_t s_buffer, GError **err)
+{
+    GError *tmp_err = NULL;
+    plugin_trigger_event(params, gfal2_get_plugin_sftp_quark(), side, GFAL_EVENT_CHECKSUM_ENTER, "");
+    gfal2_checksum(context, url, type, 0, 0, buffer, s_buffer, &tmp_err);
+    if (tmp_err) {
+        gfalt_propagate_prefixed_error(err, tmp_err, __func__,
+            side == GFAL_EVENT_SOURCE ? GFALT_ERROR_SOURCE : GFALT_ERROR_DESTINATION, GFALT_ERROR_CHECKSUM);
+        return -1;
+    }
+    plugin_trigger_event(params, gfal2_get_plugin_sftp_quark(), side, GFAL_EVENT_CHECKSUM_EXIT, "");
+    return 0;
+}
+
+
+// Split the file into ranges and copy them in parallel, each with its own sessions
+static int gfal_sftp_streamed_copy(gfal2_context_t context, gfalt_params_t params,
+    const char *src, const char *dst, off_t filesize, GError **err)
+{
+    gfal_sftp_copy_t copy;
+    memset(&copy, 0, sizeof(copy));
+    copy.context = context;
+    copy.src = src;
+    copy.dst = dst;
+    copy.buffersize = gfal2_get_opt_integer_with_default(context, "CORE", "COPY_BUFFERSIZE",
+        GFAL_SFTP_DEFAULT_COPY_BUFFERSIZE);
+    pthread_mutex_init(&copy.lock, NULL);
+    pthread_cond_init(&copy.finished, NULL);
+
+    off_t min_stream_size = gfal2_get_opt_integer_with_default(context, "SFTP PLUGIN", "MIN_STREAM_SIZE",
+        GFAL_SFTP_DEFAULT_MIN_STREAM_SIZE);
+    guint nstreams = gfalt_get_nbstreams(params, NULL);
+    if (nstreams < 1) {
+        nstreams = 1;
+    }
+    if (nstreams > GFAL_SFTP_MAX_STREAMS) {
+        nstreams = GFAL_SFTP_MAX_STREAMS;
+    }
+    if (min_stream_size > 0 && filesize / min_stream_size < nstreams) {
+        nstreams = MAX(1, filesize / min_stream_size);
+    }
+
+    gfal2_log(G_LOG_LEVEL_DEBUG, "SFTP copy %s => %s of %lld bytes with %u streams",
+        src, dst, (long long)filesize, nstreams);
+
+    gfal_sftp_stream_t *streams = g_new0(gfal_sftp_stream_t, nstreams);
+    off_t range = filesize / nstreams;
+    guint i, started = 0;
+
+    pthread_mutex_lock(&copy.lock);
+    for (i = 0; i < nstreams; ++i) {
+        streams[i].copy = &copy;
+        streams[i].begin = i * range;
+        streams[i].end = (i == nstreams - 1) ? filesize : (i + 1) * range;
+        if (pthread_create(&streams[i].thread, NULL, gfal_sftp_copy_stream, &streams[i]) != 0) {
+            if (copy.error == NULL) {
+                gfal2_set_error(&copy.error, gfal2_get_plugin_sftp_quark(), errno, __func__,
+                    "Could not start the copy stream %u", i);
+            }
+            break;
+        }
+        ++copy.running;
+        ++started;
+    }
+
+    // Wait, sending performance markers and enforcing the timeout
+    time_t start = time(NULL), last_update = start;
+    time_t timeout = start + gfalt_get_timeout(params, NULL);
+    guint64 done_last_update = 0;
+
+    while (copy.running > 0) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;
+        pthread_cond_timedwait(&copy.finished, &copy.lock, &deadline);
+
+        time_t now = time(NULL);
+        if (now >= timeout && copy.error == NULL) {
+            gfal2_set_error(&copy.error, gfal2_get_plugin_sftp_quark(), ETIMEDOUT, __func__,
+                "Transfer canceled because the timeout expired");
+        }
+        else if (gfal2_is_canceled(context) && copy.error == NULL) {
+            gfal2_set_error(&copy.error, gfal2_get_plugin_sftp_quark(), ECANCELED, __func__,
+                "Transfer canceled");
+        }
+        else if (now - last_update >= GFAL_SFTP_PERF_MARKER_INTERVAL) {
+            guint64 done = copy.done;
+            pthread_mutex_unlock(&copy.lock);
+            gfal_sftp_send_performance_data(params, src, dst, start, now, last_update,
+                done, done - done_last_update);
+            pthread_mutex_lock(&copy.lock);
+            done_last_update = done;
+            last_update = now;
+        }
+    }
+    pthread_mutex_unlock(&copy.lock);
+
+    for (i = 0; i < started; ++i) {
+        pthread_join(streams[i].thread, NULL);
+    }
+    g_free(streams);
+
+    pthread_cond_destroy(&copy.finished);
+    pthread_mutex_destroy(&copy.lock);
+
+    if (copy.error) {
+        gfalt_propagate_prefixed_error(err, copy.error, __func__, GFALT_ERROR_TRANSFER, NULL);
+        return -1;
+    }
+    return 0;
+}
+
+
+int gfal_sftp_copy_file(plugin_handle plugin_data, gfal2_context_t context, gfalt_params_t params,
+    const char *src, const char *dst, GError **err)
+{
+    GError *tmp_err = NULL;
+    char checksum_type[64] = {0};
+    char user_checksum[GFAL_URL_MAX_LEN] = {0};
+    char source_checksum[GFAL_URL_MAX_LEN] = {0};
+    char destination_checksum[GFAL_URL_MAX_LEN] = {0};
+    struct stat st;
+
+    gfalt_checksum_mode_t checksum_mode = gfalt_get_checksum(params,
+        checksum_type, sizeof(checksum_type), user_checksum, sizeof(user_checksum), NULL);
+    if (checksum_type[0] == '\0') {
+        g_strlcpy(checksum_type, "ADLER32", sizeof(checksum_type));
+    }
+
+    plugin_trigger_event(params, gfal2_get_plugin_sftp_quark(), GFAL_EVENT_NONE,
+        GFAL_EVENT_TRANSFER_ENTER, "%s => %s", src, dst);
+    plugin_trigger_event(params, gfal2_get_plugin_sftp_quark(), GFAL_EVENT_NONE,
+        GFAL_EVENT_TRANSFER_TYPE, "%s", GFAL_TRANSFER_TYPE_STREAMED);
+
+    if (gfal2_stat(context, src, &st, &tmp_err) < 0) {
+        gfalt_propagate_prefixed_error(err, tmp_err, __func__, GFALT_ERROR_SOURCE, NULL);
+        return -1;
+    }
+
+    if (checksum_mode & GFALT_CHECKSUM_SOURCE) {
+        if (gfal_sftp_get_checksum(context, params, src, GFAL_EVENT_SOURCE, checksum_type,
+                source_checksum, sizeof(source_checksum), err) < 0) {
+            return -1;
+        }
+        if (user_checksum[0] && gfal_compare_checksums(user_checksum, source_checksum, sizeof(source_checksum)) != 0) {
+            gfalt_set_error(err, gfal2_get_plugin_sftp_quark(), EIO, __func__,
+                GFALT_ERROR_SOURCE, GFALT_ERROR_CHECKSUM_MISMATCH,
+                "Source checksum and user-specified checksum do not match: %s != %s",
+                source_checksum, user_checksum);
+            return -1;
+        }
+    }
+
+    if (gfal_sftp_prepare_destination(context, params, dst, err) < 0) {
+        return -1;
+    }
+
+    if (gfal_sftp_streamed_copy(context, params, src, dst, st.st_size, err) < 0) {
+        return -1;
+    }
+
+    if (checksum_mode & GFALT_CHECKSUM_TARGET) {
+        const char *expected = user_checksum[0] ? user_checksum : source_checksum;
+        if (gfal_sftp_get_checksum(context, params, dst, GFAL_EVENT_DESTINATION, checksum_type,
+                destination_checksum, sizeof(destination_checksum), err) < 0) {
+            return -1;
+        }
+        if (expected[0] && gfal_compare_checksums(expected, destination_checksum, sizeof(destination_checksum)) != 0) {
+            gfalt_set_error(err, gfal2_get_plugin_sftp_quark(), EIO, __func__,
+                GFALT_ERROR_DESTINATION, GFALT_ERROR_CHECKSUM_MISMATCH,
+                "Source and destination checksums do not match: %s != %s",
+                expected, destination_checksum);
+            return -1;
+        }
+    }
+
+    plugin_trigger_event(params, gfal2_get_plugin_sftp_quark(), GFAL_EVENT_NONE,
+        GFAL_EVENT_TRANSFER_EXIT, "%s => %s", src, dst);
+    return 0;
+}
+
+
+/// State shared by the workers of a bulk copy
+struct gfal_sftp_bulk_s {
+    plugin_handle plugin_data;
+    gfal2_context_t context;
+    gfalt_params_t params;
+    size_t nbfiles;
+    const char *const *srcs, *const *dsts, *const *checksums;
+    GError **file_errors;
+
+    pthread_mutex_t lock;
+    size_t next;
+    int failed;
+};
+typedef struct gfal_sftp_bulk_s gfal_sftp_bulk_t;
+
+
+static int gfal_sftp_copy_bulk_file(gfal_sftp_bulk_t *bulk, size_t i)
+{
+    GError **file_error = &bulk->file_errors[i];
+
+    if (gfal2_is_canceled(bulk->context)) {
+        gfal2_set_error(file_error, gfal2_get_plugin_sftp_quark(), ECANCELED, __func__, "Transfer canceled");
+        return -1;
+    }
+
+    // The files run concurrently, so their callbacks are forwarded one at a time
+    GError *tmp_err = NULL;
+    gfalt_params_t file_params = gfalt_params_handle_copy_bulk_file(bulk->params,
+        bulk->checksums ? bulk->checksums[i] : NULL, &tmp_err);
+    if (file_params == NULL) {
+        gfal2_propagate_prefixed_error(file_error, tmp_err, __func__);
+        return -1;
+    }
+
+    int ret = gfal_sftp_copy_file(bulk->plugin_data, bulk->context, file_params,
+        bulk->srcs[i], bulk->dsts[i], file_error);
+    gfalt_params_handle_delete(file_params, NULL);
+    return ret;
+}
+
+
+static void *gfal_sftp_copy_bulk_worker(void *data)
+{
+    gfal_sftp_bulk_t *bulk = (gfal_sftp_bulk_t*)data;
+
+    while (1) {
+        pthread_mutex_lock(&bulk->lock);
+        size_t i = bulk->next++;
+        pthread_mutex_unlock(&bulk->lock);
+        if (i >= bulk->nbfiles) {
+            break;
+        }
+
+        if (gfal_sftp_copy_bulk_file(bulk, i) < 0) {
+            pthread_mutex_lock(&bulk->lock);
+            ++bulk->failed;
+            pthread_mutex_unlock(&bulk->lock);
+        }
+    }
+    return NULL;
+}
+
+
+// Files are copied by up to SFTP PLUGIN:BULK_COPY_CONCURRENCY workers, each of them
+// running the streams of one file at a time
+int gfal_sftp_copy_bulk(plugin_handle plugin_data, gfal2_context_t context, gfalt_params_t params,
+    size_t nbfiles, const char *const *srcs, const char *const *dsts, const char *const *checksums,
+    GError **op_error, GError ***file_errors)
+{
+    *file_errors = g_new0(GError*, nbfiles);
+    if (nbfiles == 0) {
+        return 0;
+    }
+
+    gfal_sftp_bulk_t bulk;
+    memset(&bulk, 0, sizeof(bulk));
+    bulk.plugin_data = plugin_data;
+    bulk.context = context;
+    bulk.params = params;
+    bulk.nbfiles = nbfiles;
+    bulk.srcs = srcs;
+    bulk.dsts = dsts;
+    bulk.checksums = checksums;
+    bulk.file_errors = *file_errors;
+    pthread_mutex_init(&bulk.lock, NULL);
+
+    int nworkers = gfal2_get_opt_integer_with_default(context, "SFTP PLUGIN", "BULK_COPY_CONCURRENCY",
+        GFAL_SFTP_DEFAULT_BULK_CONCURRENCY);
+    if (nworkers < 1) {
+        nworkers = 1;
+    }
+    if ((size_t)nworkers > nbfiles) {
+        nworkers = nbfiles;
+    }
+
+    gfal2_log(G_LOG_LEVEL_INFO, "SFTP bulk copy of %zu files with up to %d concurrent transfers", nbfiles, nworkers);
+
+    // The calling thread is one of the workers
+    pthread_t *workers = g_new0(pthread_t, nworkers);
+    int started = 1, w;
+    for (w = 1; w < nworkers; ++w) {
+        if (pthread_create(&workers[w], NULL, gfal_sftp_copy_bulk_worker, &bulk) != 0) {
+            gfal2_log(G_LOG_LEVEL_WARNING, "Could only start %d SFTP bulk copy workers", started);
+            break;
+        }
+        ++started;
+    }
+    gfal_sftp_copy_bulk_worker(&bulk);
+    for (w = 1; w < started; ++w) {
+        pthread_join(workers[w], NULL);
+    }
+    g_free(workers);
+    pthread_mutex_destroy(&bulk.lock);
+
+    if (gfal2_is_canceled(context)) {
+        gfal2_set_error(op_error, gfal2_get_plugin_sftp_quark(), ECANCELED, __func__,
+            "Bulk copy canceled, %d out of %zu files failed", bulk.failed, nbfiles);
+    }
+    else if ((size_t)bulk.failed == nbfiles) {
+        gfal2_set_error(op_error, gfal2_get_plugin_sftp_quark(), EIO, __func__,
+            "All the %zu files of the bulk copy failed", nbfiles);
+    }
+    return -bulk.failed;
+}
@@ -16,6 +16,9 @@
 
 #include "gfal_sftp_plugin.h"
 #include "gfal_sftp_connection.h"
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
 
 // These methods were introduced with version 1.0
 #if LIBSSH2_VERSION_MAJOR < 1
@@ -24,9 +27,21 @@
 #endif
 
 
+#define GFAL_SFTP_DEFAULT_PIPELINE_DEPTH 64
+#define GFAL_SFTP_DEFAULT_IO_TIMEOUT 300
+// Roughly the payload libssh2 puts on each SSH_FXP_READ/WRITE packet
+#define GFAL_SFTP_PACKET_SIZE 32768
+
+
 struct gfal_sftp_file_s {
     gfal_sftp_handle_t *sftp_handle;
     LIBSSH2_SFTP_HANDLE *file_handle;
+    // Bytes handed to libssh2 on each call, which splits them into
+    // that many outstanding packets
+    size_t window;
+    int timeout;
+    // Set when an I/O failed with requests still outstanding on the session
+    gboolean broken;
 };
 typedef struct gfal_sftp_file_s gfal_sftp_file_t;
 
@@ -67,6 +82,16 @@ gfal_file_handle gfal_sftp_open(plugin_handle plugin_data, const char *url, int
     gfal_sftp_file_t *fd = g_malloc(sizeof(gfal_sftp_file_t));
     fd->sftp_handle = sftp_handle;
 
+    int depth = gfal2_get_opt_integer_with_default(data->gfal2_context, "SFTP PLUGIN", "PIPELINE_DEPTH",
+        GFAL_SFTP_DEFAULT_PIPELINE_DEPTH);
+    if (depth < 1) {
+        depth = 1;
+    }
+    fd->window = (size_t)depth * GFAL_SFTP_PACKET_SIZE;
+    fd->broken = FALSE;
+    fd->timeout = gfal2_get_opt_integer_with_default(data->gfal2_context, "SFTP PLUGIN", "IO_TIMEOUT",
+        GFAL_SFTP_DEFAULT_IO_TIMEOUT);
+
     fd->file_handle = libssh2_sftp_open(sftp_handle->sftp_session, sftp_handle->path,
         gfal_sftp_std2ssh2_open_flags(flag), mode);
     if (!fd->file_handle) {
@@ -85,8 +110,15 @@ int gfal_sftp_close(plugin_handle plugin_data, gfal_file_handle fd, GError **err
     gfal_sftp_context_t *data = (gfal_sftp_context_t*)plugin_data;
     gfal_sftp_file_t *ssh_fd = gfal_file_handle_get_fdesc(fd);
 
-    libssh2_sftp_close(ssh_fd->file_handle);
-    gfal_sftp_release(data, ssh_fd->sftp_handle);
+    if (ssh_fd->broken) {
+        // Closing the file would read the replies of the requests still outstanding,
+        // so drop the whole connection instead, which cancels them on the remote
+        gfal_sftp_discard(data, ssh_fd->sftp_handle);
+    }
+    else {
+        libssh2_sftp_close(ssh_fd->file_handle);
+        gfal_sftp_release(data, ssh_fd->sftp_handle);
+    }
     g_free(ssh_fd);
 
     gfal_file_handle_delete(fd);
@@ -94,39 +126,188 @@ int gfal_sftp_close(plugin_handle plugin_data, gfal_file_handle fd, GError **err
 }
 
 
-ssize_t gfal_sftp_read(plugin_handle plugin_data, gfal_file_handle fd, void *buff, size_t count, GError **err)
+// Wait until the socket is ready in the direction libssh2 is blocked on
+static int gfal_sftp_wait_socket(gfal_sftp_file_t *ssh_fd, const char *func, GError **err)
 {
-    gfal_sftp_file_t *ssh_fd = gfal_file_handle_get_fdesc(fd);
-    ssize_t read = 0;
+    struct pollfd pfd;
+    int dir = libssh2_session_block_directions(ssh_fd->sftp_handle->ssh_session);
 
-    // libssh2 may need to read in chunks
-    char *buffer = (char*)buff;
+    pfd.fd = ssh_fd->sftp_handle->sock;
+    pfd.events = 0;
+    pfd.revents = 0;
+    if (dir & LIBSSH2_SESSION_BLOCK_INBOUND) {
+        pfd.events |= POLLIN;
+    }
+    if (dir & LIBSSH2_SESSION_BLOCK_OUTBOUND) {
+        pfd.events |= POLLOUT;
+    }
+
+    int rc;
     do {
-        ssize_t rc = libssh2_sftp_read(ssh_fd->file_handle, buffer + read, count - read);
-        if (rc < 0) {
+        rc = poll(&pfd, 1, ssh_fd->timeout * 1000);
+    } while (rc < 0 && errno == EINTR);
+
+    if (rc == 0) {
+        gfal2_set_error(err, gfal2_get_plugin_sftp_quark(), ETIMEDOUT, func,
+            "Timeout waiting for the remote after %d seconds", ssh_fd->timeout);
+        return -1;
+    }
+    else if (rc < 0) {
+        gfal2_set_error(err, gfal2_get_plugin_sftp_quark(), errno, func,
+            "Failed to wait on the SSH socket: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+
+// A failed pipelined read or write may leave requests in flight, and their replies would
+// be taken as the answer to whatever comes next on the session. The session stays in
+// non-blocking mode, and is discarded when the file is closed.
+static ssize_t gfal_sftp_pipeline_failed(gfal_sftp_file_t *ssh_fd)
+{
+    gfal2_log(G_LOG_LEVEL_DEBUG, "SFTP I/O failed with requests in flight, the connection to %s:%d will be closed",
+        ssh_fd->sftp_handle->host, ssh_fd->sftp_handle->port);
+    ssh_fd->broken = TRUE;
+    return -1;
+}
+
+
+static int gfal_sftp_check_broken(gfal_sftp_file_t *ssh_fd, const char *func, GError **err)
+{
+    if (ssh_fd->broken) {
+        gfal2_set_error(err, gfal2_get_plugin_sftp_quark(), EIO, func,
+            "A previous read or write on this file failed, it must be closed");
+        return -1;
+    }
+    return 0;
+}
+
+
+// Read count bytes, or until EOF, keeping up to window bytes requested ahead
+static ssize_t gfal_sftp_pipelined_read(gfal_sftp_file_t *ssh_fd, char *buffer, size_t count, GError **err)
+{
+    LIBSSH2_SESSION *session = ssh_fd->sftp_handle->ssh_session;
+    ssize_t read = 0;
+
+    if (gfal_sftp_check_broken(ssh_fd, __func__, err) < 0) {
+        return -1;
+    }
+
+    libssh2_session_set_blocking(session, 0);
+    while (read < count) {
+        size_t chunk = MIN(count - read, ssh_fd->window);
+        ssize_t rc = libssh2_sftp_read(ssh_fd->file_handle, buffer + read, chunk);
+        if (rc == LIBSSH2_ERROR_EAGAIN) {
+            if (gfal_sftp_wait_socket(ssh_fd, __func__, err) < 0) {
+                return gfal_sftp_pipeline_failed(ssh_fd);
+            }
+            continue;
+        }
+        else if (rc < 0) {
             gfal_plugin_sftp_translate_error(__func__, ssh_fd->sftp_handle, err);
-            return rc;
-        } else if (rc == 0) {
+            return gfal_sftp_pipeline_failed(ssh_fd);
+        }
+        else if (rc == 0) {
             break;
         }
         read += rc;
-    } while (read < count);
+    }
+    libssh2_session_set_blocking(session, 1);
 
     return read;
 }
 
 
+// Write count bytes, keeping up to window bytes in flight. Returns once all of them are acknowledged.
+static ssize_t gfal_sftp_pipelined_write(gfal_sftp_file_t *ssh_fd, const char *buffer, size_t count, GError **err)
+{
+    LIBSSH2_SESSION *session = ssh_fd->sftp_handle->ssh_session;
+    ssize_t written = 0;
+
+    if (gfal_sftp_check_broken(ssh_fd, __func__, err) < 0) {
+        return -1;
+    }
+
+    libssh2_session_set_blocking(session, 0);
+    while (written < count) {
+        // On EAGAIN, or short writes, libssh2 expects the same buffer back starting at the
+        // first byte not yet acknowledged, which is exactly buffer + written
+        size_t chunk = MIN(count - written, ssh_fd->window);
+        ssize_t rc = libssh2_sftp_write(ssh_fd->file_handle, buffer + written, chunk);
+        if (rc == LIBSSH2_ERROR_EAGAIN) {
+            if (gfal_sftp_wait_socket(ssh_fd, __func__, err) < 0) {
+                return gfal_sftp_pipeline_failed(ssh_fd);
+            }
+            continue;
+        }
+        else if (rc < 0) {
+            gfal_plugin_sftp_translate_error(__func__, ssh_fd->sftp_handle, err);
+            return gfal_sftp_pipeline_failed(ssh_fd);
+        }
+        written += rc;
+    }
+    libssh2_session_set_blocking(session, 1);
+
+    return written;
+}
+
+
+ssize_t gfal_sftp_read(plugin_handle plugin_data, gfal_file_handle fd, void *buff, size_t count, GError **err)
+{
+    gfal_sftp_file_t *ssh_fd = gfal_file_handle_get_fdesc(fd);
+
+    gfal_file_handle_lock(fd);
+    ssize_t rc = gfal_sftp_pipelined_read(ssh_fd, (char*)buff, count, err);
+    gfal_file_handle_unlock(fd);
+
+    return rc;
+}
+
+
 ssize_t gfal_sftp_write(plugin_handle plugin_data, gfal_file_handle fd, const void *buff, size_t count, GError **err)
 {
     gfal_sftp_file_t *ssh_fd = gfal_file_handle_get_fdesc(fd);
-    ssize_t rc = libssh2_sftp_write(ssh_fd->file_handle, buff, count);
-    if (rc < 0) {
-        gfal_plugin_sftp_translate_error(__func__, ssh_fd->sftp_handle, err);
-    }
-    // normally, one would expect to return the value from libssh2_sftp_write, but as it happens it may be
-    // shorter, but still the data is cached on the pipe.
-    // See https://www.libssh2.org/libssh2_sftp_write.html
-    return count;
+
+    gfal_file_handle_lock(fd);
+    ssize_t rc = gfal_sftp_pipelined_write(ssh_fd, (const char*)buff, count, err);
+    gfal_file_handle_unlock(fd);
+
+    return rc;
+}
+
+
+ssize_t gfal_sftp_pread(plugin_handle plugin_data, gfal_file_handle fd, void *buff, size_t count,
+    off_t offset, GError **err)
+{
+    gfal_sftp_file_t *ssh_fd = gfal_file_handle_get_fdesc(fd);
+
+    // The session is shared by the whole file, so positional reads still serialize,
+    // but the file offset seen by read/write is preserved
+    gfal_file_handle_lock(fd);
+    libssh2_uint64_t position = libssh2_sftp_tell64(ssh_fd->file_handle);
+    libssh2_sftp_seek64(ssh_fd->file_handle, offset);
+    ssize_t rc = gfal_sftp_pipelined_read(ssh_fd, (char*)buff, count, err);
+    libssh2_sftp_seek64(ssh_fd->file_handle, position);
+    gfal_file_handle_unlock(fd);
+
+    return rc;
+}
+
+
+ssize_t gfal_sftp_pwrite(plugin_handle plugin_data, gfal_file_handle fd, const void *buff, size_t count,
+    off_t offset, GError **err)
+{
+    gfal_sftp_file_t *ssh_fd = gfal_file_handle_get_fdesc(fd);
+
+    gfal_file_handle_lock(fd);
+    libssh2_uint64_t position = libssh2_sftp_tell64(ssh_fd->file_handle);
+    libssh2_sftp_seek64(ssh_fd->file_handle, offset);
+    ssize_t rc = gfal_sftp_pipelined_write(ssh_fd, (const char*)buff, count, err);
+    libssh2_sftp_seek64(ssh_fd->file_handle, position);
+    gfal_file_handle_unlock(fd);
+
+    return rc;
 }
 
 
@@ -136,6 +317,11 @@ off_t gfal_sftp_seek(plugin_handle plugin_data, gfal_file_handle fd, off_t offse
     off_t absolute = 0;
     LIBSSH2_SFTP_ATTRIBUTES attrs;
 
+    gfal_file_handle_lock(fd);
+    if (gfal_sftp_check_broken(ssh_fd, __func__, err) < 0) {
+        gfal_file_handle_unlock(fd);
+        return -1;
+    }
     switch (whence) {
         case SEEK_SET:
             absolute = offset;
@@ -146,10 +332,12 @@ off_t gfal_sftp_seek(plugin_handle plugin_data, gfal_file_handle fd, off_t offse
         case SEEK_END:
             if (libssh2_sftp_fstat(ssh_fd->file_handle, &attrs) < 0) {
                 gfal_plugin_sftp_translate_error(__func__, ssh_fd->sftp_handle, err);
+                gfal_file_handle_unlock(fd);
                 return -1;
             }
             absolute = attrs.filesize + offset;
     }
     libssh2_sftp_seek64(ssh_fd->file_handle, absolute);
+    gfal_file_handle_unlock(fd);
     return absolute;
 }
@@ -61,6 +61,15 @@ static gboolean gfal_sftp_check_url(plugin_handle handle, const char *url, plugi
 static void gfal_plugin_sftp_delete(plugin_handle plugin_data)
 {
     gfal_sftp_context_t *data = (gfal_sftp_context_t*)plugin_data;
+    gfal_sftp_cache_stats_t stats;
+    gfal_sftp_cache_get_stats(data->cache, &stats);
+    guint64 requests = stats.hits + stats.misses;
+    gfal2_log(G_LOG_LEVEL_DEBUG,
+        "SFTP connection pool: %" G_GUINT64_FORMAT " reused out of %" G_GUINT64_FORMAT " (%.1f%%), "
+        "%" G_GUINT64_FORMAT " evicted, %" G_GUINT64_FORMAT " expired, %" G_GUINT64_FORMAT " dead, "
+        "%" G_GUINT64_FORMAT " discarded",
+        stats.hits, requests, requests ? (100.0 * stats.hits) / requests : 0.0,
+        stats.evicted, stats.expired, stats.dead, stats.discarded);
     gfal_sftp_cache_destroy(data->cache);
     free(data);
 }
@@ -73,7 +82,7 @@ gfal_plugin_interface gfal_plugin_init(gfal2_context_t context, GError **err)
 
     gfal_sftp_context_t *data = g_malloc(sizeof(gfal_sftp_context_t));
     data->gfal2_context = context;
-    data->cache = gfal_sftp_cache_new();
+    data->cache = gfal_sftp_cache_new(context);
 
     sftp_plugin.plugin_data = data;
     sftp_plugin.plugin_delete = gfal_plugin_sftp_delete;
@@ -101,6 +110,12 @@ gfal_plugin_interface gfal_plugin_init(gfal2_context_t context, GError **err)
     sftp_plugin.readG = gfal_sftp_read;
     sftp_plugin.writeG = gfal_sftp_write;
     sftp_plugin.lseekG = gfal_sftp_seek;
+    sftp_plugin.preadG = gfal_sftp_pread;
+    sftp_plugin.pwriteG = gfal_sftp_pwrite;
+
+    sftp_plugin.check_plugin_url_transfer = gfal_sftp_check_url_transfer;
+    sftp_plugin.copy_file = gfal_sftp_copy_file;
+    sftp_plugin.copy_bulk = gfal_sftp_copy_bulk;
 
     return sftp_plugin;
 }
@@ -79,9 +79,26 @@ ssize_t gfal_sftp_read(plugin_handle plugin_data, gfal_file_handle fd,
 ssize_t gfal_sftp_write(plugin_handle plugin_data, gfal_file_handle fd,
     const void *buff, size_t count, GError **err);
 
+ssize_t gfal_sftp_pread(plugin_handle plugin_data, gfal_file_handle fd,
+    void *buff, size_t count, off_t offset, GError **err);
+
+ssize_t gfal_sftp_pwrite(plugin_handle plugin_data, gfal_file_handle fd,
+    const void *buff, size_t count, off_t offset, GError **err);
+
 int gfal_sftp_close(plugin_handle plugin_data, gfal_file_handle fd, GError **err);
 
 off_t gfal_sftp_seek(plugin_handle plugin_data, gfal_file_handle fd,
     off_t offset, int whence, GError **err);
 
+// Transfer operations
+gboolean gfal_sftp_check_url_transfer(plugin_handle plugin_data, gfal2_context_t context,
+    const char *src, const char *dst, gfal_url2_check check);
+
+int gfal_sftp_copy_file(plugin_handle plugin_data, gfal2_context_t context, gfalt_params_t params,
+    const char *src, const char *dst, GError **err);
+
+int gfal_sftp_copy_bulk(plugin_handle plugin_data, gfal2_context_t context, gfalt_params_t params,
+    size_t nbfiles, const char *const *srcs, const char *const *dsts, const char *const *checksums,
+    GError **op_error, GError ***file_errors);
+
 #endif // GFAL_SFTP_PLUGIN_H
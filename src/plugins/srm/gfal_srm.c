@@ -208,6 +208,7 @@ void gfal_srm_opt_initG(gfal_srmv2_opt *opts, gfal2_context_t handle)
     opts->handle = handle;
     opts->cache = gsimplecache_new(5000, &srm_internal_copy_stat,
         sizeof(struct extended_stat));
+    opts->cache_metrics = gfal2_metrics_register_cache(handle, "srm_stat");
     g_static_rec_mutex_init(&opts->srm_context_mutex);
 }
 
@@ -258,6 +259,7 @@ gfal_plugin_interface gfal_plugin_init(gfal2_context_t handle, GError **err)
     srm_plugin.abort_files = &gfal_srm2_abort_filesG;
     srm_plugin.renameG = &gfal_srm_renameG;
     srm_plugin.unlink_listG = &gfal_srm_unlink_listG;
+    srm_plugin.stat_listG = &gfal_srm_stat_listG;
     srm_plugin.archive_poll = &gfal_srm_archive_pollG;
     srm_plugin.archive_poll_list = &gfal_srm_archive_poll_listG;
     return srm_plugin;
@@ -36,6 +36,9 @@
 
 #define GFAL_SRM_LSTAT_PREFIX "lstat_"
 
+// Most servers refuse requests with more SURLs than this
+#define GFAL_SRM_DEFAULT_MAX_SURLS 1000
+
 //typedef struct srm_spacemd gfal_spacemd;
 enum status_type {DEFAULT_STATUS = 0, MD_STATUS, PIN_STATUS};
 
@@ -71,6 +74,7 @@ typedef struct _gfal_srmv2_opt{
 	regex_t rex_full;
 	gfal2_context_t handle;
 	GSimpleCache* cache;
+	gfal_metrics_cache_t cache_metrics;
 
 	char srm_ifce_error_buffer[GFAL_ERRMSG_LEN];
 
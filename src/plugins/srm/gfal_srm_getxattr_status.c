@@ -68,9 +68,11 @@ ssize_t gfal_srm_status_internal(gfal_srmv2_opt *opts, srm_context_t context, co
     gfal_srm_construct_key(path, GFAL_SRM_LSTAT_PREFIX, key_buff, GFAL_URL_MAX_LEN);
     if (gsimplecache_take_one_kstr(opts->cache, key_buff, &buf) == 0) {
         gfal2_log(G_LOG_LEVEL_DEBUG, " gfal_srm_status_internal -> value taken from the cache");
+        gfal2_metrics_cache_lookup(opts->cache_metrics, TRUE);
         ret = 0;
     }
     else {
+        gfal2_metrics_cache_lookup(opts->cache_metrics, FALSE);
         ret = gfal_statG_srmv2__generic_internal(context, &buf.stat, &buf.locality, path, &tmp_err);
     }
 
@@ -26,6 +26,7 @@ const char *srm_config_turl_protocols = "TURL_PROTOCOLS";
 const char *srm_config_3rd_party_turl_protocols = "TURL_3RD_PARTY_PROTOCOLS";
 const char *srm_config_keep_alive = "KEEP_ALIVE";
 const char *srm_spacetokendesc = "SPACETOKENDESC";
+const char *srm_config_max_surls = "MAX_SURLS_PER_REQUEST";
 
 #include "gfal_srm_internal_layer.h"
 #include "gfal_srm_url_check.h"
@@ -34,6 +34,7 @@ extern const char *srm_config_transfer_checksum;
 extern const char *srm_config_turl_protocols;
 extern const char *srm_config_3rd_party_turl_protocols;
 extern const char *srm_spacetokendesc;
+extern const char *srm_config_max_surls;
 
 // request type for surl <-> turl translation
 typedef enum _srm_req_type {
@@ -22,24 +22,6 @@
 #include "gfal_srm_endpoint.h"
 
 
-/*
- * clear memory used by the internal srm_ifce items
- * required by the old design of srm_ifce
- *
- * */
-void gfal_srm_ls_memory_management(struct srm_ls_input *input, struct srm_ls_output *output)
-{
-    if (input) {
-        // nothing
-
-    }
-    if (output) {
-        gfal_srm_external_call.srm_srmv2_mdfilestatus_delete(output->statuses, 1);
-        gfal_srm_external_call.srm_srm2__TReturnStatus_delete(output->retstatus);
-
-    }
-}
-
 /*
  *  concentrate the srm_ls logical in one point for stat, readdir, status, and access
  *
@@ -82,25 +64,23 @@ static void gfal_srm_adjust_time(struct stat *buf)
 }
 
 
-int gfal_statG_srmv2__generic_internal(srm_context_t context, struct stat *buf, TFileLocality *loc,
-    const char *surl, GError **err)
+int gfal_statG_srmv2__list_internal(srm_context_t context, int nbfiles, const char *const *surls,
+    struct stat *bufs, TFileLocality *locs, GError **errors)
 {
-    g_return_val_err_if_fail(context && surl
-                             && buf
+    g_return_val_err_if_fail(context && surls
+                             && bufs
 #if !defined(_DARWIN_FEATURE_ONLY_64_BIT_INODE)
                              && (sizeof(struct stat) == sizeof(struct stat64))
 #endif
-        , -1, err, "[gfal_statG_srmv2_generic_internal] Invalid args handle/endpoint or invalid stat struct size");
+        , -1, errors, "[gfal_statG_srmv2__list_internal] Invalid args handle/endpoint or invalid stat struct size");
     GError *tmp_err = NULL;
     struct srm_ls_input input;
     struct srm_ls_output output;
-    struct srmv2_mdfilestatus *srmv2_mdstatuses = NULL;
-    const int nb_request = 1;
-    int ret = -1;
-    char *tab_surl[] = {(char *) surl, NULL};
+    int ret = -1, i;
 
-    input.nbfiles = nb_request;
-    input.surls = tab_surl;
+    memset(&output, 0, sizeof(output));
+    input.nbfiles = nbfiles;
+    input.surls = (char **) surls;
     input.numlevels = 0;
     input.offset = 0;
     input.count = 0;
@@ -108,23 +88,44 @@ int gfal_statG_srmv2__generic_internal(srm_context_t context, struct stat *buf,
     ret = gfal_srm_ls_internal(context, &input, &output, &tmp_err);
 
     if (ret >= 0) {
-        srmv2_mdstatuses = output.statuses;
-        if (srmv2_mdstatuses->status != 0) {
-            gfal2_set_error(&tmp_err, gfal2_get_plugin_srm_quark(), srmv2_mdstatuses->status, __func__,
-                "Error reported from srm_ifce : %d %s",
-                srmv2_mdstatuses->status, srmv2_mdstatuses->explanation);
-            ret = -1;
-        } else {
-            memcpy(buf, &(srmv2_mdstatuses->stat), sizeof(struct stat));
-            if (loc)
-                *loc = srmv2_mdstatuses->locality;
-            errno = 0;
-            ret = 0;
-            // SRM returns the time in UTC
-            gfal_srm_adjust_time(buf);
+        ret = 0;
+        for (i = 0; i < nbfiles; ++i) {
+            struct srmv2_mdfilestatus *srmv2_mdstatus = &output.statuses[i];
+            if (srmv2_mdstatus->status != 0) {
+                gfal2_set_error(&errors[i], gfal2_get_plugin_srm_quark(), srmv2_mdstatus->status, __func__,
+                    "Error reported from srm_ifce : %d %s",
+                    srmv2_mdstatus->status, srmv2_mdstatus->explanation);
+                ret = -1;
+            } else {
+                memcpy(&bufs[i], &(srmv2_mdstatus->stat), sizeof(struct stat));
+                if (locs)
+                    locs[i] = srmv2_mdstatus->locality;
+                // SRM returns the time in UTC
+                gfal_srm_adjust_time(&bufs[i]);
+            }
         }
+        if (ret == 0)
+            errno = 0;
+    }
+    else {
+        for (i = 0; i < nbfiles; ++i)
+            errors[i] = g_error_copy(tmp_err);
+        g_error_free(tmp_err);
     }
-    gfal_srm_ls_memory_management(&input, &output);
+    gfal_srm_external_call.srm_srmv2_mdfilestatus_delete(output.statuses, nbfiles);
+    gfal_srm_external_call.srm_srm2__TReturnStatus_delete(output.retstatus);
+
+    return ret;
+}
+
+
+int gfal_statG_srmv2__generic_internal(srm_context_t context, struct stat *buf, TFileLocality *loc,
+    const char *surl, GError **err)
+{
+    GError *tmp_err = NULL;
+    const char *tab_surl[] = {surl, NULL};
+
+    int ret = gfal_statG_srmv2__list_internal(context, 1, tab_surl, buf, loc, &tmp_err);
 
     G_RETURN_ERR(ret, tmp_err, err);
 }
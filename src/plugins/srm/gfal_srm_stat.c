@@ -18,11 +18,14 @@
  * limitations under the License.
  */
 
+#include <string.h>
+
 #include "gfal_srm.h"
 #include "gfal_srm_internal_ls.h"
 #include "gfal_srm_namespace.h"
 #include "gfal_srm_internal_layer.h"
 #include "gfal_srm_endpoint.h"
+#include "gfal_srm_url_check.h"
 
 
 int gfal_statG_srmv2_internal(srm_context_t context, struct stat *buf, TFileLocality *loc, const char *surl,
@@ -50,11 +53,13 @@ int gfal_srm_statG(plugin_handle ch, const char *surl, struct stat *buf, GError
     if (gsimplecache_take_one_kstr(opts->cache, key_buff, &xstat) == 0) {
         gfal2_log(G_LOG_LEVEL_DEBUG,
             " srm_statG -> value taken from the cache");
+        gfal2_metrics_cache_lookup(opts->cache_metrics, TRUE);
         ret = 0;
         *buf = xstat.stat;
     }
     // Ask server otherwise
     else {
+        gfal2_metrics_cache_lookup(opts->cache_metrics, FALSE);
         gfal_srm_easy_t easy = gfal_srm_ifce_easy_context(opts, surl, &tmp_err);
         if (easy != NULL) {
             gfal2_log(G_LOG_LEVEL_DEBUG, "   [gfal_srm_statG] try to stat file %s", surl);
@@ -75,3 +80,98 @@ int gfal_srm_statG(plugin_handle ch, const char *surl, struct stat *buf, GError
 
     return ret;
 }
+
+
+/*
+ * bulk stat, the files not in the cache are queried with as few srm_ls as the
+ * server limit on the number of SURLs per request allows
+ */
+int gfal_srm_stat_listG(plugin_handle ch, int nbfiles, const char *const *surls, struct stat *bufs, GError **errors)
+{
+    g_return_val_err_if_fail(ch && surls && bufs && errors, -1, errors, "[gfal_srm_stat_listG] Invalid args");
+    GError *tmp_err = NULL;
+    gfal_srmv2_opt *opts = (gfal_srmv2_opt *) ch;
+    char key_buff[GFAL_URL_MAX_LEN];
+    struct extended_stat xstat;
+    int ret = 0, i, offset, nbpending = 0;
+
+    int *pending_index = g_new(int, nbfiles);
+
+    for (i = 0; i < nbfiles; ++i) {
+        gfal_srm_construct_key(surls[i], GFAL_SRM_LSTAT_PREFIX, key_buff, GFAL_URL_MAX_LEN);
+        if (gsimplecache_take_one_kstr(opts->cache, key_buff, &xstat) == 0) {
+            gfal2_metrics_cache_lookup(opts->cache_metrics, TRUE);
+            bufs[i] = xstat.stat;
+        }
+        else {
+            gfal2_metrics_cache_lookup(opts->cache_metrics, FALSE);
+            pending_index[nbpending] = i;
+            ++nbpending;
+        }
+    }
+    gfal2_log(G_LOG_LEVEL_DEBUG, "   [gfal_srm_stat_listG] %d files taken from the cache, %d to query",
+        nbfiles - nbpending, nbpending);
+    if (nbpending == 0) {
+        g_free(pending_index);
+        return 0;
+    }
+
+    gfal_srm_easy_t easy = gfal_srm_ifce_easy_context(opts, surls[pending_index[0]], &tmp_err);
+    if (easy == NULL) {
+        for (i = 0; i < nbpending; ++i) {
+            errors[pending_index[i]] = g_error_copy(tmp_err);
+        }
+        g_error_free(tmp_err);
+        g_free(pending_index);
+        return -1;
+    }
+
+    int max_surls = gfal2_get_opt_integer_with_default(opts->handle, srm_config_group, srm_config_max_surls,
+        GFAL_SRM_DEFAULT_MAX_SURLS);
+    if (max_surls <= 0) {
+        max_surls = nbpending;
+    }
+    int chunk_size = MIN(max_surls, nbpending);
+
+    char **decoded = g_new0(char *, chunk_size + 1);
+    struct stat *chunk_bufs = g_new(struct stat, chunk_size);
+    TFileLocality *chunk_locs = g_new(TFileLocality, chunk_size);
+    GError **chunk_errors = g_new0(GError *, chunk_size);
+
+    for (offset = 0; offset < nbpending; offset += chunk_size) {
+        int count = MIN(chunk_size, nbpending - offset);
+
+        for (i = 0; i < count; ++i) {
+            decoded[i] = gfal2_srm_get_decoded_path(surls[pending_index[offset + i]]);
+        }
+        decoded[count] = NULL;
+
+        if (gfal_statG_srmv2__list_internal(easy->srm_context, count, (const char *const *) decoded,
+                chunk_bufs, chunk_locs, chunk_errors) < 0) {
+            ret = -1;
+        }
+
+        for (i = 0; i < count; ++i) {
+            int index = pending_index[offset + i];
+            if (chunk_errors[i]) {
+                errors[index] = chunk_errors[i];
+                chunk_errors[i] = NULL;
+            }
+            else {
+                bufs[index] = chunk_bufs[i];
+                gfal_srm_cache_stat_add(ch, surls[index], &chunk_bufs[i], &chunk_locs[i]);
+            }
+            g_free(decoded[i]);
+            decoded[i] = NULL;
+        }
+    }
+
+    g_free(chunk_errors);
+    g_free(chunk_locs);
+    g_free(chunk_bufs);
+    g_free(decoded);
+    g_free(pending_index);
+    gfal_srm_ifce_easy_context_release(opts, easy);
+
+    return ret;
+}
@@ -20,7 +20,10 @@
 
 #include <condition_variable>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <vector>
 #include <sys/stat.h>
 
 // This header provides all the required functions except chmod
@@ -70,98 +73,127 @@ int gfal_xrootd_statG(plugin_handle handle, const char* path, struct stat* buff,
         GError ** err)
 {
     std::string sanitizedUrl = prepare_url((gfal2_context_t) handle, path);
+    set_xrootd_log_level();
 
     // reset stat fields
     reset_stat(*buff);
 
-    if (XrdPosixXrootd::Stat(sanitizedUrl.c_str(), buff) != 0) {
-        gfal2_xrootd_set_error(err, errno, __func__, "Failed to stat file");
+    XrdCl::URL xrdcl_url(sanitizedUrl);
+    XrdCl::FileSystem fs(xrdcl_url);
+    XrdCl::StatInfo* stinfo = NULL;
+    XrdCl::XRootDStatus status = fs.Stat(xrdcl_url.GetPathWithParams(), stinfo);
+    if (!status.IsOK()) {
+        gfal2_xrootd_set_error(err, xrootd_status_to_posix_errno(status), __func__,
+            "Failed to stat file: %s", status.ToStr().c_str());
         return -1;
     }
+    stat_info_to_stat(stinfo, *buff);
+    delete stinfo;
     return 0;
 }
 
 
-gfal_file_handle gfal_xrootd_openG(plugin_handle handle, const char *path,
-        int flag, mode_t mode, GError ** err)
-{
-    std::string sanitizedUrl = prepare_url((gfal2_context_t) handle, path);
+// Shared by the asynchronous requests of a bulk operation
+struct BulkListState {
+    std::mutex mutex;
+    std::condition_variable cv;
+    int pending;
 
-    int *fd = new int;
-    *fd = XrdPosixXrootd::Open(sanitizedUrl.c_str(), flag, mode);
-    if (*fd == -1) {
-        gfal2_xrootd_set_error(err, errno, __func__, "Failed to open file");
-        delete fd;
-        return NULL;
+    BulkListState(): pending(0) {}
+
+    void Done()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --pending;
+        cv.notify_all();
     }
-    return gfal_file_handle_new(gfal_xrootd_getName(), (gpointer) fd);
-}
+};
 
 
-ssize_t gfal_xrootd_readG(plugin_handle handle, gfal_file_handle fd, void *buff,
-        size_t count, GError ** err)
+class StatListHandler: public XrdCl::ResponseHandler
 {
-    int * fdesc = (int*) (gfal_file_handle_get_fdesc(fd));
-    if (!fdesc) {
-        gfal2_xrootd_set_error(err, errno, __func__, "Bad file handle");
-        return -1;
+public:
+    StatListHandler(BulkListState& state, struct stat* st, GError** err): state(state), st(st), err(err)
+    {
     }
-    ssize_t l = XrdPosixXrootd::Read(*fdesc, buff, count);
-    if (l < 0) {
-        gfal2_xrootd_set_error(err, errno, __func__, "Failed while reading from file");
-        return -1;
+
+    void HandleResponse(XrdCl::XRootDStatus* status, XrdCl::AnyObject* response)
+    {
+        if (status->IsOK()) {
+            XrdCl::StatInfo* stinfo = NULL;
+            response->Get<XrdCl::StatInfo*>(stinfo);
+            if (stinfo) {
+                stat_info_to_stat(stinfo, *st);
+            }
+        }
+        else {
+            gfal2_xrootd_set_error(err, xrootd_status_to_posix_errno(*status), __func__,
+                "Failed to stat file: %s", status->ToStr().c_str());
+        }
+        delete status;
+        delete response;
+        state.Done();
     }
-    return l;
-}
+
+private:
+    BulkListState& state;
+    struct stat* st;
+    GError** err;
+};
 
 
-ssize_t gfal_xrootd_writeG(plugin_handle handle, gfal_file_handle fd,
-        const void *buff, size_t count, GError ** err)
+// The stat requests are pipelined over one connection per host, with up to BULK_INFLIGHT at once
+int gfal_xrootd_stat_listG(plugin_handle handle, int nbfiles, const char* const* urls,
+        struct stat* buffs, GError** errors)
 {
-    int * fdesc = (int*) (gfal_file_handle_get_fdesc(fd));
-    if (!fdesc) {
-        gfal2_xrootd_set_error(err, errno, __func__, "Bad file handle");
-        return -1;
-    }
-    ssize_t l = XrdPosixXrootd::Write(*fdesc, buff, count);
-    if (l < 0) {
-        gfal2_xrootd_set_error(err, errno, __func__, "Failed while writing to file");
-        return -1;
+    gfal2_context_t context = (gfal2_context_t) handle;
+    set_xrootd_log_level();
+
+    int inflight = gfal2_get_opt_integer_with_default(context, XROOTD_CONFIG_GROUP, XROOTD_BULK_INFLIGHT, 64);
+    if (inflight <= 0) {
+        inflight = 1;
     }
-    return l;
-}
 
+    BulkListState state;
+    std::map<std::string, std::unique_ptr<XrdCl::FileSystem>> filesystems;
+    std::vector<std::unique_ptr<StatListHandler>> handlers;
+    handlers.reserve(nbfiles);
+    int ret = 0;
 
-off_t gfal_xrootd_lseekG(plugin_handle handle, gfal_file_handle fd,
-        off_t offset, int whence, GError **err)
-{
-    int * fdesc = (int*) (gfal_file_handle_get_fdesc(fd));
-    if (!fdesc) {
-        gfal2_xrootd_set_error(err, errno, __func__, "Bad file handle");
-        return -1;
-    }
-    off_t l = XrdPosixXrootd::Lseek(*fdesc, offset, whence);
-    if (l < 0) {
-        gfal2_xrootd_set_error(err, errno, __func__, "Failed to seek within file");
-        return -1;
+    for (int i = 0; i < nbfiles; ++i) {
+        reset_stat(buffs[i]);
+
+        XrdCl::URL xrdcl_url(prepare_url(context, urls[i]));
+        std::unique_ptr<XrdCl::FileSystem>& fs = filesystems[xrdcl_url.GetHostId()];
+        if (!fs) {
+            fs.reset(new XrdCl::FileSystem(xrdcl_url));
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.cv.wait(lock, [&state, inflight] { return state.pending < inflight; });
+            ++state.pending;
+        }
+
+        handlers.emplace_back(new StatListHandler(state, &buffs[i], &errors[i]));
+        XrdCl::XRootDStatus status = fs->Stat(xrdcl_url.GetPathWithParams(), handlers.back().get());
+        if (!status.IsOK()) {
+            gfal2_xrootd_set_error(&errors[i], xrootd_status_to_posix_errno(status), __func__,
+                "Failed to stat file: %s", status.ToStr().c_str());
+            state.Done();
+        }
     }
-    return l;
-}
 
+    // The handlers must outlive all the responses
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.cv.wait(lock, [&state] { return state.pending == 0; });
 
-int gfal_xrootd_closeG(plugin_handle handle, gfal_file_handle fd, GError ** err)
-{
-    int r = 0;
-    int * fdesc = (int*) (gfal_file_handle_get_fdesc(fd));
-    if (fdesc) {
-        r = XrdPosixXrootd::Close(*fdesc);
-        if (r != 0) {
-            gfal2_xrootd_set_error(err, errno, __func__, "Failed to close file");
+    for (int i = 0; i < nbfiles; ++i) {
+        if (errors[i] != NULL) {
+            ret = -1;
         }
-        delete (int*) (gfal_file_handle_get_fdesc(fd));
     }
-    gfal_file_handle_delete(fd);
-    return r;
+    return ret;
 }
 
 
@@ -370,21 +402,6 @@ public:
         cv.notify_all();
     }
 
-    void StatInfo2Stat(const XrdCl::StatInfo* stinfo, struct stat* st)
-    {
-        st->st_size = stinfo->GetSize();
-        st->st_mtime = stinfo->GetModTime();
-        st->st_mode = 0;
-        if (stinfo->TestFlags(XrdCl::StatInfo::IsDir))
-            st->st_mode |= S_IFDIR;
-        if (stinfo->TestFlags(XrdCl::StatInfo::IsReadable))
-            st->st_mode |= (S_IRUSR | S_IRGRP | S_IROTH);
-        if (stinfo->TestFlags(XrdCl::StatInfo::IsWritable))
-            st->st_mode |= (S_IWUSR | S_IWGRP | S_IWOTH);
-        if (stinfo->TestFlags(XrdCl::StatInfo::XBitSet))
-            st->st_mode |= (S_IXUSR | S_IXGRP | S_IXOTH);
-    }
-
     struct dirent* Get(struct stat* st = NULL)
     {
         if (!done) {
@@ -413,7 +430,7 @@ public:
 
         if (st != NULL) {
             if (stinfo != NULL) {
-                StatInfo2Stat(stinfo, st);
+                stat_info_to_stat(stinfo, *st);
             }
             else {
 
@@ -425,7 +442,7 @@ public:
                     errstr = status.ToString();
                     return NULL;
                 }
-                StatInfo2Stat(stinfo, st);
+                stat_info_to_stat(stinfo, *st);
                 delete stinfo;
             }
         }
@@ -515,6 +532,28 @@ int gfal_xrootd_closedirG(plugin_handle plugin_data, gfal_file_handle dir_desc,
 }
 
 
+// The checksum queries return "type value"
+static int xrootd_parse_checksum(const std::string& type, char* checksum_buffer, size_t buffer_length,
+        GError** err)
+{
+    char* space = ::index(checksum_buffer, ' ');
+    if (!space) {
+        gfal2_xrootd_set_error(err, errno, __func__, "Could not get the checksum (Wrong format)");
+        return -1;
+    }
+    *space = '\0';
+
+    if (strncasecmp(checksum_buffer, type.c_str(), type.length()) != 0) {
+        gfal2_xrootd_set_error(err, errno, __func__, "Got '%s' while expecting '%s'",
+                checksum_buffer, type.c_str());
+        return -1;
+    }
+
+    memmove(checksum_buffer, space + 1, strlen(space + 1) + 1);
+    return 0;
+}
+
+
 int gfal_xrootd_checksumG(plugin_handle plugin_data, const char* url,
         const char* check_type, char * checksum_buffer, size_t buffer_length,
         off_t start_offset, size_t data_length, GError ** err)
@@ -542,24 +581,104 @@ int gfal_xrootd_checksumG(plugin_handle plugin_data, const char* url,
         return -1;
     }
 
-    // Note that the returned value is "type value"
-    char* space = ::index(checksum_buffer, ' ');
-    if (!space) {
-        gfal2_xrootd_set_error(err, errno, __func__, "Could not get the checksum (Wrong format)");
-        return -1;
+    return xrootd_parse_checksum(lowerChecksumType, checksum_buffer, buffer_length, err);
+}
+
+
+class ChecksumListHandler: public XrdCl::ResponseHandler
+{
+public:
+    ChecksumListHandler(BulkListState& state, const std::string& type, char* buffer, size_t buffer_length,
+            GError** err): state(state), type(type), buffer(buffer), buffer_length(buffer_length), err(err)
+    {
     }
-    *space = '\0';
 
-    if (strncasecmp(checksum_buffer, lowerChecksumType.c_str(),
-            lowerChecksumType.length()) != 0) {
-        gfal2_xrootd_set_error(err, errno, __func__, "Got '%s' while expecting '%s'",
-                checksum_buffer, lowerChecksumType.c_str());
-        return -1;
+    void HandleResponse(XrdCl::XRootDStatus* status, XrdCl::AnyObject* response)
+    {
+        XrdCl::Buffer* answer = NULL;
+        if (status->IsOK() && response) {
+            response->Get<XrdCl::Buffer*>(answer);
+        }
+        if (answer) {
+            copy_to_cstring(buffer, buffer_length, answer->GetBuffer(), answer->GetSize());
+            xrootd_parse_checksum(type, buffer, buffer_length, err);
+        }
+        else {
+            gfal2_xrootd_set_error(err, xrootd_status_to_posix_errno(*status), __func__,
+                "Could not get the checksum: %s", status->ToStr().c_str());
+        }
+        delete status;
+        delete response;
+        state.Done();
     }
 
-    g_strlcpy(checksum_buffer, space + 1, buffer_length);
+private:
+    BulkListState& state;
+    const std::string& type;
+    char* buffer;
+    size_t buffer_length;
+    GError** err;
+};
+
 
-    return 0;
+// Same as the bulk stat, the cks.type queries are pipelined
+int gfal_xrootd_checksum_listG(plugin_handle plugin_data, int nbfiles, const char* const* urls,
+        const char* check_type, char** checksum_buffers, size_t buffer_length, GError** errors)
+{
+    gfal2_context_t context = (gfal2_context_t) plugin_data;
+    set_xrootd_log_level();
+
+    int inflight = gfal2_get_opt_integer_with_default(context, XROOTD_CONFIG_GROUP, XROOTD_BULK_INFLIGHT, 64);
+    if (inflight <= 0) {
+        inflight = 1;
+    }
+
+    std::string lowerChecksumType = predefined_checksum_type_to_lower(check_type);
+    BulkListState state;
+    std::map<std::string, std::unique_ptr<XrdCl::FileSystem>> filesystems;
+    std::vector<std::unique_ptr<ChecksumListHandler>> handlers;
+    handlers.reserve(nbfiles);
+    int ret = 0;
+
+    for (int i = 0; i < nbfiles; ++i) {
+        XrdCl::URL xrdcl_url(prepare_url(context, urls[i]));
+        std::unique_ptr<XrdCl::FileSystem>& fs = filesystems[xrdcl_url.GetHostId()];
+        if (!fs) {
+            fs.reset(new XrdCl::FileSystem(xrdcl_url));
+        }
+
+        std::string query = xrdcl_url.GetPathWithParams();
+        query += (query.find('?') == std::string::npos) ? "?" : "&";
+        query += "cks.type=" + lowerChecksumType;
+        XrdCl::Buffer arg;
+        arg.FromString(query);
+
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.cv.wait(lock, [&state, inflight] { return state.pending < inflight; });
+            ++state.pending;
+        }
+
+        handlers.emplace_back(new ChecksumListHandler(state, lowerChecksumType, checksum_buffers[i],
+            buffer_length, &errors[i]));
+        XrdCl::XRootDStatus status = fs->Query(XrdCl::QueryCode::Checksum, arg, handlers.back().get());
+        if (!status.IsOK()) {
+            gfal2_xrootd_set_error(&errors[i], xrootd_status_to_posix_errno(status), __func__,
+                "Could not get the checksum: %s", status.ToStr().c_str());
+            state.Done();
+        }
+    }
+
+    // The handlers must outlive all the responses
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.cv.wait(lock, [&state] { return state.pending == 0; });
+
+    for (int i = 0; i < nbfiles; ++i) {
+        if (errors[i] != NULL) {
+            ret = -1;
+        }
+    }
+    return ret;
 }
 
 
@@ -28,18 +28,29 @@
 #define XROOTD_CHECKSUM_MODE    "COPY_CHECKSUM_MODE"
 #define XROOTD_PARALLEL_COPIES  "PARALLEL_COPIES"
 #define XROOTD_NORMALIZE_PATH   "NORMALIZE_PATH"
+#define XROOTD_IO_CHUNK_SIZE    "IO_CHUNK_SIZE"
+#define XROOTD_READ_AHEAD_DEPTH "READ_AHEAD_DEPTH"
+#define XROOTD_VECTOR_READ      "VECTOR_READ"
+#define XROOTD_BULK_INFLIGHT    "BULK_INFLIGHT"
 
 extern "C" {
 
 
 int gfal_xrootd_statG(plugin_handle handle, const char* name, struct stat* buff, GError ** err);
 
+int gfal_xrootd_stat_listG(plugin_handle handle, int nbfiles, const char* const* urls,
+        struct stat* buffs, GError** errors);
+
 gfal_file_handle gfal_xrootd_openG(plugin_handle handle, const char *path, int flag, mode_t mode, GError ** err);
 
 ssize_t gfal_xrootd_readG(plugin_handle handle, gfal_file_handle fd, void *buff, size_t count, GError ** err);
 
+ssize_t gfal_xrootd_preadG(plugin_handle handle, gfal_file_handle fd, void *buff, size_t count, off_t offset, GError ** err);
+
 ssize_t gfal_xrootd_writeG(plugin_handle handle, gfal_file_handle fd, const void *buff, size_t count, GError ** err);
 
+ssize_t gfal_xrootd_pwriteG(plugin_handle handle, gfal_file_handle fd, const void *buff, size_t count, off_t offset, GError ** err);
+
 off_t gfal_xrootd_lseekG(plugin_handle handle, gfal_file_handle fd, off_t offset, int whence, GError **err);
 
 int gfal_xrootd_closeG(plugin_handle handle, gfal_file_handle fd, GError ** err);
@@ -69,6 +80,10 @@ int gfal_xrootd_checksumG(plugin_handle data, const char* url, const char* check
                           off_t start_offset, size_t data_length,
                           GError ** err);
 
+int gfal_xrootd_checksum_listG(plugin_handle plugin_data, int nbfiles, const char* const* urls,
+                               const char* check_type, char** checksum_buffers, size_t buffer_length,
+                               GError** errors);
+
 ssize_t gfal_xrootd_getxattrG(plugin_handle plugin_data, const char* url, const char* key,
                             void* buff, size_t s_buff, GError** err);
 
@@ -0,0 +1,546 @@
+/*
+ * Copyright (c) CERN 2013-2015
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <fcntl.h>
+#include <string.h>
+
+#include <XrdCl/XrdClFile.hh>
+#include <XrdCl/XrdClXRootDResponses.hh>
+
+// TRUE and FALSE are defined in Glib and xrootd headers
+#ifdef TRUE
+#undef TRUE
+#endif
+#ifdef FALSE
+#undef FALSE
+#endif
+
+#include <gfal_plugins_api.h>
+#include "gfal_xrootd_plugin_interface.h"
+#include "gfal_xrootd_plugin_io.h"
+#include "gfal_xrootd_plugin_utils.h"
+
+// Upper bound of the size of each element of a vector read (kXR_readv)
+#define XROOTD_MAX_VECTOR_CHUNK_SIZE    2097136
+#define XROOTD_MAX_VECTOR_CHUNKS        1024
+
+
+// Tracks a set of asynchronous requests issued on the same file,
+// bounding how many are outstanding at the same time
+class RequestBatch
+{
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t pending;
+    bool failed;
+
+public:
+    std::vector<uint32_t> transferred;
+    XrdCl::XRootDStatus error;
+
+    RequestBatch(size_t nrequests): pending(0), failed(false), transferred(nrequests, 0)
+    {
+    }
+
+    void Issued()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++pending;
+    }
+
+    void Done(size_t index, const XrdCl::XRootDStatus& status, uint32_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!status.IsOK() && !failed) {
+            failed = true;
+            error = status;
+        }
+        transferred[index] = bytes;
+        --pending;
+        cv.notify_all();
+    }
+
+    // Wait until there are less than max requests outstanding
+    // Returns false if any of the requests failed
+    bool WaitBelow(size_t max)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this, max] { return pending < max; });
+        return !failed;
+    }
+
+    bool WaitAll()
+    {
+        return WaitBelow(1);
+    }
+};
+
+
+class ChunkHandler: public XrdCl::ResponseHandler
+{
+private:
+    RequestBatch* batch;
+    size_t index;
+    uint32_t size;
+
+public:
+    ChunkHandler(RequestBatch* batch, size_t index, uint32_t size):
+        batch(batch), index(index), size(size)
+    {
+    }
+
+    void HandleResponse(XrdCl::XRootDStatus* status, XrdCl::AnyObject* response)
+    {
+        uint32_t bytes = 0;
+        if (status->IsOK()) {
+            XrdCl::ChunkInfo* info = NULL;
+            if (response) {
+                response->Get(info);
+            }
+            // Writes have no response
+            bytes = info ? info->length : size;
+        }
+        batch->Done(index, *status, bytes);
+        delete status;
+        delete response;
+        delete this;
+    }
+};
+
+
+static XrootdFile* get_xrootd_file(gfal_file_handle fd, const char* func, GError** err)
+{
+    XrootdFile* xfile = (XrootdFile*) (gfal_file_handle_get_fdesc(fd));
+    if (!xfile) {
+        gfal2_xrootd_set_error(err, EBADF, func, "Bad file handle");
+    }
+    return xfile;
+}
+
+
+static XrdCl::OpenFlags::Flags std_to_xrdcl_open_flags(int flag)
+{
+    if (flag & O_CREAT) {
+        XrdCl::OpenFlags::Flags flags = (flag & O_EXCL) ? XrdCl::OpenFlags::New : XrdCl::OpenFlags::Delete;
+        return flags | XrdCl::OpenFlags::MakePath;
+    }
+    if ((flag & O_ACCMODE) != O_RDONLY) {
+        return XrdCl::OpenFlags::Update;
+    }
+    return XrdCl::OpenFlags::Read;
+}
+
+
+// Read [offset, offset + count) splitting it into chunks with up to depth outstanding requests
+static ssize_t xrootd_parallel_read(XrootdFile* xfile, uint64_t offset, char* buff, size_t count,
+    XrdCl::XRootDStatus& error)
+{
+    size_t nchunks = (count + xfile->chunk_size - 1) / xfile->chunk_size;
+    if (nchunks <= 1) {
+        uint32_t bytes = 0;
+        error = xfile->file.Read(offset, count, buff, bytes);
+        return error.IsOK() ? (ssize_t)bytes : -1;
+    }
+
+    RequestBatch batch(nchunks);
+    size_t max_outstanding = xfile->depth ? xfile->depth : 1;
+    for (size_t i = 0; i < nchunks; ++i) {
+        if (!batch.WaitBelow(max_outstanding)) {
+            break;
+        }
+        uint64_t chunk_offset = i * (uint64_t)xfile->chunk_size;
+        uint32_t chunk = std::min<uint64_t>(xfile->chunk_size, count - chunk_offset);
+        batch.Issued();
+        ChunkHandler* handler = new ChunkHandler(&batch, i, chunk);
+        XrdCl::XRootDStatus st = xfile->file.Read(offset + chunk_offset, chunk, buff + chunk_offset, handler);
+        if (!st.IsOK()) {
+            delete handler;
+            batch.Done(i, st, 0);
+            break;
+        }
+    }
+    if (!batch.WaitAll()) {
+        error = batch.error;
+        return -1;
+    }
+
+    // Stop at the first short read, which marks the end of file
+    ssize_t total = 0;
+    for (size_t i = 0; i < nchunks; ++i) {
+        uint32_t expected = std::min<uint64_t>(xfile->chunk_size, count - i * (uint64_t)xfile->chunk_size);
+        total += batch.transferred[i];
+        if (batch.transferred[i] < expected) {
+            break;
+        }
+    }
+    return total;
+}
+
+
+// Same as xrootd_parallel_read, but with a single kXR_readv round trip per batch of chunks
+static ssize_t xrootd_vector_read(XrootdFile* xfile, uint64_t offset, char* buff, size_t count,
+    XrdCl::XRootDStatus& error)
+{
+    uint32_t chunk_size = std::min<uint32_t>(xfile->chunk_size, XROOTD_MAX_VECTOR_CHUNK_SIZE);
+    ssize_t total = 0;
+
+    while ((size_t)total < count) {
+        XrdCl::ChunkList chunks;
+        size_t batch_size = 0;
+        while (chunks.size() < XROOTD_MAX_VECTOR_CHUNKS && total + batch_size < count) {
+            uint32_t len = std::min<uint64_t>(chunk_size, count - total - batch_size);
+            chunks.push_back(XrdCl::ChunkInfo(offset + total + batch_size, len, buff + total + batch_size));
+            batch_size += len;
+        }
+
+        XrdCl::VectorReadInfo* info = NULL;
+        error = xfile->file.VectorRead(chunks, NULL, info);
+        if (!error.IsOK()) {
+            delete info;
+            // Servers reject vector reads crossing the end of file, fallback to plain reads
+            ssize_t rest = xrootd_parallel_read(xfile, offset + total, buff + total, count - total, error);
+            return rest < 0 ? -1 : total + rest;
+        }
+        uint32_t received = info ? info->GetSize() : 0;
+        delete info;
+
+        total += received;
+        if (received < batch_size) {
+            break;
+        }
+    }
+    return total;
+}
+
+
+static ssize_t xrootd_parallel_write(XrootdFile* xfile, uint64_t offset, const char* buff, size_t count,
+    XrdCl::XRootDStatus& error)
+{
+    size_t nchunks = (count + xfile->chunk_size - 1) / xfile->chunk_size;
+    if (nchunks <= 1) {
+        error = xfile->file.Write(offset, count, buff);
+        return error.IsOK() ? (ssize_t)count : -1;
+    }
+
+    RequestBatch batch(nchunks);
+    size_t max_outstanding = xfile->depth ? xfile->depth : 1;
+    for (size_t i = 0; i < nchunks; ++i) {
+        if (!batch.WaitBelow(max_outstanding)) {
+            break;
+        }
+        uint64_t chunk_offset = i * (uint64_t)xfile->chunk_size;
+        uint32_t chunk = std::min<uint64_t>(xfile->chunk_size, count - chunk_offset);
+        batch.Issued();
+        ChunkHandler* handler = new ChunkHandler(&batch, i, chunk);
+        XrdCl::XRootDStatus st = xfile->file.Write(offset + chunk_offset, chunk, buff + chunk_offset, handler);
+        if (!st.IsOK()) {
+            delete handler;
+            batch.Done(i, st, 0);
+            break;
+        }
+    }
+    if (!batch.WaitAll()) {
+        error = batch.error;
+        return -1;
+    }
+    return count;
+}
+
+
+// Issue the reads of the window up to the end of file or, if the size is not known,
+// up to want_end only, so no request goes past the end of file on speculation
+// Must be called with the file lock held
+static void xrootd_fill_window(XrootdFile* xfile, uint64_t want_end)
+{
+    uint64_t next = xfile->window.empty() ? xfile->offset : xfile->window.back()->offset + xfile->chunk_size;
+    uint64_t limit = xfile->size_known ? xfile->size : want_end;
+
+    while (xfile->window.size() < xfile->depth && next < limit) {
+        std::shared_ptr<ReadAheadChunk> chunk = std::make_shared<ReadAheadChunk>(next, xfile->chunk_size);
+        chunk->self = chunk;
+        XrdCl::XRootDStatus st = xfile->file.Read(next, xfile->chunk_size, chunk->data.data(), chunk.get());
+        if (!st.IsOK()) {
+            chunk->Complete(st, 0);
+        }
+        xfile->window.push_back(chunk);
+        next += xfile->chunk_size;
+    }
+}
+
+
+// Sequential read served from the read-ahead window
+// Must be called with the file lock held
+ssize_t xrootd_read_ahead(XrootdFile* xfile, char* buff, size_t count, XrdCl::XRootDStatus& error)
+{
+    size_t done = 0;
+
+    while (done < count) {
+        // Drop what is behind, restart if the position jumped outside the window
+        while (!xfile->window.empty() &&
+               xfile->window.front()->offset + xfile->chunk_size <= xfile->offset) {
+            xfile->window.pop_front();
+        }
+        if (!xfile->window.empty() && xfile->window.front()->offset > xfile->offset) {
+            xfile->window.clear();
+        }
+        xrootd_fill_window(xfile, xfile->offset + (count - done));
+        if (xfile->window.empty()) {
+            break;
+        }
+
+        std::shared_ptr<ReadAheadChunk> chunk = xfile->window.front();
+        chunk->Wait();
+        if (!chunk->status.IsOK()) {
+            error = chunk->status;
+            xfile->window.clear();
+            return -1;
+        }
+
+        uint64_t chunk_end = chunk->offset + chunk->size;
+        if (chunk->size < xfile->chunk_size && (!xfile->size_known || xfile->size > chunk_end)) {
+            // Short chunk, so this is the end of file. Whatever was issued after it is of no use.
+            xfile->size = chunk_end;
+            xfile->size_known = true;
+            xfile->window.resize(1);
+        }
+        if (xfile->offset >= chunk_end) {
+            break;
+        }
+        size_t n = std::min<uint64_t>(count - done, chunk_end - xfile->offset);
+        memcpy(buff + done, chunk->data.data() + (xfile->offset - chunk->offset), n);
+        done += n;
+        xfile->offset += n;
+
+        // Short chunk, end of file
+        if (chunk->size < xfile->chunk_size && xfile->offset >= chunk_end) {
+            break;
+        }
+    }
+    return done;
+}
+
+
+gfal_file_handle gfal_xrootd_openG(plugin_handle handle, const char *path,
+        int flag, mode_t mode, GError ** err)
+{
+    gfal2_context_t context = (gfal2_context_t) handle;
+    std::string sanitizedUrl = prepare_url(context, path);
+
+    XrootdFile* xfile = new XrootdFile();
+    xfile->chunk_size = gfal2_get_opt_integer_with_default(context, XROOTD_CONFIG_GROUP, XROOTD_IO_CHUNK_SIZE,
+        XROOTD_DEFAULT_IO_CHUNK_SIZE);
+    if (xfile->chunk_size == 0) {
+        xfile->chunk_size = XROOTD_DEFAULT_IO_CHUNK_SIZE;
+    }
+    int depth = gfal2_get_opt_integer_with_default(context, XROOTD_CONFIG_GROUP, XROOTD_READ_AHEAD_DEPTH,
+        XROOTD_DEFAULT_READ_AHEAD_DEPTH);
+    xfile->depth = depth > 0 ? depth : 0;
+    xfile->vector_read = gfal2_get_opt_boolean_with_default(context, XROOTD_CONFIG_GROUP, XROOTD_VECTOR_READ, FALSE);
+
+    XrdCl::XRootDStatus status = xfile->file.Open(sanitizedUrl, std_to_xrdcl_open_flags(flag),
+        file_mode_to_xrdcl_access(mode));
+    if (!status.IsOK()) {
+        gfal2_xrootd_set_error(err, xrootd_status_to_posix_errno(status), __func__,
+            "Failed to open file: %s", status.ToStr().c_str());
+        delete xfile;
+        return NULL;
+    }
+
+    // The size bounds the read-ahead
+    if ((flag & O_ACCMODE) == O_RDONLY) {
+        XrdCl::StatInfo* info = NULL;
+        if (xfile->file.Stat(false, info).IsOK() && info) {
+            xfile->size = info->GetSize();
+            xfile->size_known = true;
+        }
+        delete info;
+    }
+    else {
+        // Read-ahead would return stale data after a write
+        xfile->depth = 0;
+    }
+
+    return gfal_file_handle_new(gfal_xrootd_getName(), (gpointer) xfile);
+}
+
+
+ssize_t gfal_xrootd_readG(plugin_handle handle, gfal_file_handle fd, void *buff,
+        size_t count, GError ** err)
+{
+    XrootdFile* xfile = get_xrootd_file(fd, __func__, err);
+    if (!xfile) {
+        return -1;
+    }
+
+    XrdCl::XRootDStatus status;
+    ssize_t l;
+
+    std::lock_guard<std::mutex> lock(xfile->mutex);
+    if (xfile->depth > 0) {
+        l = xrootd_read_ahead(xfile, (char*)buff, count, status);
+    }
+    else {
+        l = xrootd_parallel_read(xfile, xfile->offset, (char*)buff, count, status);
+        if (l > 0) {
+            xfile->offset += l;
+        }
+    }
+
+    if (l < 0) {
+        gfal2_xrootd_set_error(err, xrootd_status_to_posix_errno(status), __func__,
+            "Failed while reading from file: %s", status.ToStr().c_str());
+        return -1;
+    }
+    return l;
+}
+
+
+ssize_t gfal_xrootd_preadG(plugin_handle handle, gfal_file_handle fd, void *buff,
+        size_t count, off_t offset, GError ** err)
+{
+    XrootdFile* xfile = get_xrootd_file(fd, __func__, err);
+    if (!xfile) {
+        return -1;
+    }
+
+    // XrdCl::File is thread safe, and positional reads do not touch the shared state
+    XrdCl::XRootDStatus status;
+    ssize_t l;
+    if (xfile->vector_read && count > xfile->chunk_size) {
+        l = xrootd_vector_read(xfile, offset, (char*)buff, count, status);
+    }
+    else {
+        l = xrootd_parallel_read(xfile, offset, (char*)buff, count, status);
+    }
+
+    if (l < 0) {
+        gfal2_xrootd_set_error(err, xrootd_status_to_posix_errno(status), __func__,
+            "Failed while reading from file: %s", status.ToStr().c_str());
+        return -1;
+    }
+    return l;
+}
+
+
+ssize_t gfal_xrootd_writeG(plugin_handle handle, gfal_file_handle fd,
+        const void *buff, size_t count, GError ** err)
+{
+    XrootdFile* xfile = get_xrootd_file(fd, __func__, err);
+    if (!xfile) {
+        return -1;
+    }
+
+    XrdCl::XRootDStatus status;
+    std::lock_guard<std::mutex> lock(xfile->mutex);
+    ssize_t l = xrootd_parallel_write(xfile, xfile->offset, (const char*)buff, count, status);
+    if (l < 0) {
+        gfal2_xrootd_set_error(err, xrootd_status_to_posix_errno(status), __func__,
+            "Failed while writing to file: %s", status.ToStr().c_str());
+        return -1;
+    }
+    xfile->offset += l;
+    if (xfile->size_known && xfile->offset > xfile->size) {
+        xfile->size = xfile->offset;
+    }
+    return l;
+}
+
+
+ssize_t gfal_xrootd_pwriteG(plugin_handle handle, gfal_file_handle fd,
+        const void *buff, size_t count, off_t offset, GError ** err)
+{
+    XrootdFile* xfile = get_xrootd_file(fd, __func__, err);
+    if (!xfile) {
+        return -1;
+    }
+
+    XrdCl::XRootDStatus status;
+    ssize_t l = xrootd_parallel_write(xfile, offset, (const char*)buff, count, status);
+    if (l < 0) {
+        gfal2_xrootd_set_error(err, xrootd_status_to_posix_errno(status), __func__,
+            "Failed while writing to file: %s", status.ToStr().c_str());
+        return -1;
+    }
+    return l;
+}
+
+
+off_t gfal_xrootd_lseekG(plugin_handle handle, gfal_file_handle fd,
+        off_t offset, int whence, GError **err)
+{
+    XrootdFile* xfile = get_xrootd_file(fd, __func__, err);
+    if (!xfile) {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(xfile->mutex);
+    off_t absolute;
+    switch (whence) {
+        case SEEK_SET:
+            absolute = offset;
+            break;
+        case SEEK_CUR:
+            absolute = xfile->offset + offset;
+            break;
+        case SEEK_END: {
+            XrdCl::StatInfo* info = NULL;
+            XrdCl::XRootDStatus status = xfile->file.Stat(true, info);
+            if (!status.IsOK()) {
+                delete info;
+                gfal2_xrootd_set_error(err, xrootd_status_to_posix_errno(status), __func__,
+                    "Failed to seek within file: %s", status.ToStr().c_str());
+                return -1;
+            }
+            absolute = info->GetSize() + offset;
+            delete info;
+            break;
+        }
+        default:
+            gfal2_xrootd_set_error(err, EINVAL, __func__, "Failed to seek within file: invalid whence");
+            return -1;
+    }
+    if (absolute < 0) {
+        gfal2_xrootd_set_error(err, EINVAL, __func__, "Failed to seek within file: negative offset");
+        return -1;
+    }
+    xfile->offset = absolute;
+    return absolute;
+}
+
+
+int gfal_xrootd_closeG(plugin_handle handle, gfal_file_handle fd, GError ** err)
+{
+    int r = 0;
+    XrootdFile* xfile = (XrootdFile*) (gfal_file_handle_get_fdesc(fd));
+    if (xfile) {
+        // Outstanding read-ahead requests keep their own buffers alive
+        xfile->window.clear();
+        XrdCl::XRootDStatus status = xfile->file.Close();
+        if (!status.IsOK()) {
+            gfal2_xrootd_set_error(err, xrootd_status_to_posix_errno(status), __func__,
+                "Failed to close file: %s", status.ToStr().c_str());
+            r = -1;
+        }
+        delete xfile;
+    }
+    gfal_file_handle_delete(fd);
+    return r;
+}
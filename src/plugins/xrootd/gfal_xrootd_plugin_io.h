@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GFAL_XROOTD_PLUGIN_IO_H_
+#define GFAL_XROOTD_PLUGIN_IO_H_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <XrdCl/XrdClFile.hh>
+#include <XrdCl/XrdClXRootDResponses.hh>
+
+#define XROOTD_DEFAULT_IO_CHUNK_SIZE    1048576
+#define XROOTD_DEFAULT_READ_AHEAD_DEPTH 4
+
+
+// One block of the sequential read-ahead window
+// Keeps itself alive until the response arrives, so the window can be dropped at any time
+class ReadAheadChunk: public XrdCl::ResponseHandler
+{
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done;
+
+public:
+    uint64_t offset;
+    std::vector<char> data;
+    uint32_t size;
+    XrdCl::XRootDStatus status;
+    std::shared_ptr<ReadAheadChunk> self;
+
+    ReadAheadChunk(uint64_t offset, uint32_t capacity): done(false), offset(offset), data(capacity), size(0)
+    {
+    }
+
+    void Complete(const XrdCl::XRootDStatus& st, uint32_t bytes)
+    {
+        std::shared_ptr<ReadAheadChunk> keep;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            status = st;
+            size = bytes;
+            done = true;
+            keep.swap(self);
+            cv.notify_all();
+        }
+        // keep may release the last reference here
+    }
+
+    void HandleResponse(XrdCl::XRootDStatus* st, XrdCl::AnyObject* response)
+    {
+        uint32_t bytes = 0;
+        if (st->IsOK() && response) {
+            XrdCl::ChunkInfo* info = NULL;
+            response->Get(info);
+            if (info) {
+                bytes = info->length;
+            }
+        }
+        XrdCl::XRootDStatus copy = *st;
+        delete st;
+        delete response;
+        Complete(copy, bytes);
+    }
+
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return done; });
+    }
+};
+
+
+struct XrootdFile
+{
+    XrdCl::File file;
+    std::mutex mutex;
+    // Position for read/write/lseek
+    uint64_t offset;
+    uint64_t size;
+    bool size_known;
+
+    uint32_t chunk_size;
+    unsigned depth;
+    bool vector_read;
+    std::deque<std::shared_ptr<ReadAheadChunk> > window;
+
+    XrootdFile(): offset(0), size(0), size_known(false), chunk_size(XROOTD_DEFAULT_IO_CHUNK_SIZE),
+        depth(XROOTD_DEFAULT_READ_AHEAD_DEPTH), vector_read(false)
+    {
+    }
+};
+
+
+/// Sequential read of count bytes from the current position, served from the read-ahead window
+/// Must be called with the file lock held
+ssize_t xrootd_read_ahead(XrootdFile* xfile, char* buff, size_t count, XrdCl::XRootDStatus& error);
+
+#endif // GFAL_XROOTD_PLUGIN_IO_H_
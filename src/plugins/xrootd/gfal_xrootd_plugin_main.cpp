@@ -52,9 +52,10 @@ gfal_plugin_interface gfal_plugin_init(gfal2_context_t handle, GError** err)
 
     xrootd_plugin.statG = &gfal_xrootd_statG;
     xrootd_plugin.lstatG = &gfal_xrootd_statG;
+    xrootd_plugin.stat_listG = &gfal_xrootd_stat_listG;
 
-    xrootd_plugin.preadG = NULL; // &gfal_xrootd_preadG;
-    xrootd_plugin.pwriteG = NULL; // &gfal_xrootd_pwriteG;
+    xrootd_plugin.preadG = &gfal_xrootd_preadG;
+    xrootd_plugin.pwriteG = &gfal_xrootd_pwriteG;
 
     xrootd_plugin.mkdirpG = &gfal_xrootd_mkdirpG;
     xrootd_plugin.chmodG = &gfal_xrootd_chmodG;
@@ -75,6 +76,7 @@ gfal_plugin_interface gfal_plugin_init(gfal2_context_t handle, GError** err)
     xrootd_plugin.readlinkG = NULL; // symlinks not supported on xrootd
     xrootd_plugin.symlinkG = NULL; // symlinks not supported on xrootd
 
+    xrootd_plugin.checksum_listG = &gfal_xrootd_checksum_listG;
     xrootd_plugin.checksum_calcG = &gfal_xrootd_checksumG;
 
     xrootd_plugin.check_plugin_url_transfer = &gfal_xrootd_3rdcopy_check;
@@ -79,6 +79,21 @@ void reset_stat(struct stat& st)
 }
 
 
+void stat_info_to_stat(const XrdCl::StatInfo* stinfo, struct stat& st)
+{
+    st.st_size = stinfo->GetSize();
+    st.st_mtime = st.st_atime = st.st_ctime = stinfo->GetModTime();
+    st.st_nlink = 1;
+    st.st_mode = stinfo->TestFlags(XrdCl::StatInfo::IsDir) ? S_IFDIR : S_IFREG;
+    if (stinfo->TestFlags(XrdCl::StatInfo::IsReadable))
+        st.st_mode |= (S_IRUSR | S_IRGRP | S_IROTH);
+    if (stinfo->TestFlags(XrdCl::StatInfo::IsWritable))
+        st.st_mode |= (S_IWUSR | S_IWGRP | S_IWOTH);
+    if (stinfo->TestFlags(XrdCl::StatInfo::XBitSet))
+        st.st_mode |= (S_IXUSR | S_IXGRP | S_IXOTH);
+}
+
+
 static std::string query_args(gfal2_context_t context, const char *url)
 {
     bool prev_args = false;
@@ -372,7 +387,7 @@ void gfal2_xrootd_set_error(GError **err, int errcode, const char *func, const c
 
     char buffer[512];
     snprintf(buffer, sizeof(buffer), "%s (%s)", err_msg, error_string_ptr);
-    gfal2_set_error(err, xrootd_domain, errno, func, "%s", buffer);
+    gfal2_set_error(err, xrootd_domain, errcode, func, "%s", buffer);
 }
 
 
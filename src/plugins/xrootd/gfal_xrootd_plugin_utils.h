@@ -36,6 +36,10 @@ XrdCl::Access::Mode file_mode_to_xrdcl_access( mode_t mode );
 /// Initialize all stat fields to zero
 void reset_stat(struct stat& st);
 
+/// Fill the stat fields from the XrdCl stat information
+/// @note shared by stat, bulk stat and listing, so they all report the same mode
+void stat_info_to_stat(const XrdCl::StatInfo* stinfo, struct stat& st);
+
 /// Return the same URL, but making sure the path is always relative
 /// and adding the user credentials appended as keywords
 std::string prepare_url(gfal2_context_t context, const char *url);
@@ -18,7 +18,9 @@
  * limitations under the License.
  */
 
+#include <limits.h>
 #include <string.h>
+#include <zlib.h>
 #include "checksums.h"
 
 
@@ -41,6 +43,21 @@ int gfal_compare_checksums(const char* chk1, const char* chk2, size_t len)
 }
 
 
+unsigned long gfal2_adler32(unsigned long adler, const void *data, size_t size)
+{
+    const Bytef *p = data;
+
+    // zlib takes the length as uInt
+    while (size > 0) {
+        uInt n = size < UINT_MAX ? (uInt)size : UINT_MAX;
+        adler = adler32(adler, p, n);
+        p += n;
+        size -= n;
+    }
+    return adler;
+}
+
+
 
 // ----------------------------------------------------------------------------------------------------
 /*
@@ -33,6 +33,12 @@ extern "C" {
  */
 int gfal_compare_checksums(const char* chk1, const char* chk2, size_t len);
 
+/**
+ * Update a running adler32 with size bytes of data, using zlib's adler32.
+ * The initial value is 1.
+ */
+unsigned long gfal2_adler32(unsigned long adler, const void *data, size_t size);
+
 
 // md5 checksum calculation
 
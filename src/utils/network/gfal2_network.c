@@ -14,15 +14,417 @@
  * limitations under the License.
  */
 
+#include <string.h>
 #include <time.h>
 #include <netdb.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 
 #include "gfal2_network.h"
 #include "gfal_plugins_api.h"
 #include <uri/gfal2_uri.h>
 
-char* resolve_dns_helper(const char* host_uri, const char* msg)
+#define GFAL2_DNS_TTL                   "RESOLVE_DNS_TTL"
+#define GFAL2_DNS_POLICY                "RESOLVE_DNS_POLICY"
+#define GFAL2_DNS_DEFAULT_TTL           60
+// After a failed resolution, wait this many seconds before trying again
+#define GFAL2_DNS_NEGATIVE_TTL          10
+// Failures count half after this many seconds
+#define GFAL2_DNS_FAILURE_HALFLIFE      300
+#define GFAL2_DNS_PREFETCH_THREADS      2
+
+
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    int family;
+    char ip[INET6_ADDRSTRLEN];
+    // Reverse lookup, done only when needed
+    char* hostname;
+    gboolean reversed;
+    // Health
+    double failures;
+    time_t failure_stamp;
+    double throughput;
+} gfal2_dns_address_t;
+
+
+typedef struct {
+    // NULL until the first successful resolution
+    GArray* addresses;
+    time_t resolved;
+    int ttl;
+    guint cursor;
+    // A resolution is in flight, in the background or for another caller
+    gboolean refreshing;
+    // Last failed resolution, so the resolver is not retried on every lookup
+    time_t failed;
+} gfal2_dns_entry_t;
+
+
+typedef struct {
+    char* host;
+    int ttl;
+} gfal2_dns_prefetch_t;
+
+
+// Callers wait on dns_cache_resolved for the resolutions already in flight
+static pthread_mutex_t dns_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dns_cache_resolved = PTHREAD_COND_INITIALIZER;
+static GHashTable* dns_cache = NULL;
+static GThreadPool* dns_prefetch_pool = NULL;
+
+
+static void dns_address_array_free(GArray* addresses)
+{
+    guint i;
+    if (addresses == NULL) {
+        return;
+    }
+    for (i = 0; i < addresses->len; ++i) {
+        g_free(g_array_index(addresses, gfal2_dns_address_t, i).hostname);
+    }
+    g_array_free(addresses, TRUE);
+}
+
+
+static void dns_entry_free(gpointer data)
+{
+    gfal2_dns_entry_t* entry = (gfal2_dns_entry_t*)data;
+    dns_address_array_free(entry->addresses);
+    g_free(entry);
+}
+
+
+// Must be called with the lock held
+static gfal2_dns_entry_t* dns_get_entry(const char* host, gboolean create)
+{
+    if (dns_cache == NULL) {
+        dns_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, dns_entry_free);
+    }
+    gfal2_dns_entry_t* entry = g_hash_table_lookup(dns_cache, host);
+    if (entry == NULL && create) {
+        entry = g_new0(gfal2_dns_entry_t, 1);
+        g_hash_table_insert(dns_cache, g_strdup(host), entry);
+    }
+    return entry;
+}
+
+
+static gboolean dns_entry_expired(const gfal2_dns_entry_t* entry, time_t now)
+{
+    return entry->addresses == NULL || now - entry->resolved >= entry->ttl;
+}
+
+
+static gboolean dns_entry_backoff(const gfal2_dns_entry_t* entry, time_t now)
+{
+    return entry->failed != 0 && now - entry->failed < GFAL2_DNS_NEGATIVE_TTL;
+}
+
+
+static int dns_get_ttl(gfal2_context_t context)
+{
+    if (context == NULL) {
+        return GFAL2_DNS_DEFAULT_TTL;
+    }
+    return gfal2_get_opt_integer_with_default(context, CORE_CONFIG_GROUP, GFAL2_DNS_TTL, GFAL2_DNS_DEFAULT_TTL);
+}
+
+
+static GArray* dns_getaddrinfo(const char* host)
+{
+    struct addrinfo hints;
+    struct addrinfo* addresses = NULL;
+    struct addrinfo* addrP = NULL;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int rc = getaddrinfo(host, NULL, &hints, &addresses);
+    if (rc || !addresses) {
+        if (addresses) {
+            freeaddrinfo(addresses);
+        }
+        return NULL;
+    }
+
+    GArray* result = g_array_new(FALSE, TRUE, sizeof(gfal2_dns_address_t));
+    for (addrP = addresses; addrP != NULL; addrP = addrP->ai_next) {
+        gfal2_dns_address_t address;
+        void* ptr = NULL;
+
+        if (addrP->ai_family == AF_INET) {
+            ptr = &((struct sockaddr_in *) addrP->ai_addr)->sin_addr;
+        }
+        else if (addrP->ai_family == AF_INET6) {
+            ptr = &((struct sockaddr_in6 *) addrP->ai_addr)->sin6_addr;
+        }
+        else {
+            continue;
+        }
+
+        memset(&address, 0, sizeof(address));
+        memcpy(&address.addr, addrP->ai_addr, addrP->ai_addrlen);
+        address.addrlen = addrP->ai_addrlen;
+        address.family = addrP->ai_family;
+        inet_ntop(addrP->ai_family, ptr, address.ip, sizeof(address.ip));
+        g_array_append_val(result, address);
+    }
+    freeaddrinfo(addresses);
+
+    if (result->len == 0) {
+        g_array_free(result, TRUE);
+        return NULL;
+    }
+    return result;
+}
+
+
+static char* dns_reverse_lookup(const gfal2_dns_address_t* address)
+{
+    char hostname[256];
+    if (getnameinfo((const struct sockaddr*)&address->addr, address->addrlen, hostname, sizeof(hostname),
+                    NULL, 0, NI_NAMEREQD) != 0) {
+        return NULL;
+    }
+    return g_strdup(hostname);
+}
+
+
+// Carry over the health and the reverse lookups of the addresses that are still there
+static void dns_merge(GArray* fresh, GArray* old)
+{
+    guint i, j;
+    if (old == NULL) {
+        return;
+    }
+    for (i = 0; i < fresh->len; ++i) {
+        gfal2_dns_address_t* f = &g_array_index(fresh, gfal2_dns_address_t, i);
+        for (j = 0; j < old->len; ++j) {
+            gfal2_dns_address_t* o = &g_array_index(old, gfal2_dns_address_t, j);
+            if (strcmp(f->ip, o->ip) == 0) {
+                f->hostname = g_strdup(o->hostname);
+                f->reversed = o->reversed;
+                f->failures = o->failures;
+                f->failure_stamp = o->failure_stamp;
+                f->throughput = o->throughput;
+                break;
+            }
+        }
+    }
+}
+
+
+// Resolve host and store the result, keeping what is already known about each address
+// Must be called without the lock
+static gboolean dns_resolve_and_store(const char* host, int ttl)
+{
+    GArray* fresh = dns_getaddrinfo(host);
+
+    pthread_mutex_lock(&dns_cache_lock);
+    gfal2_dns_entry_t* entry = dns_get_entry(host, TRUE);
+    entry->refreshing = FALSE;
+    pthread_cond_broadcast(&dns_cache_resolved);
+    if (fresh == NULL) {
+        // Keep serving the stale addresses, if any, and do not retry before GFAL2_DNS_NEGATIVE_TTL
+        entry->failed = time(NULL);
+        pthread_mutex_unlock(&dns_cache_lock);
+        gfal2_log(G_LOG_LEVEL_WARNING, "Could not resolve DNS alias: %s", host);
+        return FALSE;
+    }
+
+    dns_merge(fresh, entry->addresses);
+    dns_address_array_free(entry->addresses);
+    entry->addresses = fresh;
+    entry->resolved = time(NULL);
+    entry->ttl = ttl;
+    entry->failed = 0;
+    pthread_mutex_unlock(&dns_cache_lock);
+
+    // Reverse lookups just for the log are only worth it when it is going to be printed
+    if (gfal2_log_get_level() >= G_LOG_LEVEL_DEBUG) {
+        GString* log_str = g_string_sized_new(512);
+        GArray* copy = g_array_new(FALSE, TRUE, sizeof(gfal2_dns_address_t));
+        guint i;
+
+        pthread_mutex_lock(&dns_cache_lock);
+        entry = g_hash_table_lookup(dns_cache, host);
+        if (entry && entry->addresses) {
+            g_array_append_vals(copy, entry->addresses->data, entry->addresses->len);
+            for (i = 0; i < copy->len; ++i) {
+                gfal2_dns_address_t* address = &g_array_index(copy, gfal2_dns_address_t, i);
+                address->hostname = g_strdup(address->hostname);
+            }
+        }
+        pthread_mutex_unlock(&dns_cache_lock);
+
+        for (i = 0; i < copy->len; ++i) {
+            gfal2_dns_address_t* address = &g_array_index(copy, gfal2_dns_address_t, i);
+            if (!address->reversed) {
+                address->hostname = dns_reverse_lookup(address);
+            }
+            g_string_append_printf(log_str, "%s[%s] ", address->hostname ? address->hostname : "", address->ip);
+        }
+        dns_address_array_free(copy);
+
+        gfal2_log(G_LOG_LEVEL_DEBUG, "Resolved DNS alias %s into: %s", host, log_str->str);
+        g_string_free(log_str, TRUE);
+    }
+    return TRUE;
+}
+
+
+static void dns_prefetch_worker(gpointer data, gpointer user_data)
+{
+    gfal2_dns_prefetch_t* prefetch = (gfal2_dns_prefetch_t*)data;
+    dns_resolve_and_store(prefetch->host, prefetch->ttl);
+    g_free(prefetch->host);
+    g_free(prefetch);
+}
+
+
+// Resolve host in the background, and mark the entry as refreshing
+// Must be called with the lock held
+static void dns_schedule_refresh(gfal2_dns_entry_t* entry, const char* host, int ttl)
+{
+    if (dns_prefetch_pool == NULL) {
+        dns_prefetch_pool = g_thread_pool_new(dns_prefetch_worker, NULL, GFAL2_DNS_PREFETCH_THREADS, FALSE, NULL);
+        if (dns_prefetch_pool == NULL) {
+            return;
+        }
+    }
+    gfal2_dns_prefetch_t* prefetch = g_new0(gfal2_dns_prefetch_t, 1);
+    prefetch->host = g_strdup(host);
+    prefetch->ttl = ttl;
+    entry->refreshing = TRUE;
+    g_thread_pool_push(dns_prefetch_pool, prefetch, NULL);
+}
+
+
+// Returns the cache entry for host, with the lock held, or NULL without the lock
+// A resolution already in flight for an entry with nothing fresh to serve,
+// i.e. a prefetch, is waited for instead of being repeated
+static gfal2_dns_entry_t* dns_lookup(const char* host, int ttl)
+{
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&dns_cache_lock);
+    gfal2_dns_entry_t* entry = dns_get_entry(host, TRUE);
+    while (entry->refreshing && dns_entry_expired(entry, now)) {
+        pthread_cond_wait(&dns_cache_resolved, &dns_cache_lock);
+        entry = dns_get_entry(host, TRUE);
+        now = time(NULL);
+    }
+
+    if (dns_entry_expired(entry, now) && !dns_entry_backoff(entry, now)) {
+        entry->refreshing = TRUE;
+        pthread_mutex_unlock(&dns_cache_lock);
+        dns_resolve_and_store(host, ttl);
+        pthread_mutex_lock(&dns_cache_lock);
+        entry = dns_get_entry(host, TRUE);
+    }
+    else if (!entry->refreshing && !dns_entry_backoff(entry, now) &&
+             (now - entry->resolved) * 4 >= entry->ttl * 3) {
+        // Refresh ahead of time, so the next callers do not have to wait
+        dns_schedule_refresh(entry, host, ttl);
+    }
+
+    // A stale entry is still better than nothing
+    if (entry->addresses == NULL) {
+        pthread_mutex_unlock(&dns_cache_lock);
+        return NULL;
+    }
+    return entry;
+}
+
+
+static double dns_decayed_failures(const gfal2_dns_address_t* address, time_t now)
+{
+    time_t age = now - address->failure_stamp;
+    int halvings = age / GFAL2_DNS_FAILURE_HALFLIFE;
+    if (halvings > 16) {
+        return 0;
+    }
+    return address->failures / (1 << halvings);
+}
+
+
+// The reverse lookup of the address already failed, so it can not be handed out
+static gboolean dns_address_unnamed(const gfal2_dns_address_t* address)
+{
+    return address->reversed && address->hostname == NULL;
+}
+
+
+// Must be called with the lock held
+static guint dns_select_round_robin(gfal2_dns_entry_t* entry)
+{
+    time_t now = time(NULL);
+    guint i;
+
+    // Skip the addresses that failed recently or have no name, unless all did
+    for (i = 0; i < entry->addresses->len; ++i) {
+        guint candidate = (entry->cursor + i) % entry->addresses->len;
+        gfal2_dns_address_t* address = &g_array_index(entry->addresses, gfal2_dns_address_t, candidate);
+        if (!dns_address_unnamed(address) && dns_decayed_failures(address, now) < 1) {
+            entry->cursor = candidate + 1;
+            return candidate;
+        }
+    }
+    return entry->cursor++ % entry->addresses->len;
+}
+
+
+// Must be called with the lock held
+static guint dns_select_weighted(gfal2_dns_entry_t* entry)
+{
+    time_t now = time(NULL);
+    guint i, n = entry->addresses->len;
+    double total = 0, mean_throughput = 0;
+    int with_throughput = 0;
+    double* weights = g_new(double, n);
+
+    for (i = 0; i < n; ++i) {
+        gfal2_dns_address_t* address = &g_array_index(entry->addresses, gfal2_dns_address_t, i);
+        if (address->throughput > 0) {
+            mean_throughput += address->throughput;
+            ++with_throughput;
+        }
+    }
+    if (with_throughput) {
+        mean_throughput /= with_throughput;
+    }
+
+    guint last = n - 1;
+    for (i = 0; i < n; ++i) {
+        gfal2_dns_address_t* address = &g_array_index(entry->addresses, gfal2_dns_address_t, i);
+        double weight = 0;
+        if (!dns_address_unnamed(address)) {
+            weight = 1.0 / (1.0 + 4.0 * dns_decayed_failures(address, now));
+            if (mean_throughput > 0 && address->throughput > 0) {
+                weight *= CLAMP(address->throughput / mean_throughput, 0.25, 4.0);
+            }
+            last = i;
+        }
+        weights[i] = weight;
+        total += weight;
+    }
+
+    double pick = g_random_double_range(0, total);
+    for (i = 0; i < last; ++i) {
+        pick -= weights[i];
+        if (weights[i] > 0 && pick < 0) {
+            break;
+        }
+    }
+    g_free(weights);
+    return i;
+}
+
+
+char* resolve_dns_helper(gfal2_context_t context, const char* host_uri, const char* msg)
 {
     char* resolved_str;
     GError *error = NULL;
@@ -30,12 +432,14 @@ char* resolve_dns_helper(const char* host_uri, const char* msg)
 
     if (error) {
         gfal2_log(G_LOG_LEVEL_WARNING, "Failed to parse host uri while resolving DNS alias: %s", host_uri);
+        g_error_free(error);
         return NULL;
     }
 
-    char *resolved = gfal2_resolve_dns_to_hostname(parsed->host);
+    char *resolved = gfal2_resolve_dns_to_hostname(context, parsed->host);
 
     if (!resolved) {
+        gfal2_free_uri(parsed);
         return NULL;
     }
 
@@ -47,71 +451,178 @@ char* resolve_dns_helper(const char* host_uri, const char* msg)
     return resolved_str;
 }
 
-char* gfal2_resolve_dns_to_hostname(const char* dnshost)
+
+char* gfal2_resolve_dns_to_hostname(gfal2_context_t context, const char* dnshost)
 {
-    struct addrinfo hints;
-    struct addrinfo* addresses = NULL;
-    struct addrinfo* addrP = NULL;
-    GString* log_str = g_string_sized_new(512);
-    char addrstr[INET6_ADDRSTRLEN * 2];
-    char hostname[256];
-    void* ptr = NULL;
-    int count = 0;
+    gboolean round_robin = FALSE;
+    if (context) {
+        gchar* policy = gfal2_get_opt_string_with_default(context, CORE_CONFIG_GROUP, GFAL2_DNS_POLICY, "weighted");
+        round_robin = (g_ascii_strcasecmp(policy, "round-robin") == 0);
+        g_free(policy);
+    }
 
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_flags |= AI_CANONNAME;
+    gfal2_dns_entry_t* entry = dns_lookup(dnshost, dns_get_ttl(context));
+    if (entry == NULL) {
+        return NULL;
+    }
 
-    int rc = getaddrinfo(dnshost, NULL, &hints, &addresses);
+    guint selected = round_robin ? dns_select_round_robin(entry) : dns_select_weighted(entry);
+    gfal2_dns_address_t address = g_array_index(entry->addresses, gfal2_dns_address_t, selected);
+    if (address.reversed) {
+        char* hostname = g_strdup(address.hostname);
+        pthread_mutex_unlock(&dns_cache_lock);
+        return hostname;
+    }
+    pthread_mutex_unlock(&dns_cache_lock);
 
-    if (rc || !addresses) {
-        if (addresses) {
-            freeaddrinfo(addresses);
+    // First time this address is selected
+    char* hostname = dns_reverse_lookup(&address);
+
+    pthread_mutex_lock(&dns_cache_lock);
+    entry = g_hash_table_lookup(dns_cache, dnshost);
+    if (entry && entry->addresses) {
+        guint i;
+        for (i = 0; i < entry->addresses->len; ++i) {
+            gfal2_dns_address_t* cached = &g_array_index(entry->addresses, gfal2_dns_address_t, i);
+            if (strcmp(cached->ip, address.ip) == 0 && !cached->reversed) {
+                cached->hostname = g_strdup(hostname);
+                cached->reversed = TRUE;
+                break;
+            }
         }
+    }
+    pthread_mutex_unlock(&dns_cache_lock);
 
-        gfal2_log(G_LOG_LEVEL_WARNING, "Could not resolve DNS alias: %s", dnshost);
+    if (hostname == NULL) {
+        gfal2_log(G_LOG_LEVEL_WARNING, "Could not find a hostname for %s (alias %s)", address.ip, dnshost);
+    }
+    return hostname;
+}
+
+
+char* gfal2_resolve_dns_to_address(gfal2_context_t context, const char* host, gboolean ipv6_enabled, gboolean* got_ipv6)
+{
+    const char* ip4 = NULL;
+    const char* ip6 = NULL;
+    char* result = NULL;
+    guint i;
+
+    if (got_ipv6) {
+        *got_ipv6 = FALSE;
+    }
+    if (host == NULL) {
         return NULL;
     }
 
-    // Count and log all resolved addresses
-    for (addrP = addresses; addrP != NULL; addrP = addrP->ai_next) {
-        inet_ntop(addrP->ai_family, addrP->ai_addr->sa_data, addrstr, sizeof(addrstr));
+    gfal2_dns_entry_t* entry = dns_lookup(host, dns_get_ttl(context));
+    if (entry == NULL) {
+        return NULL;
+    }
 
-        switch (addrP->ai_family) {
-            case AF_INET:
-                ptr = &((struct sockaddr_in *) addrP->ai_addr)->sin_addr;
-                if (ptr) {
-                    inet_ntop(addrP->ai_family, ptr, addrstr, sizeof(addrstr));
-                }
-                break;
-            case AF_INET6:
-                ptr = &((struct sockaddr_in6 *) addrP->ai_addr)->sin6_addr;
-                if (ptr) {
-                    inet_ntop(addrP->ai_family, ptr, addrstr, sizeof(addrstr));
-                }
-                break;
+    // Last address of each family, as getaddrinfo returns them
+    for (i = 0; i < entry->addresses->len; ++i) {
+        gfal2_dns_address_t* address = &g_array_index(entry->addresses, gfal2_dns_address_t, i);
+        if (address->family == AF_INET6) {
+            ip6 = address->ip;
         }
+        else {
+            ip4 = address->ip;
+        }
+    }
 
-        getnameinfo(addrP->ai_addr, addrP->ai_addrlen, hostname, sizeof(hostname), NULL, 0, NI_NAMEREQD);
-        g_string_append_printf(log_str, "%s[%s] ", hostname, addrstr);
-        count++;
+    if (got_ipv6) {
+        *got_ipv6 = (ip6 != NULL);
+    }
+    if (ipv6_enabled && ip6) {
+        result = g_strdup_printf("[%s]", ip6);
     }
+    else if (ip4) {
+        result = g_strdup(ip4);
+    }
+    pthread_mutex_unlock(&dns_cache_lock);
+    return result;
+}
 
-    gfal2_log(G_LOG_LEVEL_DEBUG, "Resolved DNS alias %s into: %s", dnshost, log_str->str);
-    g_string_free(log_str, TRUE);
 
-    // Select at random an address between [0, count)
-    srand(time(NULL));
-    int selected = rand() % count;
+void gfal2_resolve_dns_prefetch(gfal2_context_t context, const char* host_uri)
+{
+    GError *error = NULL;
+    gfal2_uri *parsed = gfal2_parse_uri(host_uri, &error);
+    if (error) {
+        g_error_free(error);
+        return;
+    }
+    if (parsed->host) {
+        time_t now = time(NULL);
+        pthread_mutex_lock(&dns_cache_lock);
+        gfal2_dns_entry_t* entry = dns_get_entry(parsed->host, TRUE);
+        if (!entry->refreshing && dns_entry_expired(entry, now) && !dns_entry_backoff(entry, now)) {
+            dns_schedule_refresh(entry, parsed->host, dns_get_ttl(context));
+        }
+        pthread_mutex_unlock(&dns_cache_lock);
+    }
+    gfal2_free_uri(parsed);
+}
 
-    for (addrP = addresses; addrP != NULL; addrP = addrP->ai_next) {
-        if (selected-- == 0) {
-            getnameinfo(addrP->ai_addr, addrP->ai_addrlen, hostname, sizeof(hostname), NULL, 0, NI_NAMEREQD);
-            break;
+
+void gfal2_resolve_dns_report(const char* resolved_uri, gboolean success, guint64 bytes, double elapsed)
+{
+    GError *error = NULL;
+    gfal2_uri *parsed = gfal2_parse_uri(resolved_uri, &error);
+    if (error) {
+        g_error_free(error);
+        return;
+    }
+    if (parsed->host == NULL) {
+        gfal2_free_uri(parsed);
+        return;
+    }
+
+    time_t now = time(NULL);
+    GHashTableIter iter;
+    gpointer value;
+
+    pthread_mutex_lock(&dns_cache_lock);
+    if (dns_cache) {
+        g_hash_table_iter_init(&iter, dns_cache);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            gfal2_dns_entry_t* entry = (gfal2_dns_entry_t*)value;
+            guint i;
+            if (entry->addresses == NULL) {
+                continue;
+            }
+            for (i = 0; i < entry->addresses->len; ++i) {
+                gfal2_dns_address_t* address = &g_array_index(entry->addresses, gfal2_dns_address_t, i);
+                if ((address->hostname && strcmp(address->hostname, parsed->host) == 0) ||
+                    strcmp(address->ip, parsed->host) == 0) {
+                    address->failures = dns_decayed_failures(address, now);
+                    address->failure_stamp = now;
+                    if (success) {
+                        address->failures /= 2;
+                        if (bytes > 0 && elapsed > 0) {
+                            double throughput = bytes / elapsed;
+                            address->throughput = address->throughput > 0 ?
+                                0.7 * address->throughput + 0.3 * throughput : throughput;
+                        }
+                    }
+                    else {
+                        address->failures += 1;
+                    }
+                }
+            }
         }
     }
+    pthread_mutex_unlock(&dns_cache_lock);
 
-    freeaddrinfo(addresses);
-    return strdup(hostname);
+    gfal2_free_uri(parsed);
+}
+
+
+void gfal2_resolve_dns_clear_cache(void)
+{
+    pthread_mutex_lock(&dns_cache_lock);
+    if (dns_cache) {
+        g_hash_table_remove_all(dns_cache);
+    }
+    pthread_mutex_unlock(&dns_cache_lock);
 }
@@ -23,16 +23,57 @@ extern "C"
 {
 #endif
 
+// Same as gfal2_context_t, without pulling the whole public API
+struct gfal_handle_;
+
+/*
+ * Resolved aliases are kept in a process wide cache for RESOLVE_DNS_TTL seconds.
+ * Entries close to expiration are refreshed in the background, so callers
+ * only wait for the resolver the first time an alias is seen.
+ * After a failed resolution the resolver is not tried again for a few seconds,
+ * and the previous addresses, if any, keep being served meanwhile.
+ */
+
 /*
  * Helper function to resolve a DNS URI to a specific a host
  * Returns a newly allocated string with the resolved uri
 */
-char* resolve_dns_helper(const char* host_uri, const char* msg);
+char* resolve_dns_helper(struct gfal_handle_* context, const char* host_uri, const char* msg);
+
+/*
+ * Given a DNS alias, resolve the list of underlying addresses and select one of them,
+ * following CORE:RESOLVE_DNS_POLICY (round-robin, or weighted by the recent health of each address).
+ * Returns the hostname of the selected address, or NULL if it can not be resolved.
+ * context may be NULL, in which case the defaults are used.
+ */
+char* gfal2_resolve_dns_to_hostname(struct gfal_handle_* context, const char* dnshost);
+
+/*
+ * Resolve host and return one of its addresses as a string, using the same cache.
+ * IPv6 addresses are preferred if ipv6_enabled, and returned between brackets.
+ * got_ipv6, if not NULL, is set to whether the host has any IPv6 address.
+ * Returns NULL if it can not be resolved.
+ * context may be NULL, in which case the default CORE:RESOLVE_DNS_TTL is used.
+ */
+char* gfal2_resolve_dns_to_address(struct gfal_handle_* context, const char* host, gboolean ipv6_enabled, gboolean* got_ipv6);
+
+/*
+ * Start resolving the alias used by host_uri in the background, if it is not cached yet.
+ * A later lookup of the same alias waits for this resolution instead of starting another one.
+ */
+void gfal2_resolve_dns_prefetch(struct gfal_handle_* context, const char* host_uri);
+
+/*
+ * Feed back the outcome of a transfer done against a resolved uri,
+ * as returned by resolve_dns_helper.
+ * bytes is the amount transferred, or 0 if unknown, and elapsed the duration in seconds.
+ */
+void gfal2_resolve_dns_report(const char* resolved_uri, gboolean success, guint64 bytes, double elapsed);
 
 /*
- * Given a DNS alias, resolve the list of underlying addresses and select one at random.
+ * Drop all the cached entries
  */
-char* gfal2_resolve_dns_to_hostname(const char* dnshost);
+void gfal2_resolve_dns_clear_cache(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checksum throughput, computed by the file plugin over a file kept in the page cache
+
+#include "bench_common.h"
+#include <benchmark/benchmark.h>
+#include <utils/checksums/checksums.h>
+#include <vector>
+
+
+static void bench_checksum_file(benchmark::State& state, const char* algorithm)
+{
+    gfal2_context_t context = bench_context();
+    const size_t file_size = state.range(0);
+    std::string url = "file://" + bench_local_file(file_size);
+    char checksum[GFAL_URL_MAX_LEN];
+    GError* error = NULL;
+
+    for (auto _ : state) {
+        if (gfal2_checksum(context, url.c_str(), algorithm, 0, 0, checksum, sizeof(checksum), &error) < 0) {
+            state.SkipWithError(error->message);
+            g_clear_error(&error);
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * file_size);
+}
+BENCHMARK_CAPTURE(bench_checksum_file, adler32, "ADLER32")->Arg(1 << 20)->Arg(64 << 20);
+BENCHMARK_CAPTURE(bench_checksum_file, crc32, "CRC32")->Arg(1 << 20)->Arg(64 << 20);
+BENCHMARK_CAPTURE(bench_checksum_file, md5, "MD5")->Arg(1 << 20)->Arg(64 << 20);
+
+
+// The in tree md5 implementation alone, without any I/O
+static void bench_md5_update(benchmark::State& state)
+{
+    std::vector<char> buffer(state.range(0), 'x');
+    unsigned char digest[16];
+
+    for (auto _ : state) {
+        GFAL_MD5_CTX ctx;
+        gfal2_md5_init(&ctx);
+        gfal2_md5_update(&ctx, buffer.data(), buffer.size());
+        gfal2_md5_final(digest, &ctx);
+        benchmark::DoNotOptimize(digest);
+    }
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(bench_md5_update)->Arg(4096)->Arg(1 << 20);
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef GFAL2_BENCH_COMMON_H_
+#define GFAL2_BENCH_COMMON_H_
+
+#include <gfal_api.h>
+#include <string>
+
+// Context shared by all the benchmarks, with the plugins of the build tree
+gfal2_context_t bench_context();
+
+// Path of a local file filled with size deterministic bytes, created on first use
+std::string bench_local_file(size_t size);
+
+#endif // GFAL2_BENCH_COMMON_H_
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Orchestration overhead of the copies, the mock plugin transfers nothing and takes no time
+
+#include "bench_common.h"
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+
+
+static const char* bench_copy_source = "mock://host/source?size=1000";
+static const char* bench_copy_destination = "mock://host/destination?size_post=1000&time=0";
+
+
+static void bench_copy_file(benchmark::State& state)
+{
+    gfal2_context_t context = bench_context();
+    gfalt_params_t params = gfalt_params_handle_new(NULL);
+    GError* error = NULL;
+
+    for (auto _ : state) {
+        if (gfalt_copy_file(context, params, bench_copy_source, bench_copy_destination, &error) < 0) {
+            state.SkipWithError(error->message);
+            g_clear_error(&error);
+            break;
+        }
+    }
+    gfalt_params_handle_delete(params, NULL);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bench_copy_file);
+
+
+// With the listeners and event callbacks a transfer tool would set
+static void bench_copy_file_monitored(benchmark::State& state)
+{
+    gfal2_context_t context = bench_context();
+    gfalt_params_t params = gfalt_params_handle_new(NULL);
+    GError* error = NULL;
+    int events = 0;
+
+    gfalt_add_event_callback(params, [](const gfalt_event_t, gpointer user_data) {
+        ++*static_cast<int*>(user_data);
+    }, &events, NULL, NULL);
+
+    for (auto _ : state) {
+        if (gfalt_copy_file(context, params, bench_copy_source, bench_copy_destination, &error) < 0) {
+            state.SkipWithError(error->message);
+            g_clear_error(&error);
+            break;
+        }
+    }
+    gfalt_params_handle_delete(params, NULL);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["events_per_copy"] = benchmark::Counter(events, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(bench_copy_file_monitored);
+
+
+// Overhead per file of a bulk copy
+static void bench_copy_bulk(benchmark::State& state)
+{
+    gfal2_context_t context = bench_context();
+    gfalt_params_t params = gfalt_params_handle_new(NULL);
+    const size_t nbfiles = state.range(0);
+
+    std::vector<std::string> source_urls, destination_urls;
+    std::vector<const char*> sources, destinations;
+    for (size_t i = 0; i < nbfiles; ++i) {
+        source_urls.push_back(std::string(bench_copy_source) + "&n=" + std::to_string(i));
+        destination_urls.push_back(std::string(bench_copy_destination) + "&n=" + std::to_string(i));
+    }
+    for (size_t i = 0; i < nbfiles; ++i) {
+        sources.push_back(source_urls[i].c_str());
+        destinations.push_back(destination_urls[i].c_str());
+    }
+
+    for (auto _ : state) {
+        GError* op_error = NULL;
+        GError** file_errors = NULL;
+        int ret = gfalt_copy_bulk(context, params, nbfiles, sources.data(), destinations.data(), NULL,
+            &op_error, &file_errors);
+        if (file_errors) {
+            for (size_t i = 0; i < nbfiles; ++i) {
+                g_clear_error(&file_errors[i]);
+            }
+            g_free(file_errors);
+        }
+        if (ret < 0) {
+            state.SkipWithError(op_error ? op_error->message : "Bulk copy failed");
+            g_clear_error(&op_error);
+            break;
+        }
+    }
+    gfalt_params_handle_delete(params, NULL);
+    state.SetItemsProcessed(state.iterations() * nbfiles);
+}
+BENCHMARK(bench_copy_bulk)->RangeMultiplier(10)->Range(1, 1000);
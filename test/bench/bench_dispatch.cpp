@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cost of a call through the core and the plugin dispatch, with plugins doing no real work
+
+#include "bench_common.h"
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <vector>
+
+
+static void bench_stat_mock(benchmark::State& state)
+{
+    gfal2_context_t context = bench_context();
+    struct stat st;
+    GError* error = NULL;
+
+    for (auto _ : state) {
+        if (gfal2_stat(context, "mock://host/path?size=1000", &st, &error) < 0) {
+            state.SkipWithError(error->message);
+            g_clear_error(&error);
+            break;
+        }
+        benchmark::DoNotOptimize(st);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bench_stat_mock)->ThreadRange(1, 8)->UseRealTime();
+
+
+// Expected errors, the path of existence checks
+static void bench_stat_mock_enoent(benchmark::State& state)
+{
+    gfal2_context_t context = bench_context();
+    struct stat st;
+    GError* error = NULL;
+
+    for (auto _ : state) {
+        gfal2_stat(context, "mock://host/path?errno=2", &st, &error);
+        g_clear_error(&error);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bench_stat_mock_enoent);
+
+
+static void bench_stat_file(benchmark::State& state)
+{
+    gfal2_context_t context = bench_context();
+    std::string url = "file://" + bench_local_file(1024);
+    struct stat st;
+    GError* error = NULL;
+
+    for (auto _ : state) {
+        if (gfal2_stat(context, url.c_str(), &st, &error) < 0) {
+            state.SkipWithError(error->message);
+            g_clear_error(&error);
+            break;
+        }
+        benchmark::DoNotOptimize(st);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bench_stat_file)->ThreadRange(1, 8)->UseRealTime();
+
+
+static void bench_open_close(benchmark::State& state, const char* url)
+{
+    gfal2_context_t context = bench_context();
+    GError* error = NULL;
+
+    for (auto _ : state) {
+        int fd = gfal2_open(context, url, O_RDONLY, &error);
+        if (fd < 0) {
+            state.SkipWithError(error->message);
+            g_clear_error(&error);
+            break;
+        }
+        gfal2_close(context, fd, &error);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(bench_open_close, mock, "mock://host/path?size=1000")->ThreadRange(1, 8)->UseRealTime();
+
+
+static void bench_open_close_file(benchmark::State& state)
+{
+    bench_open_close(state, ("file://" + bench_local_file(1024)).c_str());
+}
+BENCHMARK(bench_open_close_file)->ThreadRange(1, 8)->UseRealTime();
+
+
+// Read a whole file with the given block size, through the gfal2 file descriptors
+static void bench_read_file(benchmark::State& state)
+{
+    gfal2_context_t context = bench_context();
+    const size_t file_size = 16 * 1024 * 1024;
+    std::string url = "file://" + bench_local_file(file_size);
+    std::vector<char> buffer(state.range(0));
+    GError* error = NULL;
+    int64_t bytes = 0;
+
+    int fd = gfal2_open(context, url.c_str(), O_RDONLY, &error);
+    if (fd < 0) {
+        state.SkipWithError(error->message);
+        g_clear_error(&error);
+        return;
+    }
+    for (auto _ : state) {
+        ssize_t n = gfal2_read(context, fd, buffer.data(), buffer.size(), &error);
+        if (n < 0) {
+            state.SkipWithError(error->message);
+            g_clear_error(&error);
+            break;
+        }
+        bytes += n;
+        if (n == 0) {
+            state.PauseTiming();
+            gfal2_lseek(context, fd, 0, SEEK_SET, NULL);
+            state.ResumeTiming();
+        }
+    }
+    gfal2_close(context, fd, NULL);
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(bench_read_file)->RangeMultiplier(16)->Range(64, 1 << 20);
+
+
+static void bench_read_mock(benchmark::State& state)
+{
+    gfal2_context_t context = bench_context();
+    std::vector<char> buffer(4096);
+    GError* error = NULL;
+
+    // Large enough to never reach the end
+    int fd = gfal2_open(context, "mock://host/path?size=1099511627776", O_RDONLY, &error);
+    if (fd < 0) {
+        state.SkipWithError(error->message);
+        g_clear_error(&error);
+        return;
+    }
+    for (auto _ : state) {
+        if (gfal2_read(context, fd, buffer.data(), buffer.size(), &error) < 0) {
+            state.SkipWithError(error->message);
+            g_clear_error(&error);
+            break;
+        }
+    }
+    gfal2_close(context, fd, NULL);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bench_read_mock);
+
+
+// Same, through the POSIX like API and its own descriptor table
+static void bench_posix_read_file(benchmark::State& state)
+{
+    const size_t file_size = 16 * 1024 * 1024;
+    std::string url = "file://" + bench_local_file(file_size);
+    std::vector<char> buffer(state.range(0));
+    int64_t bytes = 0;
+
+    int fd = gfal_open(url.c_str(), O_RDONLY);
+    if (fd < 0) {
+        state.SkipWithError("Could not open the file with gfal_open");
+        return;
+    }
+    for (auto _ : state) {
+        ssize_t n = gfal_read(fd, buffer.data(), buffer.size());
+        if (n < 0) {
+            state.SkipWithError("gfal_read failed");
+            break;
+        }
+        bytes += n;
+        if (n == 0) {
+            state.PauseTiming();
+            gfal_lseek(fd, 0, SEEK_SET);
+            state.ResumeTiming();
+        }
+    }
+    gfal_close(fd);
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(bench_posix_read_file)->Arg(4096)->Arg(1 << 20);
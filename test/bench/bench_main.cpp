@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bench_common.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <unistd.h>
+
+
+static std::mutex bench_lock;
+static gfal2_context_t bench_shared_context = NULL;
+static std::map<size_t, std::string> bench_files;
+
+
+gfal2_context_t bench_context()
+{
+    std::lock_guard<std::mutex> guard(bench_lock);
+    if (bench_shared_context == NULL) {
+        GError* error = NULL;
+        bench_shared_context = gfal2_context_new(&error);
+        if (bench_shared_context == NULL) {
+            fprintf(stderr, "Could not create the gfal2 context: %s\n", error->message);
+            exit(1);
+        }
+    }
+    return bench_shared_context;
+}
+
+
+std::string bench_local_file(size_t size)
+{
+    std::lock_guard<std::mutex> guard(bench_lock);
+    auto i = bench_files.find(size);
+    if (i != bench_files.end()) {
+        return i->second;
+    }
+
+    char path[] = "/tmp/gfal2_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("Could not create the benchmark file");
+        exit(1);
+    }
+    char block[4096];
+    for (size_t b = 0; b < sizeof(block); ++b) {
+        block[b] = static_cast<char>(b * 31 + 7);
+    }
+    for (size_t written = 0; written < size;) {
+        ssize_t n = write(fd, block, std::min(sizeof(block), size - written));
+        if (n <= 0) {
+            perror("Could not write the benchmark file");
+            exit(1);
+        }
+        written += n;
+    }
+    close(fd);
+
+    bench_files[size] = path;
+    return path;
+}
+
+
+int main(int argc, char** argv)
+{
+    // Use the plugins and configuration of the build tree, unless told otherwise
+    setenv("GFAL_PLUGIN_DIR", GFAL2_BENCH_PLUGIN_DIR, 0);
+    setenv("GFAL_CONFIG_DIR", GFAL2_BENCH_CONFIG_DIR, 0);
+    gfal2_log_set_level(G_LOG_LEVEL_WARNING);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    for (auto& file : bench_files) {
+        unlink(file.second.c_str());
+    }
+    if (bench_shared_context) {
+        gfal2_context_free(bench_shared_context);
+    }
+    return 0;
+}
@@ -287,6 +287,16 @@ ENDIF()
 #    test_rwt_seek("SFTP" "${sftp_prefix}" 100 4560)
 #ENDIF ()
 
+# sftp_prefix can point to any OpenSSH server, i.e. sftp://${USER}@localhost/tmp/gfal2-tests
+IF (PLUGIN_SFTP AND MAIN_TRANSFER)
+    test_copy_file_no_checksum("SFTP_TO_SFTP" "${sftp_prefix}" "${sftp_prefix}")
+    test_copy_file_no_checksum("FILE_TO_SFTP" ${file_prefix} "${sftp_prefix}")
+    test_copy_file_no_checksum("SFTP_TO_FILE" "${sftp_prefix}" ${file_prefix})
+    test_copy_bulk("SFTP_TO_SFTP" "${sftp_prefix}" "${sftp_prefix}")
+    test_copy_bulk("FILE_TO_SFTP" ${file_prefix} "${sftp_prefix}")
+    test_copy_bulk("SFTP_TO_FILE" "${sftp_prefix}" ${file_prefix})
+ENDIF ()
+
 IF (MAIN_TRANSFER)
         test_copy_file_full("GRIDFTP_TO_GRIDFTP"        ${gsiftp_prefix_dpm} ${gsiftp_prefix_dpm})
         test_copy_file_full("SRM_DPM_TO_DCACHE"         ${srm_prefix_dpm} ${srm_prefix_dcache})
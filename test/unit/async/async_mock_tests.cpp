@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+
+// The mock plugin completes stat and checksum requests natively
+class AsyncMockTest: public testing::Test {
+protected:
+    gfal2_context_t context;
+    gfal2_async_queue_t queue;
+
+    virtual void SetUp() {
+        GError* error = NULL;
+        context = gfal2_context_new(&error);
+        ASSERT_TRUE(context != NULL);
+
+        struct stat st;
+        ASSERT_EQ(0, gfal2_stat(context, "mock://host/probe?size=1", &st, &error))
+            << "The mock plugin is not available: " << (error ? error->message : "");
+
+        // A single worker, so anything not done natively is serialized
+        queue = gfal2_async_queue_new(context, 1, &error);
+        ASSERT_TRUE(queue != NULL);
+    }
+
+    virtual void TearDown() {
+        gfal2_async_queue_free(queue);
+        gfal2_context_free(context);
+    }
+
+    void wait_all(int count) {
+        std::vector<gfal2_async_request_t> completed(count);
+        int done = 0;
+        while (done < count) {
+            int n = gfal2_async_poll(queue, completed.data(), count, 10000);
+            ASSERT_GT(n, 0);
+            done += n;
+        }
+        EXPECT_EQ(0, gfal2_async_get_pending(queue));
+    }
+};
+
+
+TEST_F(AsyncMockTest, nativeStatConcurrent)
+{
+    const int nreqs = 40;
+    std::vector<std::string> urls(nreqs);
+    std::vector<struct gfal2_async_request_s> reqs(nreqs);
+
+    gint64 start = g_get_monotonic_time();
+    for (int i = 0; i < nreqs; ++i) {
+        // 200 ms each, 8 seconds if they were run one after the other
+        urls[i] = "mock://host/file" + std::to_string(i) + "?size=" + std::to_string(i) + "&latency=200000";
+        memset(&reqs[i], 0, sizeof(reqs[i]));
+        reqs[i].op = GFAL2_ASYNC_STAT;
+        reqs[i].url = urls[i].c_str();
+        ASSERT_EQ(0, gfal2_async_submit(queue, &reqs[i], NULL));
+    }
+    wait_all(nreqs);
+    gint64 elapsed = g_get_monotonic_time() - start;
+
+    EXPECT_LT(elapsed, 4 * G_USEC_PER_SEC);
+    for (int i = 0; i < nreqs; ++i) {
+        EXPECT_EQ(0, reqs[i].result);
+        EXPECT_TRUE(reqs[i].error == NULL);
+        EXPECT_EQ(i, reqs[i].stat.st_size);
+        EXPECT_TRUE(S_ISREG(reqs[i].stat.st_mode));
+    }
+}
+
+
+TEST_F(AsyncMockTest, nativeError)
+{
+    struct gfal2_async_request_s req;
+    memset(&req, 0, sizeof(req));
+    req.op = GFAL2_ASYNC_STAT;
+    req.url = "mock://host/file?errno=2&latency=1000";
+    ASSERT_EQ(0, gfal2_async_submit(queue, &req, NULL));
+    wait_all(1);
+
+    EXPECT_EQ(-1, req.result);
+    ASSERT_TRUE(req.error != NULL);
+    EXPECT_EQ(ENOENT, req.error->code);
+    g_clear_error(&req.error);
+}
+
+
+TEST_F(AsyncMockTest, nativeChecksum)
+{
+    char buffer[64] = {0};
+    struct gfal2_async_request_s req;
+    memset(&req, 0, sizeof(req));
+    req.op = GFAL2_ASYNC_CHECKSUM;
+    req.url = "mock://host/file?checksum=0a0b0c0d&latency=1000";
+    req.checksum_type = "ADLER32";
+    req.buffer = buffer;
+    req.size = sizeof(buffer);
+    ASSERT_EQ(0, gfal2_async_submit(queue, &req, NULL));
+    wait_all(1);
+
+    EXPECT_EQ(0, req.result);
+    EXPECT_TRUE(req.error == NULL);
+    EXPECT_STREQ("0a0b0c0d", buffer);
+}
+
+
+TEST_F(AsyncMockTest, blockingOnWorkers)
+{
+    // max_connections can not be emulated natively, the result must be the same
+    struct gfal2_async_request_s req;
+    memset(&req, 0, sizeof(req));
+    req.op = GFAL2_ASYNC_STAT;
+    req.url = "mock://host/file?size=5&max_connections=1";
+    ASSERT_EQ(0, gfal2_async_submit(queue, &req, NULL));
+    wait_all(1);
+
+    EXPECT_EQ(0, req.result);
+    EXPECT_EQ(5, req.stat.st_size);
+}
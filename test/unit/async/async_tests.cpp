@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gtest/gtest.h>
+#include <poll.h>
+
+
+static ssize_t async_square(gfal2_context_t context, gfal2_async_request_t req, GError** err)
+{
+    return req->offset * req->offset;
+}
+
+
+static ssize_t async_fail(gfal2_context_t context, gfal2_async_request_t req, GError** err)
+{
+    gfal2_set_error(err, gfal2_get_core_quark(), EIO, __func__, "Expected failure");
+    return -1;
+}
+
+
+TEST(gfalAsync, testCompletion)
+{
+    GError* tmp_err = NULL;
+    gfal2_context_t c = gfal2_context_new(&tmp_err);
+    ASSERT_TRUE(c != NULL);
+
+    gfal2_async_queue_t queue = gfal2_async_queue_new(c, 4, &tmp_err);
+    ASSERT_TRUE(queue != NULL);
+
+    const int nreqs = 32;
+    struct gfal2_async_request_s reqs[nreqs];
+    memset(reqs, 0, sizeof(reqs));
+
+    for (int i = 0; i < nreqs; ++i) {
+        reqs[i].op = GFAL2_ASYNC_CALL;
+        reqs[i].offset = i;
+        reqs[i].func = (i % 2) ? async_fail : async_square;
+        ASSERT_EQ(0, gfal2_async_submit(queue, &reqs[i], &tmp_err));
+    }
+
+    // The descriptor must signal completions
+    struct pollfd pfd = {gfal2_async_get_fd(queue), POLLIN, 0};
+    ASSERT_EQ(1, poll(&pfd, 1, 10000));
+
+    int done = 0;
+    gfal2_async_request_t completed[5];
+    while (done < nreqs) {
+        int n = gfal2_async_poll(queue, completed, 5, 10000);
+        ASSERT_GT(n, 0);
+        for (int j = 0; j < n; ++j) {
+            gfal2_async_request_t r = completed[j];
+            if (r->offset % 2) {
+                EXPECT_EQ(-1, r->result);
+                ASSERT_TRUE(r->error != NULL);
+                EXPECT_EQ(EIO, r->error->code);
+                g_clear_error(&r->error);
+            }
+            else {
+                EXPECT_EQ(r->offset * r->offset, r->result);
+                EXPECT_TRUE(r->error == NULL);
+            }
+        }
+        done += n;
+    }
+
+    EXPECT_EQ(0, gfal2_async_get_pending(queue));
+    EXPECT_EQ(0, gfal2_async_poll(queue, completed, 5, 0));
+
+    gfal2_async_queue_free(queue);
+    gfal2_context_free(c);
+}
+
+
+TEST(gfalAsync, testUnsupportedUrl)
+{
+    GError* tmp_err = NULL;
+    gfal2_context_t c = gfal2_context_new(&tmp_err);
+    ASSERT_TRUE(c != NULL);
+
+    gfal2_async_queue_t queue = gfal2_async_queue_new(c, 1, &tmp_err);
+    ASSERT_TRUE(queue != NULL);
+
+    struct gfal2_async_request_s req;
+    memset(&req, 0, sizeof(req));
+    req.op = GFAL2_ASYNC_STAT;
+    req.url = "unknown://host/path";
+    ASSERT_EQ(0, gfal2_async_submit(queue, &req, &tmp_err));
+
+    gfal2_async_request_t completed = NULL;
+    ASSERT_EQ(1, gfal2_async_poll(queue, &completed, 1, 10000));
+    EXPECT_EQ(&req, completed);
+    EXPECT_EQ(-1, req.result);
+    EXPECT_TRUE(req.error != NULL);
+    g_clear_error(&req.error);
+
+    gfal2_async_queue_free(queue);
+    gfal2_context_free(c);
+}
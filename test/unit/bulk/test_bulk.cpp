@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <common/gfal_plugin_bulk.h>
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+
+static GPtrArray* create_partitions(const char* const* urls, int nbfiles)
+{
+    GPtrArray* partitions = gfal_bulk_partitions_new();
+    GHashTable* index_by_key = gfal_bulk_partitions_index_new();
+    for (int i = 0; i < nbfiles; ++i) {
+        gchar* endpoint = gfal_bulk_get_endpoint(urls[i]);
+        gfal_bulk_partitions_add(partitions, index_by_key, endpoint, NULL, NULL, i, urls[i], NULL);
+        g_free(endpoint);
+    }
+    g_hash_table_destroy(index_by_key);
+    return partitions;
+}
+
+
+// Fail the files whose path ends with "fail"
+static int fail_some(gfal2_context_t, gfal_bulk_partition_t* partition, gpointer)
+{
+    int resu = 0;
+    for (int i = 0; i < partition->nbfiles; ++i) {
+        if (g_str_has_suffix(partition->uris[i], "fail")) {
+            g_set_error(&partition->errors[i], g_quark_from_static_string("test"), EIO, "%s", partition->uris[i]);
+            resu = -1;
+        }
+    }
+    return resu;
+}
+
+
+TEST(gfalBulk, endpoint)
+{
+    gchar* endpoint = gfal_bulk_get_endpoint("davs://host.cern.ch:8443/path");
+    EXPECT_STREQ("davs://host.cern.ch:8443", endpoint);
+    g_free(endpoint);
+}
+
+
+TEST(gfalBulk, partitionsKeepOrder)
+{
+    const char* urls[] = {
+        "davs://a.cern.ch/1", "davs://b.cern.ch/2/fail", "davs://a.cern.ch/3/fail", "davs://b.cern.ch/4"
+    };
+    GPtrArray* partitions = create_partitions(urls, 4);
+    ASSERT_EQ(2u, partitions->len);
+
+    gfal_bulk_partition_t* first = (gfal_bulk_partition_t*)g_ptr_array_index(partitions, 0);
+    ASSERT_EQ(2, first->nbfiles);
+    EXPECT_EQ(0, first->indexes[0]);
+    EXPECT_EQ(2, first->indexes[1]);
+    EXPECT_EQ(NULL, first->uris[2]);
+
+    gfal2_context_t context = gfal2_context_new(NULL);
+    GError* errors[4] = {NULL};
+    int resu = gfal_bulk_partitions_run(context, partitions, fail_some, NULL, errors);
+    EXPECT_EQ(-1, resu);
+
+    for (int i = 0; i < 4; ++i) {
+        if (g_str_has_suffix(urls[i], "fail")) {
+            ASSERT_TRUE(errors[i] != NULL);
+            EXPECT_STREQ(urls[i], errors[i]->message);
+            g_error_free(errors[i]);
+        }
+        else {
+            EXPECT_EQ(NULL, errors[i]);
+        }
+    }
+
+    gfal_bulk_partitions_free(partitions);
+    gfal2_context_free(context);
+}
+
+
+TEST(gfalBulk, tokens)
+{
+    const char* urls[] = {"srm://a.cern.ch/1", "srm://b.cern.ch/2"};
+    GPtrArray* partitions = create_partitions(urls, 2);
+
+    char* tokens[] = {(char*)"token-a", (char*)"token-b"};
+    char token[128];
+    ASSERT_EQ(0, gfal_bulk_token_join(partitions, tokens, token, sizeof(token)));
+
+    gchar* first = gfal_bulk_token_get(token, (gfal_bulk_partition_t*)g_ptr_array_index(partitions, 0));
+    gchar* second = gfal_bulk_token_get(token, (gfal_bulk_partition_t*)g_ptr_array_index(partitions, 1));
+    EXPECT_STREQ("token-a", first);
+    EXPECT_STREQ("token-b", second);
+    g_free(first);
+    g_free(second);
+
+    // Plain tokens are passed as they are
+    gchar* plain = gfal_bulk_token_get("plain", (gfal_bulk_partition_t*)g_ptr_array_index(partitions, 0));
+    EXPECT_STREQ("plain", plain);
+    g_free(plain);
+
+    // Does not fit
+    char small[8];
+    EXPECT_EQ(-1, gfal_bulk_token_join(partitions, tokens, small, sizeof(small)));
+
+    gfal_bulk_partitions_free(partitions);
+}
+
+
+TEST(gfalBulk, tokensWithSeparators)
+{
+    const char* urls[] = {"srm://a.cern.ch/1", "srm://b.cern.ch/2", "srm://c.cern.ch/3"};
+    GPtrArray* partitions = create_partitions(urls, 3);
+    gfal_bulk_partition_t* last = (gfal_bulk_partition_t*)g_ptr_array_index(partitions, 2);
+
+    char* tokens[] = {(char*)"a;b=c", (char*)"", (char*)"12:x;srm://c.cern.ch:0=y"};
+    char token[256];
+    ASSERT_EQ(0, gfal_bulk_token_join(partitions, tokens, token, sizeof(token)));
+
+    gchar* first = gfal_bulk_token_get(token, (gfal_bulk_partition_t*)g_ptr_array_index(partitions, 0));
+    gchar* second = gfal_bulk_token_get(token, (gfal_bulk_partition_t*)g_ptr_array_index(partitions, 1));
+    gchar* third = gfal_bulk_token_get(token, last);
+    EXPECT_STREQ("a;b=c", first);
+    EXPECT_TRUE(second == NULL);
+    EXPECT_STREQ("12:x;srm://c.cern.ch:0=y", third);
+    g_free(first);
+    g_free(second);
+    g_free(third);
+
+    // A single token that looks like a joined one is joined too, so it comes back unchanged
+    GPtrArray* single_partition = create_partitions(urls, 1);
+    char* lookalike[] = {token};
+    char single[512];
+    ASSERT_EQ(0, gfal_bulk_token_join(single_partition, lookalike, single, sizeof(single)));
+    gchar* back = gfal_bulk_token_get(single, (gfal_bulk_partition_t*)g_ptr_array_index(single_partition, 0));
+    EXPECT_STREQ(token, back);
+    g_free(back);
+    gfal_bulk_partitions_free(single_partition);
+
+    // Truncated
+    token[strlen(token) - 1] = '\0';
+    EXPECT_TRUE(gfal_bulk_token_get(token, last) == NULL);
+
+    gfal_bulk_partitions_free(partitions);
+}
+
+
+TEST(gfalBulk, tokenMinSize)
+{
+    const char* urls[] = {"srm://a.cern.ch/1", "srm://b.cern.ch/2"};
+    GPtrArray* partitions = create_partitions(urls, 2);
+
+    // The shortest possible tokens fit exactly
+    size_t min_size = gfal_bulk_token_min_size(partitions);
+    char* tokens[] = {(char*)"a", (char*)"b"};
+    std::vector<char> token(min_size);
+    EXPECT_EQ(0, gfal_bulk_token_join(partitions, tokens, token.data(), min_size));
+    EXPECT_EQ(-1, gfal_bulk_token_join(partitions, tokens, token.data(), min_size - 1));
+
+    gfal_bulk_partitions_free(partitions);
+
+    // No limit other than the plugin's own for a single partition
+    partitions = create_partitions(urls, 1);
+    EXPECT_EQ(1u, gfal_bulk_token_min_size(partitions));
+    gfal_bulk_partitions_free(partitions);
+}
+
+
+TEST(gfalBulk, bringOnlineTokenOverflow)
+{
+    GError* error = NULL;
+    gfal2_context_t context = gfal2_context_new(&error);
+    ASSERT_TRUE(context != NULL);
+
+    struct stat st;
+    ASSERT_EQ(0, gfal2_stat(context, "mock://host/probe?size=1", &st, &error))
+        << "The mock plugin is not available: " << (error ? error->message : "");
+
+    const char* urls[] = {"mock://a.cern.ch/1", "mock://b.cern.ch/2", NULL};
+    GError* errors[2] = {NULL};
+
+    // Rejected before anything is submitted
+    char small[8];
+    EXPECT_EQ(-1, gfal2_bring_online_list(context, 2, urls, 0, 0, small, sizeof(small), 1, errors));
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_TRUE(errors[i] != NULL);
+        EXPECT_EQ(ENOBUFS, errors[i]->code);
+        g_clear_error(&errors[i]);
+    }
+
+    // Large enough for the mock to hand out uuids, but not for both of them
+    char token[96];
+    EXPECT_EQ(-1, gfal2_bring_online_list(context, 2, urls, 0, 0, token, sizeof(token), 1, errors));
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_TRUE(errors[i] != NULL);
+        EXPECT_EQ(ENOBUFS, errors[i]->code);
+        g_clear_error(&errors[i]);
+    }
+
+    // And it works when there is room
+    char large[256];
+    EXPECT_LE(0, gfal2_bring_online_list(context, 2, urls, 0, 0, large, sizeof(large), 1, errors));
+    EXPECT_TRUE(errors[0] == NULL);
+    EXPECT_TRUE(errors[1] == NULL);
+    EXPECT_TRUE(g_str_has_prefix(large, "gfal2-bulk:"));
+
+    gfal2_context_free(context);
+}
+
+
+TEST(gfalBulk, statListUnsupported)
+{
+    gfal2_context_t context = gfal2_context_new(NULL);
+    const char* urls[] = {"nosuchprotocol://a.cern.ch/1", "nosuchprotocol://b.cern.ch/2", NULL};
+    struct stat stats[2];
+    GError* errors[2] = {NULL};
+
+    EXPECT_EQ(-1, gfal2_stat_list(context, 2, urls, stats, errors));
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_TRUE(errors[i] != NULL);
+        g_error_free(errors[i]);
+    }
+    gfal2_context_free(context);
+}
+
+
+TEST(gfalBulk, statListMock)
+{
+    GError* error = NULL;
+    gfal2_context_t context = gfal2_context_new(&error);
+    ASSERT_TRUE(context != NULL);
+
+    // Duplicates and failures mixed with files of other endpoints
+    const char* urls[] = {
+        "mock://a.cern.ch/dir/1?size=1", "mock://b.cern.ch/dir/2?size=2", "mock://a.cern.ch/dir/1?size=1",
+        "mock://a.cern.ch/dir/missing?errno=2", "mock://b.cern.ch/dir/5?size=5", NULL
+    };
+    const int nbfiles = 5;
+    struct stat stats[nbfiles];
+    GError* errors[nbfiles] = {NULL};
+
+    EXPECT_EQ(-1, gfal2_stat_list(context, nbfiles, urls, stats, errors));
+    EXPECT_EQ(1, stats[0].st_size);
+    EXPECT_EQ(2, stats[1].st_size);
+    EXPECT_EQ(1, stats[2].st_size);
+    EXPECT_EQ(5, stats[4].st_size);
+    for (int i = 0; i < nbfiles; ++i) {
+        if (i == 3) {
+            ASSERT_TRUE(errors[i] != NULL);
+            EXPECT_EQ(ENOENT, errors[i]->code);
+            g_clear_error(&errors[i]);
+        }
+        else {
+            EXPECT_TRUE(errors[i] == NULL) << urls[i];
+            EXPECT_TRUE(S_ISREG(stats[i].st_mode)) << urls[i];
+        }
+    }
+
+    gfal2_context_free(context);
+}
+
+
+TEST(gfalBulk, checksumListInvalid)
+{
+    gfal2_context_t context = gfal2_context_new(NULL);
+    const char* urls[] = {"nosuchprotocol://a.cern.ch/1", "nosuchprotocol://b.cern.ch/2", NULL};
+    char buffer1[64], buffer2[64];
+    char* buffers[] = {buffer1, buffer2};
+    GError* errors[2] = {NULL};
+
+    EXPECT_EQ(-1, gfal2_checksum_list(context, 2, urls, "ADLER32", buffers, 0, errors));
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_TRUE(errors[i] != NULL);
+        EXPECT_EQ(EFAULT, errors[i]->code);
+        g_clear_error(&errors[i]);
+    }
+
+    EXPECT_EQ(-1, gfal2_checksum_list(context, 2, urls, "ADLER32", buffers, sizeof(buffer1), errors));
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_TRUE(errors[i] != NULL);
+        g_clear_error(&errors[i]);
+    }
+
+    // Nowhere to put the errors
+    errno = 0;
+    EXPECT_EQ(-1, gfal2_checksum_list(context, 2, urls, "ADLER32", buffers, sizeof(buffer1), NULL));
+    EXPECT_EQ(EFAULT, errno);
+    errno = 0;
+    EXPECT_EQ(-1, gfal2_checksum_list(context, 0, urls, "ADLER32", buffers, sizeof(buffer1), errors));
+    EXPECT_EQ(EINVAL, errno);
+    EXPECT_EQ(-1, gfal2_checksum_list(context, -1, urls, "ADLER32", buffers, sizeof(buffer1), errors));
+    EXPECT_TRUE(errors[0] == NULL);
+
+    gfal2_context_free(context);
+}
+
+
+static std::string write_temp_file(const std::string& content)
+{
+    char tmpl[] = "/tmp/gfal2_test_bulk.XXXXXX";
+    int fd = mkstemp(tmpl);
+    EXPECT_GE(fd, 0);
+    EXPECT_EQ((ssize_t)content.size(), write(fd, content.data(), content.size()));
+    close(fd);
+    return tmpl;
+}
+
+
+// The file plugin has no native bulk checksum, so this goes through the per-file fallback
+TEST(gfalBulk, checksumListFile)
+{
+    gfal2_context_t context = gfal2_context_new(NULL);
+    ASSERT_TRUE(context != NULL);
+
+    std::string pattern(100000, '\0');
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        pattern[i] = (char)((i * 7) % 251);
+    }
+    std::string paths[] = {write_temp_file("Hello gfal2 checksums\n"), write_temp_file(pattern)};
+    std::string file_urls[] = {"file://" + paths[0], "file://" + paths[1], "file://" + paths[0] + ".missing"};
+    const char* urls[] = {file_urls[0].c_str(), file_urls[1].c_str(), file_urls[2].c_str(), NULL};
+
+    char buffer1[64], buffer2[64], buffer3[64];
+    char* buffers[] = {buffer1, buffer2, buffer3};
+    GError* errors[3] = {NULL};
+
+    EXPECT_EQ(-1, gfal2_checksum_list(context, 3, urls, "ADLER32", buffers, sizeof(buffer1), errors));
+    EXPECT_TRUE(errors[0] == NULL);
+    EXPECT_TRUE(errors[1] == NULL);
+    EXPECT_STREQ("5a0c07d1", buffer1);
+    EXPECT_STREQ("437bc42e", buffer2);
+    ASSERT_TRUE(errors[2] != NULL);
+    EXPECT_EQ(ENOENT, errors[2]->code);
+    g_clear_error(&errors[2]);
+
+    EXPECT_EQ(0, gfal2_checksum_list(context, 2, urls, "MD5", buffers, sizeof(buffer1), errors));
+    EXPECT_TRUE(errors[0] == NULL);
+    EXPECT_TRUE(errors[1] == NULL);
+    EXPECT_STREQ("23e25614b59c735dac32152dbec989f7", buffer1);
+    EXPECT_STREQ("c260642229888763c0fa2a4843f50a36", buffer2);
+
+    unlink(paths[0].c_str());
+    unlink(paths[1].c_str());
+    gfal2_context_free(context);
+}
@@ -258,3 +258,28 @@ TEST_F(CredTest, set_get_prefix)
     ASSERT_EQ(resp, (void*) NULL);
     ASSERT_STREQ("", baseurl);
 }
+
+TEST_F(CredTest, generation)
+{
+    GError* error = NULL;
+    guint generation = gfal2_cred_get_generation(context);
+
+    int ret = gfal2_cred_set(context, "https://host.com/path", token, &error);
+    ASSERT_PRED_FORMAT2(AssertGfalSuccess, ret, error);
+    ASSERT_NE(generation, gfal2_cred_get_generation(context));
+
+    // Lookups do not modify the list
+    generation = gfal2_cred_get_generation(context);
+    char* resp = gfal2_cred_get(context, GFAL_CRED_BEARER, "https://host.com/path/file", NULL, &error);
+    g_free(resp);
+    ASSERT_EQ(generation, gfal2_cred_get_generation(context));
+
+    ret = gfal2_cred_del(context, GFAL_CRED_BEARER, "https://host.com/path", &error);
+    ASSERT_PRED_FORMAT2(AssertGfalSuccess, ret, error);
+    ASSERT_NE(generation, gfal2_cred_get_generation(context));
+
+    generation = gfal2_cred_get_generation(context);
+    ret = gfal2_cred_clean(context, &error);
+    ASSERT_PRED_FORMAT2(AssertGfalSuccess, ret, error);
+    ASSERT_NE(generation, gfal2_cred_get_generation(context));
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gtest/gtest.h>
+#include <cstring>
+
+
+static GQuark test_quark()
+{
+    return g_quark_from_static_string("test");
+}
+
+
+TEST(gfalError, setError)
+{
+    GError* error = NULL;
+    gfal2_set_error(&error, test_quark(), ENOENT, __func__, "%s does not exist", "/some/path");
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(ENOENT, error->code);
+    EXPECT_EQ(test_quark(), error->domain);
+    EXPECT_TRUE(strstr(error->message, "/some/path does not exist") != NULL) << error->message;
+    g_error_free(error);
+
+    // Must not crash
+    gfal2_set_error(NULL, test_quark(), ENOENT, __func__, "%s", "ignored");
+}
+
+
+TEST(gfalError, expectedErrno)
+{
+    GError* error = NULL;
+    int previous = gfal2_expect_errno_begin(ENOENT);
+    EXPECT_TRUE(gfal2_errno_is_expected(ENOENT));
+    EXPECT_FALSE(gfal2_errno_is_expected(EACCES));
+
+    gfal2_set_error(&error, test_quark(), ENOENT, __func__, "%s does not exist", "/some/path");
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(ENOENT, error->code);
+    EXPECT_STREQ(g_strerror(ENOENT), error->message);
+    g_clear_error(&error);
+
+    // Other codes keep their message
+    gfal2_set_error(&error, test_quark(), EACCES, __func__, "%s is forbidden", "/some/path");
+    ASSERT_TRUE(error != NULL);
+    EXPECT_TRUE(strstr(error->message, "/some/path is forbidden") != NULL) << error->message;
+    g_clear_error(&error);
+
+    gfal2_expect_errno_end(previous);
+    EXPECT_FALSE(gfal2_errno_is_expected(ENOENT));
+}
+
+
+TEST(gfalError, expectedErrnoNested)
+{
+    int outer = gfal2_expect_errno_begin(ENOENT);
+    int inner = gfal2_expect_errno_begin(EEXIST);
+    EXPECT_TRUE(gfal2_errno_is_expected(EEXIST));
+    EXPECT_FALSE(gfal2_errno_is_expected(ENOENT));
+    gfal2_expect_errno_end(inner);
+    EXPECT_TRUE(gfal2_errno_is_expected(ENOENT));
+    gfal2_expect_errno_end(outer);
+    EXPECT_FALSE(gfal2_errno_is_expected(ENOENT));
+}
+
+
+TEST(gfalError, expectedErrnoIsNotPrefixed)
+{
+    GLogLevelFlags level = gfal2_log_get_level();
+    gfal2_log_set_level(G_LOG_LEVEL_DEBUG);
+
+    GError* error = NULL;
+    GError* src = g_error_new_literal(test_quark(), ENOENT, "original");
+    gfal2_propagate_prefixed_error(&error, src, __func__);
+    EXPECT_STRNE("original", error->message);
+    g_clear_error(&error);
+
+    int previous = gfal2_expect_errno_begin(ENOENT);
+    src = g_error_new_literal(test_quark(), ENOENT, "original");
+    gfal2_propagate_prefixed_error(&error, src, __func__);
+    EXPECT_EQ(src, error);
+    EXPECT_STREQ("original", error->message);
+    g_clear_error(&error);
+    gfal2_expect_errno_end(previous);
+
+    gfal2_log_set_level(level);
+}
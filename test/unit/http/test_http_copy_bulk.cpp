@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) CERN 2023
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gtest/gtest.h>
+#include <utils/exceptions/gerror_to_cpp.h>
+
+#include <davix.hpp>
+#include "plugins/http/gfal_http_plugin.h"
+
+#include <unistd.h>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+// Pairs not handled by the http plugin are copied through gfal2 by the same workers,
+// so the mock plugin can stand for the remote storages
+class HttpCopyBulkTest: public testing::Test {
+protected:
+    gfal2_context_t context;
+    GfalHttpPluginData* davix;
+
+    HttpCopyBulkTest(): context(NULL), davix(NULL) {}
+
+    virtual void SetUp() {
+        GError* error = NULL;
+        context = gfal2_context_new(&error);
+        Gfal::gerror_to_cpp(&error);
+
+        // The mock plugin is only there when built with PLUGIN_MOCK
+        struct stat st;
+        if (gfal2_stat(context, "mock://host/probe?size=1", &st, &error) != 0) {
+            std::cout << "The mock plugin is not available: " << error->message << std::endl;
+            g_clear_error(&error);
+            return;
+        }
+
+        gfal2_set_opt_integer(context, "HTTP PLUGIN", "BULK_COPY_CONCURRENCY", 8, NULL);
+        davix = new GfalHttpPluginData(context);
+    }
+
+    virtual void TearDown() {
+        delete davix;
+        gfal2_context_free(context);
+    }
+
+    bool available() const {
+        return davix != NULL;
+    }
+};
+
+
+struct CallbackTracker {
+    std::atomic<int> inside;
+    std::atomic<int> max_inside;
+    std::atomic<int> events;
+
+    CallbackTracker(): inside(0), max_inside(0), events(0) {}
+};
+
+
+static void tracking_event_callback(const gfalt_event_t e, gpointer user_data)
+{
+    CallbackTracker* tracker = static_cast<CallbackTracker*>(user_data);
+    int now = ++tracker->inside;
+    int max = tracker->max_inside.load();
+    while (now > max && !tracker->max_inside.compare_exchange_weak(max, now)) {
+    }
+    // Long enough for the other workers to get here too, if they could
+    usleep(2000);
+    ++tracker->events;
+    --tracker->inside;
+}
+
+
+TEST_F(HttpCopyBulkTest, serializedCallbacks)
+{
+    if (!available()) {
+        return;
+    }
+    const size_t nbfiles = 16;
+    std::vector<std::string> src_str(nbfiles), dst_str(nbfiles);
+    std::vector<const char*> srcs(nbfiles), dsts(nbfiles);
+    for (size_t i = 0; i < nbfiles; ++i) {
+        src_str[i] = "mock://host" + std::to_string(i % 3) + "/src" + std::to_string(i) + "?size=10";
+        dst_str[i] = "mock://host/dst" + std::to_string(i) + "?time=0";
+        srcs[i] = src_str[i].c_str();
+        dsts[i] = dst_str[i].c_str();
+    }
+
+    CallbackTracker tracker;
+    GError* error = NULL;
+    gfalt_params_t params = gfalt_params_handle_new(&error);
+    Gfal::gerror_to_cpp(&error);
+    gfalt_add_event_callback(params, tracking_event_callback, &tracker, NULL, NULL);
+
+    GError* op_error = NULL;
+    GError** file_errors = NULL;
+    int ret = gfal_http_copy_bulk(davix, context, params, nbfiles, srcs.data(), dsts.data(), NULL,
+        &op_error, &file_errors);
+
+    EXPECT_EQ(0, ret);
+    EXPECT_TRUE(op_error == NULL);
+    for (size_t i = 0; i < nbfiles; ++i) {
+        EXPECT_TRUE(file_errors[i] == NULL) << dsts[i] << ": " << file_errors[i]->message;
+        g_clear_error(&file_errors[i]);
+    }
+    g_free(file_errors);
+
+    // Every copy reported its events, never two at the same time
+    EXPECT_GE(tracker.events.load(), (int)nbfiles);
+    EXPECT_EQ(1, tracker.max_inside.load());
+
+    gfalt_params_handle_delete(params, NULL);
+}
+
+
+TEST_F(HttpCopyBulkTest, perFileErrors)
+{
+    if (!available()) {
+        return;
+    }
+    const char* srcs[] = {"mock://host/src0?size=10", "mock://host/src1?size=10", "mock://host/src2?size=10"};
+    const char* dsts[] = {"mock://host/dst0?time=0", "mock://host/dst1?time=1&transfer_errno=5",
+        "mock://host/dst2?time=0"};
+
+    GError* error = NULL;
+    gfalt_params_t params = gfalt_params_handle_new(&error);
+    Gfal::gerror_to_cpp(&error);
+
+    GError* op_error = NULL;
+    GError** file_errors = NULL;
+    int ret = gfal_http_copy_bulk(davix, context, params, 3, srcs, dsts, NULL, &op_error, &file_errors);
+
+    EXPECT_EQ(-1, ret);
+    EXPECT_TRUE(file_errors[0] == NULL);
+    ASSERT_TRUE(file_errors[1] != NULL);
+    EXPECT_EQ(EIO, file_errors[1]->code);
+    EXPECT_TRUE(file_errors[2] == NULL);
+    for (size_t i = 0; i < 3; ++i) {
+        g_clear_error(&file_errors[i]);
+    }
+    g_free(file_errors);
+    g_clear_error(&op_error);
+
+    gfalt_params_handle_delete(params, NULL);
+}
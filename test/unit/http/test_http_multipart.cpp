@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) CERN 2023
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gtest/gtest.h>
+
+#include <davix.hpp>
+#include "plugins/http/gfal_http_plugin.h"
+
+#include <unistd.h>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define PART_SIZE 1000
+
+
+// Keeps the parts in memory, and fails the ones asked to
+class FakeMultipart {
+public:
+    std::mutex mutex;
+    std::map<size_t, std::string> parts;
+    std::vector<std::string> committed;
+    std::vector<std::string> aborted;
+    std::atomic<int> inside, max_inside;
+    size_t failing_part;
+
+    FakeMultipart(): inside(0), max_inside(0), failing_part(0) {}
+
+    HttpMultipartDestination destination()
+    {
+        HttpMultipartDestination dest;
+        dest.initiate = []() {
+            return std::string("upload-1");
+        };
+        dest.upload_part = [this](const std::string& upload_id, size_t part_number, const char* data, size_t len) {
+            int now = ++inside;
+            int max = max_inside.load();
+            while (now > max && !max_inside.compare_exchange_weak(max, now)) {
+            }
+            usleep(2000);
+            --inside;
+
+            EXPECT_EQ("upload-1", upload_id);
+            if (part_number == failing_part) {
+                throw Davix::DavixException("test", Davix::StatusCode::ConnectionProblem, "part failed");
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            parts[part_number] = std::string(data, len);
+            return "etag-" + std::to_string(part_number);
+        };
+        dest.commit = [this](const std::string& upload_id, const std::vector<std::string>& etags) {
+            std::lock_guard<std::mutex> lock(mutex);
+            committed = etags;
+        };
+        dest.abort = [this](const std::string& upload_id) {
+            std::lock_guard<std::mutex> lock(mutex);
+            aborted.push_back(upload_id);
+        };
+        return dest;
+    }
+};
+
+
+class HttpMultipartTest: public testing::Test {
+protected:
+    std::string content;
+    size_t position;
+    // The source stops (0) or fails (-1) there
+    size_t source_end;
+    dav_ssize_t source_end_ret;
+
+    virtual void SetUp() {
+        content.resize(10 * PART_SIZE + 77);
+        for (size_t i = 0; i < content.size(); ++i) {
+            content[i] = (char)((i * 7) % 251);
+        }
+        position = 0;
+        source_end = content.size();
+        source_end_ret = 0;
+    }
+
+    // Odd sized reads, as the stream provider would give
+    std::function<dav_ssize_t(void*, dav_size_t)> reader()
+    {
+        return [this](void* buffer, dav_size_t count) -> dav_ssize_t {
+            if (position >= source_end) {
+                return source_end_ret;
+            }
+            size_t n = std::min<size_t>(std::min<size_t>(count, 333), source_end - position);
+            memcpy(buffer, content.data() + position, n);
+            position += n;
+            return n;
+        };
+    }
+};
+
+
+TEST_F(HttpMultipartTest, partsInOrder)
+{
+    FakeMultipart fake;
+    GError* error = NULL;
+
+    ASSERT_EQ(0, gfal_http_multipart_upload(fake.destination(), reader(), content.size(), PART_SIZE, 4, 0, &error));
+    EXPECT_TRUE(error == NULL);
+
+    ASSERT_EQ(11u, fake.committed.size());
+    std::string uploaded;
+    for (size_t i = 0; i < fake.committed.size(); ++i) {
+        EXPECT_EQ("etag-" + std::to_string(i + 1), fake.committed[i]);
+        uploaded += fake.parts[i + 1];
+    }
+    EXPECT_EQ(content, uploaded);
+    EXPECT_TRUE(fake.aborted.empty());
+    EXPECT_GT(fake.max_inside.load(), 1);
+    EXPECT_LE(fake.max_inside.load(), 4);
+}
+
+
+TEST_F(HttpMultipartTest, boundedMemory)
+{
+    FakeMultipart fake;
+    GError* error = NULL;
+
+    // Room for two parts only
+    ASSERT_EQ(0, gfal_http_multipart_upload(fake.destination(), reader(), content.size(), PART_SIZE, 8,
+        2 * PART_SIZE + 10, &error));
+    EXPECT_LE(fake.max_inside.load(), 2);
+    EXPECT_EQ(11u, fake.committed.size());
+}
+
+
+TEST_F(HttpMultipartTest, abortOnPartFailure)
+{
+    FakeMultipart fake;
+    fake.failing_part = 3;
+    GError* error = NULL;
+
+    EXPECT_EQ(-1, gfal_http_multipart_upload(fake.destination(), reader(), content.size(), PART_SIZE, 4, 0, &error));
+    ASSERT_TRUE(error != NULL);
+    EXPECT_TRUE(strstr(error->message, "part failed") != NULL) << error->message;
+    g_clear_error(&error);
+
+    EXPECT_TRUE(fake.committed.empty());
+    ASSERT_EQ(1u, fake.aborted.size());
+    EXPECT_EQ("upload-1", fake.aborted[0]);
+}
+
+
+TEST_F(HttpMultipartTest, abortOnShortSource)
+{
+    FakeMultipart fake;
+    source_end = 5 * PART_SIZE + 10;
+    GError* error = NULL;
+
+    EXPECT_EQ(-1, gfal_http_multipart_upload(fake.destination(), reader(), content.size(), PART_SIZE, 4, 0, &error));
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(EIO, error->code);
+    g_clear_error(&error);
+
+    EXPECT_TRUE(fake.committed.empty());
+    EXPECT_EQ(1u, fake.aborted.size());
+}
+
+
+TEST_F(HttpMultipartTest, sourceErrorLeftToReader)
+{
+    FakeMultipart fake;
+    source_end = 2 * PART_SIZE;
+    source_end_ret = -1;
+    GError* error = NULL;
+
+    EXPECT_EQ(-1, gfal_http_multipart_upload(fake.destination(), reader(), content.size(), PART_SIZE, 4, 0, &error));
+    EXPECT_TRUE(error == NULL);
+    EXPECT_TRUE(fake.committed.empty());
+    EXPECT_EQ(1u, fake.aborted.size());
+}
+
+
+TEST_F(HttpMultipartTest, initiateFailure)
+{
+    FakeMultipart fake;
+    HttpMultipartDestination dest = fake.destination();
+    dest.initiate = []() -> std::string {
+        throw Davix::DavixException("test", Davix::StatusCode::PermissionRefused, "denied");
+    };
+    GError* error = NULL;
+
+    EXPECT_EQ(-1, gfal_http_multipart_upload(dest, reader(), content.size(), PART_SIZE, 4, 0, &error));
+    ASSERT_TRUE(error != NULL);
+    g_clear_error(&error);
+
+    // Nothing to abort
+    EXPECT_TRUE(fake.aborted.empty());
+    EXPECT_EQ(0u, position);
+}
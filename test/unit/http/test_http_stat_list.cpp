@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) CERN 2023
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gtest/gtest.h>
+
+#include <davix.hpp>
+#include "plugins/http/gfal_http_plugin.h"
+
+#include <string>
+#include <vector>
+
+
+TEST(HttpStatList, disabledByDefault)
+{
+    std::vector<std::string> urls;
+    for (int i = 0; i < 16; ++i) {
+        urls.push_back("https://host/dir/file" + std::to_string(i));
+    }
+    EXPECT_TRUE(gfal_http_stat_list_groups(urls, 0).empty());
+}
+
+
+TEST(HttpStatList, fewEntriesAreNotListed)
+{
+    std::vector<std::string> urls = {
+        "https://host/dir/a", "https://host/dir/b", "https://host/other/c"
+    };
+    EXPECT_TRUE(gfal_http_stat_list_groups(urls, 3).empty());
+
+    std::vector<StatListGroup> groups = gfal_http_stat_list_groups(urls, 2);
+    ASSERT_EQ(1u, groups.size());
+    EXPECT_EQ("https://host/dir/", groups[0].parent);
+    EXPECT_EQ(2u, groups[0].names.size());
+}
+
+
+TEST(HttpStatList, duplicatedUrls)
+{
+    std::vector<std::string> urls = {
+        "https://host/dir/a", "https://host/dir/b", "https://host/dir/a", "https://host/dir/a%20b"
+    };
+
+    // Duplicates do not count towards the threshold
+    EXPECT_TRUE(gfal_http_stat_list_groups(urls, 4).empty());
+
+    std::vector<StatListGroup> groups = gfal_http_stat_list_groups(urls, 3);
+    ASSERT_EQ(1u, groups.size());
+    ASSERT_EQ(3u, groups[0].names.size());
+
+    // Every position is kept, so all of them get filled
+    std::vector<int> expected = {0, 2};
+    EXPECT_EQ(expected, groups[0].names["a"]);
+    EXPECT_EQ(std::vector<int>{1}, groups[0].names["b"]);
+    EXPECT_EQ(std::vector<int>{3}, groups[0].names["a b"]);
+}
+
+
+TEST(HttpStatList, queryStringsAreStatedAlone)
+{
+    std::vector<std::string> urls = {
+        "https://host/dir/a?x=1", "https://host/dir/b?x=1", "https://host/dir/"
+    };
+    EXPECT_TRUE(gfal_http_stat_list_groups(urls, 1).empty());
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) CERN 2023
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gtest/gtest.h>
+#include <utils/exceptions/gerror_to_cpp.h>
+
+#include <davix.hpp>
+#include "plugins/http/gfal_http_plugin.h"
+#include "plugins/http/gfal_http_stream_prefetcher.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#define CHUNK_SIZE 1000
+
+
+// The file:// sources need the file plugin of the build tree
+class HttpStreamPrefetcherTest: public testing::Test {
+protected:
+    gfal2_context_t context;
+    std::vector<char> content;
+    std::string path;
+
+    virtual void SetUp() {
+        GError* error = NULL;
+        context = gfal2_context_new(&error);
+        Gfal::gerror_to_cpp(&error);
+
+        // Not a multiple of the chunk size, so the last one is short
+        content.resize(100 * CHUNK_SIZE + 3);
+        for (size_t i = 0; i < content.size(); ++i) {
+            content[i] = (char)((i * 7) % 251);
+        }
+
+        char tmpl[] = "/tmp/gfal2_test_prefetcher.XXXXXX";
+        int fd = mkstemp(tmpl);
+        ASSERT_GE(fd, 0);
+        path = tmpl;
+        ASSERT_EQ((ssize_t)content.size(), write(fd, content.data(), content.size()));
+        close(fd);
+    }
+
+    virtual void TearDown() {
+        unlink(path.c_str());
+        gfal2_context_free(context);
+    }
+
+    // Serves the content, with the later ranges answered first
+    HttpStreamPrefetcher::RangeReader range_reader()
+    {
+        return [this](void* buffer, dav_size_t count, dav_off_t offset, GError**) -> dav_ssize_t {
+            usleep(((content.size() - offset) / CHUNK_SIZE) % 4 * 500);
+            size_t n = std::min<size_t>(count, content.size() - offset);
+            memcpy(buffer, content.data() + offset, n);
+            return n;
+        };
+    }
+
+    // Drain the prefetcher with reads that do not align with the chunks
+    dav_ssize_t read_all(HttpStreamPrefetcher& prefetcher, std::vector<char>& out, GError** err,
+                         size_t limit = SIZE_MAX)
+    {
+        char buffer[333];
+        dav_ssize_t n;
+        while (out.size() < limit && (n = prefetcher.Read(buffer, sizeof(buffer), err)) > 0) {
+            out.insert(out.end(), buffer, buffer + n);
+        }
+        return out.size() < limit ? n : 1;
+    }
+};
+
+
+TEST_F(HttpStreamPrefetcherTest, sequentialFromFd)
+{
+    GError* error = NULL;
+    int fd = gfal2_open(context, ("file://" + path).c_str(), O_RDONLY, &error);
+    ASSERT_GE(fd, 0) << error->message;
+
+    HttpStreamPrefetcher prefetcher(context, fd, 4, CHUNK_SIZE);
+    prefetcher.Start();
+
+    std::vector<char> out;
+    EXPECT_EQ(0, read_all(prefetcher, out, &error));
+    EXPECT_TRUE(error == NULL);
+    EXPECT_EQ(content, out);
+
+    // The end is sticky
+    char buffer[10];
+    EXPECT_EQ(0, prefetcher.Read(buffer, sizeof(buffer), &error));
+
+    prefetcher.Stop();
+    gfal2_close(context, fd, NULL);
+}
+
+
+TEST_F(HttpStreamPrefetcherTest, orderingWithParallelReaders)
+{
+    GError* error = NULL;
+    HttpStreamPrefetcher prefetcher(context, -1, 8, CHUNK_SIZE);
+    prefetcher.SetRangeReader(range_reader(), content.size(), 4);
+    prefetcher.Start();
+
+    std::vector<char> out;
+    EXPECT_EQ(0, read_all(prefetcher, out, &error));
+    EXPECT_TRUE(error == NULL);
+    ASSERT_EQ(content.size(), out.size());
+    EXPECT_TRUE(content == out);
+}
+
+
+TEST_F(HttpStreamPrefetcherTest, rewindFd)
+{
+    GError* error = NULL;
+    int fd = gfal2_open(context, ("file://" + path).c_str(), O_RDONLY, &error);
+    ASSERT_GE(fd, 0) << error->message;
+
+    HttpStreamPrefetcher prefetcher(context, fd, 4, CHUNK_SIZE);
+    prefetcher.Start();
+
+    // Stop halfway, with chunks still in flight
+    std::vector<char> partial;
+    read_all(prefetcher, partial, &error, content.size() / 2);
+    ASSERT_TRUE(error == NULL);
+
+    ASSERT_EQ(0, prefetcher.Rewind(&error));
+    std::vector<char> out;
+    EXPECT_EQ(0, read_all(prefetcher, out, &error));
+    EXPECT_TRUE(error == NULL);
+    EXPECT_TRUE(content == out);
+
+    prefetcher.Stop();
+    gfal2_close(context, fd, NULL);
+}
+
+
+TEST_F(HttpStreamPrefetcherTest, rewindRanges)
+{
+    GError* error = NULL;
+    HttpStreamPrefetcher prefetcher(context, -1, 8, CHUNK_SIZE);
+    prefetcher.SetRangeReader(range_reader(), content.size(), 4);
+    prefetcher.Start();
+
+    std::vector<char> partial;
+    read_all(prefetcher, partial, &error, 10 * CHUNK_SIZE + 17);
+    ASSERT_TRUE(error == NULL);
+
+    ASSERT_EQ(0, prefetcher.Rewind(&error));
+    std::vector<char> out;
+    EXPECT_EQ(0, read_all(prefetcher, out, &error));
+    EXPECT_TRUE(error == NULL);
+    EXPECT_TRUE(content == out);
+}
+
+
+TEST_F(HttpStreamPrefetcherTest, errorAfterGoodChunks)
+{
+    GError* error = NULL;
+    const dav_off_t failing = 5 * CHUNK_SIZE;
+
+    // The chunks after the failed one are slower, and fail too, with a different error
+    auto reader = [this, failing](void* buffer, dav_size_t count, dav_off_t offset, GError** err) -> dav_ssize_t {
+        if (offset == failing) {
+            usleep(20000);
+            gfal2_set_error(err, http_plugin_domain, EIO, __func__, "first failure");
+            return -1;
+        }
+        else if (offset > failing) {
+            gfal2_set_error(err, http_plugin_domain, ECONNRESET, __func__, "later failure");
+            return -1;
+        }
+        memcpy(buffer, content.data() + offset, count);
+        return count;
+    };
+
+    HttpStreamPrefetcher prefetcher(context, -1, 8, CHUNK_SIZE);
+    prefetcher.SetRangeReader(reader, content.size(), 4);
+    prefetcher.Start();
+
+    // Everything before the failure is delivered, then the earliest error
+    std::vector<char> out;
+    EXPECT_EQ(-1, read_all(prefetcher, out, &error));
+    ASSERT_EQ((size_t)failing, out.size());
+    EXPECT_TRUE(std::equal(out.begin(), out.end(), content.begin()));
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(EIO, error->code);
+    EXPECT_TRUE(strstr(error->message, "first failure") != NULL) << error->message;
+    g_clear_error(&error);
+
+    // The error stays
+    char buffer[10];
+    EXPECT_EQ(-1, prefetcher.Read(buffer, sizeof(buffer), &error));
+    EXPECT_TRUE(error != NULL);
+    g_clear_error(&error);
+}
+
+
+TEST_F(HttpStreamPrefetcherTest, sourceShorterThanExpected)
+{
+    GError* error = NULL;
+    const size_t real_size = 3 * CHUNK_SIZE + 10;
+
+    auto reader = [this, real_size](void* buffer, dav_size_t count, dav_off_t offset, GError**) -> dav_ssize_t {
+        if ((size_t)offset >= real_size) {
+            return 0;
+        }
+        size_t n = std::min<size_t>(count, real_size - offset);
+        memcpy(buffer, content.data() + offset, n);
+        return n;
+    };
+
+    HttpStreamPrefetcher prefetcher(context, -1, 4, CHUNK_SIZE);
+    prefetcher.SetRangeReader(reader, content.size(), 2);
+    prefetcher.Start();
+
+    std::vector<char> out;
+    EXPECT_EQ(-1, read_all(prefetcher, out, &error));
+    EXPECT_EQ(3u * CHUNK_SIZE, out.size());
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(EIO, error->code);
+    g_clear_error(&error);
+}
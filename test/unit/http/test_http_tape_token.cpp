@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) CERN 2023
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gtest/gtest.h>
+
+#include <davix.hpp>
+#include "plugins/http/gfal_http_plugin.h"
+
+#include <string>
+#include <vector>
+
+
+TEST(HttpTapeToken, singleIdAsIs)
+{
+    std::vector<std::string> reqids = {"3b6d5f4e-0b1c-4c4e-9f6a-2f1f6b7c8d9e"};
+    std::string token = gfal_http_tape_token_encode(reqids);
+    EXPECT_EQ(reqids[0], token);
+
+    // Tokens of older versions are single plain IDs
+    std::vector<std::string> decoded;
+    ASSERT_TRUE(gfal_http_tape_token_decode(token.c_str(), decoded));
+    EXPECT_EQ(reqids, decoded);
+
+    ASSERT_TRUE(gfal_http_tape_token_decode("a,b", decoded));
+    ASSERT_EQ(1u, decoded.size());
+    EXPECT_EQ("a,b", decoded[0]);
+}
+
+
+TEST(HttpTapeToken, severalIds)
+{
+    // Any character is allowed within the IDs, including separators and digits
+    std::vector<std::string> reqids = {"req-1", "with,comma", "12:34", " spaces ", "gfal2-reqids:1:x"};
+    std::string token = gfal_http_tape_token_encode(reqids);
+    EXPECT_EQ(GFAL_HTTP_TAPE_TOKEN_PREFIX "5:req-110:with,comma5:12:348: spaces 16:gfal2-reqids:1:x", token);
+
+    std::vector<std::string> decoded;
+    ASSERT_TRUE(gfal_http_tape_token_decode(token.c_str(), decoded));
+    EXPECT_EQ(reqids, decoded);
+}
+
+
+TEST(HttpTapeToken, singleIdLookingEncoded)
+{
+    std::vector<std::string> reqids = {"gfal2-reqids:3:abc"};
+    std::string token = gfal_http_tape_token_encode(reqids);
+    EXPECT_NE(reqids[0], token);
+
+    std::vector<std::string> decoded;
+    ASSERT_TRUE(gfal_http_tape_token_decode(token.c_str(), decoded));
+    EXPECT_EQ(reqids, decoded);
+}
+
+
+TEST(HttpTapeToken, malformed)
+{
+    std::vector<std::string> decoded;
+    const char* tokens[] = {
+        "",
+        GFAL_HTTP_TAPE_TOKEN_PREFIX,
+        GFAL_HTTP_TAPE_TOKEN_PREFIX "abc",
+        GFAL_HTTP_TAPE_TOKEN_PREFIX "3abc",
+        GFAL_HTTP_TAPE_TOKEN_PREFIX "0:",
+        GFAL_HTTP_TAPE_TOKEN_PREFIX "-1:a",
+        GFAL_HTTP_TAPE_TOKEN_PREFIX " 1:a",
+        GFAL_HTTP_TAPE_TOKEN_PREFIX "5:abc",
+        GFAL_HTTP_TAPE_TOKEN_PREFIX "3:abc2:d",
+        GFAL_HTTP_TAPE_TOKEN_PREFIX "99999999999999999999999:a",
+    };
+
+    EXPECT_FALSE(gfal_http_tape_token_decode(NULL, decoded));
+    for (size_t i = 0; i < sizeof(tokens) / sizeof(tokens[0]); ++i) {
+        EXPECT_FALSE(gfal_http_tape_token_decode(tokens[i], decoded)) << tokens[i];
+        EXPECT_TRUE(decoded.empty()) << tokens[i];
+    }
+}
@@ -23,6 +23,9 @@
 #include <common/gfal_plugin.h>
 #undef __GFAL2_H_INSIDE__
 
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <davix.hpp>
 #include "plugins/http/gfal_http_plugin.h"
 
@@ -69,6 +72,11 @@ protected:
     char* findInTokenMap(const char* path, const OP& operation) {
         return httpData->find_se_token(Davix::Uri(path), operation);
     }
+
+    void storeSEToken(const char* path, const char* token, const OP& operation, unsigned validity) {
+        TokenCache::Entry entry{path, token, httpData->writeFlagFromOperation(operation), validity};
+        httpData->store_se_token(entry);
+    }
 };
 
 TEST_F(TokenMapTest, ReadOperation)
@@ -253,3 +261,83 @@ TEST_F(TokenMapTest, CopyTestFTSCompatibility)
     ASSERT_STREQ(findInTokenMap(source, OP::HEAD), "token_source");
     ASSERT_STREQ(findInTokenMap(dest, OP::HEAD), "token_dest_host");
 }
+
+TEST_F(TokenMapTest, ExpiredSEToken)
+{
+    const char* path = "davs://example.cern.ch:443/path/subpath/file";
+    const char* parentpath = "davs://example.cern.ch:443/path/subpath";
+
+    storeSEToken(parentpath, "token_parentpath", OP::READ, 180);
+    storeSEToken(path, "token_expired", OP::READ, 0);
+    ASSERT_STREQ(findInTokenMap(path, OP::READ), "token_parentpath");
+
+    storeSEToken(path, "token_path", OP::READ, 180);
+    ASSERT_STREQ(findInTokenMap(path, OP::READ), "token_path");
+}
+
+TEST_F(TokenMapTest, IndexFollowsCredentialMap)
+{
+    const char* path = "davs://example.cern.ch:443/path/subpath/file";
+    const char* parentpath = "davs://example.cern.ch:443/path/subpath";
+
+    storeInTokenMap(parentpath, "token_parentpath", OP::READ);
+    ASSERT_STREQ(findInTokenMap(path, OP::READ), "token_parentpath");
+
+    storeInTokenMap(path, "token_path", OP::READ);
+    ASSERT_STREQ(findInTokenMap(path, OP::READ), "token_path");
+
+    GError* error = NULL;
+    int ret = gfal2_cred_del(context, GFAL_CRED_BEARER, path, &error);
+    ASSERT_PRED_FORMAT2(AssertGfalSuccess, ret, error);
+    ASSERT_STREQ(findInTokenMap(path, OP::READ), "token_parentpath");
+}
+
+TEST_F(TokenMapTest, ExpiredSETokenEvicted)
+{
+    const char* path = "davs://example.cern.ch:443/path/subpath/file";
+    TokenCache& cache = httpData->token_cache;
+
+    // Still in the credential map, so still known as expired
+    storeSEToken(path, "token_expired", OP::READ, 0);
+    ASSERT_EQ(TokenCache::State::EXPIRED, cache.state("token_expired", 0));
+    ASSERT_EQ(1u, httpData->token_map.count("token_expired"));
+
+    // Replaced, it is forgotten
+    storeSEToken(path, "token_path", OP::READ, 180);
+    ASSERT_EQ(TokenCache::State::UNKNOWN, cache.state("token_expired", 0));
+    ASSERT_EQ(0u, httpData->token_map.count("token_expired"));
+    ASSERT_EQ(TokenCache::State::VALID, cache.state("token_path", 0));
+    ASSERT_EQ(1u, httpData->token_map.count("token_path"));
+}
+
+TEST(TokenCacheTest, CoalesceExchanges)
+{
+    const std::string scope = "davs://example.cern.ch/path#read";
+    TokenCache cache;
+    std::atomic<int> exchanges(0);
+    std::vector<std::string> tokens(8);
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            tokens[i] = cache.exchange(scope, [&]() {
+                ++exchanges;
+                // Complete only once all the other threads wait for this exchange
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+                while (cache.exchange_waiters(scope) < (int)tokens.size() - 1 &&
+                       std::chrono::steady_clock::now() < deadline) {
+                    std::this_thread::yield();
+                }
+                return std::string("token");
+            });
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(1, exchanges.load());
+    for (auto& token : tokens) {
+        ASSERT_EQ(token, "token");
+    }
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct LogCollector {
+    std::mutex lock;
+    std::vector<std::string> messages;
+    std::vector<GLogLevelFlags> levels;
+    std::atomic<bool> blocked;
+    std::atomic<bool> block;
+
+    LogCollector(): blocked(false), block(false) {}
+};
+
+
+static void collect_handler(const gchar*, GLogLevelFlags level, const gchar* message, gpointer user_data)
+{
+    LogCollector* collector = static_cast<LogCollector*>(user_data);
+    while (collector->block) {
+        collector->blocked = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::lock_guard<std::mutex> guard(collector->lock);
+    collector->messages.push_back(message);
+    collector->levels.push_back(static_cast<GLogLevelFlags>(level & G_LOG_LEVEL_MASK));
+}
+
+
+class AsyncLoggerTest: public testing::Test {
+protected:
+    LogCollector collector;
+    guint handler;
+
+    virtual void SetUp() {
+        gfal2_log_set_level(G_LOG_LEVEL_DEBUG);
+        handler = gfal2_log_set_handler(collect_handler, &collector);
+    }
+
+    virtual void TearDown() {
+        gfal2_log_set_async(FALSE, 0);
+        g_log_remove_handler("GFAL2", handler);
+        gfal2_log_set_level(G_LOG_LEVEL_WARNING);
+    }
+};
+
+
+TEST_F(AsyncLoggerTest, orderPerThread)
+{
+    const int nthreads = 4, nmessages = 1000;
+
+    gfal2_log_set_async(TRUE, 0);
+    EXPECT_TRUE(gfal2_log_get_async());
+    guint64 dropped = gfal2_log_get_dropped();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < nmessages; ++i) {
+                gfal2_log(G_LOG_LEVEL_DEBUG, "%d %d", t, i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    gfal2_log_flush();
+
+    EXPECT_EQ(dropped, gfal2_log_get_dropped());
+    std::lock_guard<std::mutex> guard(collector.lock);
+    ASSERT_EQ(static_cast<size_t>(nthreads * nmessages), collector.messages.size());
+
+    std::vector<int> last(nthreads, -1);
+    for (auto& message : collector.messages) {
+        int t, i;
+        ASSERT_EQ(2, sscanf(message.c_str(), "%d %d", &t, &i));
+        EXPECT_EQ(last[t] + 1, i);
+        last[t] = i;
+    }
+}
+
+
+TEST_F(AsyncLoggerTest, criticalIsSynchronous)
+{
+    gfal2_log_set_async(TRUE, 0);
+    for (int i = 0; i < 10; ++i) {
+        gfal2_log(G_LOG_LEVEL_INFO, "queued %d", i);
+    }
+    gfal2_log(G_LOG_LEVEL_CRITICAL, "critical");
+
+    // Logged after the queued ones, and without flushing
+    std::lock_guard<std::mutex> guard(collector.lock);
+    ASSERT_EQ(11u, collector.messages.size());
+    EXPECT_EQ("critical", collector.messages.back());
+    EXPECT_EQ(G_LOG_LEVEL_CRITICAL, collector.levels.back());
+}
+
+
+TEST_F(AsyncLoggerTest, budget)
+{
+    gfal2_log_set_async(TRUE, 512);
+    guint64 dropped = gfal2_log_get_dropped();
+
+    // Stall the writer in the handler
+    collector.block = true;
+    gfal2_log(G_LOG_LEVEL_MESSAGE, "blocking");
+    while (!collector.blocked) {
+        std::this_thread::yield();
+    }
+
+    const int nmessages = 100;
+    for (int i = 0; i < nmessages; ++i) {
+        gfal2_log(G_LOG_LEVEL_MESSAGE, "a message long enough to exhaust the budget quickly %d", i);
+    }
+    collector.block = false;
+    gfal2_log_flush();
+
+    guint64 now_dropped = gfal2_log_get_dropped() - dropped;
+    EXPECT_GT(now_dropped, 0u);
+
+    std::lock_guard<std::mutex> guard(collector.lock);
+    size_t received = 0;
+    for (auto& message : collector.messages) {
+        if (message.find("exhaust") != std::string::npos) {
+            ++received;
+        }
+    }
+    EXPECT_GT(received, 0u);
+    EXPECT_EQ(static_cast<guint64>(nmessages), received + now_dropped);
+}
+
+
+TEST_F(AsyncLoggerTest, synchronousWhenDisabled)
+{
+    EXPECT_FALSE(gfal2_log_get_async());
+    gfal2_log(G_LOG_LEVEL_DEBUG, "synchronous");
+    std::lock_guard<std::mutex> guard(collector.lock);
+    ASSERT_EQ(1u, collector.messages.size());
+    EXPECT_EQ("synchronous", collector.messages.front());
+}
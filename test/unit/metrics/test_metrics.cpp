@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_plugins_api.h>
+#include <common/gfal_metrics_internal.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <cstring>
+#include <string>
+
+
+static const char* metrics_plugin_name()
+{
+    return "METRICS-PLUGIN";
+}
+
+
+static gboolean metrics_plugin_check_url(plugin_handle, const char* url, plugin_mode, GError**)
+{
+    return strncmp(url, "metrics://", 10) == 0;
+}
+
+
+// Fail the urls ending with "fail", take 3 ms for those ending with "slow"
+static int metrics_plugin_stat(plugin_handle, const char* url, struct stat* buf, GError** err)
+{
+    if (g_str_has_suffix(url, "slow")) {
+        usleep(3000);
+    }
+    if (g_str_has_suffix(url, "fail")) {
+        gfal2_set_error(err, g_quark_from_static_string("test"), ENOENT, __func__, "%s", url);
+        return -1;
+    }
+    memset(buf, 0, sizeof(*buf));
+    return 0;
+}
+
+
+static gfal2_context_t create_context()
+{
+    gfal_plugin_interface plugin;
+    memset(&plugin, 0, sizeof(plugin));
+    plugin.getName = metrics_plugin_name;
+    plugin.check_plugin_url = metrics_plugin_check_url;
+    plugin.statG = metrics_plugin_stat;
+
+    gfal2_context_t context = gfal2_context_new(NULL);
+    gfal2_register_plugin(context, &plugin, NULL);
+    return context;
+}
+
+
+TEST(gfalMetrics, buckets)
+{
+    for (gint64 value = 0; value < 100000; value += 7) {
+        guint index = gfal_metrics_bucket_index(value);
+        EXPECT_LE(gfal_metrics_bucket_lower_bound(index), value);
+        EXPECT_GT(gfal_metrics_bucket_lower_bound(index + 1), value);
+        // Relative error within 1/8
+        EXPECT_LE(value - gfal_metrics_bucket_lower_bound(index), value / 8);
+    }
+    EXPECT_EQ(gfal_metrics_bucket_index(G_MAXINT64), gfal_metrics_bucket_index(G_MAXINT64 / 2));
+}
+
+
+TEST(gfalMetrics, dispatchIsAccounted)
+{
+    gfal2_context_t context = create_context();
+    struct stat buf;
+    GError* error = NULL;
+
+    EXPECT_EQ(0, gfal2_stat(context, "metrics://host/file", &buf, &error));
+    EXPECT_EQ(0, gfal2_stat(context, "metrics://host/other", &buf, &error));
+    EXPECT_EQ(-1, gfal2_stat(context, "metrics://host/fail", &buf, &error));
+    g_clear_error(&error);
+
+    gchar* json = gfal2_metrics_snapshot(context, GFAL_METRICS_JSON, &error);
+    ASSERT_TRUE(json != NULL);
+    EXPECT_TRUE(strstr(json, "\"plugin\": \"METRICS-PLUGIN\", \"operation\": \"stat\", "
+        "\"count\": 3, \"errors\": 1") != NULL) << json;
+    g_free(json);
+
+    gfal2_metrics_reset(context);
+    json = gfal2_metrics_snapshot(context, GFAL_METRICS_JSON, &error);
+    EXPECT_TRUE(strstr(json, "\"count\": 0, \"errors\": 0") != NULL) << json;
+    g_free(json);
+
+    gfal2_context_free(context);
+}
+
+
+TEST(gfalMetrics, caches)
+{
+    gfal2_context_t context = create_context();
+    GError* error = NULL;
+
+    gfal_metrics_cache_t cache = gfal2_metrics_register_cache(context, "test_cache");
+    ASSERT_TRUE(cache != NULL);
+    EXPECT_EQ(cache, gfal2_metrics_register_cache(context, "test_cache"));
+
+    gfal2_metrics_cache_lookup(cache, TRUE);
+    gfal2_metrics_cache_lookup(cache, TRUE);
+    gfal2_metrics_cache_lookup(cache, FALSE);
+    gfal2_metrics_cache_lookup(NULL, TRUE);
+
+    gchar* json = gfal2_metrics_snapshot(context, GFAL_METRICS_JSON, &error);
+    EXPECT_TRUE(strstr(json, "{\"name\": \"test_cache\", \"hits\": 2, \"misses\": 1}") != NULL) << json;
+    g_free(json);
+
+    gchar* text = gfal2_metrics_snapshot(context, GFAL_METRICS_PROMETHEUS, &error);
+    ASSERT_TRUE(text != NULL);
+    EXPECT_TRUE(strstr(text, "gfal2_cache_hits_total{cache=\"test_cache\"} 2\n") != NULL) << text;
+    EXPECT_TRUE(strstr(text, "gfal2_cache_misses_total{cache=\"test_cache\"} 1\n") != NULL) << text;
+    g_free(text);
+
+    gfal2_context_free(context);
+}
+
+
+TEST(gfalMetrics, prometheusHistogram)
+{
+    gfal2_context_t context = create_context();
+    struct stat buf;
+    GError* error = NULL;
+
+    gfal2_stat(context, "metrics://host/file", &buf, &error);
+
+    gchar* text = gfal2_metrics_snapshot(context, GFAL_METRICS_PROMETHEUS, &error);
+    ASSERT_TRUE(text != NULL);
+    std::string labels = "{plugin=\"METRICS-PLUGIN\",operation=\"stat\"";
+    EXPECT_TRUE(strstr(text, ("gfal2_operations_total" + labels + "} 1\n").c_str()) != NULL) << text;
+    EXPECT_TRUE(strstr(text, ("gfal2_operation_duration_seconds_bucket" + labels + ",le=\"+Inf\"} 1\n").c_str()) != NULL) << text;
+    EXPECT_TRUE(strstr(text, ("gfal2_operation_duration_seconds_count" + labels + "} 1\n").c_str()) != NULL) << text;
+    g_free(text);
+
+    // Between 2048 and 4095 us
+    gfal2_stat(context, "metrics://host/slow", &buf, &error);
+
+    text = gfal2_metrics_snapshot(context, GFAL_METRICS_PROMETHEUS, &error);
+    ASSERT_TRUE(text != NULL);
+    std::string bucket = "gfal2_operation_duration_seconds_bucket" + labels;
+    EXPECT_TRUE(strstr(text, (bucket + ",le=\"0.000000\"} ").c_str()) != NULL) << text;
+    EXPECT_TRUE(strstr(text, (bucket + ",le=\"0.002047\"} 1\n").c_str()) != NULL) << text;
+    EXPECT_TRUE(strstr(text, (bucket + ",le=\"0.004095\"} 2\n").c_str()) != NULL) << text;
+    EXPECT_TRUE(strstr(text, (bucket + ",le=\"1.048575\"} 2\n").c_str()) != NULL) << text;
+    EXPECT_TRUE(strstr(text, ("gfal2_operation_duration_seconds_sum" + labels + "} 0.00").c_str()) != NULL) << text;
+    g_free(text);
+
+    EXPECT_EQ(NULL, gfal2_metrics_snapshot(context, (gfal_metrics_format_t)42, &error));
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(EINVAL, error->code);
+    g_error_free(error);
+
+    gfal2_context_free(context);
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Expected values computed independently, from splitmix64 with seed 42
+#define SEEDED_URL "mock://host/file?seed=42&size=100000"
+
+
+static std::string to_hex(const std::vector<char>& data, size_t offset, size_t count)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (size_t i = offset; i < offset + count; ++i) {
+        hex += digits[(data[i] >> 4) & 0x0F];
+        hex += digits[data[i] & 0x0F];
+    }
+    return hex;
+}
+
+
+class MockTest: public testing::Test {
+protected:
+    gfal2_context_t context;
+
+    virtual void SetUp() {
+        GError* error = NULL;
+        context = gfal2_context_new(&error);
+        ASSERT_TRUE(context != NULL);
+
+        struct stat st;
+        ASSERT_EQ(0, gfal2_stat(context, "mock://host/probe?size=1", &st, &error))
+            << "The mock plugin is not available: " << (error ? error->message : "");
+    }
+
+    virtual void TearDown() {
+        gfal2_context_free(context);
+    }
+
+    std::string checksum(const char* url, const char* type, off_t offset, size_t length) {
+        char buffer[64] = {0};
+        GError* error = NULL;
+        int ret = gfal2_checksum(context, url, type, offset, length, buffer, sizeof(buffer), &error);
+        EXPECT_EQ(0, ret) << (error ? error->message : "");
+        g_clear_error(&error);
+        return buffer;
+    }
+};
+
+
+TEST_F(MockTest, seededContent)
+{
+    GError* error = NULL;
+    int fd = gfal2_open(context, SEEDED_URL, O_RDONLY, &error);
+    ASSERT_GE(fd, 0) << (error ? error->message : "");
+
+    // Odd sized reads, so the words are split at every possible position
+    std::vector<char> content(100000);
+    size_t total = 0;
+    ssize_t ret;
+    while ((ret = gfal2_read(context, fd, content.data() + total, std::min<size_t>(777, content.size() - total),
+            &error)) > 0) {
+        total += ret;
+    }
+    EXPECT_EQ(0, ret) << (error ? error->message : "");
+    EXPECT_EQ(content.size(), total);
+    EXPECT_EQ(0, gfal2_close(context, fd, &error));
+
+    EXPECT_EQ("956eeb2f2632d7bd03f166b233e3ef28", to_hex(content, 0, 16));
+    EXPECT_EQ("ec9637fcac5d84f5", to_hex(content, 12345, 8));
+}
+
+
+TEST_F(MockTest, seededChecksums)
+{
+    EXPECT_EQ("5a671d50", checksum(SEEDED_URL, "ADLER32", 0, 0));
+    EXPECT_EQ("1298551404", checksum(SEEDED_URL, "CRC32", 0, 0));
+    EXPECT_EQ("87e4c0879e27420a2f4d6c544c2eed15", checksum(SEEDED_URL, "MD5", 0, 0));
+
+    // Of a range
+    EXPECT_EQ("c6a7a8ce", checksum(SEEDED_URL, "ADLER32", 1000, 5000));
+    EXPECT_EQ("1780011214", checksum(SEEDED_URL, "CRC32", 1000, 5000));
+    EXPECT_EQ("e35363a36ae4c0f0f6f64d3487c2aeaf", checksum(SEEDED_URL, "MD5", 1000, 5000));
+
+    // An explicit checksum wins
+    EXPECT_EQ("0a0b0c0d", checksum(SEEDED_URL "&checksum=0a0b0c0d", "ADLER32", 0, 0));
+}
+
+
+TEST_F(MockTest, maxConnectionsBlocks)
+{
+    GError* error = NULL;
+    const char* url = "mock://limited/file?size=10&max_connections=1";
+
+    // An open file holds its connection until closed
+    int fd = gfal2_open(context, url, O_RDONLY, &error);
+    ASSERT_GE(fd, 0) << (error ? error->message : "");
+
+    std::atomic<bool> opened(false);
+    std::thread other([&]() {
+        GError* other_error = NULL;
+        int other_fd = gfal2_open(context, url, O_RDONLY, &other_error);
+        EXPECT_GE(other_fd, 0);
+        opened = true;
+        gfal2_close(context, other_fd, &other_error);
+        g_clear_error(&other_error);
+    });
+
+    usleep(300000);
+    EXPECT_FALSE(opened.load());
+
+    // Other hosts are not limited
+    int unrelated = gfal2_open(context, "mock://other/file?size=10&max_connections=1", O_RDONLY, &error);
+    EXPECT_GE(unrelated, 0);
+    gfal2_close(context, unrelated, &error);
+
+    EXPECT_EQ(0, gfal2_close(context, fd, &error));
+    other.join();
+    EXPECT_TRUE(opened.load());
+}
+
+
+TEST_F(MockTest, syntheticReaddir)
+{
+    GError* error = NULL;
+    DIR* dir = gfal2_opendir(context, "mock://host/dir?entries=2500&entry_dirs=10&entry_size=42", &error);
+    ASSERT_TRUE(dir != NULL) << (error ? error->message : "");
+
+    struct stat st;
+    struct dirent* entry;
+    int count = 0, dirs = 0;
+    while ((entry = gfal2_readdirpp(context, dir, &st, &error)) != NULL) {
+        if (S_ISDIR(st.st_mode)) {
+            ++dirs;
+            EXPECT_EQ(0, strncmp(entry->d_name, "dir", 3)) << entry->d_name;
+        }
+        else {
+            EXPECT_TRUE(S_ISREG(st.st_mode));
+            EXPECT_EQ(42, st.st_size);
+        }
+        ++count;
+    }
+    EXPECT_TRUE(error == NULL);
+    EXPECT_EQ(2500, count);
+    EXPECT_EQ(10, dirs);
+    EXPECT_EQ(0, gfal2_closedir(context, dir, &error));
+}
+
+
+TEST_F(MockTest, exactKeyMatch)
+{
+    GError* error = NULL;
+    struct stat st;
+
+    // "entry_size" and "size_pre" are not "size"
+    ASSERT_EQ(0, gfal2_stat(context, "mock://host/file?entry_size=5&size_pre=6", &st, &error));
+    EXPECT_EQ(0, st.st_size);
+
+    ASSERT_EQ(0, gfal2_stat(context, "mock://host/file?entry_size=5&size=7&size_pre=6", &st, &error));
+    EXPECT_EQ(7, st.st_size);
+
+    // Nor is "sizes"
+    ASSERT_EQ(0, gfal2_stat(context, "mock://host/file?sizes=8", &st, &error));
+    EXPECT_EQ(0, st.st_size);
+}
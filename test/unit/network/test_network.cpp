@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) CERN 2022
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <utils/network/gfal2_network.h>
+#include <gtest/gtest.h>
+
+
+TEST(gfalNetwork, resolveAddress)
+{
+    gfal2_resolve_dns_clear_cache();
+
+    gboolean got_ipv6 = TRUE;
+    char* address = gfal2_resolve_dns_to_address(NULL, "127.0.0.1", FALSE, &got_ipv6);
+    ASSERT_TRUE(address != NULL);
+    EXPECT_STREQ("127.0.0.1", address);
+    EXPECT_FALSE(got_ipv6);
+    g_free(address);
+
+    // Served from the cache
+    address = gfal2_resolve_dns_to_address(NULL, "127.0.0.1", TRUE, NULL);
+    ASSERT_TRUE(address != NULL);
+    EXPECT_STREQ("127.0.0.1", address);
+    g_free(address);
+}
+
+
+TEST(gfalNetwork, resolveIPv6Address)
+{
+    gboolean got_ipv6 = FALSE;
+    char* address = gfal2_resolve_dns_to_address(NULL, "::1", TRUE, &got_ipv6);
+    ASSERT_TRUE(address != NULL);
+    EXPECT_STREQ("[::1]", address);
+    EXPECT_TRUE(got_ipv6);
+    g_free(address);
+}
+
+
+TEST(gfalNetwork, resolveUnknown)
+{
+    EXPECT_TRUE(gfal2_resolve_dns_to_address(NULL, NULL, FALSE, NULL) == NULL);
+    EXPECT_TRUE(gfal2_resolve_dns_to_address(NULL, "does.not.exist.invalid", FALSE, NULL) == NULL);
+    EXPECT_TRUE(gfal2_resolve_dns_to_hostname(NULL, "does.not.exist.invalid") == NULL);
+}
+
+
+TEST(gfalNetwork, reportUnknownHost)
+{
+    // Must be harmless
+    gfal2_resolve_dns_report("https://unknown.host.invalid/path", FALSE, 0, 1);
+    gfal2_resolve_dns_report("not an url", TRUE, 100, 1);
+    gfal2_resolve_dns_prefetch(NULL, "not an url");
+}
+
+
+TEST(gfalNetwork, prefetchThenResolve)
+{
+    gfal2_resolve_dns_clear_cache();
+
+    // The lookup waits for the prefetch instead of resolving again
+    gfal2_resolve_dns_prefetch(NULL, "https://127.0.0.1/path");
+    char* address = gfal2_resolve_dns_to_address(NULL, "127.0.0.1", FALSE, NULL);
+    ASSERT_TRUE(address != NULL);
+    EXPECT_STREQ("127.0.0.1", address);
+    g_free(address);
+}
+
+
+TEST(gfalNetwork, failedResolutionBacksOff)
+{
+    gfal2_resolve_dns_clear_cache();
+
+    // Failures are remembered, and the next lookups fail the same way
+    EXPECT_TRUE(gfal2_resolve_dns_to_address(NULL, "does.not.exist.invalid", FALSE, NULL) == NULL);
+    gfal2_resolve_dns_prefetch(NULL, "https://does.not.exist.invalid/path");
+    EXPECT_TRUE(gfal2_resolve_dns_to_address(NULL, "does.not.exist.invalid", FALSE, NULL) == NULL);
+    EXPECT_TRUE(gfal2_resolve_dns_to_hostname(NULL, "does.not.exist.invalid") == NULL);
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Without plugins nor local transfers, every copy fails right away,
+// so the order in which they finish is the order in which they were started
+struct Completions {
+    std::mutex lock;
+    std::vector<std::string> dsts;
+    std::vector<int> codes;
+};
+
+
+static void on_done(gfalt_scheduler_t, guint64, const char*, const char* dst, const GError* error, gpointer user_data)
+{
+    Completions* completions = static_cast<Completions*>(user_data);
+    std::lock_guard<std::mutex> guard(completions->lock);
+    completions->dsts.push_back(dst);
+    completions->codes.push_back(error ? error->code : 0);
+}
+
+
+class SchedulerTest: public testing::Test {
+protected:
+    gfal2_context_t context;
+    gfalt_params_t params;
+    gfalt_scheduler_t scheduler;
+    Completions completions;
+
+    virtual void SetUp() {
+        context = gfal2_context_new(NULL);
+        params = gfalt_params_handle_new(NULL);
+        gfalt_set_local_transfer_perm(params, FALSE, NULL);
+        scheduler = gfalt_scheduler_new(context, NULL);
+        ASSERT_TRUE(scheduler != NULL);
+        ASSERT_EQ(0, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_ACTIVE, 1, NULL));
+    }
+
+    virtual void TearDown() {
+        gfalt_scheduler_free(scheduler);
+        gfalt_params_handle_delete(params, NULL);
+        gfal2_context_free(context);
+    }
+
+    void submit(const std::string& dst, const char* group, int priority = 0) {
+        GError* error = NULL;
+        guint64 id = gfalt_scheduler_submit(scheduler, params, "unknown://source/file", dst.c_str(), NULL,
+            group, priority, on_done, &completions, &error);
+        ASSERT_NE(0u, id);
+        ASSERT_TRUE(error == NULL);
+    }
+};
+
+
+TEST_F(SchedulerTest, allComplete)
+{
+    for (int i = 0; i < 10; ++i) {
+        submit("unknown://destination/" + std::to_string(i), NULL);
+    }
+
+    GError* error = NULL;
+    EXPECT_EQ(-1, gfalt_scheduler_wait(scheduler, &error));
+    ASSERT_TRUE(error != NULL);
+    g_error_free(error);
+
+    guint queued, running;
+    gfalt_scheduler_get_counts(scheduler, &queued, &running);
+    EXPECT_EQ(0u, queued);
+    EXPECT_EQ(0u, running);
+
+    std::lock_guard<std::mutex> guard(completions.lock);
+    ASSERT_EQ(10u, completions.codes.size());
+    for (int code : completions.codes) {
+        EXPECT_EQ(EPROTONOSUPPORT, code);
+    }
+}
+
+
+TEST_F(SchedulerTest, weightedGroups)
+{
+    ASSERT_EQ(0, gfalt_scheduler_set_group_weight(scheduler, "a", 2, NULL));
+
+    gfalt_scheduler_pause(scheduler);
+    for (int i = 0; i < 6; ++i) {
+        submit("unknown://destination/a", "a");
+    }
+    for (int i = 0; i < 3; ++i) {
+        submit("unknown://destination/b", "b");
+    }
+
+    guint queued;
+    gfalt_scheduler_get_counts(scheduler, &queued, NULL);
+    EXPECT_EQ(9u, queued);
+
+    gfalt_scheduler_resume(scheduler);
+    gfalt_scheduler_wait(scheduler, NULL);
+
+    std::lock_guard<std::mutex> guard(completions.lock);
+    std::string order;
+    for (auto& dst : completions.dsts) {
+        order += dst.back();
+    }
+    EXPECT_EQ("aabaabaab", order);
+}
+
+
+TEST_F(SchedulerTest, priority)
+{
+    gfalt_scheduler_pause(scheduler);
+    submit("unknown://destination/low", NULL, 0);
+    submit("unknown://destination/high", NULL, 10);
+    submit("unknown://destination/medium", NULL, 5);
+    submit("unknown://destination/medium2", NULL, 5);
+    gfalt_scheduler_resume(scheduler);
+    gfalt_scheduler_wait(scheduler, NULL);
+
+    std::lock_guard<std::mutex> guard(completions.lock);
+    std::vector<std::string> expected = {
+        "unknown://destination/high", "unknown://destination/medium",
+        "unknown://destination/medium2", "unknown://destination/low"
+    };
+    EXPECT_EQ(expected, completions.dsts);
+}
+
+
+TEST_F(SchedulerTest, freeCancelsQueued)
+{
+    gfalt_scheduler_pause(scheduler);
+    for (int i = 0; i < 3; ++i) {
+        submit("unknown://destination/" + std::to_string(i), NULL);
+    }
+    EXPECT_EQ(0, gfalt_scheduler_wait(scheduler, NULL));
+
+    gfalt_scheduler_free(scheduler);
+    scheduler = NULL;
+
+    std::lock_guard<std::mutex> guard(completions.lock);
+    ASSERT_EQ(3u, completions.codes.size());
+    for (int code : completions.codes) {
+        EXPECT_EQ(ECANCELED, code);
+    }
+}
+
+
+TEST_F(SchedulerTest, invalidLimits)
+{
+    GError* error = NULL;
+    EXPECT_EQ(-1, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_ACTIVE, 0, &error));
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(EINVAL, error->code);
+    g_clear_error(&error);
+
+    EXPECT_EQ(-1, gfalt_scheduler_set_group_weight(scheduler, "a", 0, &error));
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(EINVAL, error->code);
+    g_clear_error(&error);
+
+    EXPECT_EQ(0, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_PER_LINK, 0, NULL));
+}
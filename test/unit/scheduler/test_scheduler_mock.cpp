@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gtest/gtest.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Native bulk copies of the mock plugin announce how many files they got
+struct BulkTracker {
+    std::mutex lock;
+    std::vector<std::string> bulks;
+    int failed;
+
+    BulkTracker(): failed(0) {}
+};
+
+
+static void on_event(const gfalt_event_t e, gpointer user_data)
+{
+    BulkTracker* tracker = static_cast<BulkTracker*>(user_data);
+    const char* description = gfalt_event_get_description(e);
+    if (e->stage == GFAL_EVENT_TRANSFER_ENTER && description && strncmp(description, "Mock bulk", 9) == 0) {
+        std::lock_guard<std::mutex> guard(tracker->lock);
+        tracker->bulks.push_back(description);
+    }
+}
+
+
+static void on_done(gfalt_scheduler_t, guint64, const char*, const char*, const GError* error, gpointer user_data)
+{
+    BulkTracker* tracker = static_cast<BulkTracker*>(user_data);
+    if (error) {
+        std::lock_guard<std::mutex> guard(tracker->lock);
+        ++tracker->failed;
+    }
+}
+
+
+class SchedulerMockTest: public testing::Test {
+protected:
+    gfal2_context_t context;
+    gfalt_params_t params;
+    gfalt_scheduler_t scheduler;
+    BulkTracker tracker;
+
+    virtual void SetUp() {
+        GError* error = NULL;
+        context = gfal2_context_new(&error);
+        ASSERT_TRUE(context != NULL);
+
+        struct stat st;
+        ASSERT_EQ(0, gfal2_stat(context, "mock://host/probe?size=1", &st, &error))
+            << "The mock plugin is not available: " << (error ? error->message : "");
+
+        params = gfalt_params_handle_new(NULL);
+        gfalt_add_event_callback(params, on_event, &tracker, NULL, NULL);
+
+        scheduler = gfalt_scheduler_new(context, NULL);
+        ASSERT_TRUE(scheduler != NULL);
+        // Only the limit under test applies
+        ASSERT_EQ(0, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_ACTIVE, 8, NULL));
+        ASSERT_EQ(0, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_PER_SOURCE, 0, NULL));
+        ASSERT_EQ(0, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_PER_DESTINATION, 0, NULL));
+        ASSERT_EQ(0, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_PER_LINK, 0, NULL));
+    }
+
+    virtual void TearDown() {
+        gfalt_scheduler_free(scheduler);
+        gfalt_params_handle_delete(params, NULL);
+        gfal2_context_free(context);
+    }
+
+    void submit(gfalt_params_t p, const std::string& src, const std::string& dst) {
+        GError* error = NULL;
+        guint64 id = gfalt_scheduler_submit(scheduler, p, src.c_str(), dst.c_str(), NULL,
+            NULL, 0, on_done, &tracker, &error);
+        ASSERT_NE(0u, id);
+        ASSERT_TRUE(error == NULL);
+    }
+
+    // Resume, and return the most copies seen running at the same time
+    guint run() {
+        guint queued, running, max_running = 0;
+        gfalt_scheduler_resume(scheduler);
+        do {
+            usleep(10000);
+            gfalt_scheduler_get_counts(scheduler, &queued, &running);
+            max_running = std::max(max_running, running);
+        } while (queued + running > 0);
+        EXPECT_EQ(0, gfalt_scheduler_wait(scheduler, NULL));
+        return max_running;
+    }
+};
+
+
+TEST_F(SchedulerMockTest, perSourceLimit)
+{
+    ASSERT_EQ(0, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_PER_SOURCE, 2, NULL));
+
+    gfalt_scheduler_pause(scheduler);
+    for (int i = 0; i < 6; ++i) {
+        std::string n = std::to_string(i);
+        submit(params, "mock://source/file" + n + "?size=10",
+            "mock://destination" + n + "/file?time=0&latency=200000");
+    }
+    EXPECT_EQ(2u, run());
+}
+
+
+TEST_F(SchedulerMockTest, perDestinationLimit)
+{
+    ASSERT_EQ(0, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_PER_DESTINATION, 3, NULL));
+
+    gfalt_scheduler_pause(scheduler);
+    for (int i = 0; i < 6; ++i) {
+        std::string n = std::to_string(i);
+        submit(params, "mock://source" + n + "/file?size=10",
+            "mock://destination/file" + n + "?time=0&latency=200000");
+    }
+    EXPECT_EQ(3u, run());
+}
+
+
+TEST_F(SchedulerMockTest, perLinkLimit)
+{
+    ASSERT_EQ(0, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_PER_LINK, 1, NULL));
+
+    // Two links into the same destination, one copy at a time over each
+    gfalt_scheduler_pause(scheduler);
+    for (int i = 0; i < 6; ++i) {
+        std::string n = std::to_string(i);
+        submit(params, "mock://source" + std::to_string(i % 2) + "/file" + n + "?size=10",
+            "mock://destination/file" + n + "?time=0&latency=200000");
+    }
+    gint64 start = g_get_monotonic_time();
+    EXPECT_EQ(2u, run());
+    EXPECT_GE(g_get_monotonic_time() - start, 600000);
+}
+
+
+TEST_F(SchedulerMockTest, bulkEqualParams)
+{
+    gfalt_params_t other = gfalt_params_handle_new(NULL);
+    gfalt_add_event_callback(other, on_event, &tracker, NULL, NULL);
+
+    // Different handles with the same contents
+    gfalt_scheduler_pause(scheduler);
+    for (int i = 0; i < 6; ++i) {
+        std::string n = std::to_string(i);
+        submit(i < 3 ? params : other, "mock://source/file" + n + "?size=10&bulk=1",
+            "mock://destination/file" + n + "?time=0");
+    }
+    run();
+    gfalt_params_handle_delete(other, NULL);
+
+    std::lock_guard<std::mutex> guard(tracker.lock);
+    std::vector<std::string> expected = {"Mock bulk copy of 6 files"};
+    EXPECT_EQ(expected, tracker.bulks);
+    EXPECT_EQ(0, tracker.failed);
+}
+
+
+TEST_F(SchedulerMockTest, bulkChangedParams)
+{
+    // The same handle, modified in between
+    gfalt_scheduler_pause(scheduler);
+    for (int i = 0; i < 6; ++i) {
+        if (i == 3) {
+            gfalt_set_timeout(params, 60, NULL);
+        }
+        std::string n = std::to_string(i);
+        submit(params, "mock://source/file" + n + "?size=10&bulk=1",
+            "mock://destination/file" + n + "?time=0");
+    }
+    run();
+
+    std::lock_guard<std::mutex> guard(tracker.lock);
+    std::vector<std::string> expected = {"Mock bulk copy of 3 files", "Mock bulk copy of 3 files"};
+    EXPECT_EQ(expected, tracker.bulks);
+    EXPECT_EQ(0, tracker.failed);
+}
+
+
+TEST_F(SchedulerMockTest, bulkBatchLimit)
+{
+    ASSERT_EQ(0, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_ACTIVE, 6, NULL));
+    ASSERT_EQ(0, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_BATCH, 4, NULL));
+
+    gfalt_scheduler_pause(scheduler);
+    for (int i = 0; i < 6; ++i) {
+        std::string n = std::to_string(i);
+        submit(params, "mock://source/file" + n + "?size=10&bulk=1",
+            "mock://destination/file" + n + "?time=0");
+    }
+    run();
+
+    // Both batches may run at the same time
+    std::lock_guard<std::mutex> guard(tracker.lock);
+    std::sort(tracker.bulks.begin(), tracker.bulks.end());
+    std::vector<std::string> expected = {"Mock bulk copy of 2 files", "Mock bulk copy of 4 files"};
+    EXPECT_EQ(expected, tracker.bulks);
+    EXPECT_EQ(0, tracker.failed);
+}
+
+
+TEST_F(SchedulerMockTest, bulkActiveLimit)
+{
+    ASSERT_EQ(0, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_ACTIVE, 3, NULL));
+    ASSERT_EQ(0, gfalt_scheduler_set_limit(scheduler, GFALT_SCHEDULER_MAX_BATCH, 0, NULL));
+
+    // Every file of a bulk copy counts, so the second one waits for the first
+    gfalt_scheduler_pause(scheduler);
+    for (int i = 0; i < 5; ++i) {
+        std::string n = std::to_string(i);
+        submit(params, "mock://source/file" + n + "?size=10&bulk=1",
+            "mock://destination/file" + n + "?time=0");
+    }
+    run();
+
+    std::lock_guard<std::mutex> guard(tracker.lock);
+    std::vector<std::string> expected = {"Mock bulk copy of 3 files", "Mock bulk copy of 2 files"};
+    EXPECT_EQ(expected, tracker.bulks);
+    EXPECT_EQ(0, tracker.failed);
+}
+
+
+static void wait_from_callback(gfalt_scheduler_t scheduler, guint64, const char*, const char*, const GError*,
+    gpointer user_data)
+{
+    GError* error = NULL;
+    *static_cast<int*>(user_data) = gfalt_scheduler_wait(scheduler, &error) < 0 ? error->code : 0;
+    g_clear_error(&error);
+}
+
+
+TEST_F(SchedulerMockTest, waitFromCallback)
+{
+    int code = -1;
+    GError* error = NULL;
+    ASSERT_NE(0u, gfalt_scheduler_submit(scheduler, params, "mock://source/file?size=10",
+        "mock://destination/file?time=0", NULL, NULL, 0, wait_from_callback, &code, &error));
+    EXPECT_EQ(0, gfalt_scheduler_wait(scheduler, &error));
+    EXPECT_EQ(EDEADLK, code);
+}
+
+
+TEST_F(SchedulerMockTest, failuresSinceLastWait)
+{
+    gfalt_scheduler_pause(scheduler);
+    submit(params, "mock://source/file?size=10", "mock://destination/file?time=0&fail_probability=1");
+    gfalt_scheduler_resume(scheduler);
+
+    GError* error = NULL;
+    EXPECT_EQ(-1, gfalt_scheduler_wait(scheduler, &error));
+    ASSERT_TRUE(error != NULL);
+    g_clear_error(&error);
+
+    // The earlier failure is not reported again
+    submit(params, "mock://source/file?size=10", "mock://destination/file?time=0");
+    EXPECT_EQ(0, gfalt_scheduler_wait(scheduler, &error));
+    EXPECT_TRUE(error == NULL);
+}
@@ -0,0 +1,467 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gfal_plugins_api.h>
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+#include <uri/gfal2_uri.h>
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "gfal_sftp_plugin.h"
+
+gfal_plugin_interface gfal_plugin_init(gfal2_context_t context, GError **err);
+}
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Forwards the connections to the SSH server, and can stop doing so at any point
+// to emulate a remote that stalls with requests in flight
+class SftpProxy {
+public:
+    SftpProxy(const std::string& host, int port): host(host), port(port), frozen(false), stop(false)
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        bind(listener, (struct sockaddr*)&addr, sizeof(addr));
+        listen(listener, 16);
+
+        socklen_t len = sizeof(addr);
+        getsockname(listener, (struct sockaddr*)&addr, &len);
+        local_port = ntohs(addr.sin_port);
+
+        acceptor = std::thread(&SftpProxy::accept_loop, this);
+    }
+
+    ~SftpProxy()
+    {
+        stop = true;
+        shutdown(listener, SHUT_RDWR);
+        acceptor.join();
+        for (auto& pump : pumps) {
+            pump.join();
+        }
+        close(listener);
+    }
+
+    int get_port() const
+    {
+        return local_port;
+    }
+
+    void freeze(bool value)
+    {
+        frozen = value;
+    }
+
+private:
+    std::string host;
+    int port, local_port;
+    int listener;
+    std::atomic<bool> frozen, stop;
+    std::thread acceptor;
+    std::mutex mutex;
+    std::vector<std::thread> pumps;
+
+    int connect_server()
+    {
+        struct addrinfo hints, *addresses = NULL;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = PF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+            return -1;
+        }
+        int sock = -1;
+        for (struct addrinfo *i = addresses; i != NULL && sock < 0; i = i->ai_next) {
+            sock = socket(i->ai_family, i->ai_socktype, i->ai_protocol);
+            if (sock >= 0 && connect(sock, i->ai_addr, i->ai_addrlen) < 0) {
+                close(sock);
+                sock = -1;
+            }
+        }
+        freeaddrinfo(addresses);
+        return sock;
+    }
+
+    void accept_loop()
+    {
+        while (!stop) {
+            int client = accept(listener, NULL, NULL);
+            if (client < 0) {
+                break;
+            }
+            int server = connect_server();
+            if (server < 0) {
+                close(client);
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            pumps.emplace_back(&SftpProxy::pump, this, client, server);
+        }
+    }
+
+    static bool send_all(int fd, const char *buffer, ssize_t size)
+    {
+        while (size > 0) {
+            ssize_t sent = send(fd, buffer, size, MSG_NOSIGNAL);
+            if (sent <= 0) {
+                return false;
+            }
+            buffer += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    void pump(int client, int server)
+    {
+        struct pollfd fds[2];
+        fds[0].fd = client;
+        fds[1].fd = server;
+        char buffer[65536];
+        bool closed = false;
+
+        while (!stop && !closed) {
+            if (frozen) {
+                usleep(10000);
+                continue;
+            }
+            fds[0].events = fds[1].events = POLLIN;
+            fds[0].revents = fds[1].revents = 0;
+            if (poll(fds, 2, 100) <= 0) {
+                continue;
+            }
+            for (int i = 0; i < 2 && !closed; ++i) {
+                if (fds[i].revents) {
+                    ssize_t size = recv(fds[i].fd, buffer, sizeof(buffer), 0);
+                    closed = (size <= 0 || !send_all(fds[1 - i].fd, buffer, size));
+                }
+            }
+        }
+        close(client);
+        close(server);
+    }
+};
+
+
+// Goes through the plugin entry points, with the SSH traffic passing by SftpProxy
+// GFAL2_SFTP_TEST_URL must point to a writable directory, i.e. sftp://user@localhost/tmp
+class SftpIoTest: public testing::Test {
+protected:
+    static const size_t FILE_SIZE = 4 * 1024 * 1024;
+
+    SftpProxy *proxy;
+    gfal2_context_t context;
+    gfal_plugin_interface sftp;
+    std::string base, prefix;
+    std::vector<std::string> created;
+
+    SftpIoTest(): proxy(NULL), context(NULL)
+    {
+        memset(&sftp, 0, sizeof(sftp));
+    }
+
+    virtual void SetUp()
+    {
+        const char *env = getenv("GFAL2_SFTP_TEST_URL");
+        if (env == NULL) {
+            std::cout << "GFAL2_SFTP_TEST_URL is not set, nothing to test against" << std::endl;
+            return;
+        }
+        base = env;
+
+        GError *error = NULL;
+        gfal2_uri *parsed = gfal2_parse_uri(base.c_str(), &error);
+        ASSERT_TRUE(parsed != NULL);
+        proxy = new SftpProxy(parsed->host, parsed->port ? parsed->port : 22);
+
+        std::ostringstream url;
+        url << "sftp://";
+        if (parsed->userinfo) {
+            url << parsed->userinfo << "@";
+        }
+        url << "127.0.0.1:" << proxy->get_port() << parsed->path;
+        prefix = url.str();
+        gfal2_free_uri(parsed);
+
+        context = gfal2_context_new(&error);
+        ASSERT_TRUE(context != NULL);
+        gfal2_set_opt_integer(context, "SFTP PLUGIN", "IO_TIMEOUT", 1, NULL);
+        gfal2_set_opt_integer(context, "SFTP PLUGIN", "PIPELINE_DEPTH", 16, NULL);
+        sftp = gfal_plugin_init(context, &error);
+        ASSERT_TRUE(sftp.plugin_data != NULL);
+    }
+
+    virtual void TearDown()
+    {
+        if (sftp.plugin_data) {
+            proxy->freeze(false);
+            for (auto& url : created) {
+                sftp.unlinkG(sftp.plugin_data, url.c_str(), NULL);
+            }
+            sftp.plugin_delete(sftp.plugin_data);
+        }
+        if (context) {
+            gfal2_context_free(context);
+        }
+        delete proxy;
+    }
+
+    bool available() const
+    {
+        return sftp.plugin_data != NULL;
+    }
+
+    gfal_sftp_cache_stats_t stats()
+    {
+        gfal_sftp_cache_stats_t stats;
+        gfal_sftp_cache_get_stats(((gfal_sftp_context_t*)sftp.plugin_data)->cache, &stats);
+        return stats;
+    }
+
+    std::string put(const char *name)
+    {
+        GError *error = NULL;
+        std::string url = prefix + "/gfal2_test_sftp_io_" + name;
+        std::string content(FILE_SIZE, 0);
+        for (size_t i = 0; i < content.size(); ++i) {
+            content[i] = static_cast<char>(i % 251);
+        }
+
+        gfal_file_handle fd = sftp.openG(sftp.plugin_data, url.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644, &error);
+        EXPECT_TRUE(fd != NULL) << (error ? error->message : "");
+        if (fd) {
+            created.push_back(url);
+            EXPECT_EQ((ssize_t)content.size(), sftp.writeG(sftp.plugin_data, fd, content.data(), content.size(), &error));
+            EXPECT_EQ(0, sftp.closeG(sftp.plugin_data, fd, &error));
+        }
+        g_clear_error(&error);
+        return url;
+    }
+};
+
+
+TEST_F(SftpIoTest, readTimeoutDiscardsConnection)
+{
+    if (!available()) {
+        return;
+    }
+    GError *error = NULL;
+    std::string url = put("read");
+
+    gfal_file_handle fd = sftp.openG(sftp.plugin_data, url.c_str(), O_RDONLY, 0, &error);
+    ASSERT_TRUE(fd != NULL) << error->message;
+    std::vector<char> buffer(FILE_SIZE);
+    ASSERT_EQ(65536, sftp.readG(sftp.plugin_data, fd, buffer.data(), 65536, &error));
+    EXPECT_EQ(0, buffer[0]);
+    EXPECT_EQ(static_cast<char>(65535 % 251), buffer[65535]);
+
+    proxy->freeze(true);
+    EXPECT_EQ(-1, sftp.readG(sftp.plugin_data, fd, buffer.data(), buffer.size(), &error));
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(ETIMEDOUT, error->code);
+    g_clear_error(&error);
+
+    // The replies still in flight arrive now, and must not be taken for the answer of anything else
+    proxy->freeze(false);
+    EXPECT_EQ(-1, sftp.readG(sftp.plugin_data, fd, buffer.data(), 1024, &error));
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(EIO, error->code);
+    g_clear_error(&error);
+    EXPECT_EQ(-1, sftp.preadG(sftp.plugin_data, fd, buffer.data(), 1024, 0, &error));
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(EIO, error->code);
+    g_clear_error(&error);
+
+    guint64 misses = stats().misses;
+    EXPECT_EQ(0, sftp.closeG(sftp.plugin_data, fd, &error));
+    EXPECT_EQ(1u, stats().discarded);
+
+    // The connection did not go back to the pool, a new one is used
+    struct stat st;
+    EXPECT_EQ(0, sftp.statG(sftp.plugin_data, url.c_str(), &st, &error));
+    EXPECT_EQ(FILE_SIZE, (size_t)st.st_size);
+    EXPECT_EQ(misses + 1, stats().misses);
+}
+
+
+TEST_F(SftpIoTest, writeTimeoutDiscardsConnection)
+{
+    if (!available()) {
+        return;
+    }
+    GError *error = NULL;
+    std::string url = put("write");
+    std::vector<char> buffer(FILE_SIZE, 'x');
+
+    gfal_file_handle fd = sftp.openG(sftp.plugin_data, url.c_str(), O_WRONLY | O_TRUNC, 0644, &error);
+    ASSERT_TRUE(fd != NULL) << error->message;
+    ASSERT_EQ(65536, sftp.writeG(sftp.plugin_data, fd, buffer.data(), 65536, &error));
+
+    proxy->freeze(true);
+    EXPECT_EQ(-1, sftp.writeG(sftp.plugin_data, fd, buffer.data(), buffer.size(), &error));
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(ETIMEDOUT, error->code);
+    g_clear_error(&error);
+
+    proxy->freeze(false);
+    EXPECT_EQ(-1, sftp.pwriteG(sftp.plugin_data, fd, buffer.data(), 1024, 0, &error));
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(EIO, error->code);
+    g_clear_error(&error);
+    EXPECT_EQ(-1, sftp.lseekG(sftp.plugin_data, fd, 0, SEEK_END, &error));
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(EIO, error->code);
+    g_clear_error(&error);
+
+    EXPECT_EQ(0, sftp.closeG(sftp.plugin_data, fd, &error));
+    EXPECT_EQ(1u, stats().discarded);
+}
+
+
+TEST_F(SftpIoTest, deadPooledConnection)
+{
+    if (!available()) {
+        return;
+    }
+    GError *error = NULL;
+    std::string url = put("dead");
+    gfal_sftp_cache_t *cache = ((gfal_sftp_context_t*)sftp.plugin_data)->cache;
+
+    // Break the connection left in the pool, as a server dropping it would do
+    gfal_sftp_handle_t *handle = gfal_sftp_cache_pop(cache, "127.0.0.1", proxy->get_port());
+    ASSERT_TRUE(handle != NULL);
+    shutdown(handle->sock, SHUT_RDWR);
+    gfal_sftp_cache_push(cache, handle);
+
+    guint64 dead = stats().dead;
+    struct stat st;
+    EXPECT_EQ(0, sftp.statG(sftp.plugin_data, url.c_str(), &st, &error)) << (error ? error->message : "");
+    EXPECT_EQ(FILE_SIZE, (size_t)st.st_size);
+    EXPECT_EQ(dead + 1, stats().dead);
+    g_clear_error(&error);
+}
+
+
+TEST_F(SftpIoTest, pipelinedRoundtrip)
+{
+    if (!available()) {
+        return;
+    }
+    GError *error = NULL;
+    std::string url = put("roundtrip");
+
+    gfal_file_handle fd = sftp.openG(sftp.plugin_data, url.c_str(), O_RDONLY, 0, &error);
+    ASSERT_TRUE(fd != NULL) << error->message;
+
+    // pread does not move the offset used by read
+    std::vector<char> buffer(FILE_SIZE);
+    ASSERT_EQ(1000, sftp.preadG(sftp.plugin_data, fd, buffer.data(), 1000, 1000000, &error));
+    EXPECT_EQ(static_cast<char>(1000000 % 251), buffer[0]);
+    ASSERT_EQ((ssize_t)FILE_SIZE, sftp.readG(sftp.plugin_data, fd, buffer.data(), buffer.size(), &error));
+    for (size_t i = 0; i < FILE_SIZE; i += 4099) {
+        ASSERT_EQ(static_cast<char>(i % 251), buffer[i]) << "At " << i;
+    }
+    EXPECT_EQ(0, sftp.readG(sftp.plugin_data, fd, buffer.data(), buffer.size(), &error));
+
+    EXPECT_EQ(0, sftp.closeG(sftp.plugin_data, fd, &error));
+    EXPECT_EQ(0u, stats().discarded);
+}
+
+
+static void bulk_event_callback(const gfalt_event_t e, gpointer user_data)
+{
+    std::atomic<int> *inside = (std::atomic<int>*)user_data;
+    // Any other callback running at the same time is caught here
+    EXPECT_EQ(1, ++inside[0]);
+    g_usleep(1000);
+    ++inside[1];
+    --inside[0];
+}
+
+
+// Goes through gfal2 and the plugins of the build tree, not through the proxy
+TEST_F(SftpIoTest, bulkCopy)
+{
+    if (!available()) {
+        return;
+    }
+    const int nfiles = 6;
+    GError *error = NULL;
+    std::vector<std::string> sources, destinations;
+    std::vector<const char*> srcs, dsts;
+    std::string content(1024 * 1024, 'b');
+
+    for (int i = 0; i < nfiles; ++i) {
+        char local[] = "/tmp/gfal2_test_sftp_bulk_XXXXXX";
+        int fd = mkstemp(local);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ((ssize_t)content.size(), write(fd, content.data(), content.size()));
+        close(fd);
+        sources.push_back(std::string("file://") + local);
+        destinations.push_back(base + "/gfal2_test_sftp_bulk_" + std::to_string(i));
+    }
+    for (int i = 0; i < nfiles; ++i) {
+        srcs.push_back(sources[i].c_str());
+        dsts.push_back(destinations[i].c_str());
+    }
+
+    std::atomic<int> inside[2];
+    inside[0] = inside[1] = 0;
+    gfalt_params_t params = gfalt_params_handle_new(NULL);
+    gfalt_set_replace_existing_file(params, TRUE, NULL);
+    gfalt_add_event_callback(params, bulk_event_callback, inside, NULL, NULL);
+    gfal2_set_opt_integer(context, "SFTP PLUGIN", "BULK_COPY_CONCURRENCY", 3, NULL);
+
+    GError **file_errors = NULL;
+    EXPECT_EQ(0, gfalt_copy_bulk(context, params, nfiles, srcs.data(), dsts.data(), NULL, &error, &file_errors));
+    EXPECT_TRUE(error == NULL) << error->message;
+    for (int i = 0; i < nfiles; ++i) {
+        EXPECT_TRUE(file_errors[i] == NULL) << file_errors[i]->message;
+        g_clear_error(&file_errors[i]);
+
+        struct stat st;
+        EXPECT_EQ(0, gfal2_stat(context, dsts[i], &st, NULL));
+        EXPECT_EQ(content.size(), (size_t)st.st_size);
+        gfal2_unlink(context, dsts[i], NULL);
+        unlink(srcs[i] + 7);
+    }
+    g_free(file_errors);
+    g_clear_error(&error);
+    EXPECT_GT(inside[1].load(), 0);
+
+    gfalt_params_handle_delete(params, NULL);
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gfal_plugins_api.h>
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "gfal_sftp_connection.h"
+}
+
+#include <dirent.h>
+#include <unistd.h>
+#include <vector>
+
+
+// The pool only needs host and port, the rest of a handle is left unconnected
+static gfal_sftp_handle_t *fake_handle(const char *host, int port)
+{
+    gfal_sftp_handle_t *handle = g_new0(gfal_sftp_handle_t, 1);
+    handle->sock = -1;
+    handle->host = g_strdup(host);
+    handle->port = port;
+    return handle;
+}
+
+
+static int count_threads()
+{
+    int count = 0;
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir) {
+        return -1;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            ++count;
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+
+class SftpPoolTest: public testing::Test {
+protected:
+    gfal2_context_t context;
+
+    virtual void SetUp()
+    {
+        GError *error = NULL;
+        context = gfal2_context_new(&error);
+        ASSERT_TRUE(context != NULL);
+        gfal2_set_opt_integer(context, "SFTP PLUGIN", "MAX_IDLE_PER_HOST", 2, NULL);
+        gfal2_set_opt_integer(context, "SFTP PLUGIN", "IDLE_TIMEOUT", 1, NULL);
+        // Keepalives need a real session
+        gfal2_set_opt_integer(context, "SFTP PLUGIN", "KEEPALIVE_INTERVAL", 0, NULL);
+    }
+
+    virtual void TearDown()
+    {
+        gfal2_context_free(context);
+    }
+};
+
+
+TEST_F(SftpPoolTest, hitAndMiss)
+{
+    gfal_sftp_cache_t *cache = gfal_sftp_cache_new(context);
+    gfal_sftp_cache_stats_t stats;
+
+    EXPECT_TRUE(gfal_sftp_cache_pop(cache, "host", 22) == NULL);
+
+    gfal_sftp_handle_t *handle = fake_handle("host", 22);
+    gfal_sftp_cache_push(cache, handle);
+    EXPECT_TRUE(gfal_sftp_cache_pop(cache, "host", 2222) == NULL);
+    EXPECT_TRUE(gfal_sftp_cache_pop(cache, "other", 22) == NULL);
+    EXPECT_EQ(handle, gfal_sftp_cache_pop(cache, "host", 22));
+    EXPECT_TRUE(gfal_sftp_cache_pop(cache, "host", 22) == NULL);
+
+    gfal_sftp_cache_get_stats(cache, &stats);
+    EXPECT_EQ(1u, stats.hits);
+    EXPECT_EQ(4u, stats.misses);
+
+    gfal_sftp_cache_push(cache, handle);
+    gfal_sftp_cache_destroy(cache);
+}
+
+
+TEST_F(SftpPoolTest, boundedPerHost)
+{
+    gfal_sftp_cache_t *cache = gfal_sftp_cache_new(context);
+    gfal_sftp_cache_stats_t stats;
+
+    gfal_sftp_handle_t *a = fake_handle("host", 22);
+    gfal_sftp_handle_t *b = fake_handle("host", 22);
+    gfal_sftp_handle_t *c = fake_handle("host", 22);
+    gfal_sftp_handle_t *other = fake_handle("other", 22);
+    gfal_sftp_cache_push(cache, a);
+    gfal_sftp_cache_push(cache, b);
+    gfal_sftp_cache_push(cache, other);
+    // a is the least recently used, and gets closed
+    gfal_sftp_cache_push(cache, c);
+
+    gfal_sftp_cache_get_stats(cache, &stats);
+    EXPECT_EQ(1u, stats.evicted);
+
+    // Most recently used first
+    EXPECT_EQ(c, gfal_sftp_cache_pop(cache, "host", 22));
+    EXPECT_EQ(b, gfal_sftp_cache_pop(cache, "host", 22));
+    EXPECT_TRUE(gfal_sftp_cache_pop(cache, "host", 22) == NULL);
+    EXPECT_EQ(other, gfal_sftp_cache_pop(cache, "other", 22));
+
+    gfal_sftp_cache_push(cache, b);
+    gfal_sftp_cache_push(cache, c);
+    gfal_sftp_cache_push(cache, other);
+    gfal_sftp_cache_destroy(cache);
+}
+
+
+TEST_F(SftpPoolTest, idleExpire)
+{
+    gfal_sftp_cache_t *cache = gfal_sftp_cache_new(context);
+    gfal_sftp_cache_stats_t stats;
+
+    gfal_sftp_cache_push(cache, fake_handle("host", 22));
+
+    for (int i = 0; i < 50; ++i) {
+        gfal_sftp_cache_get_stats(cache, &stats);
+        if (stats.expired > 0) {
+            break;
+        }
+        usleep(100000);
+    }
+    EXPECT_EQ(1u, stats.expired);
+    EXPECT_TRUE(gfal_sftp_cache_pop(cache, "host", 22) == NULL);
+
+    gfal_sftp_cache_destroy(cache);
+}
+
+
+TEST_F(SftpPoolTest, sharedKeeper)
+{
+    const int npools = 4;
+    int before = count_threads();
+    ASSERT_GT(before, 0);
+
+    // No thread until a pool has something to look after
+    std::vector<gfal_sftp_cache_t*> caches;
+    for (int i = 0; i < npools; ++i) {
+        caches.push_back(gfal_sftp_cache_new(context));
+    }
+    EXPECT_EQ(before, count_threads());
+
+    // A single one for all of them
+    for (int i = 0; i < npools; ++i) {
+        gfal_sftp_cache_push(caches[i], fake_handle("host", 22));
+    }
+    EXPECT_EQ(before + 1, count_threads());
+
+    // Still running while a pool is left
+    for (int i = 0; i < npools - 1; ++i) {
+        gfal_sftp_cache_destroy(caches[i]);
+    }
+    EXPECT_EQ(before + 1, count_threads());
+
+    gfal_sftp_cache_destroy(caches[npools - 1]);
+    EXPECT_EQ(before, count_threads());
+
+    // And it comes back for new pools
+    gfal_sftp_cache_t *cache = gfal_sftp_cache_new(context);
+    gfal_sftp_cache_push(cache, fake_handle("host", 22));
+    EXPECT_EQ(before + 1, count_threads());
+    gfal_sftp_cache_destroy(cache);
+    EXPECT_EQ(before, count_threads());
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+static std::string span_hex(gfal2_span_t span)
+{
+    char buffer[17];
+    g_snprintf(buffer, sizeof(buffer), "%016" G_GINT64_MODIFIER "x", span);
+    return buffer;
+}
+
+
+static size_t count_occurrences(const std::string& haystack, const std::string& needle)
+{
+    size_t count = 0;
+    for (size_t pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+
+static std::string snapshot(gfal2_trace_format_t format)
+{
+    GError* error = NULL;
+    gchar* content = gfal2_trace_snapshot(format, &error);
+    EXPECT_TRUE(content != NULL);
+    std::string result(content ? content : "");
+    g_free(content);
+    return result;
+}
+
+
+class TraceTest: public testing::Test {
+protected:
+    virtual void SetUp() {
+        gfal2_trace_clear();
+        gfal2_trace_enable(0);
+    }
+
+    virtual void TearDown() {
+        gfal2_trace_disable();
+        gfal2_trace_clear();
+    }
+};
+
+
+TEST_F(TraceTest, disabled)
+{
+    gfal2_trace_disable();
+    gfal2_span_t span = gfal2_trace_begin("test", "disabled");
+    EXPECT_EQ(0u, span);
+    EXPECT_EQ(0u, gfal2_trace_current());
+    gfal2_trace_end(span);
+    EXPECT_EQ(std::string::npos, snapshot(GFAL2_TRACE_CHROME).find("disabled"));
+}
+
+
+TEST_F(TraceTest, nested)
+{
+    gfal2_span_t parent = gfal2_trace_begin("test", "parent");
+    ASSERT_NE(0u, parent);
+    EXPECT_EQ(parent, gfal2_trace_current());
+
+    gfal2_span_t child = gfal2_trace_begin("test", "child");
+    ASSERT_NE(0u, child);
+    EXPECT_NE(parent, child);
+    EXPECT_EQ(child, gfal2_trace_current());
+
+    gfal2_trace_end(child);
+    EXPECT_EQ(parent, gfal2_trace_current());
+    gfal2_trace_end(parent);
+    EXPECT_EQ(0u, gfal2_trace_current());
+
+    std::string chrome = snapshot(GFAL2_TRACE_CHROME);
+    EXPECT_NE(std::string::npos, chrome.find("\"name\": \"parent\", \"cat\": \"test\", \"ph\": \"X\"")) << chrome;
+    EXPECT_NE(std::string::npos,
+        chrome.find("\"span\": \"" + span_hex(child) + "\", \"parent\": \"" + span_hex(parent) + "\"")) << chrome;
+}
+
+
+TEST_F(TraceTest, endParentEndsChildren)
+{
+    gfal2_span_t parent = gfal2_trace_begin("test", "parent");
+    gfal2_trace_begin("test", "leaked");
+    gfal2_trace_end(parent);
+    EXPECT_EQ(0u, gfal2_trace_current());
+
+    std::string chrome = snapshot(GFAL2_TRACE_CHROME);
+    EXPECT_NE(std::string::npos, chrome.find("\"name\": \"leaked\"")) << chrome;
+}
+
+
+TEST_F(TraceTest, endByName)
+{
+    gfal2_span_t outer = gfal2_trace_begin("SOURCE", "PREPARE");
+    gfal2_trace_begin("DESTINATION", "PREPARE");
+    gfal2_trace_end_by_name("SOURCE", "TRANSFER");
+    EXPECT_NE(outer, gfal2_trace_current());
+    gfal2_trace_end_by_name("DESTINATION", "PREPARE");
+    EXPECT_EQ(outer, gfal2_trace_current());
+    gfal2_trace_end_by_name("SOURCE", "PREPARE");
+    EXPECT_EQ(0u, gfal2_trace_current());
+}
+
+
+TEST_F(TraceTest, crossThread)
+{
+    Gfal::TraceScope parent("test", "dispatcher");
+    gfal2_span_t worker_span = 0;
+
+    std::thread worker([&]() {
+        EXPECT_EQ(0u, gfal2_trace_current());
+        Gfal::TraceScope child("test", "worker", parent.id());
+        worker_span = child.id();
+    });
+    worker.join();
+
+    ASSERT_NE(0u, worker_span);
+    std::string chrome = snapshot(GFAL2_TRACE_CHROME);
+    EXPECT_NE(std::string::npos,
+        chrome.find("\"span\": \"" + span_hex(worker_span) + "\", \"parent\": \"" + span_hex(parent.id()) + "\"")) << chrome;
+}
+
+
+TEST_F(TraceTest, keyedCrossThread)
+{
+    int transfer = 0;
+    gfal2_span_t parent = gfal2_trace_begin("test", "copy");
+    gfal2_span_t keyed = gfal2_trace_begin_keyed("SOURCE", "TRANSFER", &transfer);
+    ASSERT_NE(0u, keyed);
+
+    // Not the parent of what comes after
+    EXPECT_EQ(parent, gfal2_trace_current());
+
+    std::thread other([&]() {
+        gfal2_trace_end_keyed("SOURCE", "TRANSFER", &transfer);
+    });
+    other.join();
+    gfal2_trace_end(parent);
+
+    std::string chrome = snapshot(GFAL2_TRACE_CHROME);
+    EXPECT_EQ(1u, count_occurrences(chrome, "\"name\": \"TRANSFER\"")) << chrome;
+    EXPECT_NE(std::string::npos,
+        chrome.find("\"span\": \"" + span_hex(keyed) + "\", \"parent\": \"" + span_hex(parent) + "\"")) << chrome;
+
+    // Already ended
+    gfal2_trace_end_keyed("SOURCE", "TRANSFER", &transfer);
+    EXPECT_EQ(1u, count_occurrences(snapshot(GFAL2_TRACE_CHROME), "\"name\": \"TRANSFER\""));
+}
+
+
+TEST_F(TraceTest, keyedOldestFirst)
+{
+    int transfer = 0, other = 0;
+    gfal2_span_t first = gfal2_trace_begin_keyed("SOURCE", "PREPARE", &transfer);
+    gfal2_span_t second = gfal2_trace_begin_keyed("SOURCE", "PREPARE", &transfer);
+    gfal2_span_t unrelated = gfal2_trace_begin_keyed("SOURCE", "PREPARE", &other);
+
+    gfal2_trace_end_keyed("DESTINATION", "PREPARE", &transfer);
+    gfal2_trace_end_keyed("SOURCE", "PREPARE", &transfer);
+
+    std::string chrome = snapshot(GFAL2_TRACE_CHROME);
+    EXPECT_NE(std::string::npos, chrome.find(span_hex(first))) << chrome;
+    EXPECT_EQ(std::string::npos, chrome.find(span_hex(second))) << chrome;
+    EXPECT_EQ(std::string::npos, chrome.find(span_hex(unrelated))) << chrome;
+
+    gfal2_trace_drop_keyed(&transfer);
+    gfal2_trace_end_keyed("SOURCE", "PREPARE", &transfer);
+    gfal2_trace_end_keyed("SOURCE", "PREPARE", &other);
+
+    chrome = snapshot(GFAL2_TRACE_CHROME);
+    EXPECT_EQ(std::string::npos, chrome.find(span_hex(second))) << chrome;
+    EXPECT_NE(std::string::npos, chrome.find(span_hex(unrelated))) << chrome;
+}
+
+
+TEST_F(TraceTest, keyedLeftOpen)
+{
+    // Spans never ended do not use up the nesting of the thread
+    std::vector<int> transfers(200);
+    for (size_t i = 0; i < transfers.size(); ++i) {
+        EXPECT_NE(0u, gfal2_trace_begin_keyed("SOURCE", "TRANSFER", &transfers[i]));
+    }
+    gfal2_span_t span = gfal2_trace_begin("test", "after");
+    EXPECT_NE(0u, span);
+    gfal2_trace_end(span);
+
+    for (size_t i = 0; i < transfers.size(); ++i) {
+        gfal2_trace_drop_keyed(&transfers[i]);
+    }
+}
+
+
+TEST_F(TraceTest, otlp)
+{
+    gfal2_span_t root = gfal2_trace_begin("test", "root");
+    gfal2_span_t child = gfal2_trace_begin("test", "child");
+    gfal2_trace_end(child);
+    gfal2_trace_end(root);
+
+    std::string otlp = snapshot(GFAL2_TRACE_OTLP);
+    EXPECT_NE(std::string::npos, otlp.find("\"resourceSpans\"")) << otlp;
+    EXPECT_NE(std::string::npos, otlp.find("\"parentSpanId\": \"" + span_hex(root) + "\", \"name\": \"child\"")) << otlp;
+    // Both spans belong to the trace of the root
+    EXPECT_EQ(2u, count_occurrences(otlp, span_hex(root) + "\", \"spanId\"")) << otlp;
+}
+
+
+TEST_F(TraceTest, ringOverwrite)
+{
+    gfal2_trace_enable(4);
+    for (int i = 0; i < 10; ++i) {
+        gfal2_span_t span = gfal2_trace_begin("test", "ring");
+        gfal2_trace_end(span);
+    }
+    EXPECT_EQ(4u, count_occurrences(snapshot(GFAL2_TRACE_CHROME), "\"name\": \"ring\""));
+}
+
+
+TEST_F(TraceTest, invalidFormat)
+{
+    GError* error = NULL;
+    EXPECT_EQ(NULL, gfal2_trace_snapshot((gfal2_trace_format_t)42, &error));
+    ASSERT_TRUE(error != NULL);
+    EXPECT_EQ(EINVAL, error->code);
+    g_error_free(error);
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <gfal_api.h>
+#include <transfer/gfal_transfer_internal.h>
+
+#define HALF_LIFE (3600 * G_USEC_PER_SEC)
+#define LINK "gsiftp://source:2811>gsiftp://destination:2811"
+
+static const int STREAMS_AND_TCP =
+    GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_STREAMS) | GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_TCP_BUFFER);
+
+
+// Fastest with 6 streams and a 4 MiB TCP buffer
+static double link_throughput(const gfal_autotune_ticket_t& ticket)
+{
+    double streams = ticket.values[GFAL_AUTOTUNE_STREAMS];
+    double buffer = ticket.values[GFAL_AUTOTUNE_TCP_BUFFER] / (1024.0 * 1024.0);
+    double rate = 100e6 - 15e6 * fabs(streams - 6);
+    if (buffer > 0) {
+        rate += 60e6 - 10e6 * fabs(log2(buffer / 4));
+    }
+    return rate;
+}
+
+
+static gfal_autotune_ticket_t run(gfal_autotune_t* tuner, gint64 now)
+{
+    guint64 initial[GFAL_AUTOTUNE_DIMENSIONS] = {1, 0, 4194304};
+    gfal_autotune_ticket_t ticket;
+    gfal_autotune_next(tuner, LINK, STREAMS_AND_TCP, initial, now, &ticket);
+    gfal_autotune_feedback(tuner, &ticket, link_throughput(ticket), now);
+    g_free(ticket.link);
+    return ticket;
+}
+
+
+TEST(gfalAutotune, initial)
+{
+    gfal_autotune_t* tuner = gfal_autotune_new(16, HALF_LIFE);
+    gfal_autotune_ticket_t ticket = run(tuner, 0);
+    EXPECT_EQ(1u, ticket.values[GFAL_AUTOTUNE_STREAMS]);
+    EXPECT_EQ(0u, ticket.values[GFAL_AUTOTUNE_TCP_BUFFER]);
+    EXPECT_EQ(-1, ticket.probe_dim);
+    gfal_autotune_free(tuner);
+}
+
+
+TEST(gfalAutotune, converges)
+{
+    gfal_autotune_t* tuner = gfal_autotune_new(16, HALF_LIFE);
+    gfal_autotune_ticket_t ticket;
+    for (int i = 0; i < 400; ++i) {
+        ticket = run(tuner, i * G_USEC_PER_SEC);
+    }
+    if (ticket.probe_dim >= 0) {
+        ticket = run(tuner, 400 * G_USEC_PER_SEC);
+    }
+    EXPECT_EQ(6u, ticket.values[GFAL_AUTOTUNE_STREAMS]);
+    EXPECT_EQ(4u * 1024 * 1024, ticket.values[GFAL_AUTOTUNE_TCP_BUFFER]);
+    gfal_autotune_free(tuner);
+}
+
+
+TEST(gfalAutotune, respectsMaxStreams)
+{
+    gfal_autotune_t* tuner = gfal_autotune_new(3, HALF_LIFE);
+    for (int i = 0; i < 400; ++i) {
+        gfal_autotune_ticket_t ticket = run(tuner, i * G_USEC_PER_SEC);
+        ASSERT_LE(ticket.values[GFAL_AUTOTUNE_STREAMS], 3u);
+    }
+    gfal_autotune_free(tuner);
+}
+
+
+TEST(gfalAutotune, forgets)
+{
+    gfal_autotune_t* tuner = gfal_autotune_new(16, HALF_LIFE);
+    for (int i = 0; i < 400; ++i) {
+        run(tuner, i * G_USEC_PER_SEC);
+    }
+    gfal_autotune_ticket_t ticket = run(tuner, 11 * HALF_LIFE);
+    EXPECT_EQ(1u, ticket.values[GFAL_AUTOTUNE_STREAMS]);
+    EXPECT_EQ(0u, ticket.values[GFAL_AUTOTUNE_TCP_BUFFER]);
+    gfal_autotune_free(tuner);
+}
+
+
+TEST(gfalAutotune, unknownThroughput)
+{
+    gfal_autotune_t* tuner = gfal_autotune_new(16, HALF_LIFE);
+    guint64 initial[GFAL_AUTOTUNE_DIMENSIONS] = {1, 0, 4194304};
+    // Without a measurement of the initial settings, there is nothing to compare with
+    for (int i = 0; i < 20; ++i) {
+        gfal_autotune_ticket_t ticket;
+        gfal_autotune_next(tuner, LINK, STREAMS_AND_TCP, initial, i, &ticket);
+        EXPECT_EQ(-1, ticket.probe_dim);
+        gfal_autotune_feedback(tuner, &ticket, 0, i);
+        g_free(ticket.link);
+    }
+    gfal_autotune_free(tuner);
+}
+
+
+TEST(gfalAutotune, pluginDimensions)
+{
+    EXPECT_EQ(GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_COPY_BUFFER), gfal_autotune_dimensions(NULL));
+    EXPECT_EQ(STREAMS_AND_TCP, gfal_autotune_dimensions("gridftp-2.21.0"));
+    EXPECT_EQ(GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_STREAMS), gfal_autotune_dimensions("xrootd-2.21.0"));
+    // Nothing to tune for the others
+    EXPECT_EQ(0, gfal_autotune_dimensions("http_plugin-2.21.0"));
+    EXPECT_EQ(0, gfal_autotune_dimensions("mock-2.21.0"));
+}
+
+
+TEST(gfalAutotune, onlyPluginSettings)
+{
+    gfal2_context_t context = gfal2_context_new(NULL);
+    ASSERT_TRUE(context != NULL);
+    gfal2_set_opt_boolean(context, "CORE", "COPY_AUTOTUNE", TRUE, NULL);
+    gfalt_params_t params = gfalt_params_handle_new(NULL);
+
+    // Left as they are when the plugin does not use them
+    gfal_autotune_ticket_t ticket;
+    gfalt_params_t tuned = gfal_autotune_begin(context, params, "davs://a/file", "davs://b/file",
+        gfal_autotune_dimensions("http_plugin-2.21.0"), &ticket);
+    EXPECT_EQ(params, tuned);
+    gfal_autotune_end(context, tuned, &ticket, 0);
+
+    tuned = gfal_autotune_begin(context, params, "root://a/file", "root://b/file",
+        gfal_autotune_dimensions("xrootd-2.21.0"), &ticket);
+    EXPECT_EQ(GFAL_AUTOTUNE_MASK(GFAL_AUTOTUNE_STREAMS), ticket.dimensions);
+    EXPECT_EQ(0u, gfalt_get_tcp_buffer_size(tuned, NULL));
+    gfal_autotune_end(context, tuned, &ticket, 0);
+
+    gfalt_params_handle_delete(params, NULL);
+    gfal2_context_free(context);
+}
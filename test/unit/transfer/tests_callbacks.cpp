@@ -19,7 +19,11 @@
  */
 
 #include <gtest/gtest.h>
+#include <atomic>
 #include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
 #include <gfal_api.h>
 #include <gfal_plugins_api.h>
 
@@ -56,6 +60,21 @@ static void event_callback_2(const gfalt_event_t e, gpointer user_data)
 }
 
 
+struct lazy_event_capture {
+    bool had_description;
+    std::string description;
+    gint64 monotonic;
+};
+
+static void event_callback_lazy(const gfalt_event_t e, gpointer user_data)
+{
+    lazy_event_capture *capture = (lazy_event_capture*)(user_data);
+    capture->had_description = (e->description != NULL);
+    capture->description = gfalt_event_get_description(e);
+    capture->monotonic = gfalt_event_get_monotonic_time(e);
+}
+
+
 static void event_reset_counter(gpointer user_data)
 {
     int *data = (int*)(user_data);
@@ -206,3 +225,251 @@ TEST(gfalTransfer, test_inject_callback_bulk)
 
     gfalt_params_handle_delete(params, NULL);
 }
+
+
+TEST(gfalTransfer, test_lazy_event_description)
+{
+    lazy_event_capture capture = {true, "", 0};
+    GLogLevelFlags log_level = gfal2_log_get_level();
+    gfal2_log_set_level(G_LOG_LEVEL_WARNING);
+
+    gfalt_params_t params = gfalt_params_handle_new(NULL);
+    gfalt_add_event_callback(params, event_callback_lazy, &capture, NULL, NULL);
+
+    plugin_trigger_event(params, domain, GFAL_EVENT_NONE, domain, "%s %d", "eager", 1);
+    EXPECT_TRUE(capture.had_description);
+    EXPECT_EQ("eager 1", capture.description);
+    EXPECT_GT(capture.monotonic, 0);
+
+    EXPECT_FALSE(gfalt_get_lazy_event_description(params, NULL));
+    gfalt_set_lazy_event_description(params, TRUE, NULL);
+    EXPECT_TRUE(gfalt_get_lazy_event_description(params, NULL));
+
+    plugin_trigger_event(params, domain, GFAL_EVENT_NONE, domain, "%s %d", "lazy", 2);
+    EXPECT_FALSE(capture.had_description);
+    EXPECT_EQ("lazy 2", capture.description);
+
+    gfalt_params_handle_delete(params, NULL);
+    gfal2_log_set_level(log_level);
+}
+
+
+TEST(gfalTransfer, test_lazy_event_conversions)
+{
+    lazy_event_capture capture = {true, "", 0};
+    GLogLevelFlags log_level = gfal2_log_get_level();
+    gfal2_log_set_level(G_LOG_LEVEL_WARNING);
+
+    gfalt_params_t params = gfalt_params_handle_new(NULL);
+    gfalt_add_event_callback(params, event_callback_lazy, &capture, NULL, NULL);
+    gfalt_set_lazy_event_description(params, TRUE, NULL);
+
+    plugin_trigger_event(params, domain, GFAL_EVENT_NONE, domain, "%s:%u %% %5.2f|%-4s|%hhd %lld %zu %#x %c",
+        "host", 2811u, 3.14159, "ab", 300, -5LL, (size_t)77, 255, 'z');
+    EXPECT_FALSE(capture.had_description);
+    EXPECT_EQ("host:2811 %  3.14|ab  |44 -5 77 0xff z", capture.description);
+
+    // Any format is left for later, whatever its arguments
+    plugin_trigger_event(params, domain, GFAL_EVENT_NONE, domain, "%*d|%ls", 4, 7, L"w");
+    EXPECT_FALSE(capture.had_description);
+    EXPECT_EQ("   7|w", capture.description);
+
+    plugin_trigger_event(params, domain, GFAL_EVENT_NONE, domain, "%d%d%d%d%d%d%d%d%d",
+        1, 2, 3, 4, 5, 6, 7, 8, 9);
+    EXPECT_FALSE(capture.had_description);
+    EXPECT_EQ("123456789", capture.description);
+
+    gfalt_params_handle_delete(params, NULL);
+    gfal2_log_set_level(log_level);
+}
+
+
+TEST(gfalTransfer, test_foreign_event)
+{
+    // Events built outside of gfal2 only have the public fields
+    struct _gfalt_event event;
+    event.side = GFAL_EVENT_NONE;
+    event.timestamp = g_get_real_time() / 1000;
+    event.stage = domain;
+    event.domain = domain;
+    event.description = "foreign";
+
+    lazy_event_capture capture = {false, "", 0};
+    gint64 before = g_get_monotonic_time();
+    event_callback_lazy(&event, &capture);
+
+    EXPECT_TRUE(capture.had_description);
+    EXPECT_EQ("foreign", capture.description);
+    EXPECT_LE(before - 2000, capture.monotonic);
+    EXPECT_GE(g_get_monotonic_time(), capture.monotonic);
+
+    event.description = NULL;
+    EXPECT_TRUE(gfalt_event_get_description(&event) == NULL);
+}
+
+
+struct concurrency_capture {
+    std::atomic<int> inside, max_inside, calls;
+};
+
+static void concurrency_enter(concurrency_capture *capture)
+{
+    int now = ++capture->inside;
+    int max = capture->max_inside;
+    while (now > max && !capture->max_inside.compare_exchange_weak(max, now));
+    g_usleep(100);
+    ++capture->calls;
+    --capture->inside;
+}
+
+static void monitor_callback_concurrency(gfalt_transfer_status_t h, const char* src, const char* dst,
+        gpointer user_data)
+{
+    concurrency_enter((concurrency_capture*)user_data);
+}
+
+static void event_callback_concurrency(const gfalt_event_t e, gpointer user_data)
+{
+    concurrency_enter((concurrency_capture*)user_data);
+}
+
+
+TEST(gfalTransfer, test_serialized_callbacks)
+{
+    const int nthreads = 8, ncalls = 50;
+    concurrency_capture capture;
+    capture.inside = capture.max_inside = capture.calls = 0;
+    int counter = 1;
+
+    gfalt_params_t params = gfalt_params_handle_new(NULL);
+    gfalt_add_monitor_callback(params, monitor_callback_concurrency, &capture, NULL, NULL);
+    gfalt_add_event_callback(params, event_callback_concurrency, &capture, NULL, NULL);
+    gfalt_add_event_callback(params, event_callback_1, &counter, event_reset_counter, NULL);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; ++t) {
+        threads.emplace_back([params, ncalls]() {
+            gfalt_params_t copy = gfalt_params_handle_copy_serialized(params, NULL);
+            for (int i = 0; i < ncalls; ++i) {
+                plugin_trigger_monitor(copy, NULL, "source", "destination");
+                plugin_trigger_event(copy, domain, GFAL_EVENT_NONE, domain, "TEST");
+            }
+            gfalt_params_handle_delete(copy, NULL);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(1, capture.max_inside.load());
+    EXPECT_EQ(2 * nthreads * ncalls, capture.calls.load());
+    // Deleting the copies does not release the user data of the original
+    EXPECT_EQ(1 + nthreads * ncalls, counter);
+
+    gfalt_params_handle_delete(params, NULL);
+    EXPECT_EQ(0, counter);
+}
+
+
+struct fallback_capture {
+    concurrency_capture callbacks;
+    std::atomic<int> copying, max_copying, wrong_urls;
+};
+
+static int test_plugin_copy_concurrent(plugin_handle plugin_data, gfal2_context_t context,
+        gfalt_params_t params, const char* src, const char* dst, GError**)
+{
+    fallback_capture *capture = (fallback_capture*)plugin_data;
+    int now = ++capture->copying;
+    int max = capture->max_copying;
+    while (now > max && !capture->max_copying.compare_exchange_weak(max, now));
+
+    for (int i = 0; i < 10; ++i) {
+        plugin_trigger_monitor(params, NULL, src, dst);
+        plugin_trigger_event(params, domain, GFAL_EVENT_NONE, domain, "TEST");
+        g_usleep(1000);
+    }
+    --capture->copying;
+    return 0;
+}
+
+static int test_plugin_check_single(plugin_handle plugin_data, gfal2_context_t context,
+        const char* src, const char* dst, gfal_url2_check check)
+{
+    return check == GFAL_FILE_COPY;
+}
+
+static void monitor_callback_fallback(gfalt_transfer_status_t h, const char* src, const char* dst,
+        gpointer user_data)
+{
+    fallback_capture *capture = (fallback_capture*)user_data;
+    // Each file reports its own pair
+    if (strncmp(src, "test://src", 10) != 0 || strncmp(dst, "test://dst", 10) != 0 ||
+        strcmp(src + 10, dst + 10) != 0) {
+        ++capture->wrong_urls;
+    }
+    concurrency_enter(&capture->callbacks);
+}
+
+static void event_callback_fallback(const gfalt_event_t e, gpointer user_data)
+{
+    concurrency_enter(&((fallback_capture*)user_data)->callbacks);
+}
+
+
+TEST(gfalTransfer, test_bulk_fallback_serialized_callbacks)
+{
+    const int nbfiles = 16;
+    fallback_capture capture;
+    capture.callbacks.inside = capture.callbacks.max_inside = capture.callbacks.calls = 0;
+    capture.copying = capture.max_copying = capture.wrong_urls = 0;
+
+    // No bulk support, so gfalt_copy_bulk goes through the core fallback
+    gfal_plugin_interface test_plugin;
+    memset(&test_plugin, 0, sizeof(test_plugin));
+    test_plugin.getName = test_plugin_name;
+    test_plugin.plugin_data = &capture;
+    test_plugin.check_plugin_url_transfer = test_plugin_check_single;
+    test_plugin.copy_file = test_plugin_copy_concurrent;
+
+    gfal2_context_t context = gfal2_context_new(NULL);
+    gfal2_register_plugin(context, &test_plugin, NULL);
+    gfal2_set_opt_integer(context, CORE_CONFIG_GROUP, "BULK_COPY_THREADS", 8, NULL);
+    gfal2_set_opt_integer(context, CORE_CONFIG_GROUP, "BULK_COPY_MAX_PER_SOURCE", 0, NULL);
+    gfal2_set_opt_integer(context, CORE_CONFIG_GROUP, "BULK_COPY_MAX_PER_DESTINATION", 0, NULL);
+
+    std::vector<std::string> src_str, dst_str;
+    std::vector<const char*> sources, destinations;
+    for (int i = 0; i < nbfiles; ++i) {
+        src_str.push_back("test://src" + std::to_string(i));
+        dst_str.push_back("test://dst" + std::to_string(i));
+    }
+    for (int i = 0; i < nbfiles; ++i) {
+        sources.push_back(src_str[i].c_str());
+        destinations.push_back(dst_str[i].c_str());
+    }
+
+    gfalt_params_t params = gfalt_params_handle_new(NULL);
+    gfalt_add_monitor_callback(params, monitor_callback_fallback, &capture, NULL, NULL);
+    gfalt_add_event_callback(params, event_callback_fallback, &capture, NULL, NULL);
+
+    GError* op_error = NULL;
+    GError** file_errors = NULL;
+    EXPECT_EQ(0, gfalt_copy_bulk(context, params, nbfiles, sources.data(), destinations.data(), NULL,
+        &op_error, &file_errors));
+    EXPECT_TRUE(op_error == NULL);
+    for (int i = 0; i < nbfiles; ++i) {
+        EXPECT_TRUE(file_errors[i] == NULL);
+    }
+    g_free(file_errors);
+
+    // The copies did overlap, but their callbacks did not
+    EXPECT_GT(capture.max_copying.load(), 1);
+    EXPECT_EQ(1, capture.callbacks.max_inside.load());
+    EXPECT_EQ(0, capture.wrong_urls.load());
+    // Core events of each copy on top of the ones triggered by the plugin
+    EXPECT_GE(capture.callbacks.calls.load(), 2 * 10 * nbfiles);
+
+    gfalt_params_handle_delete(params, NULL);
+    gfal2_context_free(context);
+}
@@ -21,6 +21,7 @@
 #include <gtest/gtest.h>
 #include <cstdlib>
 #include <gfal_api.h>
+#include <gfal_plugins_api.h>
 
 
 TEST(gfalTransfer, testparam){
@@ -77,3 +78,36 @@ TEST(gfalTransfer, testlocaltransfer){
     ASSERT_TRUE( res == FALSE && ret == FALSE && tmp_err==NULL);
     gfalt_params_handle_delete(p,NULL);
 }
+
+
+TEST(gfalTransfer, testbulkfilechecksum){
+    GError * tmp_err=NULL;
+    char type[64], value[512];
+    gfalt_params_t p = gfalt_params_handle_new(&tmp_err);
+    ASSERT_TRUE( p != NULL && tmp_err==NULL);
+    gfalt_set_checksum(p, GFALT_CHECKSUM_TARGET, "MD5", "0123", &tmp_err);
+
+    gfalt_params_t f = gfalt_params_handle_copy_bulk_file(p, "ADLER32:89abcdef", &tmp_err);
+    ASSERT_TRUE( f != NULL && tmp_err==NULL);
+    ASSERT_EQ(GFALT_CHECKSUM_TARGET, gfalt_get_checksum(f, type, sizeof(type), value, sizeof(value), &tmp_err));
+    ASSERT_STREQ("ADLER32", type);
+    ASSERT_STREQ("89abcdef", value);
+    gfalt_params_handle_delete(f, NULL);
+
+    // Only the value, the type is the one of the parameters
+    f = gfalt_params_handle_copy_bulk_file(p, "89abcdef", &tmp_err);
+    ASSERT_TRUE( f != NULL && tmp_err==NULL);
+    gfalt_get_checksum(f, type, sizeof(type), value, sizeof(value), &tmp_err);
+    ASSERT_STREQ("MD5", type);
+    ASSERT_STREQ("89abcdef", value);
+    gfalt_params_handle_delete(f, NULL);
+
+    f = gfalt_params_handle_copy_bulk_file(p, "", &tmp_err);
+    ASSERT_TRUE( f != NULL && tmp_err==NULL);
+    gfalt_get_checksum(f, type, sizeof(type), value, sizeof(value), &tmp_err);
+    ASSERT_STREQ("MD5", type);
+    ASSERT_STREQ("0123", value);
+    gfalt_params_handle_delete(f, NULL);
+
+    gfalt_params_handle_delete(p, NULL);
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <gfal_api.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <checksums/checksums.h>
+#include <transfer/gfal_transfer_internal.h>
+
+#define RESUME_SOURCE_SIZE (8 * 1048576)
+
+
+TEST(gfalResume, adler32)
+{
+    const char* data = "Wikipedia";
+    EXPECT_EQ(0x11E60398ul, gfal2_adler32(1, data, strlen(data)));
+
+    // Updating it piece by piece gives the same value
+    std::string large(100000, '\xff');
+    unsigned long whole = gfal2_adler32(1, large.data(), large.size());
+    unsigned long running = 1;
+    for (size_t i = 0; i < large.size(); i += 7000) {
+        running = gfal2_adler32(running, large.data() + i, std::min<size_t>(7000, large.size() - i));
+    }
+    EXPECT_EQ(whole, running);
+}
+
+
+TEST(gfalResume, checkpointRoundtrip)
+{
+    gfal_checkpoint_t cp;
+    memset(&cp, 0, sizeof(cp));
+    cp.offset = 5368709120LL;
+    cp.adler32 = 0x0a0b0c0d;
+    cp.src_size = 10737418240LL;
+    cp.src_mtime = 1500000000;
+
+    const char* src = "file:///tmp/source with spaces";
+    gchar* value = gfal_checkpoint_format(&cp, src);
+
+    gfal_checkpoint_t parsed;
+    memset(&parsed, 0, sizeof(parsed));
+    ASSERT_TRUE(gfal_checkpoint_parse(value, src, &parsed));
+    EXPECT_EQ(cp.offset, parsed.offset);
+    EXPECT_EQ(cp.adler32, parsed.adler32);
+    EXPECT_EQ(cp.src_size, parsed.src_size);
+    EXPECT_EQ(cp.src_mtime, parsed.src_mtime);
+
+    // A checkpoint of a copy from somewhere else is not valid
+    EXPECT_FALSE(gfal_checkpoint_parse(value, "file:///tmp/source", &parsed));
+    g_free(value);
+}
+
+
+TEST(gfalResume, checkpointInvalid)
+{
+    gfal_checkpoint_t cp;
+    EXPECT_FALSE(gfal_checkpoint_parse("", "file:///tmp/source", &cp));
+    EXPECT_FALSE(gfal_checkpoint_parse("garbage", "file:///tmp/source", &cp));
+    EXPECT_FALSE(gfal_checkpoint_parse("2 10 00000001 20 30 file:///tmp/source", "file:///tmp/source", &cp));
+    EXPECT_FALSE(gfal_checkpoint_parse("1 -10 00000001 20 30 file:///tmp/source", "file:///tmp/source", &cp));
+}
+
+
+// Streamed copies between local files, interrupted right after their first checkpoint
+class ResumeCopyTest: public testing::Test {
+protected:
+    gfal2_context_t context;
+    gfalt_params_t params;
+    std::string src, dst;
+    guint log_handler;
+
+    std::mutex lock;
+    std::vector<std::string> messages;
+    bool interrupt;
+    std::thread canceller;
+
+    static void log_handler_func(const gchar*, GLogLevelFlags, const gchar* message, gpointer user_data)
+    {
+        ResumeCopyTest* self = static_cast<ResumeCopyTest*>(user_data);
+        bool cancel = false;
+        {
+            std::lock_guard<std::mutex> guard(self->lock);
+            self->messages.push_back(message);
+            if (self->interrupt && strncmp(message, "Checkpoint of", 13) == 0) {
+                self->interrupt = false;
+                cancel = true;
+            }
+        }
+        if (cancel) {
+            // gfal2_cancel waits for the copy to finish, so it has to be called from elsewhere
+            gfal2_context_t context = self->context;
+            self->canceller = std::thread([context]() { gfal2_cancel(context); });
+            while (!gfal2_is_canceled(context)) {
+                usleep(100);
+            }
+        }
+    }
+
+    static std::string make_temp(const char* suffix)
+    {
+        char tmpl[64];
+        g_snprintf(tmpl, sizeof(tmpl), "/tmp/gfal2_test_resume_%s.XXXXXX", suffix);
+        int fd = mkstemp(tmpl);
+        EXPECT_GE(fd, 0);
+        close(fd);
+        unlink(tmpl);
+        return tmpl;
+    }
+
+    static std::string read_file(const std::string& path)
+    {
+        std::string content;
+        char buffer[65536];
+        int fd = open(path.c_str(), O_RDONLY);
+        EXPECT_GE(fd, 0) << path;
+        ssize_t ret;
+        while ((ret = read(fd, buffer, sizeof(buffer))) > 0) {
+            content.append(buffer, ret);
+        }
+        close(fd);
+        return content;
+    }
+
+    void write_source(char salt)
+    {
+        std::string content(RESUME_SOURCE_SIZE, '\0');
+        for (size_t i = 0; i < content.size(); ++i) {
+            content[i] = (char)((i * 31 + salt) % 251);
+        }
+        int fd = open(src.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ((ssize_t)content.size(), write(fd, content.data(), content.size()));
+        close(fd);
+    }
+
+    virtual void SetUp()
+    {
+        GError* error = NULL;
+        context = gfal2_context_new(&error);
+        ASSERT_TRUE(context != NULL);
+
+        src = make_temp("src");
+        dst = make_temp("dst");
+        write_source(0);
+
+        struct stat st;
+        ASSERT_EQ(0, gfal2_stat(context, ("file://" + src).c_str(), &st, &error))
+            << "The file plugin is not available: " << (error ? error->message : "");
+
+        // Small buffers and a checkpoint every MiB, so there are a few of them
+        gfal2_set_opt_integer(context, "CORE", "COPY_BUFFERSIZE", 65536, NULL);
+        gfal2_set_opt_integer(context, "CORE", "COPY_CHECKPOINT_INTERVAL", 1, NULL);
+
+        params = gfalt_params_handle_new(NULL);
+        gfalt_set_replace_existing_file(params, TRUE, NULL);
+        gfalt_set_resume(params, TRUE, NULL);
+
+        interrupt = false;
+        gfal2_log_set_level(G_LOG_LEVEL_DEBUG);
+        log_handler = gfal2_log_set_handler(log_handler_func, this);
+    }
+
+    virtual void TearDown()
+    {
+        g_log_remove_handler("GFAL2", log_handler);
+        gfal2_log_set_level(G_LOG_LEVEL_WARNING);
+        gfalt_params_handle_delete(params, NULL);
+        gfal2_context_free(context);
+        unlink(src.c_str());
+        unlink(dst.c_str());
+        unlink((dst + ".gfal2-checkpoint").c_str());
+    }
+
+    int copy(GError** error)
+    {
+        return gfalt_copy_file(context, params, ("file://" + src).c_str(), ("file://" + dst).c_str(), error);
+    }
+
+    // Leave dst with part of the source, and its checkpoint
+    void copy_interrupted()
+    {
+        interrupt = true;
+        GError* error = NULL;
+        EXPECT_EQ(-1, copy(&error));
+        if (canceller.joinable()) {
+            canceller.join();
+        }
+        ASSERT_TRUE(error != NULL);
+        EXPECT_EQ(ECANCELED, error->code);
+        g_clear_error(&error);
+
+        struct stat st;
+        ASSERT_EQ(0, stat(dst.c_str(), &st));
+        EXPECT_GT(st.st_size, 0);
+        EXPECT_LT(st.st_size, RESUME_SOURCE_SIZE);
+    }
+
+    bool logged(const char* text)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto& message : messages) {
+            if (message.find(text) != std::string::npos) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The result must be the same as a copy from scratch
+    void expect_same_as_fresh_copy()
+    {
+        std::string fresh = make_temp("fresh");
+        GError* error = NULL;
+        gfalt_params_t fresh_params = gfalt_params_handle_new(NULL);
+        ASSERT_EQ(0, gfalt_copy_file(context, fresh_params, ("file://" + src).c_str(), ("file://" + fresh).c_str(),
+            &error)) << (error ? error->message : "");
+        gfalt_params_handle_delete(fresh_params, NULL);
+
+        EXPECT_TRUE(read_file(fresh) == read_file(dst));
+
+        char fresh_checksum[64], dst_checksum[64];
+        ASSERT_EQ(0, gfal2_checksum(context, ("file://" + fresh).c_str(), "ADLER32", 0, 0,
+            fresh_checksum, sizeof(fresh_checksum), &error));
+        ASSERT_EQ(0, gfal2_checksum(context, ("file://" + dst).c_str(), "ADLER32", 0, 0,
+            dst_checksum, sizeof(dst_checksum), &error));
+        EXPECT_STREQ(fresh_checksum, dst_checksum);
+        unlink(fresh.c_str());
+    }
+};
+
+
+TEST_F(ResumeCopyTest, resume)
+{
+    copy_interrupted();
+
+    GError* error = NULL;
+    ASSERT_EQ(0, copy(&error)) << (error ? error->message : "");
+    EXPECT_TRUE(logged("Resuming the copy into"));
+    expect_same_as_fresh_copy();
+
+    // Cleared once complete
+    EXPECT_NE(0, access((dst + ".gfal2-checkpoint").c_str(), F_OK));
+}
+
+
+TEST_F(ResumeCopyTest, sourceChanged)
+{
+    copy_interrupted();
+
+    // Same size, different content and modification time
+    write_source(7);
+    struct timeval times[2];
+    gettimeofday(&times[0], NULL);
+    times[0].tv_sec += 10;
+    times[1] = times[0];
+    ASSERT_EQ(0, utimes(src.c_str(), times));
+
+    GError* error = NULL;
+    ASSERT_EQ(0, copy(&error)) << (error ? error->message : "");
+    EXPECT_TRUE(logged("changed since the checkpoint"));
+    EXPECT_FALSE(logged("Resuming the copy into"));
+    expect_same_as_fresh_copy();
+}
+
+
+TEST_F(ResumeCopyTest, corruptedPrefix)
+{
+    copy_interrupted();
+
+    // Flip a byte of what the checkpoint covers
+    int fd = open(dst.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    char byte;
+    ASSERT_EQ(1, pread(fd, &byte, 1, 100));
+    byte = ~byte;
+    ASSERT_EQ(1, pwrite(fd, &byte, 1, 100));
+    close(fd);
+
+    GError* error = NULL;
+    ASSERT_EQ(0, copy(&error)) << (error ? error->message : "");
+    EXPECT_TRUE(logged("do not match its checkpoint"));
+    EXPECT_FALSE(logged("Resuming the copy into"));
+    expect_same_as_fresh_copy();
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) CERN 2013-2017
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gfal_api.h>
+#include <gfal_plugins_api.h>
+#include <gtest/gtest.h>
+
+#include "gfal_xrootd_plugin_interface.h"
+#include "gfal_xrootd_plugin_io.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define CHUNK_SIZE 4096
+
+
+// XrdCl serves file:// urls itself, so the plugin I/O can be run without a server
+class XrootdIoTest: public testing::Test {
+protected:
+    gfal2_context_t context;
+    std::string path;
+    std::vector<char> content;
+
+    virtual void SetUp()
+    {
+        GError *error = NULL;
+        context = gfal2_context_new(&error);
+        ASSERT_TRUE(context != NULL);
+
+        char tmpl[] = "/tmp/gfal2_test_xrootd_io.XXXXXX";
+        int fd = mkstemp(tmpl);
+        ASSERT_GE(fd, 0);
+        path = tmpl;
+
+        // Not a multiple of the chunk size, so the last read is short
+        content.resize(10 * CHUNK_SIZE + 123);
+        for (size_t i = 0; i < content.size(); ++i) {
+            content[i] = (char)((i * 7) % 251);
+        }
+        ASSERT_EQ((ssize_t)content.size(), write(fd, content.data(), content.size()));
+        close(fd);
+    }
+
+    virtual void TearDown()
+    {
+        unlink(path.c_str());
+        gfal2_context_free(context);
+    }
+
+    // Same setup as gfal_xrootd_openG, but the size is left unknown unless stat_size is set
+    XrootdFile* open_file(unsigned depth, bool stat_size)
+    {
+        XrootdFile* xfile = new XrootdFile();
+        xfile->chunk_size = CHUNK_SIZE;
+        xfile->depth = depth;
+
+        XrdCl::XRootDStatus status = xfile->file.Open("file://localhost" + path, XrdCl::OpenFlags::Read);
+        EXPECT_TRUE(status.IsOK()) << status.ToStr();
+
+        if (stat_size) {
+            xfile->size = content.size();
+            xfile->size_known = true;
+        }
+        return xfile;
+    }
+
+    void close_file(gfal_file_handle fh)
+    {
+        GError *error = NULL;
+        EXPECT_EQ(0, gfal_xrootd_closeG(context, fh, &error));
+        EXPECT_TRUE(error == NULL);
+    }
+};
+
+
+TEST_F(XrootdIoTest, readAheadSequential)
+{
+    XrootdFile* xfile = open_file(4, true);
+    gfal_file_handle fh = gfal_file_handle_new("xrootd", xfile);
+    GError *error = NULL;
+
+    // Odd sized reads, so they do not align with the chunks
+    std::vector<char> buffer(content.size() + 100);
+    size_t total = 0;
+    ssize_t ret;
+    while ((ret = gfal_xrootd_readG(context, fh, buffer.data() + total, 1000, &error)) > 0) {
+        total += ret;
+        ASSERT_LE(total, content.size());
+    }
+    ASSERT_EQ(0, ret);
+    ASSERT_TRUE(error == NULL);
+    EXPECT_EQ(content.size(), total);
+    EXPECT_EQ(0, memcmp(content.data(), buffer.data(), content.size()));
+
+    close_file(fh);
+}
+
+
+TEST_F(XrootdIoTest, readAheadUnknownSize)
+{
+    XrootdFile* xfile = open_file(4, false);
+    XrdCl::XRootDStatus status;
+    std::vector<char> buffer(content.size() + CHUNK_SIZE);
+
+    // Without a size, only what is asked for is requested
+    ASSERT_EQ(100, xrootd_read_ahead(xfile, buffer.data(), 100, status));
+    EXPECT_EQ(1u, xfile->window.size());
+    EXPECT_FALSE(xfile->size_known);
+
+    size_t total = 100;
+    ssize_t ret;
+    while ((ret = xrootd_read_ahead(xfile, buffer.data() + total, 3 * CHUNK_SIZE, status)) > 0) {
+        total += ret;
+        ASSERT_LE(total, content.size());
+        // Nothing beyond the requested range
+        ASSERT_LE(xfile->window.size(), 4u);
+        for (size_t i = 0; i < xfile->window.size(); ++i) {
+            ASSERT_LT(xfile->window[i]->offset, xfile->offset + 3 * CHUNK_SIZE);
+        }
+    }
+    ASSERT_EQ(0, ret) << status.ToStr();
+    EXPECT_EQ(content.size(), total);
+    EXPECT_EQ(0, memcmp(content.data(), buffer.data(), content.size()));
+
+    // The short read gave away the end of file, and nothing past it is left in flight
+    EXPECT_TRUE(xfile->size_known);
+    EXPECT_EQ(content.size(), xfile->size);
+    for (size_t i = 0; i < xfile->window.size(); ++i) {
+        EXPECT_LT(xfile->window[i]->offset, xfile->size);
+    }
+
+    // Further reads stay at the end
+    EXPECT_EQ(0, xrootd_read_ahead(xfile, buffer.data(), CHUNK_SIZE, status));
+    for (size_t i = 0; i < xfile->window.size(); ++i) {
+        EXPECT_LT(xfile->window[i]->offset, xfile->size);
+    }
+
+    delete xfile;
+}
+
+
+TEST_F(XrootdIoTest, readAheadSeek)
+{
+    XrootdFile* xfile = open_file(4, true);
+    gfal_file_handle fh = gfal_file_handle_new("xrootd", xfile);
+    GError *error = NULL;
+    char buffer[CHUNK_SIZE];
+
+    ASSERT_EQ(CHUNK_SIZE, gfal_xrootd_readG(context, fh, buffer, CHUNK_SIZE, &error));
+    EXPECT_EQ(0, memcmp(content.data(), buffer, CHUNK_SIZE));
+
+    // Forward outside of the window, and then back
+    off_t positions[] = {8 * CHUNK_SIZE + 17, 10, (off_t)content.size() - 50};
+    for (size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); ++i) {
+        ASSERT_EQ(positions[i], gfal_xrootd_lseekG(context, fh, positions[i], SEEK_SET, &error));
+        size_t expected = std::min<size_t>(100, content.size() - positions[i]);
+        ASSERT_EQ((ssize_t)expected, gfal_xrootd_readG(context, fh, buffer, 100, &error));
+        EXPECT_EQ(0, memcmp(content.data() + positions[i], buffer, expected));
+    }
+    ASSERT_TRUE(error == NULL);
+
+    close_file(fh);
+}
+
+
+TEST_F(XrootdIoTest, parallelRead)
+{
+    XrootdFile* xfile = open_file(3, true);
+    gfal_file_handle fh = gfal_file_handle_new("xrootd", xfile);
+    GError *error = NULL;
+    std::vector<char> buffer(content.size());
+
+    // Split in chunks, more than the outstanding limit
+    ASSERT_EQ((ssize_t)content.size(), gfal_xrootd_preadG(context, fh, buffer.data(), content.size(), 0, &error));
+    EXPECT_EQ(0, memcmp(content.data(), buffer.data(), content.size()));
+
+    // Crossing the end of file
+    off_t offset = 7 * CHUNK_SIZE + 5;
+    ASSERT_EQ((ssize_t)(content.size() - offset),
+        gfal_xrootd_preadG(context, fh, buffer.data(), 5 * CHUNK_SIZE, offset, &error));
+    EXPECT_EQ(0, memcmp(content.data() + offset, buffer.data(), content.size() - offset));
+
+    // Past the end of file
+    EXPECT_EQ(0, gfal_xrootd_preadG(context, fh, buffer.data(), 100, content.size() + 10, &error));
+    EXPECT_TRUE(error == NULL);
+
+    close_file(fh);
+}
+
+
+TEST_F(XrootdIoTest, vectorRead)
+{
+    XrootdFile* xfile = open_file(4, true);
+    xfile->vector_read = true;
+    gfal_file_handle fh = gfal_file_handle_new("xrootd", xfile);
+    GError *error = NULL;
+    std::vector<char> buffer(content.size());
+
+    off_t offset = CHUNK_SIZE / 2;
+    ASSERT_EQ((ssize_t)(6 * CHUNK_SIZE), gfal_xrootd_preadG(context, fh, buffer.data(), 6 * CHUNK_SIZE, offset, &error));
+    EXPECT_EQ(0, memcmp(content.data() + offset, buffer.data(), 6 * CHUNK_SIZE));
+
+    // Crossing the end of file falls back to plain reads
+    offset = 8 * CHUNK_SIZE;
+    ASSERT_EQ((ssize_t)(content.size() - offset),
+        gfal_xrootd_preadG(context, fh, buffer.data(), 4 * CHUNK_SIZE, offset, &error));
+    EXPECT_EQ(0, memcmp(content.data() + offset, buffer.data(), content.size() - offset));
+    EXPECT_TRUE(error == NULL);
+
+    close_file(fh);
+}